@@ -21,7 +21,7 @@
 
 // other copyright notices: see end of file
 
-#include "globals.h"
+#include <cstring>
 #include "md4.h"
 #include <stdlib.h>
 #include <algorithm>
@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 
+#if defined(_MSC_VER)
 // Work-around for Microsoft double declaration
 #define _interlockedbittestandset _ms_set
 #define _interlockedbittestandreset _ms_reset
@@ -33,7 +34,13 @@
 #undef _interlockedbittestandreset
 #undef _interlockedbittestandset
 #undef _interlockedbittestandreset
+#else
+#include <stdint.h>
+#define __forceinline inline __attribute__((always_inline))
+#define __in_bcount(size)
+#endif
 
+#if defined(_MSC_VER)
 //! \brief platform independent signed 8 bit integer type.
 typedef __int8 int8;
 //! \brief platform independent signed 16 bit integer type.
@@ -51,6 +58,16 @@ typedef unsigned __int16 uint16;
 typedef unsigned long uint32;
 //! \brief platform independent unsigned 64 bit integer type.
 typedef unsigned __int64 uint64;
+#else
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef int64_t int64;
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+#endif
 
 //! \brief alias for unsigned char.
 typedef unsigned char uchar;
@@ -79,7 +96,7 @@ namespace Machine
 	//! \brief Specifies the natural byte ordering of the target machine.
 	//! \todo detect endianess during compilation.
 	const Endianess endianess = littleEndian; // x86
-#ifndef _WIN64
+#if defined(_MSC_VER) && !defined(_WIN64)
 	inline uint64 cpuFlags()
 	{
 		__asm
@@ -95,7 +112,7 @@ namespace Machine
 	inline bool SupportsSSE() { return ( cpuFlags() & 0x02000000 ) != 0; }
 	inline bool SupportsSSE2() { return ( cpuFlags() & 0x04000000 ) != 0; }
 	inline bool SupportsSSE3() { return ( cpuFlags() & 0x100000000 ) != 0; }
-#elif defined _WIN64
+#else
 	inline bool SupportsMMX() { return false; }
 	inline bool SupportsSSE() { return true; }
 	inline bool SupportsSSE2() { return true; }
@@ -118,7 +135,11 @@ template<> struct SwapEndianess< uint16 >
 {
 	uint16 operator()(uint16 value) const
 	{
+#if defined(_MSC_VER)
 		return _byteswap_ushort( value );
+#else
+		return __builtin_bswap16( value );
+#endif
 	}
 };
 
@@ -126,7 +147,11 @@ template<> struct SwapEndianess< uint32 >
 {
 	uint32 operator()(uint32 value) const
 	{
+#if defined(_MSC_VER)
 		return _byteswap_ulong( value );
+#else
+		return __builtin_bswap32( value );
+#endif
 	}
 };
 
@@ -134,7 +159,11 @@ template<> struct SwapEndianess< uint64 >
 {
 	uint64 operator()(uint64 value) const
 	{
+#if defined(_MSC_VER)
 		return _byteswap_uint64( value );
+#else
+		return __builtin_bswap64( value );
+#endif
 	}
 };
 
@@ -238,7 +267,7 @@ inline void for_each_if(InputIterator first, InputIterator last,
 	for ( ; first != last; ++first )
 	{
 		if ( pred( *first ) )
-			f( *first )
+			f( *first );
 	}
 }
 
@@ -267,8 +296,12 @@ template<> inline uint64 rotateLeft(uint64 value, uint8 shift)
 //! If the argument is 0 the result is unspecified.
 inline uint32 highestBitSet(uint32 value)
 {
+#if defined(_MSC_VER)
 	uint32 index;
 	return _BitScanReverse( &index, value ) ? index : 0;
+#else
+	return value ? 31 - __builtin_clz( value ) : 0;
+#endif
 }
 
 inline uint32 highestBitSet(uint64 value)
@@ -289,8 +322,12 @@ inline uint32 highestBitSet(uint64 value)
 //! If the argument is 0 the result is unspecified.
 inline uint32 lowestBitSet(uint32 value)
 {
+#if defined(_MSC_VER)
 	uint32 index;
 	return _BitScanForward( &index, value ) ? index : 0;
+#else
+	return value ? __builtin_ctz( value ) : 0;
+#endif
 }
 
 inline uint32 lowestBitSet(uint64 value)
@@ -0,0 +1,561 @@
+/*
+   BLAKE2 reference source code package - optimized C implementations
+
+   Copyright 2012, Samuel Neves <sneves@dei.uc.pt>.  You may use this under the
+   terms of the CC0, the OpenSSL Licence, or the Apache Public License 2.0, at
+   your option.  The terms of these licenses can be found at:
+
+   - CC0 1.0 Universal : http://creativecommons.org/publicdomain/zero/1.0
+   - OpenSSL license   : https://www.openssl.org/source/license.html
+   - Apache 2.0        : http://www.apache.org/licenses/LICENSE-2.0
+
+   More information about the BLAKE2 hash function can be found at
+   https://blake2.net.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "blake2.h"
+#include "blake2-impl.h"
+#include "../cpu_features.h"
+
+#define PARALLELISM_DEGREE 4
+
+#if defined(_MSC_VER)
+#define BLAKE2BP_TARGET(x)
+#else
+#define BLAKE2BP_TARGET(x) __attribute__((target(x)))
+#endif
+
+/*
+  As in blake2sp.c the leaves receive the same number of blocks until
+  blake2bp_final and are compressed in lockstep. The four BLAKE2b leaves are
+  kept word sliced in the 64 bit lanes of one AVX2 register per state word.
+  Without AVX2 every leaf is fed to blake2b_update on its own.
+*/
+
+static const uint64_t blake2bp_IV[8] =
+{
+  0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+  0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+  0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+  0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint8_t blake2bp_sigma[12][16] =
+{
+  {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
+  { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 } ,
+  { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 } ,
+  {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 } ,
+  {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 } ,
+  {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 } ,
+  { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 } ,
+  { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 } ,
+  {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 } ,
+  { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 } ,
+  {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
+  { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+/* 0: none (serial leaves), 1: AVX2 */
+static int blake2bp_level = -1;
+
+/* fastest first, the index counts down from level 1 */
+static const CPU_KERNEL blake2bp_kernels[] =
+{
+  { "avx2",   CPU_AVX2, NULL },
+  { "serial", 0,        NULL },
+};
+
+static int blake2bp_select_level( void )
+{
+  return 1 - ( int )cpu_select_kernel( "blake2bp", blake2bp_kernels, 2 );
+}
+
+#define ADD(a,b)  _mm256_add_epi64( a, b )
+#define XOR(a,b)  _mm256_xor_si256( a, b )
+#define ROT32(x)  _mm256_shuffle_epi32( x, _MM_SHUFFLE( 2, 3, 0, 1 ) )
+#define ROT24(x)  _mm256_shuffle_epi8( x, r24 )
+#define ROT16(x)  _mm256_shuffle_epi8( x, r16 )
+#define ROT63(x)  _mm256_or_si256( _mm256_srli_epi64( x, 63 ), _mm256_add_epi64( x, x ) )
+
+#define BLAKE2BP_G(a,b,c,d,x,y) \
+  v[a] = ADD( ADD( v[a], v[b] ), m[x] ); \
+  v[d] = ROT32( XOR( v[d], v[a] ) ); \
+  v[c] = ADD( v[c], v[d] ); \
+  v[b] = ROT24( XOR( v[b], v[c] ) ); \
+  v[a] = ADD( ADD( v[a], v[b] ), m[y] ); \
+  v[d] = ROT16( XOR( v[d], v[a] ) ); \
+  v[c] = ADD( v[c], v[d] ); \
+  v[b] = ROT63( XOR( v[b], v[c] ) );
+
+#define BLAKE2BP_ROUND(s) \
+  BLAKE2BP_G( 0, 4,  8, 12, s[ 0], s[ 1] ) \
+  BLAKE2BP_G( 1, 5,  9, 13, s[ 2], s[ 3] ) \
+  BLAKE2BP_G( 2, 6, 10, 14, s[ 4], s[ 5] ) \
+  BLAKE2BP_G( 3, 7, 11, 15, s[ 6], s[ 7] ) \
+  BLAKE2BP_G( 0, 5, 10, 15, s[ 8], s[ 9] ) \
+  BLAKE2BP_G( 1, 6, 11, 12, s[10], s[11] ) \
+  BLAKE2BP_G( 2, 7,  8, 13, s[12], s[13] ) \
+  BLAKE2BP_G( 3, 4,  9, 14, s[14], s[15] )
+
+/* transposes four rows of four 64 bit words */
+BLAKE2BP_TARGET("avx2")
+static BLAKE2_INLINE void blake2bp_transpose4( __m256i r[4] )
+{
+  __m256i t0 = _mm256_unpacklo_epi64( r[0], r[1] );
+  __m256i t1 = _mm256_unpackhi_epi64( r[0], r[1] );
+  __m256i t2 = _mm256_unpacklo_epi64( r[2], r[3] );
+  __m256i t3 = _mm256_unpackhi_epi64( r[2], r[3] );
+  r[0] = _mm256_permute2x128_si256( t0, t2, 0x20 );
+  r[1] = _mm256_permute2x128_si256( t1, t3, 0x20 );
+  r[2] = _mm256_permute2x128_si256( t0, t2, 0x31 );
+  r[3] = _mm256_permute2x128_si256( t1, t3, 0x31 );
+}
+
+/*
+  Compresses count blocks into every leaf. Block k of leaf i starts at
+  blocks[i] + k * stride. t is the counter before the first block.
+*/
+BLAKE2BP_TARGET("avx2")
+static void blake2bp_compress_avx2( blake2bp_state *S, const uint8_t * const blocks[PARALLELISM_DEGREE],
+                                    size_t stride, size_t count, uint64_t t0, uint64_t t1 )
+{
+  const __m256i r16 = _mm256_setr_epi8( 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9 );
+  const __m256i r24 = _mm256_setr_epi8( 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10 );
+  __m256i h[8], v[16], m[16];
+  size_t i, j, k, r;
+
+  for( j = 0; j < 8; j += 4 )
+  {
+    for( i = 0; i < PARALLELISM_DEGREE; ++i )
+      h[j + i] = _mm256_loadu_si256( (const __m256i *)( S->S[i]->h + j ) );
+    blake2bp_transpose4( h + j );
+  }
+
+  for( k = 0; k < count; ++k )
+  {
+    const size_t offset = k * stride;
+    t0 += BLAKE2B_BLOCKBYTES;
+    t1 += ( t0 < BLAKE2B_BLOCKBYTES );
+
+    for( j = 0; j < 16; j += 4 )
+    {
+      for( i = 0; i < PARALLELISM_DEGREE; ++i )
+        m[j + i] = _mm256_loadu_si256( (const __m256i *)( blocks[i] + offset + j * 8 ) );
+      blake2bp_transpose4( m + j );
+    }
+
+    for( i = 0; i < 8; ++i )
+      v[i] = h[i];
+    for( i = 0; i < 4; ++i )
+      v[i + 8] = _mm256_set1_epi64x( (long long)blake2bp_IV[i] );
+    v[12] = _mm256_set1_epi64x( (long long)( blake2bp_IV[4] ^ t0 ) );
+    v[13] = _mm256_set1_epi64x( (long long)( blake2bp_IV[5] ^ t1 ) );
+    v[14] = _mm256_set1_epi64x( (long long)blake2bp_IV[6] );
+    v[15] = _mm256_set1_epi64x( (long long)blake2bp_IV[7] );
+
+    for( r = 0; r < 12; ++r )
+    {
+      const uint8_t *s = blake2bp_sigma[r];
+      BLAKE2BP_ROUND( s )
+    }
+
+    for( i = 0; i < 8; ++i )
+      h[i] = XOR( h[i], XOR( v[i], v[i + 8] ) );
+  }
+
+  for( j = 0; j < 8; j += 4 )
+  {
+    blake2bp_transpose4( h + j );
+    for( i = 0; i < PARALLELISM_DEGREE; ++i )
+      _mm256_storeu_si256( (__m256i *)( S->S[i]->h + j ), h[j + i] );
+  }
+}
+
+#undef ADD
+#undef XOR
+#undef ROT32
+#undef ROT24
+#undef ROT16
+#undef ROT63
+
+/*
+  Feeds count stripes of PARALLELISM_DEGREE blocks to the leaves, keeping the
+  last block of every leaf buffered like blake2b_update does.
+*/
+static void blake2bp_feed_stripes( blake2bp_state *S, const uint8_t *in, size_t count )
+{
+  const uint8_t *blocks[PARALLELISM_DEGREE];
+  uint64_t t0, t1;
+  size_t i;
+
+  if( count == 0 ) return;
+
+  if( blake2bp_level < 0 )
+    blake2bp_level = blake2bp_select_level();
+
+  if( blake2bp_level == 0 )
+  {
+    for( ; count > 0; --count, in += PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES )
+      for( i = 0; i < PARALLELISM_DEGREE; ++i )
+        blake2b_update( S->S[i], in + i * BLAKE2B_BLOCKBYTES, BLAKE2B_BLOCKBYTES );
+    return;
+  }
+
+  /* all leaves share counter and buffer fill level */
+  t0 = S->S[0]->t[0];
+  t1 = S->S[0]->t[1];
+
+  if( S->S[0]->buflen == BLAKE2B_BLOCKBYTES )
+  {
+    for( i = 0; i < PARALLELISM_DEGREE; ++i )
+      blocks[i] = S->S[i]->buf;
+    blake2bp_compress_avx2( S, blocks, 0, 1, t0, t1 );
+    t0 += BLAKE2B_BLOCKBYTES;
+    t1 += ( t0 < BLAKE2B_BLOCKBYTES );
+  }
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    blocks[i] = in + i * BLAKE2B_BLOCKBYTES;
+  if( count > 1 )
+  {
+    const uint64_t inc = ( uint64_t )( count - 1 ) * BLAKE2B_BLOCKBYTES;
+    blake2bp_compress_avx2( S, blocks, PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES, count - 1, t0, t1 );
+    t0 += inc;
+    t1 += ( t0 < inc );
+  }
+
+  in += ( count - 1 ) * PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES;
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+  {
+    S->S[i]->t[0] = t0;
+    S->S[i]->t[1] = t1;
+    memcpy( S->S[i]->buf, in + i * BLAKE2B_BLOCKBYTES, BLAKE2B_BLOCKBYTES );
+    S->S[i]->buflen = BLAKE2B_BLOCKBYTES;
+  }
+}
+
+/*
+  blake2bp_init_param defaults to setting the expecting output length
+  from the digest_length parameter block field.
+
+  In some cases, however, we do not want this, as the output length
+  of these instances is given by inner_length instead.
+*/
+static int blake2bp_init_leaf_param( blake2b_state *S, const blake2b_param *P )
+{
+  int err = blake2b_init_param(S, P);
+  S->outlen = P->inner_length;
+  return err;
+}
+
+static int blake2bp_init_leaf( blake2b_state *S, size_t outlen, size_t keylen, uint64_t offset )
+{
+  blake2b_param P[1];
+  P->digest_length = (uint8_t)outlen;
+  P->key_length = (uint8_t)keylen;
+  P->fanout = PARALLELISM_DEGREE;
+  P->depth = 2;
+  P->leaf_length = 0;
+  P->node_offset = (uint32_t)offset;
+  P->xof_length = 0;
+  P->node_depth = 0;
+  P->inner_length = BLAKE2B_OUTBYTES;
+  memset( P->reserved, 0, sizeof( P->reserved ) );
+  memset( P->salt, 0, sizeof( P->salt ) );
+  memset( P->personal, 0, sizeof( P->personal ) );
+  return blake2bp_init_leaf_param( S, P );
+}
+
+static int blake2bp_init_root( blake2b_state *S, size_t outlen, size_t keylen )
+{
+  blake2b_param P[1];
+  P->digest_length = (uint8_t)outlen;
+  P->key_length = (uint8_t)keylen;
+  P->fanout = PARALLELISM_DEGREE;
+  P->depth = 2;
+  P->leaf_length = 0;
+  P->node_offset = 0;
+  P->xof_length = 0;
+  P->node_depth = 1;
+  P->inner_length = BLAKE2B_OUTBYTES;
+  memset( P->reserved, 0, sizeof( P->reserved ) );
+  memset( P->salt, 0, sizeof( P->salt ) );
+  memset( P->personal, 0, sizeof( P->personal ) );
+  return blake2b_init_param( S, P );
+}
+
+
+int blake2bp_init( blake2bp_state *S, size_t outlen )
+{
+  size_t i;
+
+  if( !outlen || outlen > BLAKE2B_OUTBYTES ) return -1;
+
+  memset( S->buf, 0, sizeof( S->buf ) );
+  S->buflen = 0;
+  S->outlen = outlen;
+
+  if( blake2bp_init_root( S->R, outlen, 0 ) < 0 )
+    return -1;
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    if( blake2bp_init_leaf( S->S[i], outlen, 0, i ) < 0 ) return -1;
+
+  S->R->last_node = 1;
+  S->S[PARALLELISM_DEGREE - 1]->last_node = 1;
+  return 0;
+}
+
+int blake2bp_init_key( blake2bp_state *S, size_t outlen, const void *key, size_t keylen )
+{
+  size_t i;
+
+  if( !outlen || outlen > BLAKE2B_OUTBYTES ) return -1;
+
+  if( !key || !keylen || keylen > BLAKE2B_KEYBYTES ) return -1;
+
+  memset( S->buf, 0, sizeof( S->buf ) );
+  S->buflen = 0;
+  S->outlen = outlen;
+
+  if( blake2bp_init_root( S->R, outlen, keylen ) < 0 )
+    return -1;
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    if( blake2bp_init_leaf( S->S[i], outlen, keylen, i ) < 0 ) return -1;
+
+  S->R->last_node = 1;
+  S->S[PARALLELISM_DEGREE - 1]->last_node = 1;
+  {
+    uint8_t block[BLAKE2B_BLOCKBYTES];
+    memset( block, 0, BLAKE2B_BLOCKBYTES );
+    memcpy( block, key, keylen );
+
+    for( i = 0; i < PARALLELISM_DEGREE; ++i )
+      blake2b_update( S->S[i], block, BLAKE2B_BLOCKBYTES );
+
+    secure_zero_memory( block, BLAKE2B_BLOCKBYTES ); /* Burn the key from stack */
+  }
+  return 0;
+}
+
+int blake2bp_update( blake2bp_state *S, const void *pin, size_t inlen )
+{
+  const unsigned char * in = (const unsigned char *)pin;
+  size_t left = S->buflen;
+  size_t fill = sizeof( S->buf ) - left;
+
+  if( left && inlen >= fill )
+  {
+    memcpy( S->buf + left, in, fill );
+    blake2bp_feed_stripes( S, S->buf, 1 );
+    in += fill;
+    inlen -= fill;
+    left = 0;
+  }
+
+  blake2bp_feed_stripes( S, in, inlen / ( PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES ) );
+
+  in += inlen - inlen % ( PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES );
+  inlen %= PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES;
+
+  if( inlen > 0 )
+    memcpy( S->buf + left, in, inlen );
+
+  S->buflen = left + inlen;
+  return 0;
+}
+
+
+int blake2bp_final( blake2bp_state *S, void *out, size_t outlen )
+{
+  uint8_t hash[PARALLELISM_DEGREE][BLAKE2B_OUTBYTES];
+  size_t i;
+
+  if(out == NULL || outlen < S->outlen) {
+    return -1;
+  }
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+  {
+    if( S->buflen > i * BLAKE2B_BLOCKBYTES )
+    {
+      size_t left = S->buflen - i * BLAKE2B_BLOCKBYTES;
+
+      if( left > BLAKE2B_BLOCKBYTES ) left = BLAKE2B_BLOCKBYTES;
+
+      blake2b_update( S->S[i], S->buf + i * BLAKE2B_BLOCKBYTES, left );
+    }
+
+    blake2b_final( S->S[i], hash[i], BLAKE2B_OUTBYTES );
+  }
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    blake2b_update( S->R, hash[i], BLAKE2B_OUTBYTES );
+
+  return blake2b_final( S->R, out, S->outlen );
+}
+
+
+int blake2bp( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen )
+{
+  uint8_t hash[PARALLELISM_DEGREE][BLAKE2B_OUTBYTES];
+  blake2b_state S[PARALLELISM_DEGREE][1];
+  blake2b_state FS[1];
+  size_t i;
+
+  /* Verify parameters */
+  if ( NULL == in && inlen > 0 ) return -1;
+
+  if ( NULL == out ) return -1;
+
+  if ( NULL == key && keylen > 0) return -1;
+
+  if( !outlen || outlen > BLAKE2B_OUTBYTES ) return -1;
+
+  if( keylen > BLAKE2B_KEYBYTES ) return -1;
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    if( blake2bp_init_leaf( S[i], outlen, keylen, i ) < 0 ) return -1;
+
+  S[PARALLELISM_DEGREE - 1]->last_node = 1; /* mark last node */
+
+  if( keylen > 0 )
+  {
+    uint8_t block[BLAKE2B_BLOCKBYTES];
+    memset( block, 0, BLAKE2B_BLOCKBYTES );
+    memcpy( block, key, keylen );
+
+    for( i = 0; i < PARALLELISM_DEGREE; ++i )
+      blake2b_update( S[i], block, BLAKE2B_BLOCKBYTES );
+
+    secure_zero_memory( block, BLAKE2B_BLOCKBYTES ); /* Burn the key from stack */
+  }
+
+#if defined(_OPENMP)
+  #pragma omp parallel shared(S,hash), num_threads(PARALLELISM_DEGREE)
+#else
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+#endif
+  {
+#if defined(_OPENMP)
+    size_t      i = omp_get_thread_num();
+#endif
+    size_t inlen__ = inlen;
+    const unsigned char *in__ = ( const unsigned char * )in;
+    in__ += i * BLAKE2B_BLOCKBYTES;
+
+    while( inlen__ >= PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES )
+    {
+      blake2b_update( S[i], in__, BLAKE2B_BLOCKBYTES );
+      in__ += PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES;
+      inlen__ -= PARALLELISM_DEGREE * BLAKE2B_BLOCKBYTES;
+    }
+
+    if( inlen__ > i * BLAKE2B_BLOCKBYTES )
+    {
+      const size_t left = inlen__ - i * BLAKE2B_BLOCKBYTES;
+      const size_t len = left <= BLAKE2B_BLOCKBYTES ? left : BLAKE2B_BLOCKBYTES;
+      blake2b_update( S[i], in__, len );
+    }
+
+    blake2b_final( S[i], hash[i], BLAKE2B_OUTBYTES );
+  }
+
+  if( blake2bp_init_root( FS, outlen, keylen ) < 0 )
+    return -1;
+
+  FS->last_node = 1;
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    blake2b_update( FS, hash[i], BLAKE2B_OUTBYTES );
+
+  return blake2b_final( FS, out, outlen );
+}
+
+#if defined(BLAKE2BP_SELFTEST)
+#include <string.h>
+#include "blake2-kat.h"
+int main( void )
+{
+  uint8_t key[BLAKE2B_KEYBYTES];
+  uint8_t buf[BLAKE2_KAT_LENGTH];
+  size_t i, step;
+
+  for( i = 0; i < BLAKE2B_KEYBYTES; ++i )
+    key[i] = ( uint8_t )i;
+
+  for( i = 0; i < BLAKE2_KAT_LENGTH; ++i )
+    buf[i] = ( uint8_t )i;
+
+  /* Test simple API */
+  for( i = 0; i < BLAKE2_KAT_LENGTH; ++i )
+  {
+    uint8_t hash[BLAKE2B_OUTBYTES];
+    blake2bp( hash, BLAKE2B_OUTBYTES, buf, i, key, BLAKE2B_KEYBYTES );
+
+    if( 0 != memcmp( hash, blake2bp_keyed_kat[i], BLAKE2B_OUTBYTES ) )
+    {
+      goto fail;
+    }
+  }
+
+  /* Test streaming API */
+  for(step = 1; step < BLAKE2B_BLOCKBYTES; ++step) {
+    for (i = 0; i < BLAKE2_KAT_LENGTH; ++i) {
+      uint8_t hash[BLAKE2B_OUTBYTES];
+      blake2bp_state S;
+      uint8_t * p = buf;
+      size_t mlen = i;
+      int err = 0;
+
+      if( (err = blake2bp_init_key(&S, BLAKE2B_OUTBYTES, key, BLAKE2B_KEYBYTES)) < 0 ) {
+        goto fail;
+      }
+
+      while (mlen >= step) {
+        if ( (err = blake2bp_update(&S, p, step)) < 0 ) {
+          goto fail;
+        }
+        mlen -= step;
+        p += step;
+      }
+      if ( (err = blake2bp_update(&S, p, mlen)) < 0) {
+        goto fail;
+      }
+      if ( (err = blake2bp_final(&S, hash, BLAKE2B_OUTBYTES)) < 0) {
+        goto fail;
+      }
+
+      if (0 != memcmp(hash, blake2bp_keyed_kat[i], BLAKE2B_OUTBYTES)) {
+        goto fail;
+      }
+    }
+  }
+
+  puts( "ok" );
+  return 0;
+fail:
+  puts("error");
+  return -1;
+}
+#endif
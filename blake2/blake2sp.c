@@ -16,32 +16,346 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <windows.h>
 
 #if defined(_OPENMP)
 #include <omp.h>
 #endif
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
 #include "blake2.h"
 #include "blake2-impl.h"
+#include "../cpu_features.h"
 
 #define PARALLELISM_DEGREE 8
 
-typedef struct blake2sp_thread_data {
-    size_t inlen__;
-    const unsigned char *in__;
-    blake2s_state *S;
-    HANDLE start_event;
-    HANDLE sync_event;
-    HANDLE thread_handle;
-    BOOL exit;
-} blake2sp_thread_data_t;
+#if defined(_MSC_VER)
+#define BLAKE2SP_TARGET(x)
+#else
+#define BLAKE2SP_TARGET(x) __attribute__((target(x)))
+#endif
+
+/*
+  The eight leaves always receive the same number of 64 byte blocks until
+  blake2sp_final, so their counters are identical and they can be compressed
+  in lockstep. The leaf states are kept word sliced in vector registers, with
+  lane i holding leaf i: one AVX2 register per state word, or two SSSE3
+  registers covering leaves 0-3 and 4-7.
+*/
+
+static const uint32_t blake2sp_IV[8] =
+{
+  0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+  0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+static const uint8_t blake2sp_sigma[10][16] =
+{
+  {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
+  { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 } ,
+  { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 } ,
+  {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 } ,
+  {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 } ,
+  {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 } ,
+  { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 } ,
+  { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 } ,
+  {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 } ,
+  { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 } ,
+};
+
+/* 0: none (serial leaves), 1: SSSE3, 2: AVX2 */
+static int blake2sp_level = -1;
+
+/* fastest first, the index counts down from level 2 */
+static const CPU_KERNEL blake2sp_kernels[] =
+{
+  { "avx2",   CPU_AVX2,  NULL },
+  { "ssse3",  CPU_SSSE3, NULL },
+  { "serial", 0,         NULL },
+};
+
+static int blake2sp_select_level( void )
+{
+  return 2 - ( int )cpu_select_kernel( "blake2sp", blake2sp_kernels, 3 );
+}
+
+/* one BLAKE2s round on word sliced state, op prefix selects the register width */
+#define BLAKE2SP_G(a,b,c,d,x,y) \
+  v[a] = ADD( ADD( v[a], v[b] ), m[x] ); \
+  v[d] = ROT16( XOR( v[d], v[a] ) ); \
+  v[c] = ADD( v[c], v[d] ); \
+  v[b] = ROT12( XOR( v[b], v[c] ) ); \
+  v[a] = ADD( ADD( v[a], v[b] ), m[y] ); \
+  v[d] = ROT8( XOR( v[d], v[a] ) ); \
+  v[c] = ADD( v[c], v[d] ); \
+  v[b] = ROT7( XOR( v[b], v[c] ) );
+
+#define BLAKE2SP_ROUND(s) \
+  BLAKE2SP_G( 0, 4,  8, 12, s[ 0], s[ 1] ) \
+  BLAKE2SP_G( 1, 5,  9, 13, s[ 2], s[ 3] ) \
+  BLAKE2SP_G( 2, 6, 10, 14, s[ 4], s[ 5] ) \
+  BLAKE2SP_G( 3, 7, 11, 15, s[ 6], s[ 7] ) \
+  BLAKE2SP_G( 0, 5, 10, 15, s[ 8], s[ 9] ) \
+  BLAKE2SP_G( 1, 6, 11, 12, s[10], s[11] ) \
+  BLAKE2SP_G( 2, 7,  8, 13, s[12], s[13] ) \
+  BLAKE2SP_G( 3, 4,  9, 14, s[14], s[15] )
+
+/* ------------------------------------------------------------------------- */
+/* AVX2: all eight leaves in one register per word                           */
+
+#define ADD(a,b)  _mm256_add_epi32( a, b )
+#define XOR(a,b)  _mm256_xor_si256( a, b )
+#define ROT16(x)  _mm256_shuffle_epi8( x, r16 )
+#define ROT12(x)  _mm256_or_si256( _mm256_srli_epi32( x, 12 ), _mm256_slli_epi32( x, 20 ) )
+#define ROT8(x)   _mm256_shuffle_epi8( x, r8 )
+#define ROT7(x)   _mm256_or_si256( _mm256_srli_epi32( x, 7 ), _mm256_slli_epi32( x, 25 ) )
+
+/* transposes eight rows of eight words, used for message blocks and for the chaining values */
+BLAKE2SP_TARGET("avx2")
+static BLAKE2_INLINE void blake2sp_transpose8( __m256i r[8] )
+{
+  __m256i t0 = _mm256_unpacklo_epi32( r[0], r[1] );
+  __m256i t1 = _mm256_unpackhi_epi32( r[0], r[1] );
+  __m256i t2 = _mm256_unpacklo_epi32( r[2], r[3] );
+  __m256i t3 = _mm256_unpackhi_epi32( r[2], r[3] );
+  __m256i t4 = _mm256_unpacklo_epi32( r[4], r[5] );
+  __m256i t5 = _mm256_unpackhi_epi32( r[4], r[5] );
+  __m256i t6 = _mm256_unpacklo_epi32( r[6], r[7] );
+  __m256i t7 = _mm256_unpackhi_epi32( r[6], r[7] );
+  __m256i u0 = _mm256_unpacklo_epi64( t0, t2 );
+  __m256i u1 = _mm256_unpackhi_epi64( t0, t2 );
+  __m256i u2 = _mm256_unpacklo_epi64( t1, t3 );
+  __m256i u3 = _mm256_unpackhi_epi64( t1, t3 );
+  __m256i u4 = _mm256_unpacklo_epi64( t4, t6 );
+  __m256i u5 = _mm256_unpackhi_epi64( t4, t6 );
+  __m256i u6 = _mm256_unpacklo_epi64( t5, t7 );
+  __m256i u7 = _mm256_unpackhi_epi64( t5, t7 );
+  r[0] = _mm256_permute2x128_si256( u0, u4, 0x20 );
+  r[1] = _mm256_permute2x128_si256( u1, u5, 0x20 );
+  r[2] = _mm256_permute2x128_si256( u2, u6, 0x20 );
+  r[3] = _mm256_permute2x128_si256( u3, u7, 0x20 );
+  r[4] = _mm256_permute2x128_si256( u0, u4, 0x31 );
+  r[5] = _mm256_permute2x128_si256( u1, u5, 0x31 );
+  r[6] = _mm256_permute2x128_si256( u2, u6, 0x31 );
+  r[7] = _mm256_permute2x128_si256( u3, u7, 0x31 );
+}
+
+/*
+  Compresses count blocks into every leaf. Block k of leaf i starts at
+  blocks[i] + k * stride. t is the counter before the first block.
+*/
+BLAKE2SP_TARGET("avx2")
+static void blake2sp_compress_avx2( blake2sp_state *S, const uint8_t * const blocks[PARALLELISM_DEGREE],
+                                    size_t stride, size_t count, uint64_t t )
+{
+  const __m256i r8  = _mm256_setr_epi8( 1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+                                        1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12 );
+  const __m256i r16 = _mm256_setr_epi8( 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13 );
+  __m256i h[8], v[16], m[16];
+  size_t i, k, r;
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    h[i] = _mm256_loadu_si256( (const __m256i *)S->S[i]->h );
+  blake2sp_transpose8( h );
+
+  for( k = 0; k < count; ++k )
+  {
+    const size_t offset = k * stride;
+    t += BLAKE2S_BLOCKBYTES;
+
+    for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    {
+      m[i]     = _mm256_loadu_si256( (const __m256i *)( blocks[i] + offset ) );
+      m[i + 8] = _mm256_loadu_si256( (const __m256i *)( blocks[i] + offset + 32 ) );
+    }
+    blake2sp_transpose8( m );
+    blake2sp_transpose8( m + 8 );
+
+    for( i = 0; i < 8; ++i )
+      v[i] = h[i];
+    for( i = 0; i < 4; ++i )
+      v[i + 8] = _mm256_set1_epi32( (int)blake2sp_IV[i] );
+    v[12] = _mm256_set1_epi32( (int)( blake2sp_IV[4] ^ (uint32_t)t ) );
+    v[13] = _mm256_set1_epi32( (int)( blake2sp_IV[5] ^ (uint32_t)( t >> 32 ) ) );
+    v[14] = _mm256_set1_epi32( (int)blake2sp_IV[6] );
+    v[15] = _mm256_set1_epi32( (int)blake2sp_IV[7] );
+
+    for( r = 0; r < 10; ++r )
+    {
+      const uint8_t *s = blake2sp_sigma[r];
+      BLAKE2SP_ROUND( s )
+    }
+
+    for( i = 0; i < 8; ++i )
+      h[i] = XOR( h[i], XOR( v[i], v[i + 8] ) );
+  }
+
+  blake2sp_transpose8( h );
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    _mm256_storeu_si256( (__m256i *)S->S[i]->h, h[i] );
+}
+
+#undef ADD
+#undef XOR
+#undef ROT16
+#undef ROT12
+#undef ROT8
+#undef ROT7
+
+/* ------------------------------------------------------------------------- */
+/* SSSE3: two passes over four leaves each                                   */
+
+#define ADD(a,b)  _mm_add_epi32( a, b )
+#define XOR(a,b)  _mm_xor_si128( a, b )
+#define ROT16(x)  _mm_shuffle_epi8( x, r16 )
+#define ROT12(x)  _mm_or_si128( _mm_srli_epi32( x, 12 ), _mm_slli_epi32( x, 20 ) )
+#define ROT8(x)   _mm_shuffle_epi8( x, r8 )
+#define ROT7(x)   _mm_or_si128( _mm_srli_epi32( x, 7 ), _mm_slli_epi32( x, 25 ) )
+
+BLAKE2SP_TARGET("ssse3")
+static BLAKE2_INLINE void blake2sp_transpose4( __m128i *r0, __m128i *r1, __m128i *r2, __m128i *r3 )
+{
+  __m128i t0 = _mm_unpacklo_epi32( *r0, *r1 );
+  __m128i t1 = _mm_unpackhi_epi32( *r0, *r1 );
+  __m128i t2 = _mm_unpacklo_epi32( *r2, *r3 );
+  __m128i t3 = _mm_unpackhi_epi32( *r2, *r3 );
+  *r0 = _mm_unpacklo_epi64( t0, t2 );
+  *r1 = _mm_unpackhi_epi64( t0, t2 );
+  *r2 = _mm_unpacklo_epi64( t1, t3 );
+  *r3 = _mm_unpackhi_epi64( t1, t3 );
+}
+
+BLAKE2SP_TARGET("ssse3")
+static void blake2sp_compress_ssse3( blake2sp_state *S, const uint8_t * const blocks[PARALLELISM_DEGREE],
+                                     size_t stride, size_t count, uint64_t t )
+{
+  const __m128i r8  = _mm_setr_epi8( 1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12 );
+  const __m128i r16 = _mm_setr_epi8( 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13 );
+  __m128i h[8], v[16], m[16];
+  size_t i, j, k, r, half;
 
-blake2sp_thread_data_t thread_data[PARALLELISM_DEGREE] = {0};
+  for( half = 0; half < PARALLELISM_DEGREE; half += 4 )
+  {
+    uint64_t tc = t;
+
+    for( j = 0; j < 8; j += 4 )
+    {
+      for( i = 0; i < 4; ++i )
+        h[j + i] = _mm_loadu_si128( (const __m128i *)( S->S[half + i]->h + j ) );
+      blake2sp_transpose4( &h[j], &h[j + 1], &h[j + 2], &h[j + 3] );
+    }
 
-HANDLE blake2sp_sync_handles[PARALLELISM_DEGREE] = {0};
+    for( k = 0; k < count; ++k )
+    {
+      const size_t offset = k * stride;
+      tc += BLAKE2S_BLOCKBYTES;
+
+      for( j = 0; j < 16; j += 4 )
+      {
+        for( i = 0; i < 4; ++i )
+          m[j + i] = _mm_loadu_si128( (const __m128i *)( blocks[half + i] + offset + j * 4 ) );
+        blake2sp_transpose4( &m[j], &m[j + 1], &m[j + 2], &m[j + 3] );
+      }
+
+      for( i = 0; i < 8; ++i )
+        v[i] = h[i];
+      for( i = 0; i < 4; ++i )
+        v[i + 8] = _mm_set1_epi32( (int)blake2sp_IV[i] );
+      v[12] = _mm_set1_epi32( (int)( blake2sp_IV[4] ^ (uint32_t)tc ) );
+      v[13] = _mm_set1_epi32( (int)( blake2sp_IV[5] ^ (uint32_t)( tc >> 32 ) ) );
+      v[14] = _mm_set1_epi32( (int)blake2sp_IV[6] );
+      v[15] = _mm_set1_epi32( (int)blake2sp_IV[7] );
+
+      for( r = 0; r < 10; ++r )
+      {
+        const uint8_t *s = blake2sp_sigma[r];
+        BLAKE2SP_ROUND( s )
+      }
+
+      for( i = 0; i < 8; ++i )
+        h[i] = XOR( h[i], XOR( v[i], v[i + 8] ) );
+    }
+
+    for( j = 0; j < 8; j += 4 )
+    {
+      blake2sp_transpose4( &h[j], &h[j + 1], &h[j + 2], &h[j + 3] );
+      for( i = 0; i < 4; ++i )
+        _mm_storeu_si128( (__m128i *)( S->S[half + i]->h + j ), h[j + i] );
+    }
+  }
+}
 
-DWORD WINAPI ThreadProc_BLAKE2SP(VOID * pParam);
+#undef ADD
+#undef XOR
+#undef ROT16
+#undef ROT12
+#undef ROT8
+#undef ROT7
+
+/*
+  Feeds count stripes of PARALLELISM_DEGREE blocks to the leaves, with the
+  same lazy semantics as blake2s_update: the last block of every leaf stays
+  in its buffer, so that blake2s_final can compress it with the last block
+  flag set. Blocks that were already pending are compressed first.
+*/
+static void blake2sp_feed_stripes( blake2sp_state *S, const uint8_t *in, size_t count )
+{
+  const uint8_t *blocks[PARALLELISM_DEGREE];
+  uint64_t t;
+  size_t i;
+
+  if( count == 0 ) return;
+
+  if( blake2sp_level < 0 )
+    blake2sp_level = blake2sp_select_level();
+
+  if( blake2sp_level == 0 )
+  {
+    for( ; count > 0; --count, in += PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES )
+      for( i = 0; i < PARALLELISM_DEGREE; ++i )
+        blake2s_update( S->S[i], in + i * BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES );
+    return;
+  }
+
+  /* all leaves share counter and buffer fill level */
+  t = ( ( uint64_t )S->S[0]->t[1] << 32 ) | S->S[0]->t[0];
+
+  if( S->S[0]->buflen == BLAKE2S_BLOCKBYTES )
+  {
+    for( i = 0; i < PARALLELISM_DEGREE; ++i )
+      blocks[i] = S->S[i]->buf;
+    if( blake2sp_level == 2 )
+      blake2sp_compress_avx2( S, blocks, 0, 1, t );
+    else
+      blake2sp_compress_ssse3( S, blocks, 0, 1, t );
+    t += BLAKE2S_BLOCKBYTES;
+  }
+
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+    blocks[i] = in + i * BLAKE2S_BLOCKBYTES;
+  if( count > 1 )
+  {
+    if( blake2sp_level == 2 )
+      blake2sp_compress_avx2( S, blocks, PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES, count - 1, t );
+    else
+      blake2sp_compress_ssse3( S, blocks, PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES, count - 1, t );
+    t += ( uint64_t )( count - 1 ) * BLAKE2S_BLOCKBYTES;
+  }
+
+  in += ( count - 1 ) * PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
+  for( i = 0; i < PARALLELISM_DEGREE; ++i )
+  {
+    S->S[i]->t[0] = ( uint32_t )t;
+    S->S[i]->t[1] = ( uint32_t )( t >> 32 );
+    memcpy( S->S[i]->buf, in + i * BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES );
+    S->S[i]->buflen = BLAKE2S_BLOCKBYTES;
+  }
+}
 
 /*
   blake2sp_init_param defaults to setting the expecting output length
@@ -108,14 +422,6 @@ int blake2sp_init( blake2sp_state *S, size_t outlen )
   for( i = 0; i < PARALLELISM_DEGREE; ++i )
     if( blake2sp_init_leaf( S->S[i], outlen, 0, i ) < 0 ) return -1;
 
-  for(i = 0; i < PARALLELISM_DEGREE; i++) {
-    thread_data[i].exit = FALSE;
-    thread_data[i].start_event = CreateEvent(NULL, FALSE, FALSE, NULL);
-    thread_data[i].sync_event = CreateEvent(NULL, FALSE, FALSE, NULL);
-    thread_data[i].thread_handle = CreateThread(NULL, 0, ThreadProc_BLAKE2SP, &thread_data[i], 0, NULL);
-    blake2sp_sync_handles[i] = thread_data[i].sync_event;
-  }
-
   S->R->last_node = 1;
   S->S[PARALLELISM_DEGREE - 1]->last_node = 1;
   return 0;
@@ -154,84 +460,22 @@ int blake2sp_init_key( blake2sp_state *S, size_t outlen, const void *key, size_t
   return 0;
 }
 
-DWORD WINAPI ThreadProc_BLAKE2SP(VOID * pParam)
-{
-	blake2sp_thread_data_t *thread_data = (blake2sp_thread_data_t *)pParam;
-    while(1)
-    {
-        // wait until data is ready to be calculated
-        WaitForSingleObject(thread_data->start_event, INFINITE);
-
-        // if we are done exit
-        if(thread_data->exit)
-            return 0;
-        
-        // loop across block
-        while( thread_data->inlen__ >= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES )
-        {
-            blake2s_update( thread_data->S, thread_data->in__, BLAKE2S_BLOCKBYTES );
-             thread_data->in__ += PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
-             thread_data->inlen__ -= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
-        }
-
-        // signal that we are done
-        SetEvent(thread_data->sync_event);
-    }
-	return 0;
-}
-
 int blake2sp_update( blake2sp_state *S, const void *pin, size_t inlen )
 {
   const unsigned char * in = (const unsigned char *)pin;
   size_t left = S->buflen;
   size_t fill = sizeof( S->buf ) - left;
-  size_t i;
 
   if( left && inlen >= fill )
   {
     memcpy( S->buf + left, in, fill );
-
-    for( i = 0; i < PARALLELISM_DEGREE; ++i )
-      blake2s_update( S->S[i], S->buf + i * BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES );
-
+    blake2sp_feed_stripes( S, S->buf, 1 );
     in += fill;
     inlen -= fill;
     left = 0;
   }
 
-#if defined(_OPENMP)
-  #pragma omp parallel shared(S), num_threads(PARALLELISM_DEGREE)
-#else
-
-  for( i = 0; i < PARALLELISM_DEGREE; ++i )
-#endif
-  {
-#if defined(_OPENMP)
-    size_t      i = omp_get_thread_num();
-#endif
-    size_t inlen__ = inlen;
-    const unsigned char *in__ = ( const unsigned char * )in;
-    in__ += i * BLAKE2S_BLOCKBYTES;
-
-    // set data for thread to calculate
-    thread_data[i].inlen__ = inlen__;
-    thread_data[i].in__ = in__;
-    thread_data[i].S = S->S[i];
-
-    // signal thread to start calculation
-    SetEvent(thread_data[i].start_event);
-
-    // moved to win thread for rcrc
-    /*while( inlen__ >= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES )
-    {
-      blake2s_update( S->S[i], in__, BLAKE2S_BLOCKBYTES );
-      in__ += PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
-      inlen__ -= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
-    }*/
-  }
-
-  // wait until all threads have completed their block
-  WaitForMultipleObjects(PARALLELISM_DEGREE, blake2sp_sync_handles, TRUE, INFINITE);
+  blake2sp_feed_stripes( S, in, inlen / ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES ) );
 
   in += inlen - inlen % ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES );
   inlen %= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
@@ -249,21 +493,6 @@ int blake2sp_final( blake2sp_state *S, void *out, size_t outlen )
   uint8_t hash[PARALLELISM_DEGREE][BLAKE2S_OUTBYTES];
   size_t i;
 
-  for(i = 0; i < PARALLELISM_DEGREE; i++) {
-      if(thread_data[i].thread_handle)
-      {
-        thread_data[i].exit = TRUE;
-        SetEvent(thread_data[i].start_event);
-        WaitForSingleObject(thread_data[i].thread_handle, INFINITE);
-        CloseHandle(thread_data[i].start_event);
-        CloseHandle(thread_data[i].sync_event);
-        thread_data[i].start_event = 0;
-        thread_data[i].sync_event = 0;
-        thread_data[i].thread_handle = 0;
-        thread_data[i].exit = FALSE;
-      }
-  }
-
   if(out == NULL || outlen < S->outlen) {
     return -1;
   }
@@ -47,6 +47,12 @@ void blake3_hasher_init_derive_key_raw(blake3_hasher *self, const void *context,
                                        size_t context_len);
 void blake3_hasher_update(blake3_hasher *self, const void *input,
                           size_t input_len);
+#if defined(_WIN32) && !defined(BLAKE3_NO_MT)
+#define BLAKE3_USE_MT 1
+// Like blake3_hasher_update(), but large inputs are hashed on several threads.
+void blake3_hasher_update_mt(blake3_hasher *self, const void *input,
+                             size_t input_len);
+#endif
 void blake3_hasher_finalize(const blake3_hasher *self, uint8_t *out,
                             size_t out_len);
 void blake3_hasher_finalize_seek(const blake3_hasher *self, uint64_t seek,
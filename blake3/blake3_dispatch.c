@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include "blake3_impl.h"
+#include "../cpu_features.h"
 
 #if defined(IS_X86)
 #if defined(_MSC_VER)
@@ -17,48 +18,14 @@
 #define MAYBE_UNUSED(x) (void)((x))
 
 #if defined(IS_X86)
-static uint64_t xgetbv() {
-#if defined(_MSC_VER)
-  return _xgetbv(0);
-#else
-  uint32_t eax = 0, edx = 0;
-  __asm__ __volatile__("xgetbv\n" : "=a"(eax), "=d"(edx) : "c"(0));
-  return ((uint64_t)edx << 32) | eax;
-#endif
-}
-
-static void cpuid(uint32_t out[4], uint32_t id) {
-#if defined(_MSC_VER)
-  __cpuid((int *)out, id);
-#elif defined(__i386__) || defined(_M_IX86)
-  __asm__ __volatile__("movl %%ebx, %1\n"
-                       "cpuid\n"
-                       "xchgl %1, %%ebx\n"
-                       : "=a"(out[0]), "=r"(out[1]), "=c"(out[2]), "=d"(out[3])
-                       : "a"(id));
-#else
-  __asm__ __volatile__("cpuid\n"
-                       : "=a"(out[0]), "=b"(out[1]), "=c"(out[2]), "=d"(out[3])
-                       : "a"(id));
-#endif
-}
-
-static void cpuidex(uint32_t out[4], uint32_t id, uint32_t sid) {
-#if defined(_MSC_VER)
-  __cpuidex((int *)out, id, sid);
-#elif defined(__i386__) || defined(_M_IX86)
-  __asm__ __volatile__("movl %%ebx, %1\n"
-                       "cpuid\n"
-                       "xchgl %1, %%ebx\n"
-                       : "=a"(out[0]), "=r"(out[1]), "=c"(out[2]), "=d"(out[3])
-                       : "a"(id), "c"(sid));
-#else
-  __asm__ __volatile__("cpuid\n"
-                       : "=a"(out[0]), "=b"(out[1]), "=c"(out[2]), "=d"(out[3])
-                       : "a"(id), "c"(sid));
-#endif
-}
-
+/* the feature set of the chosen kernel, lower ones stay available for the other functions */
+static const CPU_KERNEL blake3_kernels[] = {
+    {"avx512", CPU_AVX512F | CPU_AVX512VL, NULL},
+    {"avx2", CPU_AVX2 | CPU_SSE41, NULL},
+    {"sse41", CPU_SSE41, NULL},
+    {"sse2", CPU_SSE2, NULL},
+    {"portable", 0, NULL},
+};
 #endif
 
 enum cpu_feature {
@@ -88,42 +55,25 @@ static
     return g_cpu_features;
   } else {
 #if defined(IS_X86)
-    uint32_t regs[4] = {0};
-    uint32_t *eax = &regs[0], *ebx = &regs[1], *ecx = &regs[2], *edx = &regs[3];
-    (void)edx;
+    const unsigned int count = sizeof(blake3_kernels) / sizeof(blake3_kernels[0]);
+    unsigned int available = 0;
+    unsigned int i;
     enum cpu_feature features = 0;
-    cpuid(regs, 0);
-    const int max_id = *eax;
-    cpuid(regs, 1);
-#if defined(__amd64__) || defined(_M_X64)
-    features |= SSE2;
-#else
-    if (*edx & (1UL << 26))
+    for (i = cpu_select_kernel("blake3", blake3_kernels, count); i < count; i++)
+      available |= blake3_kernels[i].required;
+    available &= cpu_features();
+    if (available & CPU_SSE2)
       features |= SSE2;
-#endif
-    if (*ecx & (1UL << 0))
+    if (available & CPU_SSSE3)
       features |= SSSE3;
-    if (*ecx & (1UL << 19))
+    if (available & CPU_SSE41)
       features |= SSE41;
-
-    if (*ecx & (1UL << 27)) { // OSXSAVE
-      const uint64_t mask = xgetbv();
-      if ((mask & 6) == 6) { // SSE and AVX states
-        if (*ecx & (1UL << 28))
-          features |= AVX;
-        if (max_id >= 7) {
-          cpuidex(regs, 7, 0);
-          if (*ebx & (1UL << 5))
-            features |= AVX2;
-          if ((mask & 224) == 224) { // Opmask, ZMM_Hi256, Hi16_Zmm
-            if (*ebx & (1UL << 31))
-              features |= AVX512VL;
-            if (*ebx & (1UL << 16))
-              features |= AVX512F;
-          }
-        }
-      }
-    }
+    if (available & CPU_AVX2)
+      features |= AVX2;
+    if (available & CPU_AVX512F)
+      features |= AVX512F;
+    if (available & CPU_AVX512VL)
+      features |= AVX512VL;
     g_cpu_features = features;
     return features;
 #else
@@ -195,6 +195,29 @@ void blake3_hash_many(const uint8_t *const *inputs, size_t num_inputs,
 
 size_t blake3_simd_degree(void);
 
+size_t blake3_compress_subtree_wide(const uint8_t *input, size_t input_len,
+                                    const uint32_t key[8],
+                                    uint64_t chunk_counter, uint8_t flags,
+                                    uint8_t *out, bool use_mt);
+
+#if defined(BLAKE3_USE_MT)
+// Subtrees smaller than this are not split across threads, the cost of
+// handing work to another thread is about that of hashing a few KiB.
+#define BLAKE3_MT_MIN_SUBTREE_LEN (256 * 1024)
+
+// Hashes the left subtree on a worker thread and the right one on the calling
+// thread, then waits for both. Implemented in blake3_thread.c.
+void blake3_compress_subtree_wide_join_mt(
+    // shared params
+    const uint32_t key[8], uint8_t flags,
+    // left-hand side params
+    const uint8_t *l_input, size_t l_input_len, uint64_t l_chunk_counter,
+    uint8_t *l_cvs, size_t *l_n,
+    // right-hand side params
+    const uint8_t *r_input, size_t r_input_len, uint64_t r_chunk_counter,
+    uint8_t *r_cvs, size_t *r_n);
+#endif
+
 
 // Declarations for implementation-specific functions.
 void blake3_compress_in_place_portable(uint32_t cv[8],
@@ -0,0 +1,73 @@
+// Multi-threading for blake3_hasher_update_mt(), on top of the Windows thread
+// pool. blake3_compress_subtree_wide() calls the join below for large
+// subtrees: the left half goes to a pool thread, the calling thread hashes the
+// right half and then waits for the left one. Both halves may split further.
+
+#include "blake3_impl.h"
+
+#if defined(BLAKE3_USE_MT)
+
+#include <windows.h>
+
+typedef struct {
+  const uint8_t *input;
+  size_t input_len;
+  const uint32_t *key;
+  uint64_t chunk_counter;
+  uint8_t flags;
+  uint8_t *cvs;
+  size_t n;
+  HANDLE done;
+} blake3_subtree_job;
+
+static DWORD WINAPI blake3_subtree_job_run(LPVOID param) {
+  blake3_subtree_job *job = (blake3_subtree_job *)param;
+  job->n = blake3_compress_subtree_wide(job->input, job->input_len, job->key,
+                                        job->chunk_counter, job->flags,
+                                        job->cvs, true);
+  SetEvent(job->done);
+  return 0;
+}
+
+void blake3_compress_subtree_wide_join_mt(
+    // shared params
+    const uint32_t key[8], uint8_t flags,
+    // left-hand side params
+    const uint8_t *l_input, size_t l_input_len, uint64_t l_chunk_counter,
+    uint8_t *l_cvs, size_t *l_n,
+    // right-hand side params
+    const uint8_t *r_input, size_t r_input_len, uint64_t r_chunk_counter,
+    uint8_t *r_cvs, size_t *r_n) {
+  blake3_subtree_job job;
+  job.input = l_input;
+  job.input_len = l_input_len;
+  job.key = key;
+  job.chunk_counter = l_chunk_counter;
+  job.flags = flags;
+  job.cvs = l_cvs;
+  job.n = 0;
+  job.done = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+  // The pool may block in here, as nested joins wait for their own left halves.
+  if (job.done == NULL ||
+      !QueueUserWorkItem(blake3_subtree_job_run, &job,
+                         WT_EXECUTELONGFUNCTION)) {
+    // No worker available, hash both halves on this thread.
+    if (job.done != NULL) {
+      CloseHandle(job.done);
+    }
+    *l_n = blake3_compress_subtree_wide(l_input, l_input_len, key,
+                                        l_chunk_counter, flags, l_cvs, true);
+    *r_n = blake3_compress_subtree_wide(r_input, r_input_len, key,
+                                        r_chunk_counter, flags, r_cvs, true);
+    return;
+  }
+
+  *r_n = blake3_compress_subtree_wide(r_input, r_input_len, key,
+                                      r_chunk_counter, flags, r_cvs, true);
+  WaitForSingleObject(job.done, INFINITE);
+  CloseHandle(job.done);
+  *l_n = job.n;
+}
+
+#endif
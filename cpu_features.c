@@ -0,0 +1,278 @@
+#include "cpu_features.h"
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#define cpu_yield() Sleep(0)
+#else
+#include <stdlib.h>
+#include <sched.h>
+#define cpu_yield() sched_yield()
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_FEATURES_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#define CPU_MAX_ALGORITHMS 32
+#define CPU_MAX_ENV 512
+
+static const struct {
+	const char		*name;
+	unsigned int	flag;
+} cpu_feature_names[] = {
+	{ "sse2", CPU_SSE2 }, { "ssse3", CPU_SSSE3 }, { "sse41", CPU_SSE41 }, { "sse42", CPU_SSE42 },
+	{ "pclmul", CPU_PCLMUL }, { "avx", CPU_AVX }, { "avx2", CPU_AVX2 }, { "bmi2", CPU_BMI2 },
+	{ "sha", CPU_SHA }, { "avx512f", CPU_AVX512F }, { "avx512bw", CPU_AVX512BW },
+	{ "avx512vl", CPU_AVX512VL }, { "vpclmul", CPU_VPCLMUL },
+};
+
+static volatile int cpu_detected = 0;
+static unsigned int cpu_feature_flags = 0;
+
+/* kernels picked so far, written under cpu_record_lock. A slot is filled before the count
+   that publishes it is raised, readers go by the count only */
+static volatile long cpu_record_lock = 0;
+static volatile long cpu_selected_count = 0;
+static const char * volatile cpu_selected_algorithm[CPU_MAX_ALGORITHMS];
+static const char * volatile cpu_selected_kernel[CPU_MAX_ALGORITHMS];
+
+/* ---------------------------------------------------------------- */
+
+/* copies the variable into buffer, returns 0 if it is not set */
+static int cpu_getenv(const char *variable, char *buffer, unsigned int size)
+{
+#if defined(_WIN32)
+	DWORD length = GetEnvironmentVariableA(variable, buffer, size);
+	return length > 0 && length < size;
+#else
+	const char *value = getenv(variable);
+	if (value == NULL || strlen(value) >= size)
+		return 0;
+	strcpy(buffer, value);
+	return 1;
+#endif
+}
+
+/* finds name in the comma separated list, returns the part after '=' if there is one
+   (terminated by ',' or the end), otherwise a pointer to the terminator of the entry */
+static const char *cpu_find_entry(const char *list, const char *name)
+{
+	const size_t length = strlen(name);
+
+	while (*list) {
+		const char *end = list;
+		while (*end && *end != ',')
+			end++;
+		if (strncmp(list, name, length) == 0 && (list[length] == '=' || list + length == end))
+			return list[length] == '=' ? list + length + 1 : list + length;
+		list = *end ? end + 1 : end;
+	}
+	return NULL;
+}
+
+#if defined(CPU_FEATURES_X86)
+static void cpu_cpuid(int info[4], int leaf, int subleaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(info, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+static unsigned long long cpu_xgetbv(void)
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+static unsigned int cpu_detect(void)
+{
+	unsigned int flags = 0;
+#if defined(CPU_FEATURES_X86)
+	int info[4];
+	int maxLeaf;
+	unsigned long long xcr0 = 0;
+
+	cpu_cpuid(info, 0, 0);
+	maxLeaf = info[0];
+	if (maxLeaf < 1)
+		return 0;
+
+	cpu_cpuid(info, 1, 0);
+	if (info[3] & (1 << 26)) flags |= CPU_SSE2;
+	if (info[2] & (1 <<  9)) flags |= CPU_SSSE3;
+	if (info[2] & (1 << 19)) flags |= CPU_SSE41;
+	if (info[2] & (1 << 20)) flags |= CPU_SSE42;
+	if (info[2] & (1 <<  1)) flags |= CPU_PCLMUL;
+	if (info[2] & (1 << 27))						/* OSXSAVE */
+		xcr0 = cpu_xgetbv();
+	/* XMM/YMM state, additionally opmask/ZMM state for AVX-512 */
+	if ((info[2] & (1 << 28)) && (xcr0 & 0x06) == 0x06)
+		flags |= CPU_AVX;
+
+	if (maxLeaf >= 7) {
+		cpu_cpuid(info, 7, 0);
+		if (info[1] & (1 <<  8)) flags |= CPU_BMI2;
+		if (info[1] & (1 << 29)) flags |= CPU_SHA;
+		if ((xcr0 & 0x06) == 0x06) {
+			if (info[1] & (1 <<  5)) flags |= CPU_AVX2;
+			if (info[2] & (1 << 10)) flags |= CPU_VPCLMUL;
+		}
+		if ((xcr0 & 0xE6) == 0xE6) {
+			if (info[1] & (1 << 16)) flags |= CPU_AVX512F;
+			if (info[1] & (1 << 30)) flags |= CPU_AVX512BW;
+			if (info[1] & (1u << 31)) flags |= CPU_AVX512VL;
+		}
+	}
+#endif
+	return flags;
+}
+
+unsigned int cpu_features(void)
+{
+	if (!cpu_detected) {
+		char disable[CPU_MAX_ENV];
+		unsigned int flags = cpu_detect();
+		unsigned int i;
+
+		if (cpu_getenv("RAPIDCRC_CPU_DISABLE", disable, sizeof(disable))) {
+			for (i = 0; i < sizeof(cpu_feature_names) / sizeof(cpu_feature_names[0]); i++) {
+				if (cpu_find_entry(disable, cpu_feature_names[i].name))
+					flags &= ~cpu_feature_names[i].flag;
+			}
+		}
+		/* same result in every thread, so a race only detects twice */
+		cpu_feature_flags = flags;
+		cpu_detected = 1;
+	}
+	return cpu_feature_flags;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* the count with a full barrier, so the slots below it are seen filled */
+static long cpu_published_count(void)
+{
+#if defined(_MSC_VER)
+	return _InterlockedCompareExchange(&cpu_selected_count, 0, 0);
+#else
+	return __sync_val_compare_and_swap(&cpu_selected_count, 0, 0);
+#endif
+}
+
+/* the kernels are selected once per algorithm and thread start, a spin lock is enough */
+static void cpu_lock(void)
+{
+#if defined(_MSC_VER)
+	while (_InterlockedExchange(&cpu_record_lock, 1))
+		cpu_yield();
+#else
+	while (__sync_lock_test_and_set(&cpu_record_lock, 1))
+		cpu_yield();
+#endif
+}
+
+static void cpu_unlock(void)
+{
+#if defined(_MSC_VER)
+	_InterlockedExchange(&cpu_record_lock, 0);
+#else
+	__sync_lock_release(&cpu_record_lock);
+#endif
+}
+
+static void cpu_record(const char *algorithm, const char *kernel)
+{
+	long slot;
+
+	cpu_lock();
+	for (slot = 0; slot < cpu_selected_count; slot++) {
+		if (strcmp(cpu_selected_algorithm[slot], algorithm) == 0) {
+			cpu_selected_kernel[slot] = kernel;
+			cpu_unlock();
+			return;
+		}
+	}
+	if (slot >= CPU_MAX_ALGORITHMS) {
+		cpu_unlock();
+		return;
+	}
+
+	cpu_selected_kernel[slot] = kernel;
+	cpu_selected_algorithm[slot] = algorithm;
+#if defined(_MSC_VER)
+	_InterlockedExchange(&cpu_selected_count, slot + 1);
+#else
+	__sync_synchronize();
+	cpu_selected_count = slot + 1;
+#endif
+	cpu_unlock();
+
+#if defined(_WIN32)
+	{
+		char line[128];
+		wsprintfA(line, "RapidCRC: %s uses %s\n", algorithm, kernel);
+		OutputDebugStringA(line);
+	}
+#endif
+}
+
+unsigned int cpu_select_kernel(const char *algorithm, const CPU_KERNEL *kernels, unsigned int count)
+{
+	const unsigned int features = cpu_features();
+	char forced[CPU_MAX_ENV];
+	unsigned int selected = count - 1;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if ((kernels[i].required & features) == kernels[i].required) {
+			selected = i;
+			break;
+		}
+	}
+
+	if (cpu_getenv("RAPIDCRC_KERNELS", forced, sizeof(forced))) {
+		const char *name = cpu_find_entry(forced, algorithm);
+		if (name && *name != ',' && *name) {
+			for (i = 0; i < count; i++) {
+				const size_t length = strlen(kernels[i].name);
+				if (strncmp(name, kernels[i].name, length) == 0 && (name[length] == ',' || name[length] == 0)) {
+					if ((kernels[i].required & features) == kernels[i].required)
+						selected = i;
+					break;
+				}
+			}
+		}
+	}
+
+	cpu_record(algorithm, kernels[selected].name);
+	return selected;
+}
+
+unsigned int cpu_kernel_count(void)
+{
+	return (unsigned int)cpu_published_count();
+}
+
+const char *cpu_kernel_algorithm(unsigned int index)
+{
+	return index < cpu_kernel_count() ? cpu_selected_algorithm[index] : "";
+}
+
+const char *cpu_kernel_name(unsigned int index)
+{
+	return index < cpu_kernel_count() ? cpu_selected_kernel[index] : "";
+}
@@ -0,0 +1,77 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+/* CPU feature detection and kernel selection shared by all hash implementations
+
+   Every algorithm with more than one implementation describes them in a CPU_KERNEL
+   table, ordered from the fastest to the portable one, and lets cpu_select_kernel
+   pick the first one whose required features are present. The choice is recorded
+   and can be listed with cpu_kernel_count/cpu_kernel_algorithm/cpu_kernel_name.
+
+   Environment overrides, read once:
+   RAPIDCRC_KERNELS		"algorithm=kernel,..." forces a kernel, e.g. "crc32=pclmul,sha512=ossl";
+						a kernel the CPU can not run is ignored
+   RAPIDCRC_CPU_DISABLE	"avx512f,avx2,..." hides features, as if running on an older CPU */
+
+/* features reported by cpu_features, AVX and later are only set if the OS saves the registers */
+#define CPU_SSE2		(1u <<  0)
+#define CPU_SSSE3		(1u <<  1)
+#define CPU_SSE41		(1u <<  2)
+#define CPU_SSE42		(1u <<  3)	/* includes the CRC32 instruction */
+#define CPU_PCLMUL		(1u <<  4)
+#define CPU_AVX			(1u <<  5)
+#define CPU_AVX2		(1u <<  6)
+#define CPU_BMI2		(1u <<  7)
+#define CPU_SHA			(1u <<  8)
+#define CPU_AVX512F		(1u <<  9)
+#define CPU_AVX512BW	(1u << 10)
+#define CPU_AVX512VL	(1u << 11)
+#define CPU_VPCLMUL		(1u << 12)
+
+/* instruction sets of a function that uses intrinsics beyond the compiler's baseline, e.g.
+   CPU_TARGET("avx2,pclmul"). MSVC accepts every intrinsic anywhere, GCC and clang need the
+   attribute on the kernel and on the inline helpers it calls */
+#if defined(_MSC_VER)
+#define CPU_TARGET(features)
+#else
+#define CPU_TARGET(features)	__attribute__((target(features)))
+#endif
+
+/* CPU_TARGET for a kernel whose helpers have to use its instruction sets as well, e.g. the
+   instantiation of a template over a vector class: everything it calls is inlined into it.
+   A vector class itself is compiled for them with #pragma GCC target */
+#if defined(_MSC_VER)
+#define CPU_KERNEL_TARGET(features)
+#else
+#define CPU_KERNEL_TARGET(features)	__attribute__((target(features), flatten))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* one implementation of an algorithm */
+typedef struct _CPU_KERNEL {
+	const char		*name;		/* reported and used by RAPIDCRC_KERNELS */
+	unsigned int	required;	/* CPU_xxx flags that all have to be present */
+	const void		*impl;		/* function or table of the implementation, NULL if the caller uses the index */
+} CPU_KERNEL;
+
+/* features of this CPU without the ones hidden by RAPIDCRC_CPU_DISABLE, detected on the first call */
+unsigned int cpu_features(void);
+
+/* index of the kernel to use for algorithm: the one forced by RAPIDCRC_KERNELS if the CPU
+   can run it, otherwise the first one whose requirements are met. The last kernel of the
+   table has to be runnable everywhere, it is returned if nothing else fits */
+unsigned int cpu_select_kernel(const char *algorithm, const CPU_KERNEL *kernels, unsigned int count);
+
+/* algorithms that selected a kernel so far, in the order of their first use */
+unsigned int cpu_kernel_count(void);
+const char *cpu_kernel_algorithm(unsigned int index);
+const char *cpu_kernel_name(unsigned int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,6 +1,13 @@
-#include "Crc32.h"
+#include "crc32.h"
+#include "cpu_features.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 /* This is the slicing-by-8 algorithm from https://github.com/stbrumme/crc32 , reduced to this one algorithm
+   plus carry-less multiplication folding (PCLMULQDQ/VPCLMULQDQ) for CPUs that support it
 */
 
 namespace
@@ -87,6 +94,314 @@ uint32_t crc32_4x8bytes(const void* data, size_t length, uint32_t previousCrc32)
   return ~crc; // same as crc ^ 0xFFFFFFFF
 }
 
+// //////////////////////////////////////////////////////////
+// carry-less multiplication (folding, see Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction"), constants are (x^n mod P)' << 1
+
+namespace
+{
+  /// fold by 1 x 128 bit (k3, k4), 4 x 128 bit (k1, k2), 8 x 128 bit and 16 x 128 bit
+  const uint64_t Fold128[2]  = { 0x01751997d0ULL, 0x00ccaa009eULL };
+  const uint64_t Fold256[2]  = { 0x00f1da05aaULL, 0x015a546366ULL };
+  const uint64_t Fold512[2]  = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+  const uint64_t Fold1024[2] = { 0x01e88ef372ULL, 0x014a7fe880ULL };
+  const uint64_t Fold2048[2] = { 0x011542778aULL, 0x01322d1430ULL };
+  /// 64 -> 32 bit reduction (k5) and Barrett reduction (P', mu)
+  const uint64_t Fold64[2]   = { 0x0163cd6124ULL, 0x0000000000ULL };
+  const uint64_t Barrett[2]  = { 0x01db710641ULL, 0x01f7011641ULL };
+
+  /// multiply both halves of x with the fold constants and add the next data block
+  CPU_TARGET("sse4.1,pclmul")
+  inline __m128i fold128(__m128i x, __m128i k, __m128i data)
+  {
+    __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(lo, hi), data);
+  }
+
+  CPU_TARGET("sse4.1,pclmul,avx2,vpclmulqdq")
+  inline __m256i fold256(__m256i x, __m256i k, __m256i data)
+  {
+    __m256i lo = _mm256_clmulepi64_epi128(x, k, 0x00);
+    __m256i hi = _mm256_clmulepi64_epi128(x, k, 0x11);
+    return _mm256_xor_si256(_mm256_xor_si256(lo, hi), data);
+  }
+
+  CPU_TARGET("sse4.1,pclmul,avx512f,vpclmulqdq")
+  inline __m512i fold512(__m512i x, __m512i k, __m512i data)
+  {
+    __m512i lo = _mm512_clmulepi64_epi128(x, k, 0x00);
+    __m512i hi = _mm512_clmulepi64_epi128(x, k, 0x11);
+    return _mm512_ternarylogic_epi64(lo, hi, data, 0x96); // lo ^ hi ^ data
+  }
+
+  /// fold the remaining 16 byte blocks into x, reduce to 32 bits and process the last 0..15 bytes
+  CPU_TARGET("sse4.1,pclmul")
+  uint32_t foldTail(__m128i x, const uint8_t* current, size_t length)
+  {
+    const __m128i k3k4 = _mm_loadu_si128((const __m128i*) Fold128);
+    while (length >= 16)
+    {
+      x = fold128(x, k3k4, _mm_loadu_si128((const __m128i*) current));
+      current += 16;
+      length  -= 16;
+    }
+
+    // 128 -> 64 bits
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x = _mm_xor_si128(_mm_srli_si128(x, 8), _mm_clmulepi64_si128(x, k3k4, 0x10));
+    // 64 -> 32 bits
+    __m128i t = _mm_srli_si128(x, 4);
+    x = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), _mm_loadu_si128((const __m128i*) Fold64), 0x00);
+    x = _mm_xor_si128(x, t);
+    // Barrett reduction
+    const __m128i poly = _mm_loadu_si128((const __m128i*) Barrett);
+    t = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+    uint32_t crc = (uint32_t) _mm_extract_epi32(_mm_xor_si128(x, t), 1);
+
+    // remaining 1 to 15 bytes (standard algorithm)
+    while (length-- != 0)
+      crc = (crc >> 8) ^ Crc32Lookup[0][(crc & 0xFF) ^ *current++];
+
+    return crc;
+  }
+
+  /// fold 4 x 128 bit into one 128 bit block and continue with foldTail
+  CPU_TARGET("sse4.1,pclmul")
+  uint32_t foldFinish4(__m128i x1, __m128i x2, __m128i x3, __m128i x4, const uint8_t* current, size_t length)
+  {
+    const __m128i k3k4 = _mm_loadu_si128((const __m128i*) Fold128);
+    x1 = fold128(x1, k3k4, x2);
+    x1 = fold128(x1, k3k4, x3);
+    x1 = fold128(x1, k3k4, x4);
+    return foldTail(x1, current, length);
+  }
+} // anonymous namespace
+
+
+/// compute CRC32 (folding with PCLMULQDQ)
+CPU_TARGET("sse4.1,pclmul")
+uint32_t crc32_pclmul(const void* data, size_t length, uint32_t previousCrc32)
+{
+  // need at least four 16 byte blocks to start folding
+  if (length < 64)
+    return crc32_8bytes(data, length, previousCrc32);
+
+  const uint8_t* current = (const uint8_t*) data;
+  const __m128i k1k2 = _mm_loadu_si128((const __m128i*) Fold512);
+
+  __m128i x1 = _mm_loadu_si128((const __m128i*) (current +  0));
+  __m128i x2 = _mm_loadu_si128((const __m128i*) (current + 16));
+  __m128i x3 = _mm_loadu_si128((const __m128i*) (current + 32));
+  __m128i x4 = _mm_loadu_si128((const __m128i*) (current + 48));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) ~previousCrc32));
+  current += 64;
+  length  -= 64;
+
+  // process 64 bytes at once, four independent folds
+  while (length >= 64)
+  {
+    x1 = fold128(x1, k1k2, _mm_loadu_si128((const __m128i*) (current +  0)));
+    x2 = fold128(x2, k1k2, _mm_loadu_si128((const __m128i*) (current + 16)));
+    x3 = fold128(x3, k1k2, _mm_loadu_si128((const __m128i*) (current + 32)));
+    x4 = fold128(x4, k1k2, _mm_loadu_si128((const __m128i*) (current + 48)));
+    current += 64;
+    length  -= 64;
+  }
+
+  return ~foldFinish4(x1, x2, x3, x4, current, length);
+}
+
+
+/// compute CRC32 (folding with 256 bit VPCLMULQDQ)
+CPU_TARGET("sse4.1,pclmul,avx2,vpclmulqdq")
+uint32_t crc32_vpclmul_avx2(const void* data, size_t length, uint32_t previousCrc32)
+{
+  // need at least four 32 byte blocks, short buffers are faster with 128 bit folding
+  if (length < 256)
+    return crc32_pclmul(data, length, previousCrc32);
+
+  const uint8_t* current = (const uint8_t*) data;
+  const __m256i k1024 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) Fold1024));
+
+  __m256i y1 = _mm256_loadu_si256((const __m256i*) (current +  0));
+  __m256i y2 = _mm256_loadu_si256((const __m256i*) (current + 32));
+  __m256i y3 = _mm256_loadu_si256((const __m256i*) (current + 64));
+  __m256i y4 = _mm256_loadu_si256((const __m256i*) (current + 96));
+  y1 = _mm256_xor_si256(y1, _mm256_inserti128_si256(_mm256_setzero_si256(), _mm_cvtsi32_si128((int) ~previousCrc32), 0));
+  current += 128;
+  length  -= 128;
+
+  // process 128 bytes at once
+  while (length >= 128)
+  {
+    y1 = fold256(y1, k1024, _mm256_loadu_si256((const __m256i*) (current +  0)));
+    y2 = fold256(y2, k1024, _mm256_loadu_si256((const __m256i*) (current + 32)));
+    y3 = fold256(y3, k1024, _mm256_loadu_si256((const __m256i*) (current + 64)));
+    y4 = fold256(y4, k1024, _mm256_loadu_si256((const __m256i*) (current + 96)));
+    current += 128;
+    length  -= 128;
+  }
+
+  // 4 x 256 bit -> 256 bit
+  const __m256i k256 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) Fold256));
+  y1 = fold256(y1, k256, y2);
+  y1 = fold256(y1, k256, y3);
+  y1 = fold256(y1, k256, y4);
+
+  const __m128i k3k4 = _mm_loadu_si128((const __m128i*) Fold128);
+  __m128i x = fold128(_mm256_castsi256_si128(y1), k3k4, _mm256_extracti128_si256(y1, 1));
+  _mm256_zeroupper();
+
+  return ~foldTail(x, current, length);
+}
+
+
+/// compute CRC32 (folding with 512 bit VPCLMULQDQ)
+CPU_TARGET("sse4.1,pclmul,avx512f,vpclmulqdq")
+uint32_t crc32_vpclmul_avx512(const void* data, size_t length, uint32_t previousCrc32)
+{
+  // need at least four 64 byte blocks, short buffers are faster with 128 bit folding
+  if (length < 512)
+    return crc32_pclmul(data, length, previousCrc32);
+
+  const uint8_t* current = (const uint8_t*) data;
+  const __m512i k2048 = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) Fold2048));
+
+  __m512i z1 = _mm512_loadu_si512((const void*) (current +   0));
+  __m512i z2 = _mm512_loadu_si512((const void*) (current +  64));
+  __m512i z3 = _mm512_loadu_si512((const void*) (current + 128));
+  __m512i z4 = _mm512_loadu_si512((const void*) (current + 192));
+  z1 = _mm512_xor_si512(z1, _mm512_inserti32x4(_mm512_setzero_si512(), _mm_cvtsi32_si128((int) ~previousCrc32), 0));
+  current += 256;
+  length  -= 256;
+
+  // process 256 bytes at once
+  while (length >= 256)
+  {
+    z1 = fold512(z1, k2048, _mm512_loadu_si512((const void*) (current +   0)));
+    z2 = fold512(z2, k2048, _mm512_loadu_si512((const void*) (current +  64)));
+    z3 = fold512(z3, k2048, _mm512_loadu_si512((const void*) (current + 128)));
+    z4 = fold512(z4, k2048, _mm512_loadu_si512((const void*) (current + 192)));
+    current += 256;
+    length  -= 256;
+  }
+
+  // 4 x 512 bit -> 512 bit
+  const __m512i k512 = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*) Fold512));
+  z1 = fold512(z1, k512, z2);
+  z1 = fold512(z1, k512, z3);
+  z1 = fold512(z1, k512, z4);
+
+  __m128i x1 = _mm512_extracti32x4_epi32(z1, 0);
+  __m128i x2 = _mm512_extracti32x4_epi32(z1, 1);
+  __m128i x3 = _mm512_extracti32x4_epi32(z1, 2);
+  __m128i x4 = _mm512_extracti32x4_epi32(z1, 3);
+  _mm256_zeroupper();
+
+  return ~foldFinish4(x1, x2, x3, x4, current, length);
+}
+
+
+// //////////////////////////////////////////////////////////
+// runtime dispatch
+
+namespace
+{
+  typedef uint32_t (*Crc32Function)(const void* data, size_t length, uint32_t previousCrc32);
+
+  /// implementations from the fastest to the portable one
+  const CPU_KERNEL crc32Kernels[] =
+  {
+    { "vpclmul_avx512", CPU_PCLMUL | CPU_SSE41 | CPU_VPCLMUL | CPU_AVX512F, (const void*)crc32_vpclmul_avx512 },
+    { "vpclmul_avx2",   CPU_PCLMUL | CPU_SSE41 | CPU_VPCLMUL | CPU_AVX2,    (const void*)crc32_vpclmul_avx2 },
+    { "pclmul",         CPU_PCLMUL | CPU_SSE41,                             (const void*)crc32_pclmul },
+    { "slice8",         0,                                                  (const void*)crc32_8bytes },
+  };
+
+  /// pick the fastest implementation the CPU and OS support
+  Crc32Function selectCrc32()
+  {
+    const unsigned int kernel = cpu_select_kernel("crc32", crc32Kernels, sizeof(crc32Kernels) / sizeof(crc32Kernels[0]));
+    return (Crc32Function)crc32Kernels[kernel].impl;
+  }
+
+  uint32_t crc32_resolve(const void* data, size_t length, uint32_t previousCrc32);
+
+  /// starts with the resolver, which replaces itself on the first call (same result in every thread)
+  Crc32Function crc32Implementation = crc32_resolve;
+
+  uint32_t crc32_resolve(const void* data, size_t length, uint32_t previousCrc32)
+  {
+    crc32Implementation = selectCrc32();
+    return crc32Implementation(data, length, previousCrc32);
+  }
+} // anonymous namespace
+
+
+/// compute CRC32 with the fastest implementation the CPU supports
+uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
+{
+  return crc32Implementation(data, length, previousCrc32);
+}
+
+// //////////////////////////////////////////////////////////
+// combine two CRCs (as in zlib's crc32_combine)
+
+namespace
+{
+  /// x^(2^n) mod P, n = 0..31
+  const uint32_t X2nTable[32] =
+  {
+    0x40000000, 0x20000000, 0x08000000, 0x00800000,
+    0x00008000, 0xEDB88320, 0xB1E6B092, 0xA06A2517,
+    0xED627DAE, 0x88D14467, 0xD7BBFE6A, 0xEC447F11,
+    0x8E7EA170, 0x6427800E, 0x4D47BAE0, 0x09FE548F,
+    0x83852D0F, 0x30362F1A, 0x7B5A9CC3, 0x31FEC169,
+    0x9FEC022A, 0x6C8DEDC4, 0x15D6874D, 0x5FDE7A4E,
+    0xBAD90E37, 0x2E4E5EEF, 0x4EABA214, 0xA8A472C0,
+    0x429A969E, 0x148D302A, 0xC40BA6D0, 0xC4E22C3C,
+  };
+
+  /// a * b mod P (reflected)
+  uint32_t multModP(uint32_t a, uint32_t b)
+  {
+    uint32_t m = 1u << 31;
+    uint32_t p = 0;
+    for (;;)
+    {
+      if (a & m)
+      {
+        p ^= b;
+        if ((a & (m - 1)) == 0)
+          break;
+      }
+      m >>= 1;
+      b = (b & 1) ? (b >> 1) ^ Polynomial : b >> 1;
+    }
+    return p;
+  }
+} // anonymous namespace
+
+
+/// combine CRC32 of two consecutive blocks, length2 is the size of the second block in bytes
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t length2)
+{
+  // x^(8 * length2) mod P, built from the powers of two
+  uint32_t shift = 1u << 31;
+  unsigned int k = 3;
+  while (length2 != 0)
+  {
+    if (length2 & 1)
+      shift = multModP(X2nTable[k & 31], shift);
+    length2 >>= 1;
+    k++;
+  }
+
+  return multModP(shift, crc1) ^ crc2;
+}
+
 // //////////////////////////////////////////////////////////
 // constants
 
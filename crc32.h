@@ -7,3 +7,16 @@
 uint32_t crc32_8bytes  (const void* data, size_t length, uint32_t previousCrc32 = 0);
 /// compute CRC32 (Slicing-by-8 algorithm), unroll inner loop 4 times
 uint32_t crc32_4x8bytes(const void* data, size_t length, uint32_t previousCrc32 = 0);
+
+/// compute CRC32 (folding with PCLMULQDQ), CPU must support PCLMULQDQ and SSE4.1
+uint32_t crc32_pclmul  (const void* data, size_t length, uint32_t previousCrc32 = 0);
+/// compute CRC32 (folding with 256 bit VPCLMULQDQ), CPU must support VPCLMULQDQ and AVX2
+uint32_t crc32_vpclmul_avx2  (const void* data, size_t length, uint32_t previousCrc32 = 0);
+/// compute CRC32 (folding with 512 bit VPCLMULQDQ), CPU must support VPCLMULQDQ and AVX-512F
+uint32_t crc32_vpclmul_avx512(const void* data, size_t length, uint32_t previousCrc32 = 0);
+
+/// compute CRC32 with the fastest implementation the CPU supports, falls back to Slicing-by-8
+uint32_t crc32_fast    (const void* data, size_t length, uint32_t previousCrc32 = 0);
+
+/// combine CRC32 of two consecutive blocks, length2 is the size of the second block in bytes
+uint32_t crc32_combine (uint32_t crc1, uint32_t crc2, uint64_t length2);
@@ -23,8 +23,13 @@
 #endif
 
 #include "crc32c.h"
+#include "cpu_features.h"
 #include <nmmintrin.h>
+#if defined(_MSC_VER)
 #include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 #define NOMINMAX
 
@@ -42,6 +47,8 @@ static uint32_t long_shifts[4][256];
 
 static uint32_t short_shifts[4][256];
 
+static uint32_t x2n_table[32];
+
 static bool _tableInitialized;
 
 void calculate_table();
@@ -52,14 +59,14 @@ void calculate_table();
 extern "C" CRC32C_API uint32_t crc32c_append_sw(uint32_t crci, buffer input, size_t length)
 {
     buffer next = input;
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__)
     uint64_t crc;
 #else
     uint32_t crc;
 #endif
 
     crc = crci ^ 0xffffffff;
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__)
     while (length && ((uintptr_t)next & 7) != 0)
     {
         crc = table[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
@@ -132,12 +139,48 @@ static inline uint32_t shift_crc(uint32_t shift_table[][256], uint32_t crc)
         ^ shift_table[3][crc >> 24];
 }
 
+/* Multiply a and b modulo POLY (reflected, x^0 is the most significant bit). */
+static uint32_t multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ POLY : b >> 1;
+    }
+    return p;
+}
+
+/* Combine the CRCs of two consecutive blocks. Like long_shifts/short_shifts this
+   applies the zeros operator for length2 bytes to crc1, but for an arbitrary length
+   it is assembled from the precalculated x^(2^n) powers. */
+extern "C" CRC32C_API uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t length2)
+{
+    uint32_t shift = (uint32_t)1 << 31;
+    unsigned int k = 3;
+    while (length2)
+    {
+        if (length2 & 1)
+            shift = multmodp(x2n_table[k & 31], shift);
+        length2 >>= 1;
+        k++;
+    }
+    return multmodp(shift, crc1) ^ crc2;
+}
+
 /* Compute CRC-32C using the Intel hardware instruction. */
-extern "C" CRC32C_API uint32_t crc32c_append_hw(uint32_t crc, buffer buf, size_t len)
+extern "C" CRC32C_API CPU_TARGET("sse4.2") uint32_t crc32c_append_hw(uint32_t crc, buffer buf, size_t len)
 {
     buffer next = buf;
     buffer end;
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__)
     uint64_t crc0, crc1, crc2;      /* need to be 64 bits for crc32q */
 #else
     uint32_t crc0, crc1, crc2;
@@ -155,7 +198,7 @@ extern "C" CRC32C_API uint32_t crc32c_append_hw(uint32_t crc, buffer buf, size_t
         --len;
     }
 
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__)
     /* compute the crc on sets of LONG_SHIFT*3 bytes, executing three independent crc
        instructions, each on LONG_SHIFT bytes -- this is optimized for the Nehalem,
        Westmere, Sandy Bridge, and Ivy Bridge architectures, which have a
@@ -272,12 +315,95 @@ extern "C" CRC32C_API uint32_t crc32c_append_hw(uint32_t crc, buffer buf, size_t
     return static_cast<uint32_t>(crc0) ^ 0xffffffff;
 }
 
-extern "C" CRC32C_API int crc32c_hw_available()
+/* Fold constants for carry-less multiplication, (x^n mod POLY)' << 1 for the fold
+   distances 2048, 512 and 128 bit, followed by the 64 to 32 bit reduction and the
+   Barrett constants (POLY', mu) */
+static const uint64_t fold_2048[2] = { 0x0dcb17aa4ULL, 0x0b9e02b86ULL };
+static const uint64_t fold_512[2]  = { 0x0740eef02ULL, 0x09e4addf8ULL };
+static const uint64_t fold_128[2]  = { 0x0f20c0dfeULL, 0x14cd00bd6ULL };
+static const uint64_t fold_64[2]   = { 0x0dd45aab8ULL, 0x000000000ULL };
+static const uint64_t barrett[2]   = { 0x105ec76f1ULL, 0x0dea713f1ULL };
+
+CPU_TARGET("sse4.2,pclmul")
+static inline __m128i fold_xmm(__m128i x, __m128i k, __m128i data)
 {
-    int info[4];
-    __cpuid(info, 1);
-    return (info[2] & (1 << 20)) != 0;
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                                       _mm_clmulepi64_si128(x, k, 0x11)), data);
+}
 
+CPU_TARGET("sse4.2,pclmul,avx512f,vpclmulqdq")
+static inline __m512i fold_zmm(__m512i x, __m512i k, __m512i data)
+{
+    return _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x, k, 0x00),
+                                     _mm512_clmulepi64_epi128(x, k, 0x11), data, 0x96);
+}
+
+/* Compute CRC-32C by folding 256 bytes per iteration with 512 bit VPCLMULQDQ. Buffers
+   shorter than 4 KB, and the last bytes that do not fill a 16 byte block, go through
+   the crc32 instruction. */
+extern "C" CRC32C_API CPU_TARGET("sse4.2,pclmul,avx512f,vpclmulqdq") uint32_t crc32c_append_vpclmul(uint32_t crc, buffer buf, size_t len)
+{
+    if (len < 4096)
+        return crc32c_append_hw(crc, buf, len);
+
+    buffer next = buf;
+    const __m512i k2048 = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)fold_2048));
+
+    __m512i z0 = _mm512_loadu_si512((const void *)(next + 0));
+    __m512i z1 = _mm512_loadu_si512((const void *)(next + 64));
+    __m512i z2 = _mm512_loadu_si512((const void *)(next + 128));
+    __m512i z3 = _mm512_loadu_si512((const void *)(next + 192));
+    z0 = _mm512_xor_si512(z0, _mm512_inserti32x4(_mm512_setzero_si512(), _mm_cvtsi32_si128((int)~crc), 0));
+    next += 256;
+    len -= 256;
+
+    while (len >= 256)
+    {
+        z0 = fold_zmm(z0, k2048, _mm512_loadu_si512((const void *)(next + 0)));
+        z1 = fold_zmm(z1, k2048, _mm512_loadu_si512((const void *)(next + 64)));
+        z2 = fold_zmm(z2, k2048, _mm512_loadu_si512((const void *)(next + 128)));
+        z3 = fold_zmm(z3, k2048, _mm512_loadu_si512((const void *)(next + 192)));
+        next += 256;
+        len -= 256;
+    }
+
+    /* four 512 bit accumulators -> one, then its four 128 bit lanes -> one */
+    const __m512i k512 = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)fold_512));
+    z0 = fold_zmm(z0, k512, z1);
+    z0 = fold_zmm(z0, k512, z2);
+    z0 = fold_zmm(z0, k512, z3);
+
+    const __m128i k128 = _mm_loadu_si128((const __m128i *)fold_128);
+    __m128i x = _mm512_extracti32x4_epi32(z0, 0);
+    x = fold_xmm(x, k128, _mm512_extracti32x4_epi32(z0, 1));
+    x = fold_xmm(x, k128, _mm512_extracti32x4_epi32(z0, 2));
+    x = fold_xmm(x, k128, _mm512_extracti32x4_epi32(z0, 3));
+    _mm256_zeroupper();
+
+    while (len >= 16)
+    {
+        x = fold_xmm(x, k128, _mm_loadu_si128((const __m128i *)next));
+        next += 16;
+        len -= 16;
+    }
+
+    /* 128 -> 64 -> 32 bit, then Barrett reduction */
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x = _mm_xor_si128(_mm_srli_si128(x, 8), _mm_clmulepi64_si128(x, k128, 0x10));
+    __m128i t = _mm_srli_si128(x, 4);
+    x = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), _mm_loadu_si128((const __m128i *)fold_64), 0x00);
+    x = _mm_xor_si128(x, t);
+    const __m128i poly = _mm_loadu_si128((const __m128i *)barrett);
+    t = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+    crc = ~(uint32_t)_mm_extract_epi32(_mm_xor_si128(x, t), 1);
+
+    return crc32c_append_hw(crc, next, len);
+}
+
+extern "C" CRC32C_API int crc32c_hw_available()
+{
+    return (cpu_features() & CPU_SSE42) != 0;
 }
 
 void calculate_table() 
@@ -291,6 +417,12 @@ void calculate_table()
 		}
 	}
 
+	/* x^(2^n) mod POLY, used to build the zeros operator for any length in crc32c_combine */
+	uint32_t p = 1 << 30;
+	x2n_table[0] = p;
+	for (int n = 1; n < 32; n++)
+		x2n_table[n] = p = multmodp(p, p);
+
 	_tableInitialized = true;
 }
 
@@ -314,18 +446,26 @@ void calculate_table_hw()
 
 uint32_t (*append_func)(uint32_t, buffer, size_t);
 
+/* implementations from the fastest to the portable one, the last one is the table based version */
+static const CPU_KERNEL crc32c_kernels[] = {
+	{ "vpclmul_avx512", CPU_SSE42 | CPU_PCLMUL | CPU_SSE41 | CPU_VPCLMUL | CPU_AVX512F, (const void *)crc32c_append_vpclmul },
+	{ "sse42",          CPU_SSE42,                                                     (const void *)crc32c_append_hw },
+	{ "slice16",        0,                                                             (const void *)crc32c_append_sw },
+};
+
 void __crc32_init()
 {
 	if (append_func == NULL)
 	{
+		const unsigned int count = sizeof(crc32c_kernels) / sizeof(crc32c_kernels[0]);
+		const unsigned int kernel = cpu_select_kernel("crc32c", crc32c_kernels, count);
+
 		// somebody can call sw version directly, so, precalculate table for this version
 		calculate_table();
-		if (crc32c_hw_available()) {
+		// the vpclmul version hands the tail to the hw version
+		if (kernel != count - 1)
 			calculate_table_hw();
-			append_func = crc32c_append_hw;
-		} else {
-			append_func = crc32c_append_sw;
-		}
+		append_func = (uint32_t (*)(uint32_t, buffer, size_t))crc32c_kernels[kernel].impl;
 	}
 }
 
@@ -3,7 +3,9 @@
 
 #define CRC32C_API
 
-#if _MSC_VER >= 1600
+#include <stddef.h>
+
+#if !defined(_MSC_VER) || _MSC_VER >= 1600
 #include <stdint.h>
 #else
 typedef signed char        int8_t;
@@ -38,11 +40,22 @@ extern "C" CRC32C_API uint32_t crc32c_append_sw(uint32_t crc, const uint8_t *inp
 */
 extern "C" CRC32C_API uint32_t crc32c_append_hw(uint32_t crc, const uint8_t *input, size_t length);
 
+/*
+	Carry-less multiplication version of CRC-32C (Castagnoli) checksum for buffers of 4 KB and up. Needs VPCLMULQDQ and AVX-512
+	in addition to the CRC32 instruction, shorter buffers are passed on to crc32c_append_hw.
+*/
+extern "C" CRC32C_API uint32_t crc32c_append_vpclmul(uint32_t crc, const uint8_t *input, size_t length);
+
 /*
 	Checks if hardware version of CRC-32C is available.
 */
 extern "C" CRC32C_API int crc32c_hw_available();
 
+/*
+	Combines the CRC-32C of two consecutive blocks into the CRC-32C of the whole. length2 is the size of the second block.
+*/
+extern "C" CRC32C_API uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t length2);
+
 void __crc32_init();
 
 #endif
@@ -0,0 +1,20 @@
+// uint8_t, uint64_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+
+/// compute CRC64 (ECMA-182 polynomial as used by xz and 7-Zip, Slicing-by-8 algorithm)
+uint64_t crc64_8bytes  (const void* data, size_t length, uint64_t previousCrc64 = 0);
+
+/// compute CRC64 (folding with PCLMULQDQ), CPU must support PCLMULQDQ
+uint64_t crc64_pclmul  (const void* data, size_t length, uint64_t previousCrc64 = 0);
+/// compute CRC64 (folding with 256 bit VPCLMULQDQ), CPU must support VPCLMULQDQ and AVX2
+uint64_t crc64_vpclmul_avx2  (const void* data, size_t length, uint64_t previousCrc64 = 0);
+/// compute CRC64 (folding with 512 bit VPCLMULQDQ), CPU must support VPCLMULQDQ and AVX-512F
+uint64_t crc64_vpclmul_avx512(const void* data, size_t length, uint64_t previousCrc64 = 0);
+
+/// compute CRC64 with the fastest implementation the CPU supports, falls back to Slicing-by-8
+uint64_t crc64_fast    (const void* data, size_t length, uint64_t previousCrc64 = 0);
+
+/// combine CRC64 of two consecutive blocks, length2 is the size of the second block in bytes
+uint64_t crc64_combine (uint64_t crc1, uint64_t crc2, uint64_t length2);
@@ -236,6 +236,9 @@ LRESULT CALLBACK WndProcMain(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
 		thread_params_calc.arrHwnd = arrHwnd;
 		thread_params_calc.signalExit = FALSE;
         thread_params_calc.signalStop = FALSE;
+		if(thread_params_calc.hEvtRun == NULL)
+			thread_params_calc.hEvtRun = CreateEvent(NULL,TRUE,TRUE,NULL);
+		SetEvent(thread_params_calc.hEvtRun);
 		thread_params_calc.pshowresult_params = & showresult_params;
 		thread_params_calc.qwBytesReadAllFiles = 0;
 		thread_params_calc.qwBytesReadCurFile = 0;
@@ -287,8 +290,10 @@ LRESULT CALLBACK WndProcMain(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
 		return 0;
 	case WM_ACCEPT_PIPE:	//message generated by another rapidcrc instance if queueing is enabled
 							//wparam is the action to perform (if invoked by the shell extension)
+							//lparam is the -ConcurrentFiles value, 0 if not given
 		fileList = new lFILEINFO;
 		fileList->uiCmdOpts = (UINT)wParam;
+		fileList->uiConcurrentFiles = (UINT)lParam;
 		StartAcceptPipeThread(arrHwnd,fileList);
 		
 		return 0;
@@ -302,6 +307,8 @@ LRESULT CALLBACK WndProcMain(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
 		    fileList->uiCmdOpts = CMD_NORMAL;
 		    fileinfoTmp.parentList = fileList;
 		    for(INT i = 0; i < argc - 1; ++i){
+			    if(IsConcurrentFilesSwitch(argv[i+1], &fileList->uiConcurrentFiles))
+				    continue;
                 fileinfoTmp.szFilename = argv[i+1];
 			    fileList->fInfos.push_back(fileinfoTmp);
 		    }
@@ -407,12 +414,15 @@ LRESULT CALLBACK WndProcMain(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
 			    if(!SyncQueue.bThreadDone)
 				    if(SyncQueue.bThreadSuspended){
 					    ResumeThread(hThread);
+					    SetEvent(thread_params_calc.hEvtRun);
 					    SendMessage(arrHwnd[ID_BTN_PLAY_PAUSE],BM_SETIMAGE,IMAGE_ICON,(LPARAM)LoadImage(g_hInstance,MAKEINTRESOURCE(IDI_ICON_PAUSE),IMAGE_ICON,16,16,LR_DEFAULTCOLOR|LR_SHARED));
 					    SyncQueue.bThreadSuspended = FALSE;
                         if(pTaskbarList)
                             pTaskbarList->SetProgressState(hWnd, TBPF_NORMAL);
 				    }
 				    else{
+					    // the calc thread only waits for the file streams and segment threads, they check hEvtRun
+					    ResetEvent(thread_params_calc.hEvtRun);
 					    SuspendThread(hThread);
 					    SendMessage(arrHwnd[ID_BTN_PLAY_PAUSE],BM_SETIMAGE,IMAGE_ICON,(LPARAM)LoadImage(g_hInstance,MAKEINTRESOURCE(IDI_ICON_PLAY),IMAGE_ICON,16,16,LR_DEFAULTCOLOR|LR_SHARED));
 					    SyncQueue.bThreadSuspended = TRUE;
@@ -462,8 +472,10 @@ LRESULT CALLBACK WndProcMain(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
 		if(!SyncQueue.bThreadDone){
             thread_params_calc.signalStop = TRUE;
 			thread_params_calc.signalExit = TRUE;
-			if(SyncQueue.bThreadSuspended)
+			if(SyncQueue.bThreadSuspended) {
 				ResumeThread(hThread);
+				SetEvent(thread_params_calc.hEvtRun);
+			}
             while(MsgWaitForMultipleObjects(1, &hThread, FALSE, 4000, QS_SENDMESSAGE) == WAIT_OBJECT_0 + 1) {
                 MSG msg;
                 PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE);
@@ -587,6 +599,24 @@ INT_PTR CALLBACK DlgProcOptions(HWND hDlg, UINT message, WPARAM wParam, LPARAM l
 				return TRUE;
 			}
 			break;
+        case IDC_EDIT_READ_BUFFER_COUNT:
+			if(HIWORD(wParam) == EN_CHANGE){
+				GetWindowText(GetDlgItem(hDlg, IDC_EDIT_READ_BUFFER_COUNT), szTemp, MAX_PATH_EX);
+                program_options_temp.uiReadBufferCount =_ttoi(szTemp);
+                if(program_options_temp.uiReadBufferCount < 2 || program_options_temp.uiReadBufferCount > MAX_BUFFER_COUNT_CALC)
+                    program_options_temp.uiReadBufferCount = DEFAULT_BUFFER_COUNT_CALC;
+				return TRUE;
+			}
+			break;
+        case IDC_EDIT_CONCURRENT_FILES:
+			if(HIWORD(wParam) == EN_CHANGE){
+				GetWindowText(GetDlgItem(hDlg, IDC_EDIT_CONCURRENT_FILES), szTemp, MAX_PATH_EX);
+                program_options_temp.uiConcurrentFiles =_ttoi(szTemp);
+                if(program_options_temp.uiConcurrentFiles < 1 || program_options_temp.uiConcurrentFiles > MAX_CONCURRENT_FILES)
+                    program_options_temp.uiConcurrentFiles = DEFAULT_CONCURRENT_FILES;
+				return TRUE;
+			}
+			break;
 		case IDC_BTN_DEFAULT:
 			if(HIWORD(wParam) == BN_CLICKED){
 				SetDefaultOptions(& program_options_temp);
@@ -600,6 +630,12 @@ INT_PTR CALLBACK DlgProcOptions(HWND hDlg, UINT message, WPARAM wParam, LPARAM l
 				return TRUE;
 			}
 			break;
+        case IDC_BTN_CPU_KERNELS:
+			if(HIWORD(wParam) == BN_CLICKED){
+                ShowCpuKernels(hDlg);
+				return TRUE;
+			}
+			break;
 		case IDC_CHECK_SORT_LIST:
 			if(HIWORD(wParam) == BN_CLICKED){
 				program_options_temp.bSortList = (IsDlgButtonChecked(hDlg, IDC_CHECK_SORT_LIST) == BST_CHECKED);
@@ -637,6 +673,12 @@ INT_PTR CALLBACK DlgProcOptions(HWND hDlg, UINT message, WPARAM wParam, LPARAM l
 				return TRUE;
 			}
 			break;
+		case IDC_HASH_LARGE_FILES_IN_SEGMENTS:
+			if (HIWORD(wParam) == BN_CLICKED) {
+				program_options_temp.bHashLargeFilesInSegments = (IsDlgButtonChecked(hDlg, IDC_HASH_LARGE_FILES_IN_SEGMENTS) == BST_CHECKED);
+				return TRUE;
+			}
+			break;
 		case IDC_CLOSE_AFTER_SHELLEXT_ACTION:
 			if (HIWORD(wParam) == BN_CLICKED) {
 				program_options_temp.bCloseAfterActionFromShellExt = (IsDlgButtonChecked(hDlg, IDC_CLOSE_AFTER_SHELLEXT_ACTION) == BST_CHECKED);
@@ -699,6 +741,10 @@ INT_PTR CALLBACK DlgProcOptions(HWND hDlg, UINT message, WPARAM wParam, LPARAM l
         case IDC_CHECK_CRCC_DEFAULT:
         case IDC_CHECK_BLAKE2SP_DEFAULT:
 		case IDC_CHECK_BLAKE3_DEFAULT:
+		case IDC_CHECK_BLAKE2BP_DEFAULT:
+		case IDC_CHECK_XXH128_DEFAULT:
+		case IDC_CHECK_K12_DEFAULT:
+		case IDC_CHECK_CRC64_DEFAULT:
 			if(HIWORD(wParam) == BN_CLICKED){
                 unsigned int offset = LOWORD(wParam) - IDC_CHECK_CRC_DEFAULT;
 				program_options_temp.bCalcPerDefault[offset] = (IsDlgButtonChecked(hDlg, LOWORD(wParam)) == BST_CHECKED);
@@ -717,6 +763,10 @@ INT_PTR CALLBACK DlgProcOptions(HWND hDlg, UINT message, WPARAM wParam, LPARAM l
         case IDC_CHECK_DISPLAY_CRCC_IN_LIST:
         case IDC_CHECK_DISPLAY_BLAKE2SP_IN_LIST:
 		case IDC_CHECK_DISPLAY_BLAKE3_IN_LIST:
+		case IDC_CHECK_DISPLAY_BLAKE2BP_IN_LIST:
+		case IDC_CHECK_DISPLAY_XXH128_IN_LIST:
+		case IDC_CHECK_DISPLAY_K12_IN_LIST:
+		case IDC_CHECK_DISPLAY_CRC64_IN_LIST:
 			if(HIWORD(wParam) == BN_CLICKED){
                 unsigned int offset = LOWORD(wParam) - IDC_CHECK_DISPLAY_CRC_IN_LIST;
                 program_options_temp.bDisplayInListView[offset] = (IsDlgButtonChecked(hDlg, LOWORD(wParam)) == BST_CHECKED);
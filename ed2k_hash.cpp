@@ -1,20 +1,141 @@
 /* implementations for ed2k_hash.h */
 
 #include "ed2k_hash.h"
+#if !defined(_WIN32)
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+/*
+  The first part is hashed inline in add_data. Once it is complete the file
+  spans several parts, and the following parts are copied into job buffers
+  and hashed by worker threads from the system thread pool (a thread per part
+  outside of Windows). The jobs are used
+  round-robin, so waiting for the job that receives the next part also
+  collects the part hashes in file order.
+*/
 
 CEd2kHash::CEd2kHash() {
 	part_count = 0;
 	current_bytes = 0;
+	job_count = 0;
+	next_job = 0;
+	memset(jobs, 0, sizeof(jobs));
 }
 
 CEd2kHash::~CEd2kHash(){
+	free_jobs();
+}
+
+void CEd2kHash::init_jobs(){
+	unsigned int count, i;
+#if defined(_WIN32)
+	SYSTEM_INFO si;
+
+	GetSystemInfo(&si);
+	count = min(si.dwNumberOfProcessors, ED2K_MAX_PARTS_IN_FLIGHT);
+#else
+	const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	count = processors < ED2K_MAX_PARTS_IN_FLIGHT ? (processors > 0 ? (unsigned int)processors : 1) : ED2K_MAX_PARTS_IN_FLIGHT;
+#endif
+	if(count < 2)
+		return;
+
+	for(i = 0; i < count; i++) {
+#if defined(_WIN32)
+		jobs[i].data = (BYTE *)VirtualAlloc(NULL, BLOCKSIZE, MEM_COMMIT, PAGE_READWRITE);
+		jobs[i].hEvtDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+#else
+		jobs[i].data = (BYTE *)malloc(BLOCKSIZE);
+#endif
+		jobs[i].bPending = FALSE;
+		job_count = i + 1;
+#if defined(_WIN32)
+		if(jobs[i].data == NULL || jobs[i].hEvtDone == NULL) {
+#else
+		if(jobs[i].data == NULL) {
+#endif
+			free_jobs();
+			return;
+		}
+	}
+	next_job = 0;
+}
+
+void CEd2kHash::free_jobs(){
+	collect_pending_jobs();
+	for(unsigned int i = 0; i < job_count; i++) {
+#if defined(_WIN32)
+		if(jobs[i].data)
+			VirtualFree(jobs[i].data, 0, MEM_RELEASE);
+		if(jobs[i].hEvtDone)
+			CloseHandle(jobs[i].hEvtDone);
+#else
+		free(jobs[i].data);
+#endif
+	}
+	memset(jobs, 0, sizeof(jobs));
+	job_count = 0;
+	next_job = 0;
+}
+
+#if defined(_WIN32)
+DWORD WINAPI CEd2kHash::ThreadProc_PartCalc(VOID *pParam){
+#else
+void *CEd2kHash::ThreadProc_PartCalc(void *pParam){
+#endif
+	ED2K_PART_JOB *job = (ED2K_PART_JOB *)pParam;
+	CMD4 md4;
+
+	md4.Add(job->data, job->size);
+	md4.Finish();
+	md4.GetHash(job->hash.b);
+#if defined(_WIN32)
+	SetEvent(job->hEvtDone);
+#endif
+	return 0;
+}
+
+void CEd2kHash::start_job(const unsigned int job){
+#if defined(_WIN32)
+	ResetEvent(jobs[job].hEvtDone);
+	jobs[job].bPending = TRUE;
+	if(!QueueUserWorkItem(ThreadProc_PartCalc, &jobs[job], WT_EXECUTELONGFUNCTION))
+		ThreadProc_PartCalc(&jobs[job]);
+#else
+	jobs[job].bPending = TRUE;
+	jobs[job].bThread = pthread_create(&jobs[job].thread, NULL, ThreadProc_PartCalc, &jobs[job]) == 0;
+	if(!jobs[job].bThread)
+		ThreadProc_PartCalc(&jobs[job]);
+#endif
+}
+
+void CEd2kHash::collect_job(const unsigned int job){
+	if(!jobs[job].bPending)
+		return;
+#if defined(_WIN32)
+	WaitForSingleObject(jobs[job].hEvtDone, INFINITE);
+#else
+	if(jobs[job].bThread)
+		pthread_join(jobs[job].thread, NULL);
+#endif
+	jobs[job].bPending = FALSE;
+	md4_hashes.push_back(jobs[job].hash);
+}
+
+// collects the outstanding jobs from the oldest to the newest, the oldest one is next_job
+void CEd2kHash::collect_pending_jobs(){
+	for(unsigned int i = 0; i < job_count; i++)
+		collect_job((next_job + i) % job_count);
 }
 
 void CEd2kHash::restart_calc(){
+	collect_pending_jobs();
     md4_hashes.clear();
 	md4class.Reset(); 
 	part_count = 0;
 	current_bytes = 0;
+	next_job = 0;
 }
 
 void CEd2kHash::add_data(BYTE* data,const unsigned int size){
@@ -23,16 +144,30 @@ void CEd2kHash::add_data(BYTE* data,const unsigned int size){
 
 	if(current_bytes + size >= BLOCKSIZE) {
 		count = BLOCKSIZE - current_bytes;
-		md4class.Add(data,count);
-		md4class.Finish();
-		md4class.GetHash(current_hash.b);
-		md4class.Reset();
-		md4_hashes.push_back(current_hash);
+		if(job_count) {
+			memcpy(jobs[next_job].data + current_bytes, data, count);
+			jobs[next_job].size = BLOCKSIZE;
+			start_job(next_job);
+			next_job = (next_job + 1) % job_count;
+			// the job for the next part may still be busy with an older one
+			collect_job(next_job);
+		} else {
+			md4class.Add(data,count);
+			md4class.Finish();
+			md4class.GetHash(current_hash.b);
+			md4class.Reset();
+			md4_hashes.push_back(current_hash);
+			if(part_count == 0)
+				init_jobs();
+		}
 		current_bytes = 0;
 		part_count++;
 		this->add_data(data + count,size-count);
 	} else {
-		md4class.Add(data,size);
+		if(job_count)
+			memcpy(jobs[next_job].data + current_bytes, data, size);
+		else
+			md4class.Add(data,size);
 		current_bytes += size;
 	}
 }
@@ -41,11 +176,18 @@ void CEd2kHash::finish_calc(){
 	MD4 current_hash;
 	list<MD4>::iterator it;
 	if(current_bytes > 0) {
+		if(job_count) {
+			// the last part is hashed here while the workers finish the others
+			md4class.Reset();
+			md4class.Add(jobs[next_job].data, current_bytes);
+		}
 		md4class.Finish();
 		md4class.GetHash(current_hash.b);
+		collect_pending_jobs();
 		md4_hashes.push_back(current_hash);
 		part_count++;
-	}
+	} else
+		collect_pending_jobs();
 	if(part_count == 1)
 		memcpy(ed2k_hash,(md4_hashes.begin())->b,16);
 	else {
@@ -3,7 +3,18 @@
 
 /* wrapper class for md4.h/.cpp to calculate ED2K hashes */
 
+#if defined(_WIN32)
 #include <windows.h>
+#else
+#include <pthread.h>
+#include <string.h>
+#ifndef BYTE	// the *_ossl.h headers define it as a macro
+typedef unsigned char BYTE;
+#endif
+typedef int BOOL;
+#define TRUE 1
+#define FALSE 0
+#endif
 #include "md4.h"
 #pragma warning(disable:4995)
 #include <list>
@@ -12,16 +23,47 @@ using namespace std;
 
 #define BLOCKSIZE	(9500*1024)
 
+// maximum number of parts that are hashed at the same time, each one needs a BLOCKSIZE buffer
+#define ED2K_MAX_PARTS_IN_FLIGHT 4
+
 typedef struct _MD4 {
 	BYTE b[16];
 } MD4;
 
+// one part that is hashed by a worker thread
+typedef struct _ED2K_PART_JOB {
+	BYTE *data;                     // copy of the part
+	unsigned int size;              // bytes of data that belong to the part
+	MD4 hash;                       // md4 of the part, valid once hEvtDone is signaled
+#if defined(_WIN32)
+	HANDLE hEvtDone;
+#else
+	pthread_t thread;               // joined to collect the part if bThread
+	BOOL bThread;
+#endif
+	BOOL bPending;                  // queued and not collected yet
+} ED2K_PART_JOB;
+
 class CEd2kHash {
-	CMD4 md4class;	                // class for the md4 calculation
+	CMD4 md4class;	                // class for the md4 calculation of the first part
 	list<MD4> md4_hashes;			// list of our hashes, we need to hash across this after the last part
 	BYTE ed2k_hash[16];             // the final ed2k hash
 	unsigned int current_bytes;     // counts how many bytes of the current part have already been passed to md4
 	unsigned int part_count;        // number of parts calculated
+	ED2K_PART_JOB jobs[ED2K_MAX_PARTS_IN_FLIGHT];
+	unsigned int job_count;         // number of usable jobs, 0 while parts are hashed inline
+	unsigned int next_job;          // job that receives the data of the current part
+
+	void init_jobs();               // allocates the part buffers once the file has more than one part
+	void free_jobs();
+	void start_job(const unsigned int job);
+	void collect_job(const unsigned int job);
+	void collect_pending_jobs();
+#if defined(_WIN32)
+	static DWORD WINAPI ThreadProc_PartCalc(VOID *pParam);
+#else
+	static void *ThreadProc_PartCalc(void *pParam);
+#endif
 public:
 	CEd2kHash();
 	~CEd2kHash();
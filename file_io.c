@@ -0,0 +1,733 @@
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE		/* O_DIRECT */
+#endif
+#include "file_io.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+typedef HANDLE FILE_IO_FD;
+#define FILE_IO_NO_FD			INVALID_HANDLE_VALUE
+/* errors of the generic layer, in the same space as the ones of the system calls */
+#define FILE_IO_ERROR(posix, win32)	(win32)
+#else
+typedef int FILE_IO_FD;
+#define FILE_IO_NO_FD			(-1)
+#define FILE_IO_ERROR(posix, win32)	(posix)
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define FILE_IO_URING
+#endif
+#endif
+
+/* a read as passed to file_io_read */
+typedef struct _FILE_IO_REQUEST {
+	int					file;
+	unsigned int		buffer;
+	unsigned long long	offset;
+	size_t				length;
+} FILE_IO_REQUEST;
+
+typedef struct _FILE_IO_BACKEND {
+	const char	*name;
+	int			(*init)(FILE_IO *io);				/* 0 or -errno, the buffers are allocated */
+	void		(*cleanup)(FILE_IO *io);
+	int			(*open)(FILE_IO *io, int file);		/* fds[file] was opened */
+	void		(*close)(FILE_IO *io, int file);	/* fds[file] is about to be closed */
+	int			(*read)(FILE_IO *io, const FILE_IO_REQUEST *request);
+	void		(*cancel)(FILE_IO *io, int file);
+	int			(*submit)(FILE_IO *io);
+	int			(*reap)(FILE_IO *io, FILE_IO_COMPLETION *completions, unsigned int max, int wait);
+} FILE_IO_BACKEND;
+
+struct _FILE_IO {
+	const FILE_IO_BACKEND	*backend;
+	unsigned char			**buffers;
+	unsigned int			buffer_count;
+	size_t					buffer_size;
+	FILE_IO_FD				fds[FILE_IO_MAX_FILES];		/* FILE_IO_NO_FD for a free file number */
+	int						direct[FILE_IO_MAX_FILES];
+	FILE_IO_REQUEST			*reads;						/* the read of every buffer */
+	unsigned int			pending;					/* reads queued and not reaped yet */
+
+	/* pread, overlapped: queued reads in the order they were issued, a ring of buffer_count entries */
+	unsigned int			queue_head, queue_count;
+	unsigned int			*queue;
+
+#if defined(_WIN32)
+	OVERLAPPED				*olps;						/* the read of every buffer, each with an event */
+	DWORD					*errors;					/* ReadFile failed right away, no result to wait for */
+#endif
+
+#if defined(FILE_IO_URING)
+	int						ring_fd;
+	void					*sq_map, *cq_map;
+	size_t					sq_map_size, cq_map_size;
+	struct io_uring_sqe		*sqes;
+	size_t					sqes_size;
+	unsigned int			*sq_head, *sq_tail, *sq_mask, *sq_array, sq_entries;
+	unsigned int			*cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe		*cqes;
+	unsigned int			to_submit;
+	int						fixed_buffers;
+	int						fixed_files;
+	unsigned int			registered;					/* bit per file number in the fixed file table */
+#endif
+};
+
+/* ---------------------------------------------------------------- */
+
+#if defined(_WIN32)
+
+static void overlapped_cleanup(FILE_IO *io)
+{
+	unsigned int i;
+
+	if (io->olps) {
+		for (i = 0; i < io->buffer_count; i++) {
+			if (io->olps[i].hEvent)
+				CloseHandle(io->olps[i].hEvent);
+		}
+	}
+	free(io->olps);
+	free(io->errors);
+	free(io->queue);
+}
+
+static int overlapped_init(FILE_IO *io)
+{
+	unsigned int i;
+
+	io->queue = (unsigned int *)calloc(io->buffer_count, sizeof(unsigned int));
+	io->olps = (OVERLAPPED *)calloc(io->buffer_count, sizeof(OVERLAPPED));
+	io->errors = (DWORD *)calloc(io->buffer_count, sizeof(DWORD));
+	if (io->queue == NULL || io->olps == NULL || io->errors == NULL) {
+		overlapped_cleanup(io);
+		return -ERROR_NOT_ENOUGH_MEMORY;
+	}
+	for (i = 0; i < io->buffer_count; i++) {
+		io->olps[i].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (io->olps[i].hEvent == NULL) {
+			const int result = -(int)GetLastError();
+			overlapped_cleanup(io);
+			return result;
+		}
+	}
+	return 0;
+}
+
+static int overlapped_open(FILE_IO *io, int file) { (void)io; (void)file; return 0; }
+static void overlapped_close(FILE_IO *io, int file) { (void)io; (void)file; }
+static int overlapped_submit(FILE_IO *io) { (void)io; return 0; }
+
+/* ReadFile starts the read right away, file_io_submit has nothing left to do */
+static int overlapped_read(FILE_IO *io, const FILE_IO_REQUEST *request)
+{
+	OVERLAPPED *olp = &io->olps[request->buffer];
+	const HANDLE hEvent = olp->hEvent;
+
+	memset(olp, 0, sizeof(OVERLAPPED));
+	olp->hEvent = hEvent;
+	olp->Offset = (DWORD)(request->offset & 0xffffffff);
+	olp->OffsetHigh = (DWORD)(request->offset >> 32);
+	io->errors[request->buffer] = NO_ERROR;
+	if (!ReadFile(io->fds[request->file], io->buffers[request->buffer], (DWORD)request->length, NULL, olp) &&
+		GetLastError() != ERROR_IO_PENDING)
+		io->errors[request->buffer] = GetLastError();
+	io->queue[(io->queue_head + io->queue_count++) % io->buffer_count] = request->buffer;
+	return 0;
+}
+
+/* CancelIo only reaches the reads that the calling thread issued */
+static void overlapped_cancel(FILE_IO *io, int file)
+{
+	CancelIo(io->fds[file]);
+}
+
+/* the reads are reaped in the order they were issued */
+static int overlapped_reap(FILE_IO *io, FILE_IO_COMPLETION *completions, unsigned int max, int wait)
+{
+	unsigned int n = 0;
+
+	while (n < max && io->queue_count > 0) {
+		const unsigned int buffer = io->queue[io->queue_head];
+		OVERLAPPED *olp = &io->olps[buffer];
+		DWORD error = io->errors[buffer], bytes = 0;
+
+		if (error == NO_ERROR) {
+			if ((!wait || n > 0) && !HasOverlappedIoCompleted(olp))
+				break;
+			if (!GetOverlappedResult(io->fds[io->reads[buffer].file], olp, &bytes, TRUE))
+				error = GetLastError();
+		}
+		if (error == ERROR_HANDLE_EOF) {
+			error = NO_ERROR;
+			bytes = 0;
+		}
+		completions[n].buffer = buffer;
+		completions[n].result = error != NO_ERROR ? -(long)error : (long)bytes;
+		io->queue_head = (io->queue_head + 1) % io->buffer_count;
+		io->queue_count--;
+		n++;
+	}
+	return (int)n;
+}
+
+#else
+
+static int pread_init(FILE_IO *io)
+{
+	io->queue = (unsigned int *)calloc(io->buffer_count, sizeof(unsigned int));
+	return io->queue ? 0 : -ENOMEM;
+}
+
+static void pread_cleanup(FILE_IO *io)
+{
+	free(io->queue);
+}
+
+static int pread_open(FILE_IO *io, int file) { (void)io; (void)file; return 0; }
+static void pread_close(FILE_IO *io, int file) { (void)io; (void)file; }
+static int pread_submit(FILE_IO *io) { (void)io; return 0; }
+
+static int pread_read(FILE_IO *io, const FILE_IO_REQUEST *request)
+{
+	io->queue[(io->queue_head + io->queue_count++) % io->buffer_count] = request->buffer;
+	return 0;
+}
+
+/* the queued reads of the file are not run, they complete with 0 bytes */
+static void pread_cancel(FILE_IO *io, int file)
+{
+	unsigned int i;
+
+	for (i = 0; i < io->queue_count; i++) {
+		FILE_IO_REQUEST *request = &io->reads[io->queue[(io->queue_head + i) % io->buffer_count]];
+		if (request->file == file)
+			request->length = 0;
+	}
+}
+
+/* a short read is completed by file_io_reap */
+static int pread_reap(FILE_IO *io, FILE_IO_COMPLETION *completions, unsigned int max, int wait)
+{
+	unsigned int n = 0;
+
+	(void)wait;
+	while (n < max && io->queue_count > 0) {
+		const FILE_IO_REQUEST *request = &io->reads[io->queue[io->queue_head]];
+		ssize_t result;
+
+		do {
+			result = pread(io->fds[request->file], io->buffers[request->buffer], request->length, (off_t)request->offset);
+		} while (result < 0 && errno == EINTR);
+		completions[n].buffer = request->buffer;
+		completions[n].result = result < 0 ? -errno : (long)result;
+		io->queue_head = (io->queue_head + 1) % io->buffer_count;
+		io->queue_count--;
+		n++;
+	}
+	return (int)n;
+}
+
+#endif
+
+/* ---------------------------------------------------------------- */
+
+#if defined(FILE_IO_URING)
+
+/* the ring is used without liburing, these are the three system calls behind it */
+static int uring_setup(unsigned int entries, struct io_uring_params *params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned int opcode, const void *arg, unsigned int count)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static void uring_cleanup(FILE_IO *io)
+{
+	if (io->sqes)
+		munmap(io->sqes, io->sqes_size);
+	if (io->cq_map && io->cq_map != io->sq_map)
+		munmap(io->cq_map, io->cq_map_size);
+	if (io->sq_map)
+		munmap(io->sq_map, io->sq_map_size);
+	close(io->ring_fd);
+}
+
+static int uring_init(FILE_IO *io)
+{
+	struct io_uring_params params;
+	struct iovec *iov;
+	int files[FILE_IO_MAX_FILES];
+	unsigned int i;
+
+	memset(&params, 0, sizeof(params));
+	io->ring_fd = uring_setup(io->buffer_count, &params);
+	if (io->ring_fd < 0)
+		return -errno;
+	/* IORING_OP_READ came with 5.6, as did this flag */
+	if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+		close(io->ring_fd);
+		return -ENOSYS;
+	}
+
+	io->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	io->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (io->cq_map_size > io->sq_map_size)
+			io->sq_map_size = io->cq_map_size;
+		io->cq_map_size = io->sq_map_size;
+	}
+	io->sq_map = mmap(NULL, io->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_SQ_RING);
+	if (io->sq_map == MAP_FAILED) {
+		io->sq_map = NULL;
+		uring_cleanup(io);
+		return -ENOMEM;
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		io->cq_map = io->sq_map;
+	else {
+		io->cq_map = mmap(NULL, io->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_CQ_RING);
+		if (io->cq_map == MAP_FAILED) {
+			io->cq_map = NULL;
+			uring_cleanup(io);
+			return -ENOMEM;
+		}
+	}
+	io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	io->sqes = (struct io_uring_sqe *)mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->ring_fd, IORING_OFF_SQES);
+	if (io->sqes == MAP_FAILED) {
+		io->sqes = NULL;
+		uring_cleanup(io);
+		return -ENOMEM;
+	}
+
+	io->sq_head = (unsigned int *)((char *)io->sq_map + params.sq_off.head);
+	io->sq_tail = (unsigned int *)((char *)io->sq_map + params.sq_off.tail);
+	io->sq_mask = (unsigned int *)((char *)io->sq_map + params.sq_off.ring_mask);
+	io->sq_array = (unsigned int *)((char *)io->sq_map + params.sq_off.array);
+	io->sq_entries = params.sq_entries;
+	io->cq_head = (unsigned int *)((char *)io->cq_map + params.cq_off.head);
+	io->cq_tail = (unsigned int *)((char *)io->cq_map + params.cq_off.tail);
+	io->cq_mask = (unsigned int *)((char *)io->cq_map + params.cq_off.ring_mask);
+	io->cqes = (struct io_uring_cqe *)((char *)io->cq_map + params.cq_off.cqes);
+
+	/* registered buffers are pinned once instead of for every read, this counts against
+	   RLIMIT_MEMLOCK and may fail, the reads then go to the plain addresses */
+	iov = (struct iovec *)calloc(io->buffer_count, sizeof(struct iovec));
+	if (iov) {
+		for (i = 0; i < io->buffer_count; i++) {
+			iov[i].iov_base = io->buffers[i];
+			iov[i].iov_len = io->buffer_size;
+		}
+		io->fixed_buffers = uring_register(io->ring_fd, IORING_REGISTER_BUFFERS, iov, io->buffer_count) == 0;
+		free(iov);
+	}
+
+	/* an empty table, file_io_open fills in its slot */
+	for (i = 0; i < FILE_IO_MAX_FILES; i++)
+		files[i] = -1;
+	io->fixed_files = uring_register(io->ring_fd, IORING_REGISTER_FILES, files, FILE_IO_MAX_FILES) == 0;
+	return 0;
+}
+
+static int uring_update_file(FILE_IO *io, int file, int fd)
+{
+	struct io_uring_files_update update;
+
+	memset(&update, 0, sizeof(update));
+	update.offset = (unsigned int)file;
+	update.fds = (uint64_t)(uintptr_t)&fd;
+	return uring_register(io->ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+}
+
+/* a file that can not be put into the table is read through its descriptor */
+static int uring_open(FILE_IO *io, int file)
+{
+	if (io->fixed_files && uring_update_file(io, file, io->fds[file]))
+		io->registered |= 1u << file;
+	return 0;
+}
+
+static void uring_close(FILE_IO *io, int file)
+{
+	if (io->registered & (1u << file)) {
+		uring_update_file(io, file, -1);
+		io->registered &= ~(1u << file);
+	}
+}
+
+static int uring_read(FILE_IO *io, const FILE_IO_REQUEST *request)
+{
+	const unsigned int tail = *io->sq_tail;
+	struct io_uring_sqe *sqe;
+	unsigned int index;
+
+	if (tail - __atomic_load_n(io->sq_head, __ATOMIC_ACQUIRE) >= io->sq_entries)
+		return -EBUSY;
+	index = tail & *io->sq_mask;
+	sqe = &io->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	if (io->fixed_buffers) {
+		sqe->opcode = IORING_OP_READ_FIXED;
+		sqe->buf_index = (unsigned short)request->buffer;
+	} else
+		sqe->opcode = IORING_OP_READ;
+	if (io->registered & (1u << request->file)) {
+		sqe->fd = request->file;
+		sqe->flags = IOSQE_FIXED_FILE;
+	} else
+		sqe->fd = io->fds[request->file];
+	sqe->addr = (uint64_t)(uintptr_t)io->buffers[request->buffer];
+	sqe->len = (unsigned int)request->length;
+	sqe->off = request->offset;
+	sqe->user_data = request->buffer;
+	io->sq_array[index] = index;
+	__atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	io->to_submit++;
+	return 0;
+}
+
+/* the kernel may take only some of the reads when it is short of memory (EAGAIN) or the
+   completion queue is full (EBUSY), the rest is handed over by uring_reap */
+static int uring_submit(FILE_IO *io)
+{
+	while (io->to_submit > 0) {
+		const int submitted = uring_enter(io->ring_fd, io->to_submit, 0, 0);
+		if (submitted < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EBUSY)
+				return 0;
+			return -errno;
+		}
+		if (submitted == 0)
+			return 0;
+		io->to_submit -= (unsigned int)submitted;
+	}
+	return 0;
+}
+
+static int uring_reap(FILE_IO *io, FILE_IO_COMPLETION *completions, unsigned int max, int wait)
+{
+	unsigned int n = 0;
+	int submitted;
+
+	for (;;) {
+		unsigned int head = *io->cq_head;
+		const unsigned int tail = __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+
+		while (head != tail && n < max) {
+			const struct io_uring_cqe *cqe = &io->cqes[head & *io->cq_mask];
+			completions[n].buffer = (unsigned int)cqe->user_data;
+			completions[n].result = cqe->res;
+			head++;
+			n++;
+		}
+		__atomic_store_n(io->cq_head, head, __ATOMIC_RELEASE);
+
+		if (n > 0 || !wait)
+			return (int)n;
+		/* the reads uring_submit could not hand over go with the wait, all of the pending
+		   ones have to be in the kernel or there may be nothing to wait for */
+		submitted = uring_enter(io->ring_fd, io->to_submit, 1, IORING_ENTER_GETEVENTS);
+		if (submitted >= 0)
+			io->to_submit -= (unsigned int)submitted;
+		else if (errno == EINTR)
+			continue;
+		else if ((errno == EAGAIN || errno == EBUSY) && io->pending > io->to_submit) {
+			/* still short, one of the reads in flight frees what the others need */
+			if (uring_enter(io->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+				return -errno;
+		} else
+			return -errno;
+	}
+}
+
+/* the reads are left to finish, there are at most buffer_count of them */
+static void uring_cancel(FILE_IO *io, int file) { (void)io; (void)file; }
+
+#endif
+
+/* ---------------------------------------------------------------- */
+
+/* in the order they are tried without a name */
+static const FILE_IO_BACKEND file_io_backends[] = {
+#if defined(_WIN32)
+	{ "overlapped", overlapped_init, overlapped_cleanup, overlapped_open, overlapped_close, overlapped_read,
+	  overlapped_cancel, overlapped_submit, overlapped_reap },
+#else
+#if defined(FILE_IO_URING)
+	{ "io_uring", uring_init, uring_cleanup, uring_open, uring_close, uring_read, uring_cancel, uring_submit, uring_reap },
+#endif
+	{ "pread", pread_init, pread_cleanup, pread_open, pread_close, pread_read, pread_cancel, pread_submit, pread_reap },
+#endif
+};
+
+#define FILE_IO_BACKEND_COUNT	(sizeof(file_io_backends) / sizeof(file_io_backends[0]))
+
+/* aligned to FILE_IO_ALIGNMENT, VirtualAlloc gives whole pages */
+static unsigned char *file_io_alloc_buffer(size_t size)
+{
+#if defined(_WIN32)
+	return (unsigned char *)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void *buffer;
+
+	return posix_memalign(&buffer, FILE_IO_ALIGNMENT, size) == 0 ? (unsigned char *)buffer : NULL;
+#endif
+}
+
+static void file_io_free_buffer(unsigned char *buffer)
+{
+#if defined(_WIN32)
+	if (buffer)
+		VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+	free(buffer);
+#endif
+}
+
+static void file_io_free(FILE_IO *io)
+{
+	unsigned int i;
+
+	if (io->buffers) {
+		for (i = 0; i < io->buffer_count; i++)
+			file_io_free_buffer(io->buffers[i]);
+		free(io->buffers);
+	}
+	free(io->reads);
+	free(io);
+}
+
+FILE_IO *file_io_create(const char *backend, unsigned int buffer_count, size_t buffer_size)
+{
+	FILE_IO *io;
+	unsigned int i;
+	int result = -EINVAL;
+
+	if (buffer_count == 0 || buffer_size == 0 || buffer_size > 0x7fffffff) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (backend == NULL || *backend == 0)
+		backend = getenv("RAPIDCRC_IO");
+	if (backend != NULL && *backend == 0)
+		backend = NULL;
+
+	io = (FILE_IO *)calloc(1, sizeof(FILE_IO));
+	if (io == NULL)
+		return NULL;
+	for (i = 0; i < FILE_IO_MAX_FILES; i++)
+		io->fds[i] = FILE_IO_NO_FD;
+	io->buffer_count = buffer_count;
+	io->buffer_size = buffer_size;
+	io->buffers = (unsigned char **)calloc(buffer_count, sizeof(unsigned char *));
+	io->reads = (FILE_IO_REQUEST *)calloc(buffer_count, sizeof(FILE_IO_REQUEST));
+	if (io->buffers == NULL || io->reads == NULL) {
+		file_io_free(io);
+		errno = ENOMEM;
+		return NULL;
+	}
+	for (i = 0; i < buffer_count; i++) {
+		io->buffers[i] = file_io_alloc_buffer(buffer_size);
+		if (io->buffers[i] == NULL) {
+			file_io_free(io);
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+
+	for (i = 0; i < FILE_IO_BACKEND_COUNT; i++) {
+		if (backend && strcmp(backend, file_io_backends[i].name) != 0)
+			continue;
+		io->backend = &file_io_backends[i];
+		result = io->backend->init(io);
+		if (result == 0)
+			return io;
+		/* a backend asked for by name is not replaced by another one */
+		if (backend)
+			break;
+	}
+
+	file_io_free(io);
+#if defined(_WIN32)
+	/* the backend failed with a system error code, errno can not hold it */
+	errno = result == -EINVAL ? EINVAL : ENOMEM;
+#else
+	errno = -result;
+#endif
+	return NULL;
+}
+
+void file_io_destroy(FILE_IO *io)
+{
+	unsigned int i;
+
+	for (i = 0; i < FILE_IO_MAX_FILES; i++) {
+		if (io->fds[i] != FILE_IO_NO_FD)
+			file_io_close(io, (int)i);
+	}
+	io->backend->cleanup(io);
+	file_io_free(io);
+}
+
+const char *file_io_backend(const FILE_IO *io)
+{
+	return io->backend->name;
+}
+
+unsigned char *file_io_buffer(const FILE_IO *io, unsigned int buffer)
+{
+	return buffer < io->buffer_count ? io->buffers[buffer] : NULL;
+}
+
+static void file_io_close_fd(FILE_IO_FD fd)
+{
+#if defined(_WIN32)
+	CloseHandle(fd);
+#else
+	close(fd);
+#endif
+}
+
+int file_io_open(FILE_IO *io, const FILE_IO_CHAR *path, int direct)
+{
+	int file, result;
+
+	for (file = 0; file < FILE_IO_MAX_FILES && io->fds[file] != FILE_IO_NO_FD; file++)
+		;
+	if (file == FILE_IO_MAX_FILES)
+		return -FILE_IO_ERROR(EMFILE, ERROR_TOO_MANY_OPEN_FILES);
+
+#if defined(_WIN32)
+	io->fds[file] = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+								FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN | (direct ? FILE_FLAG_NO_BUFFERING : 0), NULL);
+	if (io->fds[file] == INVALID_HANDLE_VALUE)
+		return -(int)GetLastError();
+#else
+	io->fds[file] = open(path, O_RDONLY | O_CLOEXEC | (direct ? O_DIRECT : 0));
+	if (io->fds[file] < 0)
+		return -errno;
+#endif
+	io->direct[file] = direct;
+#if defined(POSIX_FADV_SEQUENTIAL)
+	/* like FILE_FLAG_SEQUENTIAL_SCAN, a larger read-ahead for the page cache */
+	if (!direct)
+		posix_fadvise(io->fds[file], 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	result = io->backend->open(io, file);
+	if (result < 0) {
+		file_io_close_fd(io->fds[file]);
+		io->fds[file] = FILE_IO_NO_FD;
+		return result;
+	}
+	return file;
+}
+
+void file_io_close(FILE_IO *io, int file)
+{
+	if (file < 0 || file >= FILE_IO_MAX_FILES || io->fds[file] == FILE_IO_NO_FD)
+		return;
+	io->backend->close(io, file);
+	file_io_close_fd(io->fds[file]);
+	io->fds[file] = FILE_IO_NO_FD;
+}
+
+int file_io_read(FILE_IO *io, int file, unsigned int buffer, unsigned long long offset, size_t length)
+{
+	FILE_IO_REQUEST *request;
+	int result;
+
+	if (file < 0 || file >= FILE_IO_MAX_FILES || io->fds[file] == FILE_IO_NO_FD || buffer >= io->buffer_count || length > io->buffer_size)
+		return -FILE_IO_ERROR(EINVAL, ERROR_INVALID_PARAMETER);
+	request = &io->reads[buffer];
+	request->file = file;
+	request->buffer = buffer;
+	request->offset = offset;
+	request->length = length;
+	result = io->backend->read(io, request);
+	if (result == 0)
+		io->pending++;
+	return result;
+}
+
+int file_io_submit(FILE_IO *io)
+{
+	return io->backend->submit(io);
+}
+
+void file_io_cancel(FILE_IO *io, int file)
+{
+	if (file < 0 || file >= FILE_IO_MAX_FILES || io->fds[file] == FILE_IO_NO_FD || io->pending == 0)
+		return;
+	io->backend->cancel(io, file);
+}
+
+/* a read may end early without reaching the end of the file, the rest is read here.
+   With O_DIRECT only the end of the file gives a read that is not a multiple of the block size.
+   ReadFile on a file only returns less at the end of the file */
+static void file_io_complete(FILE_IO *io, FILE_IO_COMPLETION *completion)
+{
+#if defined(_WIN32)
+	(void)io;
+	(void)completion;
+#else
+	const FILE_IO_REQUEST *request = &io->reads[completion->buffer];
+
+	while (completion->result > 0 && (size_t)completion->result < request->length) {
+		ssize_t result;
+
+		if (io->direct[request->file] && completion->result % FILE_IO_ALIGNMENT != 0)
+			break;
+		result = pread(io->fds[request->file], io->buffers[request->buffer] + completion->result,
+					   request->length - completion->result, (off_t)(request->offset + completion->result));
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result < 0)
+			completion->result = -errno;
+		if (result <= 0)
+			break;
+		completion->result += (long)result;
+	}
+#endif
+}
+
+int file_io_reap(FILE_IO *io, FILE_IO_COMPLETION *completions, unsigned int max, int wait)
+{
+	int n, i;
+
+	if (io->pending == 0 || max == 0)
+		return 0;
+	n = io->backend->reap(io, completions, max, wait);
+	for (i = 0; i < n; i++)
+		file_io_complete(io, &completions[i]);
+	if (n > 0)
+		io->pending -= (unsigned int)n;
+	return n;
+}
@@ -0,0 +1,85 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <stddef.h>
+
+/* Asynchronous reads of whole files, for the file streams of the application and the
+   POSIX build of the hashing core
+
+   A FILE_IO owns a fixed set of equally sized buffers and up to FILE_IO_MAX_FILES open
+   files. Reads into a buffer at a file offset are queued with file_io_read, handed to the
+   OS with file_io_submit and come back in any order through file_io_reap; the caller keeps
+   track of the order the data has to be hashed in. A buffer may only be passed to another
+   read after its completion was reaped.
+
+   Backends:
+   overlapped	Windows, ReadFile with an OVERLAPPED and event per buffer. The reads start in
+				file_io_read and are reaped in the order they were issued
+   io_uring		Linux 5.6 and later. The buffers and the file table are registered with the
+				ring, so the kernel does not map them again for every read. If registering
+				fails (RLIMIT_MEMLOCK, older kernels) plain reads on the ring are used
+   pread		any POSIX system, the queued reads run synchronously in file_io_reap
+
+   The backend is picked at runtime: by name in file_io_create, otherwise from the
+   environment, read by every file_io_create:
+   RAPIDCRC_IO		"overlapped", "io_uring" or "pread"
+   Without a name the first backend that can be set up is used.
+
+   Errors are -errno, on Windows -GetLastError() (file_io_create still sets errno). */
+
+#define FILE_IO_MAX_FILES	16
+/* buffers are aligned for O_DIRECT */
+#define FILE_IO_ALIGNMENT	4096
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _FILE_IO FILE_IO;
+
+/* paths are UTF-16 on Windows, the application is built with UNICODE */
+#if defined(_WIN32)
+typedef wchar_t FILE_IO_CHAR;
+#else
+typedef char FILE_IO_CHAR;
+#endif
+
+/* one finished read */
+typedef struct _FILE_IO_COMPLETION {
+	unsigned int	buffer;		/* as passed to file_io_read */
+	long			result;		/* bytes read, short at the end of the file, or -errno */
+} FILE_IO_COMPLETION;
+
+/* NULL if backend is unknown or can not be set up, or if the buffers can not be allocated
+   (errno tells why). buffer_size has to be a multiple of FILE_IO_ALIGNMENT for O_DIRECT */
+FILE_IO *file_io_create(const char *backend, unsigned int buffer_count, size_t buffer_size);
+void file_io_destroy(FILE_IO *io);
+
+/* name of the backend that io uses */
+const char *file_io_backend(const FILE_IO *io);
+unsigned char *file_io_buffer(const FILE_IO *io, unsigned int buffer);
+
+/* file number for file_io_read or -errno, direct opens the file with O_DIRECT
+   (FILE_FLAG_NO_BUFFERING) */
+int file_io_open(FILE_IO *io, const FILE_IO_CHAR *path, int direct);
+/* no read of the file may be pending */
+void file_io_close(FILE_IO *io, int file);
+
+/* queues a read of length bytes (at most the buffer size), 0 or -errno */
+int file_io_read(FILE_IO *io, int file, unsigned int buffer, unsigned long long offset, size_t length);
+/* starts the queued reads, 0 or -errno. The ones the OS does not take yet are started by
+   the next file_io_reap that waits */
+int file_io_submit(FILE_IO *io);
+/* ends the pending reads of the file early where the backend can, they still have to be
+   reaped and their data is not to be used. overlapped has to be called from the thread
+   that issued the reads */
+void file_io_cancel(FILE_IO *io, int file);
+/* up to max finished reads, waits for at least one if wait is set and a read is pending;
+   number of completions or -errno */
+int file_io_reap(FILE_IO *io, FILE_IO_COMPLETION *completions, unsigned int max, int wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
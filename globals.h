@@ -23,9 +23,11 @@
 #include <windows.h>
 #include <atlstr.h>
 #include <strsafe.h>
+#include "file_io.h"
 #pragma warning(disable:4995)
 #include <list>
 #include <map>
+#include <queue>
 #pragma warning(default:4995)
 using namespace std;
 
@@ -65,6 +67,10 @@ PCHAR* CommandLineToArgvA(PCHAR CmdLine, int* _argc);
 
 // some sizes for variables
 #define DEFAULT_BUFFER_SIZE_CALC	(8 * 1024)
+#define DEFAULT_BUFFER_COUNT_CALC	4
+#define MAX_BUFFER_COUNT_CALC		32
+#define DEFAULT_CONCURRENT_FILES	1
+#define MAX_CONCURRENT_FILES		16
 #define MAX_BUFFER_SIZE_OFN 0xFFFFF // Win9x has a problem with values where just the first bit is set like 0x20000 for OFN buffer:
 #define MAX_PATH_EX 32767
 #define MAX_LINE_LENGTH MAX_PATH_EX + 100
@@ -87,7 +93,11 @@ PCHAR* CommandLineToArgvA(PCHAR CmdLine, int* _argc);
 #define HASH_TYPE_CRC32C 9
 #define HASH_TYPE_BLAKE2SP 10
 #define HASH_TYPE_BLAKE3 11
-#define NUM_HASH_TYPES 12
+#define HASH_TYPE_BLAKE2BP 12
+#define HASH_TYPE_XXH128 13
+#define HASH_TYPE_K12 14
+#define HASH_TYPE_CRC64 15
+#define NUM_HASH_TYPES 16
 
 // RapidCRC modes; also used in the action functions
 // Have to equal hash types
@@ -103,6 +113,10 @@ PCHAR* CommandLineToArgvA(PCHAR CmdLine, int* _argc);
 #define MODE_CRC32C             9
 #define MODE_BLAKE2SP           10
 #define MODE_BLAKE3             11
+#define MODE_BLAKE2BP           12
+#define MODE_XXH128             13
+#define MODE_K12                14
+#define MODE_CRC64              15
 #define MODE_BSD                21
 
 //CMDLINE Options for the shell extension
@@ -118,6 +132,10 @@ PCHAR* CommandLineToArgvA(PCHAR CmdLine, int* _argc);
 #define CMD_CRC32C          9
 #define CMD_BLAKE2SP        10
 #define CMD_BLAKE3          11
+#define CMD_BLAKE2BP        12
+#define CMD_XXH128          13
+#define CMD_K12             14
+#define CMD_CRC64           15
 #define CMD_NAME			100
 #define CMD_NTFS			200
 #define CMD_REPARENT		23
@@ -194,8 +212,12 @@ PCHAR* CommandLineToArgvA(PCHAR CmdLine, int* _argc);
 #define ID_STATIC_CRCC_VALUE        13
 #define ID_STATIC_BLAKE2SP_VALUE    14
 #define ID_STATIC_BLAKE3_VALUE      15
-#define ID_STATIC_INFO				16
-#define ID_MAX_STATIC               16
+#define ID_STATIC_BLAKE2BP_VALUE    16
+#define ID_STATIC_XXH128_VALUE      17
+#define ID_STATIC_K12_VALUE         18
+#define ID_STATIC_CRC64_VALUE       19
+#define ID_STATIC_INFO				20
+#define ID_MAX_STATIC               20
 
 #define ID_STATIC_STATUS			21
 #define ID_STATIC_CREATE            22
@@ -230,19 +252,23 @@ PCHAR* CommandLineToArgvA(PCHAR CmdLine, int* _argc);
 #define ID_EDIT_CRCC_VALUE          48
 #define ID_EDIT_BLAKE2SP_VALUE      49
 #define ID_EDIT_BLAKE3_VALUE        50
+#define ID_EDIT_BLAKE2BP_VALUE      51
+#define ID_EDIT_XXH128_VALUE        52
+#define ID_EDIT_K12_VALUE           53
+#define ID_EDIT_CRC64_VALUE         54
 
-#define ID_EDIT_INFO				51
-#define ID_EDIT_STATUS				52
-#define ID_BTN_ERROR_DESCR			53
+#define ID_EDIT_INFO				55
+#define ID_EDIT_STATUS				56
+#define ID_BTN_ERROR_DESCR			57
 
-#define ID_BTN_PLAY_PAUSE			54
-#define ID_BTN_STOP     			55
+#define ID_BTN_PLAY_PAUSE			58
+#define ID_BTN_STOP     			59
 
-#define ID_COMBO_PRIORITY			56
-#define ID_BTN_OPENFILES_PAUSE		57
-#define ID_LAST_TAB_CONTROL			57
+#define ID_COMBO_PRIORITY			60
+#define ID_BTN_OPENFILES_PAUSE		61
+#define ID_LAST_TAB_CONTROL			61
 
-#define ID_NUM_WINDOWS				58
+#define ID_NUM_WINDOWS				62
 
 #define IDM_COPY_CRC				1
 // needs space for all hash types
@@ -279,6 +305,10 @@ PCHAR* CommandLineToArgvA(PCHAR CmdLine, int* _argc);
 #define IDM_CRCC_COLUMN             10
 #define IDM_BLAKE2SP_COLUMN         11
 #define IDM_BLAKE3_COLUMN           12
+#define IDM_BLAKE2BP_COLUMN         13
+#define IDM_XXH128_COLUMN           14
+#define IDM_K12_COLUMN              15
+#define IDM_CRC64_COLUMN            16
 
 //****** file open dialog *******
 #define FDIALOG_OPENCHOICES 0
@@ -334,6 +364,10 @@ typedef struct _FILEINFO {
             BYTE	abSha3_512Result[64];
             BYTE	abBlake2sp_Result[32];
 			BYTE	abBlake3_Result[32];
+			BYTE	abBlake2bp_Result[64];
+			BYTE	abXxh128_Result[16];
+			BYTE	abK12_Result[32];
+			BYTE	abCrc64Result[8];		// big endian, as displayed
             DWORD   dwCrc32cResult;
         } r;
         union {
@@ -347,6 +381,10 @@ typedef struct _FILEINFO {
             BYTE	abSha3_512Found[64];
 			BYTE	abBlake2sp_Found[32];
 			BYTE	abBlake3_Found[32];
+			BYTE	abBlake2bp_Found[64];
+			BYTE	abXxh128_Found[16];
+			BYTE	abK12_Found[32];
+			BYTE	abCrc64Found[8];
             DWORD   dwCrc32cFound;
         } f;
         CString szResult;
@@ -364,8 +402,9 @@ typedef struct _lFILEINFO {
 	UINT uiCmdOpts;
 	UINT uiRapidCrcMode;
 	int iGroupId;
+	UINT uiConcurrentFiles;						// files hashed at once per disk, 0 for g_program_options.uiConcurrentFiles
 	TCHAR g_szBasePath[MAX_PATH_EX];
-	_lFILEINFO() {qwFilesizeSum=0;uiCmdOpts=CMD_NORMAL;
+	_lFILEINFO() {qwFilesizeSum=0;uiCmdOpts=CMD_NORMAL;uiConcurrentFiles=0;
 				  uiRapidCrcMode=MODE_NORMAL;iGroupId=0;g_szBasePath[0]=TEXT('\0');
                   for(int i=0;i<NUM_HASH_TYPES;i++){
                       bCalculated[i] = false;
@@ -396,19 +435,99 @@ typedef struct{
 	QWORD				qwBytesReadAllFiles;			// out
 	BOOL				signalExit;
     BOOL				signalStop;
+	HANDLE				hEvtRun;						// in, reset while paused, the readers of the file streams wait for it
 	SHOWRESULT_PARAMS	* pshowresult_params;			// in / out
 	HWND				* arrHwnd;						// in
 	FILEINFO			* pFileinfo_cur;				// out
 }THREAD_PARAMS_CALC;
 
+// one buffer of the read ring of ThreadProc_Calc
 typedef struct{
-	BYTE **buffer;
-	DWORD **dwBytesRead;
-	VOID *result;
-	HANDLE hHandleReady;
-	HANDLE hHandleGo;
-	BOOL *bFileDone;
-}THREAD_PARAMS_HASHCALC;
+	BYTE			* data;
+	DWORD			dwBytesRead;					// valid bytes in data
+	BOOL			bLast;							// last buffer of the file
+	volatile LONG	lPending;						// workers that did not release the buffer yet
+	DWORD			dwError;						// reader only, error of the read into this buffer
+	BOOL			bRead;							// reader only, the read into this buffer was reaped
+}READ_BUFFER;
+
+typedef struct{
+	READ_BUFFER		* buffers;
+	UINT			uiCount;
+	FILE_IO			* io;							// reads into the buffers, data of buffer b is file_io_buffer(io, b)
+	HANDLE			hSemFree;						// counts the buffers that no worker holds
+	volatile LONG	lWorkersBusy;					// workers that did not finish the hashes of the current file
+	HANDLE			hEvtHashed;						// set by the worker that finished last
+}READ_RING;
+
+// the hashes one worker calculates for one file
+typedef struct{
+	UINT			uiHashCount;					// in, number of hashes of this worker
+	UINT			uiHashType[NUM_HASH_TYPES];		// in, hashes calculated by this worker
+	VOID			* result[NUM_HASH_TYPES];		// out, indexed like uiHashType
+	VOID			* context[NUM_HASH_TYPES];		// hash state between the tasks, NULL before the first one, reset after every file
+}HASH_GROUP;
+
+// hash one buffer, ring is NULL to end the worker
+typedef struct{
+	HASH_GROUP		* group;
+	READ_RING		* ring;
+	READ_BUFFER		* buffer;						// finalizes the hashes if bLast is set
+}HASH_TASK;
+
+typedef struct{
+	queue<HASH_TASK>	tasks;						// processed in order, so the hash state of a group is never shared
+	CRITICAL_SECTION	csTasks;
+	HANDLE				hSemTasks;					// counts the entries of tasks
+	HANDLE				hThread;
+}THREAD_PARAMS_HASHWORKER;
+
+// reads one file after the other into its own ring, the hashes are calculated by the workers of the stream,
+// so the groups of different streams run on different cores
+typedef struct{
+	THREAD_PARAMS_CALC			* pthread_params_calc;		// in, for signalStop
+	THREAD_PARAMS_HASHWORKER	hashWorkers[NUM_HASH_TYPES];	// worker w calculates groups[w]
+	UINT						uiHashThreads;				// number of running workers
+	UINT						uiWorkers;					// in
+	HASH_GROUP					groups[NUM_HASH_TYPES];		// in/out, hashes of the job, contexts and results of the file
+	READ_RING					ring;
+	UINT						uiBufferSize;				// in
+	BOOL						bUnbufferedReads;			// in
+	UINT						uiStream;					// in, index of the stream
+	FILEINFO					* CONST * ppFiles;			// in, the files of the job in list order
+	CONST UINT					* puiFileStream;			// in, stream of every file, see ScheduleFileStreams
+	volatile LONG				* plFileState;				// out, FILE_STREAM_DONE or FILE_STREAM_STOPPED once a file is finished
+	UINT						uiFirstFile;				// in, the files of the stream from here...
+	UINT						uiEndFile;					// in, ...up to here are hashed one after the other
+	FILEINFO					* pFileinfo;				// out, the file that is hashed
+	volatile UINT				uiFile;						// out, index of pFileinfo
+	volatile QWORD				qwBytesReadFile;			// out, of pFileinfo, for progress bar
+	volatile QWORD				qwBytesRead;				// out, of all files since hEvtStart, for progress bar
+	HANDLE						hEvtStart;					// set to start the files, and to exit
+	HANDLE						hEvtFile;					// set every time a file is finished
+	HANDLE						hEvtDone;					// set when all files are finished
+	HANDLE						hThread;
+	BOOL						bExit;
+	BOOL						bBusy;						// ThreadProc_Calc only, hEvtDone was not waited for yet
+}THREAD_PARAMS_FILESTREAM;
+
+// hashes a byte range of a file, the segment threads are kept by ThreadProc_Calc for all its files
+typedef struct{
+	CONST TCHAR			* szFilename;					// in
+	QWORD				qwOffset;						// in
+	QWORD				qwLength;						// in
+	BOOL				bDoCalculate[NUM_HASH_TYPES];	// in
+	THREAD_PARAMS_CALC	* pthread_params_calc;			// in, for signalStop
+	volatile QWORD		qwBytesDone;					// out, for progress bar
+	VOID				* context[NUM_HASH_TYPES];		// in/out, hash state of this segment, see hash_algorithms
+	DWORD				dwError;						// out
+	UINT				uiBufferSize;					// in
+	BOOL				bUnbufferedReads;				// in
+	HANDLE				hEvtStart;						// set to start the segment, and to exit
+	HANDLE				hEvtDone;						// set when the segment is finished
+	HANDLE				hThread;
+	BOOL				bExit;
+}THREAD_PARAMS_SEGMENTCALC;
 
 struct PROGRAM_OPTIONS;
 
@@ -473,6 +592,29 @@ struct PROGRAM_OPTIONS_FILE {
 	BOOL            bSaveAbsolutePathsBlake3;
 	BOOL			bUseUnbufferedReads;
 	BOOL			bCloseAfterActionFromShellExt;
+	BOOL			bHashLargeFilesInSegments;
+	BOOL			bDisplayBlake2bpInListView;
+	BOOL            bCalcBlake2bpPerDefault;
+	UINT			uiCreateFileModeBlake2bp;
+	TCHAR			szFilenameBlake2bp[MAX_PATH];
+	BOOL            bSaveAbsolutePathsBlake2bp;
+	BOOL			bDisplayXxh128InListView;
+	BOOL            bCalcXxh128PerDefault;
+	UINT			uiCreateFileModeXxh128;
+	TCHAR			szFilenameXxh128[MAX_PATH];
+	BOOL            bSaveAbsolutePathsXxh128;
+	BOOL			bDisplayK12InListView;
+	BOOL            bCalcK12PerDefault;
+	UINT			uiCreateFileModeK12;
+	TCHAR			szFilenameK12[MAX_PATH];
+	BOOL            bSaveAbsolutePathsK12;
+	BOOL			bDisplayCrc64InListView;
+	BOOL            bCalcCrc64PerDefault;
+	UINT			uiCreateFileModeCrc64;
+	TCHAR			szFilenameCrc64[MAX_PATH];
+	BOOL            bSaveAbsolutePathsCrc64;
+	UINT			uiReadBufferCount;
+	UINT			uiConcurrentFiles;
     void            SetDefaults();
     PROGRAM_OPTIONS_FILE& operator=(const PROGRAM_OPTIONS& other);
 };
@@ -512,6 +654,9 @@ struct PROGRAM_OPTIONS {
 	BOOL			bAlwaysUseNewWindow;
 	BOOL			bUseUnbufferedReads;
 	BOOL			bCloseAfterActionFromShellExt;
+	BOOL			bHashLargeFilesInSegments;
+	UINT			uiReadBufferCount;
+	UINT			uiConcurrentFiles;
     PROGRAM_OPTIONS& operator=(const PROGRAM_OPTIONS_FILE& other);
 };
 
@@ -579,6 +724,7 @@ BOOL SetSubItemColumns(CONST HWND hWndListView);
 BOOL ShowResult(CONST HWND arrHwnd[ID_NUM_WINDOWS], FILEINFO * pFileinfo, SHOWRESULT_PARAMS * pshowresult_params);
 VOID DisplayStatusOverview(CONST HWND hEditStatus);
 DWORD ShowErrorMsg ( CONST HWND hWndMain, CONST DWORD dwError );
+VOID ShowCpuKernels(CONST HWND hWndOwner);
 VOID UpdateOptionsDialogControls(CONST HWND hDlg, CONST BOOL bUpdateAll, CONST PROGRAM_OPTIONS * pProgram_options);
 VOID EnableWindowsForThread(CONST HWND arrHwnd[ID_NUM_WINDOWS], CONST BOOL bStatus);
 void CreateListViewPopupMenu(HMENU *menu);
@@ -616,6 +762,7 @@ VOID SetDefaultOptions(PROGRAM_OPTIONS * pProgram_options);
 BOOL IsApplDefError(CONST DWORD dwError);
 VOID CopyJustProgramOptions(CONST PROGRAM_OPTIONS * pProgram_options_src, PROGRAM_OPTIONS * pProgram_options_dst);
 BOOL IsStringPrefix(CONST TCHAR szSearchPattern[MAX_PATH_EX], CONST TCHAR szSearchString[MAX_PATH_EX]);
+BOOL IsConcurrentFilesSwitch(CONST TCHAR *szArg, UINT *puiConcurrentFiles);
 DWORD MyPriorityToPriorityClass(CONST UINT uiMyPriority);
 VOID SetFileInfoStrings(FILEINFO *pFileinfo,lFILEINFO *fileList);
 VOID SetInfoColumnText(FILEINFO *pFileinfo, lFILEINFO *fileList);
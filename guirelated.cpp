@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <commctrl.h>
 #include <windowsx.h>
 #include "CSyncQueue.h"
+#include "cpu_features.h"
 
 /*****************************************************************************
 ATOM RegisterMainWindowClass()
@@ -189,6 +190,14 @@ VOID CreateAndInitChildWindows(HWND arrHwnd[ID_NUM_WINDOWS], WNDPROC arrOldWndPr
 	arrHwnd[ID_EDIT_BLAKE2SP_VALUE]		= CreateWindow(TEXT("EDIT"), NULL, ES_AUTOHSCROLL | ES_READONLY | WS_VISIBLE | WS_CHILD | WS_TABSTOP, 0, 0, 0, 0, hMainWnd, (HMENU)ID_EDIT_BLAKE2SP_VALUE, g_hInstance, NULL);
 	arrHwnd[ID_STATIC_BLAKE3_VALUE]	    = CreateWindow(TEXT("STATIC"), TEXT("BLAKE3:"), SS_LEFTNOWORDWRAP | WS_VISIBLE | WS_CHILD, 0, 0, 0, 0, hMainWnd, (HMENU)ID_STATIC_BLAKE3_VALUE, g_hInstance, NULL);
 	arrHwnd[ID_EDIT_BLAKE3_VALUE]		= CreateWindow(TEXT("EDIT"), NULL, ES_AUTOHSCROLL | ES_READONLY | WS_VISIBLE | WS_CHILD | WS_TABSTOP, 0, 0, 0, 0, hMainWnd, (HMENU)ID_EDIT_BLAKE3_VALUE, g_hInstance, NULL);
+	arrHwnd[ID_STATIC_BLAKE2BP_VALUE]	= CreateWindow(TEXT("STATIC"), TEXT("BLAKE2BP:"), SS_LEFTNOWORDWRAP | WS_VISIBLE | WS_CHILD, 0, 0, 0, 0, hMainWnd, (HMENU)ID_STATIC_BLAKE2BP_VALUE, g_hInstance, NULL);
+	arrHwnd[ID_EDIT_BLAKE2BP_VALUE]		= CreateWindow(TEXT("EDIT"), NULL, ES_AUTOHSCROLL | ES_READONLY | WS_VISIBLE | WS_CHILD | WS_TABSTOP, 0, 0, 0, 0, hMainWnd, (HMENU)ID_EDIT_BLAKE2BP_VALUE, g_hInstance, NULL);
+	arrHwnd[ID_STATIC_XXH128_VALUE]	    = CreateWindow(TEXT("STATIC"), TEXT("XXH128:"), SS_LEFTNOWORDWRAP | WS_VISIBLE | WS_CHILD, 0, 0, 0, 0, hMainWnd, (HMENU)ID_STATIC_XXH128_VALUE, g_hInstance, NULL);
+	arrHwnd[ID_EDIT_XXH128_VALUE]		= CreateWindow(TEXT("EDIT"), NULL, ES_AUTOHSCROLL | ES_READONLY | WS_VISIBLE | WS_CHILD | WS_TABSTOP, 0, 0, 0, 0, hMainWnd, (HMENU)ID_EDIT_XXH128_VALUE, g_hInstance, NULL);
+	arrHwnd[ID_STATIC_K12_VALUE]	    = CreateWindow(TEXT("STATIC"), TEXT("K12:"), SS_LEFTNOWORDWRAP | WS_VISIBLE | WS_CHILD, 0, 0, 0, 0, hMainWnd, (HMENU)ID_STATIC_K12_VALUE, g_hInstance, NULL);
+	arrHwnd[ID_EDIT_K12_VALUE]			= CreateWindow(TEXT("EDIT"), NULL, ES_AUTOHSCROLL | ES_READONLY | WS_VISIBLE | WS_CHILD | WS_TABSTOP, 0, 0, 0, 0, hMainWnd, (HMENU)ID_EDIT_K12_VALUE, g_hInstance, NULL);
+	arrHwnd[ID_STATIC_CRC64_VALUE]	    = CreateWindow(TEXT("STATIC"), TEXT("CRC64:"), SS_LEFTNOWORDWRAP | WS_VISIBLE | WS_CHILD, 0, 0, 0, 0, hMainWnd, (HMENU)ID_STATIC_CRC64_VALUE, g_hInstance, NULL);
+	arrHwnd[ID_EDIT_CRC64_VALUE]		= CreateWindow(TEXT("EDIT"), NULL, ES_AUTOHSCROLL | ES_READONLY | WS_VISIBLE | WS_CHILD | WS_TABSTOP, 0, 0, 0, 0, hMainWnd, (HMENU)ID_EDIT_CRC64_VALUE, g_hInstance, NULL);
 	arrHwnd[ID_STATIC_INFO]				= CreateWindow(TEXT("STATIC"), TEXT("Info:"), SS_LEFTNOWORDWRAP | WS_VISIBLE | WS_CHILD, 0, 0, 0, 0, hMainWnd, (HMENU)ID_STATIC_INFO, g_hInstance, NULL);
 	arrHwnd[ID_EDIT_INFO]				= CreateWindow(TEXT("EDIT"), NULL, ES_AUTOHSCROLL | ES_READONLY | WS_VISIBLE | WS_CHILD | WS_TABSTOP, 0, 0, 0, 0, hMainWnd, (HMENU)ID_EDIT_INFO, g_hInstance, NULL);
 	arrHwnd[ID_BTN_ERROR_DESCR]			= CreateWindow(TEXT("BUTTON"), TEXT("Descr."), BS_PUSHBUTTON | WS_CHILD, 0, 0, 0, 0, hMainWnd, (HMENU)ID_BTN_ERROR_DESCR, g_hInstance, NULL);
@@ -272,6 +281,10 @@ void CreateHashFilenameButtonPopupMenu(HMENU *menu) {
         StringCchPrintf(menuText,100,TEXT("Put %s into Filename"),g_hash_names[i]);
         InsertMenu(*menu,i, MF_BYPOSITION | MF_STRING, IDM_CRC_FILENAME + i,menuText);
     }
+    StringCchPrintf(menuText,100,TEXT("Put %s into Filename"),g_hash_names[HASH_TYPE_XXH128]);
+    AppendMenu(*menu, MF_STRING, IDM_CRC_FILENAME + HASH_TYPE_XXH128, menuText);
+    StringCchPrintf(menuText,100,TEXT("Put %s into Filename"),g_hash_names[HASH_TYPE_CRC64]);
+    AppendMenu(*menu, MF_STRING, IDM_CRC_FILENAME + HASH_TYPE_CRC64, menuText);
 }
 
 /*****************************************************************************
@@ -297,7 +310,7 @@ void CreateBlakeButtonPopupMenu(HMENU *menu)
 void CreateBlakeButtonPopupMenu(HMENU *menu) {
 	*menu = CreatePopupMenu();
 
-	for (int i = 0; i < 2; i++) {
+	for (int i = 0; i < 3; i++) {
 		InsertMenu(*menu, i, MF_BYPOSITION | MF_STRING, IDM_BLAKE + i, g_hash_names[HASH_TYPE_BLAKE2SP + i]);
 	}
 }
@@ -312,6 +325,8 @@ void CreateShaButtonPopupMenu(HMENU *menu) {
     for(int i = 0; i < 6; i++) {
         InsertMenu(*menu,i, MF_BYPOSITION | MF_STRING, IDM_SHA1 + i, g_hash_names[HASH_TYPE_SHA1 + i]);
     }
+    // K12 is keccak based as well, the offset to IDM_SHA1 matches its hash type
+    InsertMenu(*menu,6, MF_BYPOSITION | MF_STRING, IDM_SHA1 + HASH_TYPE_K12 - HASH_TYPE_SHA1, g_hash_names[HASH_TYPE_K12]);
 }
 
 /*****************************************************************************
@@ -323,6 +338,8 @@ void CreateCrcButtonPopupMenu(HMENU *menu) {
 
     InsertMenu(*menu,0, MF_BYPOSITION | MF_STRING, IDM_CRC_SFV + HASH_TYPE_CRC32, g_hash_names[HASH_TYPE_CRC32]);
     InsertMenu(*menu,1, MF_BYPOSITION | MF_STRING, IDM_CRC_SFV + HASH_TYPE_CRC32C, g_hash_names[HASH_TYPE_CRC32C]);
+    InsertMenu(*menu,2, MF_BYPOSITION | MF_STRING, IDM_CRC_SFV + HASH_TYPE_XXH128, g_hash_names[HASH_TYPE_XXH128]);
+    InsertMenu(*menu,3, MF_BYPOSITION | MF_STRING, IDM_CRC_SFV + HASH_TYPE_CRC64, g_hash_names[HASH_TYPE_CRC64]);
 }
 
 /*****************************************************************************
@@ -1191,6 +1208,35 @@ DWORD ShowErrorMsg ( CONST HWND hWndMain, CONST DWORD dwError )
 	return NOERROR;
 }
 
+/*****************************************************************************
+VOID ShowCpuKernels(CONST HWND hWndOwner)
+	hWndOwner	: (IN) owner of the message box
+
+Return Value:
+	none
+
+Notes:
+- lists the implementation every algorithm picked for this CPU (see cpu_features.h),
+  an algorithm only shows up once it was used
+- is used when the user clicks on the Kernels button of the options
+*****************************************************************************/
+VOID ShowCpuKernels(CONST HWND hWndOwner)
+{
+	TCHAR szMessage[2000];
+	TCHAR szLine[100];
+	CONST UINT uiCount = cpu_kernel_count();
+
+	StringCchCopy(szMessage, 2000, TEXT("Implementations selected for this CPU:\r\n\r\n"));
+	if(uiCount == 0)
+		StringCchCat(szMessage, 2000, TEXT("none yet, they are selected when a hash is first calculated\r\n"));
+	for(UINT i=0;i<uiCount;i++) {
+		StringCchPrintf(szLine, 100, TEXT("%hs\t%hs\r\n"), cpu_kernel_algorithm(i), cpu_kernel_name(i));
+		StringCchCat(szMessage, 2000, szLine);
+	}
+	StringCchCat(szMessage, 2000, TEXT("\r\nRAPIDCRC_KERNELS=\"algorithm=kernel,...\" overrides the selection"));
+	MessageBox(hWndOwner, szMessage, TEXT("Hash Kernels"), MB_ICONINFORMATION | MB_OK);
+}
+
 /*****************************************************************************
 VOID UpdateOptionsDialogControls(CONST HWND hDlg, CONST BOOL bUpdateAll, CONST PROGRAM_OPTIONS * pprogram_options)
 hDlg				: (IN) Handle to the main dialog
@@ -1228,6 +1274,7 @@ VOID UpdateOptionsDialogControls(CONST HWND hDlg, CONST BOOL bUpdateAll, CONST P
 	CheckDlgButton(hDlg, IDC_USE_DEFAULT_CP, pprogram_options->bUseDefaultCP ? BST_CHECKED : BST_UNCHECKED);
 	CheckDlgButton(hDlg, IDC_ENABLE_UNBUFFERED_READS, pprogram_options->bUseUnbufferedReads ? BST_CHECKED : BST_UNCHECKED);
 	CheckDlgButton(hDlg, IDC_CLOSE_AFTER_SHELLEXT_ACTION, pprogram_options->bCloseAfterActionFromShellExt ? BST_CHECKED : BST_UNCHECKED);
+	CheckDlgButton(hDlg, IDC_HASH_LARGE_FILES_IN_SEGMENTS, pprogram_options->bHashLargeFilesInSegments ? BST_CHECKED : BST_UNCHECKED);
     CheckDlgButton(hDlg, IDC_CHECK_HASHTYPE_FROM_FILENAME, pprogram_options->bHashtypeFromFilename ? BST_CHECKED : BST_UNCHECKED);
 	CheckDlgButton(hDlg, IDC_ALLOW_CRC_ANYWHERE, pprogram_options->bAllowCrcAnywhere ? BST_CHECKED : BST_UNCHECKED);
     CheckDlgButton(hDlg, IDC_CHECK_INCLUDE_COMMENTS, pprogram_options->bIncludeFileComments ? BST_CHECKED : BST_UNCHECKED);
@@ -1257,6 +1304,10 @@ VOID UpdateOptionsDialogControls(CONST HWND hDlg, CONST BOOL bUpdateAll, CONST P
 		SetWindowText(GetDlgItem(hDlg, IDC_CRC_DELIM_LIST), pprogram_options->szCRCStringDelims);
         StringCchPrintf(szTemp, MAX_PATH_EX, TEXT("%d"), pprogram_options->uiReadBufferSizeKb);
         SetWindowText(GetDlgItem(hDlg, IDC_EDIT_READ_BUFFER_SIZE), szTemp);
+        StringCchPrintf(szTemp, MAX_PATH_EX, TEXT("%d"), pprogram_options->uiReadBufferCount);
+        SetWindowText(GetDlgItem(hDlg, IDC_EDIT_READ_BUFFER_COUNT), szTemp);
+        StringCchPrintf(szTemp, MAX_PATH_EX, TEXT("%d"), pprogram_options->uiConcurrentFiles);
+        SetWindowText(GetDlgItem(hDlg, IDC_EDIT_CONCURRENT_FILES), szTemp);
 	}
 
 	return;
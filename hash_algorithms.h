@@ -0,0 +1,222 @@
+#ifndef HASH_ALGORITHMS_H
+#define HASH_ALGORITHMS_H
+
+/* HashAlgorithm<HASH_TYPE_xxx> describes one hash type for the generic code in threadprocs.cpp:
+
+   typedef ...	Context;			state of one running calculation
+   dwDigestSize						bytes written to the result by Final
+   Init(Context *)
+   Update(Context *, CONST BYTE *, DWORD)
+   Final(Context *, VOID *result)	result is the matching member of the FILEINFO's hashInfo[].r
+   Combine(Context *, CONST Context *, QWORD)
+									appends the state of the following byte range of the given
+									length, only meaningful if bMergeable
+
+   capabilities:
+   bMergeable	a file can be split into byte ranges that are hashed independently (CalcFileInSegments)
+   bMultiBuffer	several small files can be hashed at once in SIMD lanes (CalcSmallFilesBatch)
+   bFusable		cheap enough to share a thread with other hashes (RunHashTask)
+
+   A new hash type only needs a specialization here and an entry in the hash_algorithms table */
+
+#include "globals.h"
+#include "ed2k_hash.h"
+#include "sha1_ossl.h"
+#include "md5_ossl.h"
+#include "sha256_ossl.h"
+#include "sha512_ossl.h"
+extern "C" {
+#include "sha3\KeccakHash.h"
+#include "sha3\KangarooTwelve.h"
+}
+#include "crc32c.h"
+#include "crc32.h"
+#include "crc64.h"
+#include "blake2\blake2.h"
+#include "blake3\blake3.h"
+#include "xxh3.h"
+
+// defaults for the capabilities, a specialization derives from this and overrides what it supports
+struct HashAlgorithmDefaults {
+	static CONST BOOL bMergeable = FALSE;
+	static CONST BOOL bMultiBuffer = FALSE;
+	static CONST BOOL bFusable = FALSE;
+
+	template<class Context>
+	static VOID Combine(Context *, CONST Context *, QWORD) { }
+};
+
+template<UINT uiHashType> struct HashAlgorithm;
+
+template<> struct HashAlgorithm<HASH_TYPE_CRC32> : HashAlgorithmDefaults {
+	typedef DWORD Context;
+	static CONST DWORD dwDigestSize = 4;
+	static CONST BOOL bMergeable = TRUE;
+	static CONST BOOL bFusable = TRUE;
+
+	static VOID Init(Context *c) { *c = 0; }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { *c = crc32_fast(data, dwLength, *c); }
+	static VOID Final(Context *c, VOID *result) { *(DWORD *)result = *c; }
+	static VOID Combine(Context *c, CONST Context *next, QWORD qwLength) { *c = crc32_combine(*c, *next, qwLength); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_MD5> : HashAlgorithmDefaults {
+	typedef MD5_CTX Context;
+	static CONST DWORD dwDigestSize = 16;
+	static CONST BOOL bMultiBuffer = TRUE;
+	static CONST BOOL bFusable = TRUE;
+
+	static VOID Init(Context *c) { MD5_Init(c); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { MD5_Update(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { MD5_Final((BYTE *)result, c); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_ED2K> : HashAlgorithmDefaults {
+	typedef CEd2kHash Context;
+	static CONST DWORD dwDigestSize = 16;
+	static CONST BOOL bFusable = TRUE;
+
+	static VOID Init(Context *c) { c->restart_calc(); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { c->add_data((BYTE *)data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { c->finish_calc(); c->get_hash((BYTE *)result); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_SHA1> : HashAlgorithmDefaults {
+	typedef SHA_CTX Context;
+	static CONST DWORD dwDigestSize = 20;
+	static CONST BOOL bMultiBuffer = TRUE;
+	static CONST BOOL bFusable = TRUE;
+
+	static VOID Init(Context *c) { SHA1_Init(c); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { SHA1_Update(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { SHA1_Final((BYTE *)result, c); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_SHA256> : HashAlgorithmDefaults {
+	typedef SHA256_CTX Context;
+	static CONST DWORD dwDigestSize = 32;
+	static CONST BOOL bMultiBuffer = TRUE;
+
+	static VOID Init(Context *c) { SHA256_Init(c); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { SHA256_Update(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { SHA256_Final((BYTE *)result, c); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_SHA512> : HashAlgorithmDefaults {
+	typedef SHA512_CTX Context;
+	static CONST DWORD dwDigestSize = 64;
+
+	static VOID Init(Context *c) { SHA512_Init(c); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { SHA512_Update(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { SHA512_Final((BYTE *)result, c); }
+};
+
+// the three SHA3 variants only differ in the parameters of the sponge
+struct Sha3AlgorithmBase : HashAlgorithmDefaults {
+	typedef Keccak_HashInstance Context;
+	static CONST BOOL bMultiBuffer = TRUE;
+
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { Keccak_HashUpdate(c, data, (BitLength)dwLength * 8); }
+	static VOID Final(Context *c, VOID *result) { Keccak_HashFinal(c, (BitSequence *)result); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_SHA3_224> : Sha3AlgorithmBase {
+	static CONST DWORD dwDigestSize = 28;
+
+	static VOID Init(Context *c) { Keccak_HashInitialize_SHA3_224(c); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_SHA3_256> : Sha3AlgorithmBase {
+	static CONST DWORD dwDigestSize = 32;
+
+	static VOID Init(Context *c) { Keccak_HashInitialize_SHA3_256(c); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_SHA3_512> : Sha3AlgorithmBase {
+	static CONST DWORD dwDigestSize = 64;
+
+	static VOID Init(Context *c) { Keccak_HashInitialize_SHA3_512(c); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_CRC32C> : HashAlgorithmDefaults {
+	typedef DWORD Context;
+	static CONST DWORD dwDigestSize = 4;
+	static CONST BOOL bMergeable = TRUE;
+	static CONST BOOL bFusable = TRUE;
+
+	static VOID Init(Context *c) { __crc32_init(); *c = 0; }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { *c = crc32c_append(*c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { *(DWORD *)result = *c; }
+	static VOID Combine(Context *c, CONST Context *next, QWORD qwLength) { *c = crc32c_combine(*c, *next, qwLength); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_BLAKE2SP> : HashAlgorithmDefaults {
+	typedef blake2sp_state Context;
+	static CONST DWORD dwDigestSize = 32;
+
+	static VOID Init(Context *c) { blake2sp_init(c, dwDigestSize); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { blake2sp_update(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { blake2sp_final(c, result, dwDigestSize); }
+};
+
+// the buffer is split into subtrees that are hashed on the thread pool
+template<> struct HashAlgorithm<HASH_TYPE_BLAKE3> : HashAlgorithmDefaults {
+	typedef blake3_hasher Context;
+	static CONST DWORD dwDigestSize = BLAKE3_OUT_LEN;
+
+	static VOID Init(Context *c) { blake3_hasher_init(c); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { blake3_hasher_update_mt(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { blake3_hasher_finalize(c, (uint8_t *)result, dwDigestSize); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_BLAKE2BP> : HashAlgorithmDefaults {
+	typedef blake2bp_state Context;
+	static CONST DWORD dwDigestSize = BLAKE2B_OUTBYTES;
+
+	static VOID Init(Context *c) { blake2bp_init(c, dwDigestSize); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { blake2bp_update(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { blake2bp_final(c, result, dwDigestSize); }
+};
+
+template<> struct HashAlgorithm<HASH_TYPE_XXH128> : HashAlgorithmDefaults {
+	typedef XXH3_128_CTX Context;
+	static CONST DWORD dwDigestSize = 16;
+	static CONST BOOL bFusable = TRUE;
+
+	static VOID Init(Context *c) { XXH3_128_Init(c); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { XXH3_128_Update(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { XXH3_128_Final((BYTE *)result, c); }
+};
+
+// whole 8 KiB leaves of the buffer are hashed in parallel on the thread pool
+template<> struct HashAlgorithm<HASH_TYPE_K12> : HashAlgorithmDefaults {
+	typedef KangarooTwelve_Instance Context;
+	static CONST DWORD dwDigestSize = 32;
+
+	static VOID Init(Context *c) { KangarooTwelve_Initialize(c, dwDigestSize); }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { KangarooTwelve_UpdateMT(c, data, dwLength); }
+	static VOID Final(Context *c, VOID *result) { KangarooTwelve_Final(c, (BYTE *)result, NULL, 0); }
+};
+
+// crc64 is kept big endian, so that the generic byte-wise compare, sort and
+// display code shows and matches the usual hex number
+template<> struct HashAlgorithm<HASH_TYPE_CRC64> : HashAlgorithmDefaults {
+	typedef QWORD Context;
+	static CONST DWORD dwDigestSize = 8;
+	static CONST BOOL bMergeable = TRUE;
+	static CONST BOOL bFusable = TRUE;
+
+	static VOID Init(Context *c) { *c = 0; }
+	static VOID Update(Context *c, CONST BYTE *data, DWORD dwLength) { *c = crc64_fast(data, dwLength, *c); }
+	static VOID Final(Context *c, VOID *result)
+	{
+		QWORD qwCrc64 = *c;
+		for(int i=7;i>=0;i--) {
+			((BYTE *)result)[i] = (BYTE)qwCrc64;
+			qwCrc64 >>= 8;
+		}
+	}
+	static VOID Combine(Context *c, CONST Context *next, QWORD qwLength) { *c = crc64_combine(*c, *next, qwLength); }
+};
+
+#endif
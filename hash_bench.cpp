@@ -0,0 +1,1071 @@
+/* hash_bench: throughput of every hash kernel, see usage() for the options
+
+   Each benchmark hashes a buffer of 64 B to 64 MiB from Init to Final, the best of
+   BENCH_TRIALS trials is reported as GB/s and as time stamp counter cycles per byte
+   (reference cycles, they differ from core cycles while the clock is boosted or throttled).
+
+   The kernels are picked once per process by cpu_select_kernel, so every dispatch path is
+   measured in a child process that hides CPU features with RAPIDCRC_CPU_DISABLE (see
+   bench_levels). The parent merges their results, a kernel that was already measured at a
+   higher level is skipped. The output is JSON with one result object per line, which is
+   also the format expected by --baseline.
+
+   Every level also checks its kernels: a child that hides all CPU features first hashes
+   the buffer with the portable kernels (slice8, opt64, ...), the digests of every level
+   have to match them, and the published test vectors of the algorithms have to come out
+   at every level (see known_answers). hash_bench exits with 3 if one of them does not.
+
+   With --read the listed files are hashed instead, read through one of the backends of
+   file_io.h, to see whether the I/O keeps up with the kernels. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define popen _popen
+#define pclose _pclose
+#else
+#include <x86intrin.h>
+#endif
+#include "cpu_features.h"
+#if !defined(_WIN32)
+#include <errno.h>
+#include <sys/stat.h>
+#include "file_io.h"
+#endif
+#include "crc32.h"
+#include "crc32c.h"
+#include "crc64.h"
+#include "md5_ossl.h"
+#include "sha1_ossl.h"
+#include "sha256_ossl.h"
+#include "sha512_ossl.h"
+#include "mb_hash.h"
+#include "xxh3.h"
+#include "ed2k_hash.h"
+extern "C" {
+#include "sha3/KeccakHash.h"
+#include "sha3/KangarooTwelve.h"
+}
+#include "blake2/blake2.h"
+#include "blake3/blake3.h"
+
+#define BENCH_MIN_SIZE		64
+#define BENCH_MAX_SIZE		(64 << 20)
+#define BENCH_TRIALS		5
+#define BENCH_MAX_LINE		512
+#define BENCH_MAX_SKIP		4096
+#define READ_BUFFERS		16
+#define READ_BUFFER_SIZE	(1 << 20)
+#define READ_MAX_DIGEST		64
+#define BENCH_MAX_DIGEST	64
+#define BENCH_MAX_EXPECT	4096
+#define KNOWN_BUFFER_SIZE	83521
+
+/* ---------------------------------------------------------------- */
+
+/* big endian, as displayed */
+static void put_be(unsigned char *md, uint64_t value, int bytes)
+{
+	int i;
+	for (i = 0; i < bytes; i++)
+		md[i] = (unsigned char)(value >> (8 * (bytes - 1 - i)));
+}
+
+static void bench_crc32(const unsigned char *data, size_t len, unsigned char *md) { put_be(md, crc32_fast(data, len), 4); }
+static void bench_crc32_4x8bytes(const unsigned char *data, size_t len, unsigned char *md) { put_be(md, crc32_4x8bytes(data, len), 4); }
+static void bench_crc32c(const unsigned char *data, size_t len, unsigned char *md) { __crc32_init(); put_be(md, crc32c_append(0, data, len), 4); }
+static void bench_crc64(const unsigned char *data, size_t len, unsigned char *md) { put_be(md, crc64_fast(data, len), 8); }
+
+static void bench_md5(const unsigned char *data, size_t len, unsigned char *md)
+{
+	MD5_CTX c;
+	MD5_Init(&c);
+	MD5_Update(&c, data, (unsigned long)len);
+	MD5_Final(md, &c);
+}
+
+static void bench_sha1(const unsigned char *data, size_t len, unsigned char *md)
+{
+	SHA_CTX c;
+	SHA1_Init(&c);
+	SHA1_Update(&c, data, len);
+	SHA1_Final(md, &c);
+}
+
+static void bench_sha256(const unsigned char *data, size_t len, unsigned char *md)
+{
+	SHA256_CTX c;
+	SHA256_Init(&c);
+	SHA256_Update(&c, data, len);
+	SHA256_Final(md, &c);
+}
+
+static void bench_sha512(const unsigned char *data, size_t len, unsigned char *md)
+{
+	SHA512_CTX c;
+	SHA512_Init(&c);
+	SHA512_Update(&c, data, len);
+	SHA512_Final(md, &c);
+}
+
+/* the buffer split into MB_MAX_LANES messages, like a batch of small files; md is the
+   xor of their digests */
+static void bench_mb(int algo, const unsigned char *data, size_t len, unsigned char *md)
+{
+	MB_JOB jobs[MB_MAX_LANES];
+	unsigned char lanes[MB_MAX_LANES][32];
+	const size_t part = len / MB_MAX_LANES;
+	unsigned int i, j;
+
+	for (i = 0; i < MB_MAX_LANES; i++) {
+		jobs[i].data = data + i * part;
+		jobs[i].len = i == MB_MAX_LANES - 1 ? len - i * part : part;
+		jobs[i].digest = lanes[i];
+	}
+	MB_Hash(algo, jobs, MB_MAX_LANES);
+	memset(md, 0, 32);
+	for (i = 0; i < MB_MAX_LANES; i++) {
+		for (j = 0; j < 32; j++)
+			md[j] ^= lanes[i][j];
+	}
+}
+
+static void bench_mb_md5(const unsigned char *data, size_t len, unsigned char *md) { bench_mb(MB_HASH_MD5, data, len, md); }
+static void bench_mb_sha1(const unsigned char *data, size_t len, unsigned char *md) { bench_mb(MB_HASH_SHA1, data, len, md); }
+static void bench_mb_sha256(const unsigned char *data, size_t len, unsigned char *md) { bench_mb(MB_HASH_SHA256, data, len, md); }
+
+static void bench_sha3_256(const unsigned char *data, size_t len, unsigned char *md)
+{
+	Keccak_HashInstance c;
+	Keccak_HashInitialize_SHA3_256(&c);
+	Keccak_HashUpdate(&c, data, (BitLength)len * 8);
+	Keccak_HashFinal(&c, md);
+}
+
+static void bench_k12(const unsigned char *data, size_t len, unsigned char *md)
+{
+	KangarooTwelve_Instance c;
+	KangarooTwelve_Initialize(&c, 32);
+	KangarooTwelve_Update(&c, data, len);
+	KangarooTwelve_Final(&c, md, NULL, 0);
+}
+
+static void bench_blake2sp(const unsigned char *data, size_t len, unsigned char *md)
+{
+	blake2sp_state c;
+	blake2sp_init(&c, BLAKE2S_OUTBYTES);
+	blake2sp_update(&c, data, len);
+	blake2sp_final(&c, md, BLAKE2S_OUTBYTES);
+}
+
+static void bench_blake2bp(const unsigned char *data, size_t len, unsigned char *md)
+{
+	blake2bp_state c;
+	blake2bp_init(&c, BLAKE2B_OUTBYTES);
+	blake2bp_update(&c, data, len);
+	blake2bp_final(&c, md, BLAKE2B_OUTBYTES);
+}
+
+static void bench_blake3(const unsigned char *data, size_t len, unsigned char *md)
+{
+	blake3_hasher c;
+	blake3_hasher_init(&c);
+	blake3_hasher_update(&c, data, len);
+	blake3_hasher_finalize(&c, md, BLAKE3_OUT_LEN);
+}
+
+static void bench_xxh128(const unsigned char *data, size_t len, unsigned char *md)
+{
+	XXH3_128_CTX c;
+	XXH3_128_Init(&c);
+	XXH3_128_Update(&c, data, len);
+	XXH3_128_Final(md, &c);
+}
+
+static CEd2kHash bench_ed2k_context;
+
+static void bench_ed2k(const unsigned char *data, size_t len, unsigned char *md)
+{
+	bench_ed2k_context.restart_calc();
+	bench_ed2k_context.add_data((BYTE *)data, (unsigned int)len);
+	bench_ed2k_context.finish_calc();
+	bench_ed2k_context.get_hash(md);
+}
+
+/* algorithm is the name the kernel is selected under, NULL for a single implementation */
+static const struct {
+	const char		*name;
+	const char		*algorithm;
+	const char		*kernel;
+	unsigned int	digest_length;
+	void			(*run)(const unsigned char *data, size_t len, unsigned char *md);
+} bench_kernels[] = {
+	{ "crc32",			"crc32",		NULL,		4,	bench_crc32 },
+	{ "crc32_4x8bytes",	NULL,			"4x8bytes",	4,	bench_crc32_4x8bytes },
+	{ "crc32c",			"crc32c",		NULL,		4,	bench_crc32c },
+	{ "crc64",			"crc64",		NULL,		8,	bench_crc64 },
+	{ "md5",			NULL,			"ossl",		16,	bench_md5 },
+	{ "sha1",			"sha1",			NULL,		20,	bench_sha1 },
+	{ "sha256",			"sha256",		NULL,		32,	bench_sha256 },
+	{ "sha512",			"sha512",		NULL,		64,	bench_sha512 },
+	{ "mb_md5",			"mb_hash",		NULL,		32,	bench_mb_md5 },
+	{ "mb_sha1",		"mb_hash",		NULL,		32,	bench_mb_sha1 },
+	{ "mb_sha256",		"mb_hash",		NULL,		32,	bench_mb_sha256 },
+	{ "sha3_256",		"keccak-p1600",	NULL,		32,	bench_sha3_256 },
+	{ "k12",			"keccak-batch",	NULL,		32,	bench_k12 },
+	{ "blake2sp",		"blake2sp",		NULL,		32,	bench_blake2sp },
+	{ "blake2bp",		"blake2bp",		NULL,		64,	bench_blake2bp },
+	{ "blake3",			"blake3",		NULL,		32,	bench_blake3 },
+	{ "xxh128",			"xxh128",		NULL,		16,	bench_xxh128 },
+	{ "ed2k",			NULL,			"md4",		16,	bench_ed2k },
+};
+
+/* CPU features hidden in the child process of each level, from the fastest to the portable kernels */
+static const struct {
+	const char	*name;
+	const char	*disable;
+} bench_levels[] = {
+	{ "native",	"" },
+	{ "avx2",	"avx512f,avx512bw,avx512vl" },
+	{ "sse42",	"avx512f,avx512bw,avx512vl,avx,avx2,bmi2,vpclmul,sha" },
+	{ "sse2",	"avx512f,avx512bw,avx512vl,avx,avx2,bmi2,vpclmul,sha,ssse3,sse41,sse42,pclmul" },
+};
+
+#define BENCH_COUNT(a)	(sizeof(a) / sizeof((a)[0]))
+
+/* ---------------------------------------------------------------- */
+
+/* state of one of the hashes of --read */
+typedef union _READ_CONTEXT {
+	uint32_t		crc32;
+	uint64_t		crc64;
+	MD5_CTX			md5;
+	SHA_CTX			sha1;
+	SHA256_CTX		sha256;
+	SHA512_CTX		sha512;
+	blake3_hasher	blake3;
+	XXH3_128_CTX	xxh128;
+} READ_CONTEXT;
+
+static void read_crc_init(READ_CONTEXT *c) { c->crc64 = 0; }
+static void read_crc32_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { c->crc32 = crc32_fast(data, len, c->crc32); }
+static void read_crc32c_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { __crc32_init(); c->crc32 = crc32c_append(c->crc32, data, len); }
+static void read_crc64_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { c->crc64 = crc64_fast(data, len, c->crc64); }
+
+static void read_crc32_final(READ_CONTEXT *c, unsigned char *md) { put_be(md, c->crc32, 4); }
+static void read_crc64_final(READ_CONTEXT *c, unsigned char *md) { put_be(md, c->crc64, 8); }
+
+static void read_md5_init(READ_CONTEXT *c) { MD5_Init(&c->md5); }
+static void read_md5_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { MD5_Update(&c->md5, data, (unsigned long)len); }
+static void read_md5_final(READ_CONTEXT *c, unsigned char *md) { MD5_Final(md, &c->md5); }
+static void read_sha1_init(READ_CONTEXT *c) { SHA1_Init(&c->sha1); }
+static void read_sha1_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { SHA1_Update(&c->sha1, data, len); }
+static void read_sha1_final(READ_CONTEXT *c, unsigned char *md) { SHA1_Final(md, &c->sha1); }
+static void read_sha256_init(READ_CONTEXT *c) { SHA256_Init(&c->sha256); }
+static void read_sha256_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { SHA256_Update(&c->sha256, data, len); }
+static void read_sha256_final(READ_CONTEXT *c, unsigned char *md) { SHA256_Final(md, &c->sha256); }
+static void read_sha512_init(READ_CONTEXT *c) { SHA512_Init(&c->sha512); }
+static void read_sha512_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { SHA512_Update(&c->sha512, data, len); }
+static void read_sha512_final(READ_CONTEXT *c, unsigned char *md) { SHA512_Final(md, &c->sha512); }
+static void read_blake3_init(READ_CONTEXT *c) { blake3_hasher_init(&c->blake3); }
+static void read_blake3_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { blake3_hasher_update(&c->blake3, data, len); }
+static void read_blake3_final(READ_CONTEXT *c, unsigned char *md) { blake3_hasher_finalize(&c->blake3, md, BLAKE3_OUT_LEN); }
+static void read_xxh128_init(READ_CONTEXT *c) { XXH3_128_Init(&c->xxh128); }
+static void read_xxh128_update(READ_CONTEXT *c, const unsigned char *data, size_t len) { XXH3_128_Update(&c->xxh128, data, len); }
+static void read_xxh128_final(READ_CONTEXT *c, unsigned char *md) { XXH3_128_Final(md, &c->xxh128); }
+
+/* hashes --read can use, named like the benchmarks */
+static const struct {
+	const char		*name;
+	const char		*algorithm;
+	const char		*kernel;
+	unsigned int	digest_length;
+	void			(*init)(READ_CONTEXT *c);
+	void			(*update)(READ_CONTEXT *c, const unsigned char *data, size_t len);
+	void			(*final)(READ_CONTEXT *c, unsigned char *md);
+} read_hashes[] = {
+	{ "crc32",	"crc32",	NULL,	4,	read_crc_init,		read_crc32_update,	read_crc32_final },
+	{ "crc32c",	"crc32c",	NULL,	4,	read_crc_init,		read_crc32c_update,	read_crc32_final },
+	{ "crc64",	"crc64",	NULL,	8,	read_crc_init,		read_crc64_update,	read_crc64_final },
+	{ "md5",	NULL,		"ossl",	16,	read_md5_init,		read_md5_update,	read_md5_final },
+	{ "sha1",	"sha1",		NULL,	20,	read_sha1_init,		read_sha1_update,	read_sha1_final },
+	{ "sha256",	"sha256",	NULL,	32,	read_sha256_init,	read_sha256_update,	read_sha256_final },
+	{ "sha512",	"sha512",	NULL,	64,	read_sha512_init,	read_sha512_update,	read_sha512_final },
+	{ "blake3",	"blake3",	NULL,	32,	read_blake3_init,	read_blake3_update,	read_blake3_final },
+	{ "xxh128",	"xxh128",	NULL,	16,	read_xxh128_init,	read_xxh128_update,	read_xxh128_final },
+};
+
+/* ---------------------------------------------------------------- */
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: hash_bench [options]\n"
+		"  --time MS          time spent per kernel and size, default 50\n"
+		"  --min-size BYTES   smallest buffer, default 64\n"
+		"  --max-size BYTES   largest buffer, default 67108864; sizes grow by a factor of 4\n"
+		"  --only NAME,...    run only these benchmarks, e.g. crc32,sha256\n"
+		"  --baseline FILE    compare with an earlier output of hash_bench\n"
+		"  --tolerance PCT    exit with 1 if a result is this much slower than the baseline, default 5\n"
+		"  --read FILE        hash FILE (may be repeated) with the --only hashes, default crc32,\n"
+		"                     instead of running the kernel benchmarks\n"
+		"  --io NAME          I/O backend of --read, io_uring or pread; default RAPIDCRC_IO or the first that works\n"
+		"  --io-buffers N     reads in flight, default 16\n"
+		"  --io-size BYTES    size of every read, default 1048576\n"
+		"  --io-direct        open the files with O_DIRECT\n"
+		"exits with 1 if a result is slower than the baseline, 3 if a kernel gives a wrong digest\n");
+}
+
+/* kernel that algorithm runs with in this process, recorded by cpu_select_kernel */
+static const char *selected_kernel(const char *algorithm)
+{
+	unsigned int i;
+
+	for (i = 0; i < cpu_kernel_count(); i++) {
+		if (strcmp(cpu_kernel_algorithm(i), algorithm) == 0)
+			return cpu_kernel_name(i);
+	}
+	return "unknown";
+}
+
+/* is entry one of the comma separated items of list */
+static int in_list(const char *list, const char *entry)
+{
+	const size_t length = strlen(entry);
+
+	while (list && *list) {
+		const char *end = strchr(list, ',');
+		if ((end ? (size_t)(end - list) : strlen(list)) == length && strncmp(list, entry, length) == 0)
+			return 1;
+		list = end ? end + 1 : NULL;
+	}
+	return 0;
+}
+
+/* copies the part after "name=" of the entry of list to value, returns 0 if there is none */
+static int list_value(const char *list, const char *name, char *value, size_t size)
+{
+	const size_t length = strlen(name);
+
+	while (list && *list) {
+		const char *end = strchr(list, ',');
+		const size_t entry = end ? (size_t)(end - list) : strlen(list);
+		if (entry > length && list[length] == '=' && strncmp(list, name, length) == 0) {
+			if (entry - length - 1 >= size)
+				return 0;
+			memcpy(value, list + length + 1, entry - length - 1);
+			value[entry - length - 1] = 0;
+			return 1;
+		}
+		list = end ? end + 1 : NULL;
+	}
+	return 0;
+}
+
+static void to_hex(const unsigned char *md, unsigned int length, char *hex)
+{
+	unsigned int i;
+	for (i = 0; i < length; i++)
+		sprintf(hex + 2 * i, "%02x", md[i]);
+	hex[2 * length] = 0;
+}
+
+/* copies the string value of key in a result line to value, returns 0 if it is missing */
+static int json_string(const char *line, const char *key, char *value, size_t size)
+{
+	char pattern[64];
+	const char *start, *end;
+
+	sprintf(pattern, "\"%s\": \"", key);
+	start = strstr(line, pattern);
+	if (start == NULL)
+		return 0;
+	start += strlen(pattern);
+	end = strchr(start, '"');
+	if (end == NULL || (size_t)(end - start) >= size)
+		return 0;
+	memcpy(value, start, end - start);
+	value[end - start] = 0;
+	return 1;
+}
+
+static int json_number(const char *line, const char *key, double *value)
+{
+	char pattern[64];
+	const char *start;
+
+	sprintf(pattern, "\"%s\": ", key);
+	start = strstr(line, pattern);
+	return start != NULL && sscanf(start + strlen(pattern), "%lf", value) == 1;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* published test vectors, hashed with the kernels of the level */
+
+/* xxhsum's sanity check data, XXH3-128 with seed 0 (xxhash cli/xsum_sanity_check.c) */
+static const struct {
+	size_t		len;
+	const char	*digest;
+} known_xxh128[] = {
+	{ 0,	"99aa06d3014798d86001c324468d497f" },
+	{ 1,	"a6cd5e9392000f6ac44bdff4074eecdb" },
+	{ 6,	"082afe0b8162d12a3e7039bdda43cfc6" },
+	{ 12,	"6e3efd8fc7802b18061a192713f69ad9" },
+	{ 24,	"0ce966e4678d37611e7044d28b1b901d" },
+	{ 48,	"a002ac4e5478227ef942219aed80f67b" },
+	{ 81,	"4952f58181ab00425e8bafb9f95fb803" },
+	{ 222,	"337e09641b948717f1aebd597cec6b3a" },
+	{ 403,	"1b6de21e332dd73dcdeb804d65c6dea4" },
+	{ 512,	"18d2d110dcc9bca1617e49599013cb6b" },
+	{ 2048,	"f736557fd47073a5dd59e2c3a5f038e0" },
+	{ 2240,	"ccb134fbfa7ce49d6e73a90539cf2948" },
+	{ 2367,	"e89c0f6ff369b427cb37aeb9e5d361ed" },
+};
+
+/* KangarooTwelve of ptn(len), no customization, 32 bytes (RFC 9861) */
+static const struct {
+	size_t		len;
+	const char	*digest;
+} known_k12[] = {
+	{ 0,		"1ac2d450fc3b4205d19da7bfca1b37513c0803577ac7167f06fe2ce1f0ef39e5" },
+	{ 17,		"6bf75fa2239198db4772e36478f8e19b0f371205f6a9a93a273f51df37122888" },
+	{ 289,		"0c315ebcdedbf61426de7dcf8fb725d1e74675d7f5327a5067f367b108ecb67c" },
+	{ 4913,		"cb552e2ec77d9910701d578b457ddf772c12e322e4ee7fe417f92c758f0d59d0" },
+	{ 83521,	"8701045e22205345ff4dda05555cbb5c3af1a771c2b89baef37db43d9998b9fe" },
+};
+
+/* BLAKE2bp of 00 01 02 ..., key 00 01 ... 3f, 64 bytes (blake2bp-kat.txt of the reference code) */
+static const struct {
+	size_t		len;
+	const char	*digest;
+} known_blake2bp[] = {
+	{ 0,	"9d9461073e4eb640a255357b839f394b838c6ff57c9b686a3f76107c1066728f3c9956bd785cbc3bf79dc2ab578c5a0c063b9d9c405848de1dbe821cd05c940a" },
+	{ 1,	"ff8e90a37b94623932c59f7559f26035029c376732cb14d41602001cbb73adb79293a2dbda5f60703025144d158e2735529596251c73c0345ca6fccb1fb1e97e" },
+	{ 255,	"96fbcbb60bd313b8845033e5bc058a38027438572d7e7957f3684f6268aadd3ad08d21767ed6878685331ba98571487e12470aad669326716e46667f69f8d7e8" },
+};
+
+/* CRC-32, CRC-32C and CRC-64/XZ of the check string of the CRC catalogue and of the first
+   4096 bytes of the xxhsum data */
+static const char known_check[] = "123456789";
+static const uint32_t known_crc32[2] = { 0xcbf43926, 0x96c6f579 };
+static const uint32_t known_crc32c[2] = { 0xe3069283, 0x6efe6bb5 };
+static const uint64_t known_crc64[2] = { 0x995dc9bbdf1939faULL, 0xe8bc8abd6fe5ec48ULL };
+
+static int known_compare(const char *level, const char *name, size_t len, const unsigned char *md, unsigned int length,
+						 const char *expected)
+{
+	char hex[2 * BENCH_MAX_DIGEST + 1];
+
+	to_hex(md, length, hex);
+	if (strcmp(hex, expected) == 0)
+		return 0;
+	fprintf(stderr, "hash_bench: %s of %lu bytes is %s at level %s, expected %s\n", name, (unsigned long)len, hex, level, expected);
+	return 1;
+}
+
+static int known_compare_crc(const char *level, const char *name, size_t len, uint64_t crc, uint64_t expected)
+{
+	if (crc == expected)
+		return 0;
+	fprintf(stderr, "hash_bench: %s of %lu bytes is %016llx at level %s, expected %016llx\n", name, (unsigned long)len,
+		(unsigned long long)crc, level, (unsigned long long)expected);
+	return 1;
+}
+
+/* checks the vectors above, the CRCs also split at some points and put together with the
+   combine functions; returns the number of wrong results */
+static int known_answers(const char *level)
+{
+	static unsigned char buffer[KNOWN_BUFFER_SIZE];
+	const unsigned char * const data[2] = { (const unsigned char *)known_check, buffer };
+	const size_t length[2] = { sizeof(known_check) - 1, 4096 };
+	static const size_t splits[] = { 0, 1, 5, 100, 2048, 4095 };
+	unsigned char key[BLAKE2B_KEYBYTES], md[BENCH_MAX_DIGEST];
+	uint64_t state = 2654435761U;
+	int failed = 0;
+	size_t i, j;
+
+	__crc32_init();
+	for (i = 0; i < 2; i++) {
+		failed += known_compare_crc(level, "crc32", length[i], crc32_fast(data[i], length[i]), known_crc32[i]);
+		failed += known_compare_crc(level, "crc32c", length[i], crc32c_append(0, data[i], length[i]), known_crc32c[i]);
+		failed += known_compare_crc(level, "crc64", length[i], crc64_fast(data[i], length[i]), known_crc64[i]);
+		for (j = 0; j < sizeof(splits) / sizeof(splits[0]) && splits[j] <= length[i]; j++) {
+			const unsigned char *second = data[i] + splits[j];
+			const size_t rest = length[i] - splits[j];
+			failed += known_compare_crc(level, "crc32_combine", length[i],
+				crc32_combine(crc32_fast(data[i], splits[j]), crc32_fast(second, rest), rest), known_crc32[i]);
+			failed += known_compare_crc(level, "crc32c_combine", length[i],
+				crc32c_combine(crc32c_append(0, data[i], splits[j]), crc32c_append(0, second, rest), rest), known_crc32c[i]);
+			failed += known_compare_crc(level, "crc64_combine", length[i],
+				crc64_combine(crc64_fast(data[i], splits[j]), crc64_fast(second, rest), rest), known_crc64[i]);
+		}
+		if (i == 0) {
+			/* the xxhsum data follows */
+			for (j = 0; j < 4096; j++) {
+				buffer[j] = (unsigned char)(state >> 56);
+				state *= 11400714785074694797ULL;
+			}
+		}
+	}
+
+	for (i = 0; i < BENCH_COUNT(known_xxh128); i++) {
+		bench_xxh128(buffer, known_xxh128[i].len, md);
+		failed += known_compare(level, "xxh128", known_xxh128[i].len, md, 16, known_xxh128[i].digest);
+	}
+
+	for (i = 0; i < KNOWN_BUFFER_SIZE; i++)
+		buffer[i] = (unsigned char)(i % 251);
+	for (i = 0; i < BENCH_COUNT(known_k12); i++) {
+		bench_k12(buffer, known_k12[i].len, md);
+		failed += known_compare(level, "k12", known_k12[i].len, md, 32, known_k12[i].digest);
+	}
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (unsigned char)i;
+	for (i = 0; i < 256; i++)
+		buffer[i] = (unsigned char)i;
+	for (i = 0; i < BENCH_COUNT(known_blake2bp); i++) {
+		blake2bp(md, BLAKE2B_OUTBYTES, buffer, known_blake2bp[i].len, key, sizeof(key));
+		failed += known_compare(level, "blake2bp", known_blake2bp[i].len, md, BLAKE2B_OUTBYTES, known_blake2bp[i].digest);
+	}
+
+	return failed;
+}
+
+/* digest of a kernel that is compared between the levels: the digests of the buffer at
+   every benchmark size and one byte shorter, xor'ed */
+static void check_digest(unsigned int kernel, const unsigned char *data, size_t min_size, size_t max_size, char *hex)
+{
+	unsigned char md[BENCH_MAX_DIGEST], sum[BENCH_MAX_DIGEST];
+	unsigned int i;
+	size_t size;
+
+	memset(sum, 0, sizeof(sum));
+	for (size = min_size; size <= max_size; size *= 4) {
+		bench_kernels[kernel].run(data, size, md);
+		for (i = 0; i < bench_kernels[kernel].digest_length; i++)
+			sum[i] ^= md[i];
+		bench_kernels[kernel].run(data, size - 1, md);
+		for (i = 0; i < bench_kernels[kernel].digest_length; i++)
+			sum[i] ^= md[i];
+	}
+	to_hex(sum, bench_kernels[kernel].digest_length, hex);
+}
+
+/* measures one kernel and size, returns the seconds and TSC cycles of the best trial;
+   the seconds are 0 if the clock is too coarse to see the run */
+static void measure(void (*run)(const unsigned char *, size_t, unsigned char *), const unsigned char *data, size_t len,
+					double seconds, double *best_seconds, double *best_cycles)
+{
+	typedef std::chrono::steady_clock clock;
+	unsigned char md[BENCH_MAX_DIGEST];
+	unsigned long long iterations = 1, i;
+	int trial;
+
+	/* warm up, then grow the iteration count until one trial takes its share of the time */
+	run(data, len, md);
+	for (;;) {
+		const clock::time_point start = clock::now();
+		for (i = 0; i < iterations; i++)
+			run(data, len, md);
+		if (std::chrono::duration<double>(clock::now() - start).count() >= seconds / BENCH_TRIALS)
+			break;
+		iterations *= 2;
+	}
+
+	*best_seconds = 0;
+	*best_cycles = 0;
+	for (trial = 0; trial < BENCH_TRIALS; trial++) {
+		const clock::time_point start = clock::now();
+		const unsigned long long tsc = __rdtsc();
+		double elapsed;
+		for (i = 0; i < iterations; i++)
+			run(data, len, md);
+		elapsed = std::chrono::duration<double>(clock::now() - start).count() / iterations;
+		if (trial == 0 || elapsed < *best_seconds) {
+			*best_seconds = elapsed;
+			*best_cycles = (double)(__rdtsc() - tsc) / iterations;
+		}
+	}
+}
+
+/* the buffer of the children, filled the same way in every one */
+static unsigned char *bench_buffer(size_t max_size)
+{
+	unsigned char *buffer;
+	unsigned int state = 0x12345678;
+	size_t size;
+
+	buffer = (unsigned char *)malloc(max_size);
+	if (buffer == NULL) {
+		fprintf(stderr, "hash_bench: can not allocate %lu bytes\n", (unsigned long)max_size);
+		return NULL;
+	}
+	for (size = 0; size < max_size; size++) {
+		state = state * 1103515245 + 12345;
+		buffer[size] = (unsigned char)(state >> 16);
+	}
+	return buffer;
+}
+
+/* child with all CPU features hidden: prints the check_digest of the portable kernel of every benchmark */
+static int run_digests(const char *only, size_t min_size, size_t max_size)
+{
+	unsigned char md[BENCH_MAX_DIGEST];
+	char hex[2 * BENCH_MAX_DIGEST + 1];
+	unsigned char *buffer;
+	unsigned int i;
+	int failed;
+
+	if ((buffer = bench_buffer(max_size)) == NULL)
+		return 2;
+	failed = known_answers("portable");
+
+	for (i = 0; i < BENCH_COUNT(bench_kernels); i++) {
+		if (only && !in_list(only, bench_kernels[i].name))
+			continue;
+		bench_kernels[i].run(buffer, max_size, md);
+		check_digest(i, buffer, min_size, max_size, hex);
+		printf("{\"name\": \"%s\", \"kernel\": \"%s\", \"digest\": \"%s\"}\n", bench_kernels[i].name,
+			bench_kernels[i].algorithm ? selected_kernel(bench_kernels[i].algorithm) : bench_kernels[i].kernel, hex);
+	}
+	free(buffer);
+	return failed ? 3 : 0;
+}
+
+/* child: runs every benchmark at one level and prints a result line for each kernel and size;
+   every kernel's check_digest has to be the one in expect (name=digest,...) */
+static int run_level(unsigned int level, const char *only, const char *skip, const char *expect,
+					 size_t min_size, size_t max_size, double seconds)
+{
+	unsigned char md[BENCH_MAX_DIGEST];
+	unsigned char *buffer;
+	unsigned int i;
+	size_t size;
+	int failed;
+
+	if ((buffer = bench_buffer(max_size)) == NULL)
+		return 2;
+	failed = known_answers(bench_levels[level].name);
+
+	for (i = 0; i < BENCH_COUNT(bench_kernels); i++) {
+		const char *kernel;
+		char entry[BENCH_MAX_LINE], hex[2 * BENCH_MAX_DIGEST + 1], expected[2 * BENCH_MAX_DIGEST + 1];
+
+		if (only && !in_list(only, bench_kernels[i].name))
+			continue;
+		/* selects the kernel, some are only used for longer inputs */
+		bench_kernels[i].run(buffer, max_size, md);
+		kernel = bench_kernels[i].algorithm ? selected_kernel(bench_kernels[i].algorithm) : bench_kernels[i].kernel;
+		snprintf(entry, sizeof(entry), "%s=%s", bench_kernels[i].name, kernel);
+		if (in_list(skip, entry))
+			continue;
+
+		check_digest(i, buffer, min_size, max_size, hex);
+		if (!list_value(expect, bench_kernels[i].name, expected, sizeof(expected))) {
+			fprintf(stderr, "hash_bench: no portable digest of %s\n", bench_kernels[i].name);
+			failed++;
+		} else if (strcmp(hex, expected) != 0) {
+			fprintf(stderr, "hash_bench: %s with kernel %s at level %s gives %s, the portable kernel %s\n",
+				bench_kernels[i].name, kernel, bench_levels[level].name, hex, expected);
+			failed++;
+		}
+
+		for (size = min_size; size <= max_size; size *= 4) {
+			double best_seconds, best_cycles;
+
+			measure(bench_kernels[i].run, buffer, size, seconds, &best_seconds, &best_cycles);
+			if (best_seconds <= 0) {
+				fprintf(stderr, "hash_bench: %s at %lu bytes is too fast for the clock, not reported\n",
+					bench_kernels[i].name, (unsigned long)size);
+				continue;
+			}
+			printf("{\"name\": \"%s\", \"kernel\": \"%s\", \"level\": \"%s\", \"size\": %lu, \"gbps\": %.3f, \"cycles_per_byte\": %.3f}\n",
+				bench_kernels[i].name, kernel, bench_levels[level].name, (unsigned long)size,
+				size / best_seconds / 1e9, best_cycles / size);
+			fflush(stdout);
+		}
+	}
+	free(buffer);
+	return failed ? 3 : 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* gbps of the result with the same name, kernel and size in the baseline, 0 if there is none */
+static double baseline_gbps(FILE *baseline, const char *name, const char *kernel, double size)
+{
+	char line[BENCH_MAX_LINE], value[BENCH_MAX_LINE];
+	double number, gbps;
+
+	if (baseline == NULL)
+		return 0;
+	rewind(baseline);
+	while (fgets(line, sizeof(line), baseline)) {
+		if (!json_string(line, "name", value, sizeof(value)) || strcmp(value, name) != 0)
+			continue;
+		if (!json_string(line, "kernel", value, sizeof(value)) || strcmp(value, kernel) != 0)
+			continue;
+		if (json_number(line, "size", &number) && number == size && json_number(line, "gbps", &gbps))
+			return gbps;
+	}
+	return 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+#if !defined(_WIN32)
+
+static void json_print_string(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			putchar('\\');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+/* reads the file in order through io, the buffers behind the one that is hashed are read
+   meanwhile; prints a result line for every hash of only and returns 0 if the whole file was read */
+static int read_file(FILE_IO *io, const char *path, int direct, unsigned int buffer_count, size_t buffer_size,
+					 const char *only, int *first)
+{
+	typedef std::chrono::steady_clock clock;
+	READ_CONTEXT contexts[BENCH_COUNT(read_hashes)];
+	FILE_IO_COMPLETION *completions;
+	long *results;
+	unsigned char *ready;
+	unsigned long long offset = 0, bytes = 0;
+	unsigned int issued = 0, done = 0, reaped = 0, i;
+	int file, n, last = 0, error = 0;
+	struct stat st;
+	double seconds;
+
+	if (stat(path, &st) != 0) {
+		fprintf(stderr, "hash_bench: can not read %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	file = file_io_open(io, path, direct);
+	if (file < 0) {
+		fprintf(stderr, "hash_bench: can not open %s: %s\n", path, strerror(-file));
+		return 1;
+	}
+	completions = (FILE_IO_COMPLETION *)malloc(buffer_count * sizeof(FILE_IO_COMPLETION));
+	results = (long *)malloc(buffer_count * sizeof(long));
+	ready = (unsigned char *)calloc(buffer_count, 1);
+	if (completions == NULL || results == NULL || ready == NULL) {
+		fprintf(stderr, "hash_bench: out of memory\n");
+		exit(2);
+	}
+
+	const clock::time_point start = clock::now();
+	for (i = 0; i < BENCH_COUNT(read_hashes); i++) {
+		if (in_list(only, read_hashes[i].name))
+			read_hashes[i].init(&contexts[i]);
+	}
+
+	while (!last && !error) {
+		/* past the size from stat only if nothing else is pending, a short read ends the file */
+		while (issued - done < buffer_count && (issued == done || offset <= (unsigned long long)st.st_size)) {
+			n = file_io_read(io, file, issued % buffer_count, offset, buffer_size);
+			if (n < 0) {
+				error = -n;
+				break;
+			}
+			offset += buffer_size;
+			issued++;
+		}
+		if (error == 0 && (n = file_io_submit(io)) < 0)
+			error = -n;
+		if (error)
+			break;
+
+		n = file_io_reap(io, completions, buffer_count, 1);
+		if (n < 0) {
+			error = -n;
+			break;
+		}
+		for (i = 0; i < (unsigned int)n; i++) {
+			results[completions[i].buffer] = completions[i].result;
+			ready[completions[i].buffer] = 1;
+		}
+		reaped += n;
+
+		/* in file order */
+		while (!last && done != issued && ready[done % buffer_count]) {
+			const unsigned int buffer = done % buffer_count;
+			unsigned int h;
+
+			ready[buffer] = 0;
+			done++;
+			if (results[buffer] < 0) {
+				error = (int)-results[buffer];
+				break;
+			}
+			for (h = 0; h < BENCH_COUNT(read_hashes); h++) {
+				if (in_list(only, read_hashes[h].name))
+					read_hashes[h].update(&contexts[h], file_io_buffer(io, buffer), (size_t)results[buffer]);
+			}
+			bytes += results[buffer];
+			last = (size_t)results[buffer] < buffer_size;
+		}
+	}
+
+	/* the reads behind the last buffer have to come back before the file is closed */
+	while (reaped != issued && (n = file_io_reap(io, completions, buffer_count, 1)) > 0)
+		reaped += n;
+	file_io_close(io, file);
+	seconds = std::chrono::duration<double>(clock::now() - start).count();
+	free(completions);
+	free(results);
+	free(ready);
+
+	if (error) {
+		fprintf(stderr, "hash_bench: can not read %s: %s\n", path, strerror(error));
+		return 1;
+	}
+
+	for (i = 0; i < BENCH_COUNT(read_hashes); i++) {
+		unsigned char md[READ_MAX_DIGEST];
+		unsigned int b;
+
+		if (!in_list(only, read_hashes[i].name))
+			continue;
+		read_hashes[i].final(&contexts[i], md);
+		printf("%s{\"file\": ", *first ? "" : ",\n");
+		json_print_string(path);
+		printf(", \"io\": \"%s\", \"name\": \"%s\", \"kernel\": \"%s\", \"size\": %llu, \"seconds\": %.6f, \"gbps\": %.3f, \"digest\": \"",
+			file_io_backend(io), read_hashes[i].name,
+			read_hashes[i].algorithm ? selected_kernel(read_hashes[i].algorithm) : read_hashes[i].kernel,
+			bytes, seconds, seconds > 0 ? bytes / seconds / 1e9 : 0.0);
+		for (b = 0; b < read_hashes[i].digest_length; b++)
+			printf("%02x", md[b]);
+		printf("\"}");
+		*first = 0;
+	}
+	fflush(stdout);
+	return 0;
+}
+
+/* --read: returns 1 if a file could not be read */
+static int run_read(const char **files, unsigned int file_count, const char *only, const char *backend,
+					unsigned int buffer_count, size_t buffer_size, int direct)
+{
+	FILE_IO *io;
+	unsigned int i, known = 0;
+	int failed = 0, first = 1;
+
+	for (i = 0; i < BENCH_COUNT(read_hashes); i++)
+		known += in_list(only, read_hashes[i].name);
+	if (known == 0) {
+		fprintf(stderr, "hash_bench: --read supports crc32, crc32c, crc64, md5, sha1, sha256, sha512, blake3 and xxh128\n");
+		return 2;
+	}
+
+	io = file_io_create(backend, buffer_count, buffer_size);
+	if (io == NULL) {
+		if (backend == NULL)
+			backend = getenv("RAPIDCRC_IO");
+		fprintf(stderr, "hash_bench: can not set up the I/O backend %s: %s\n", backend ? backend : "", strerror(errno));
+		return 2;
+	}
+
+	printf("{\n\"io\": \"%s\",\n\"results\": [\n", file_io_backend(io));
+	for (i = 0; i < file_count; i++)
+		failed |= read_file(io, files[i], direct, buffer_count, buffer_size, only, &first);
+	printf("\n]\n}\n");
+
+	file_io_destroy(io);
+	return failed;
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+	const char *only = NULL, *skip = "", *expect = "", *baseline_file = NULL;
+	unsigned long min_size = BENCH_MIN_SIZE, max_size = BENCH_MAX_SIZE;
+	double seconds = 0.05, tolerance = 5;
+	int level = -1, digests = 0, regressions = 0, failures = 0, first = 1;
+	FILE *baseline = NULL;
+	static char skip_list[BENCH_MAX_SKIP], expect_list[BENCH_MAX_EXPECT];
+	char command[BENCH_MAX_SKIP + BENCH_MAX_EXPECT + BENCH_MAX_LINE];
+	char line[BENCH_MAX_LINE], name[BENCH_MAX_LINE], kernel[BENCH_MAX_LINE];
+	FILE *child;
+	const char **read_files = (const char **)calloc(argc, sizeof(const char *)), *io_backend = NULL;
+	unsigned int read_count = 0, io_buffers = READ_BUFFERS;
+	unsigned long io_size = READ_BUFFER_SIZE;
+	int io_direct = 0;
+	unsigned int i;
+	int arg;
+
+	for (arg = 1; arg < argc; arg++) {
+		const char *value = arg + 1 < argc ? argv[arg + 1] : NULL;
+
+		if (strcmp(argv[arg], "--io-direct") == 0) {
+			io_direct = 1;
+			continue;
+		}
+		/* internal, the child that hashes with the portable kernels */
+		if (strcmp(argv[arg], "--digests") == 0) {
+			digests = 1;
+			continue;
+		}
+		if (value && strcmp(argv[arg], "--time") == 0)
+			seconds = atof(value) / 1000;
+		else if (value && strcmp(argv[arg], "--min-size") == 0)
+			min_size = strtoul(value, NULL, 0);
+		else if (value && strcmp(argv[arg], "--max-size") == 0)
+			max_size = strtoul(value, NULL, 0);
+		else if (value && strcmp(argv[arg], "--only") == 0)
+			only = value;
+		else if (value && strcmp(argv[arg], "--baseline") == 0)
+			baseline_file = value;
+		else if (value && strcmp(argv[arg], "--tolerance") == 0)
+			tolerance = atof(value);
+		else if (value && strcmp(argv[arg], "--read") == 0)
+			read_files[read_count++] = value;
+		else if (value && strcmp(argv[arg], "--io") == 0)
+			io_backend = value;
+		else if (value && strcmp(argv[arg], "--io-buffers") == 0)
+			io_buffers = (unsigned int)strtoul(value, NULL, 0);
+		else if (value && strcmp(argv[arg], "--io-size") == 0)
+			io_size = strtoul(value, NULL, 0);
+		/* internal, used for the child processes */
+		else if (value && strcmp(argv[arg], "--level") == 0)
+			level = atoi(value);
+		else if (value && strcmp(argv[arg], "--skip") == 0)
+			skip = value;
+		else if (value && strcmp(argv[arg], "--expect") == 0)
+			expect = value;
+		else {
+			usage();
+			return 2;
+		}
+		arg++;
+	}
+	if (min_size == 0 || max_size < min_size || seconds <= 0 || io_buffers == 0 || io_size == 0) {
+		usage();
+		return 2;
+	}
+
+	if (read_count > 0) {
+#if !defined(_WIN32)
+		return run_read(read_files, read_count, only ? only : "crc32", io_backend, io_buffers, io_size, io_direct);
+#else
+		fprintf(stderr, "hash_bench: --read needs the POSIX build\n");
+		return 2;
+#endif
+	}
+
+	if (digests) {
+		/* the lowest level without SSE2 as well leaves every algorithm its last kernel */
+		snprintf(line, sizeof(line), "%s,sse2", bench_levels[BENCH_COUNT(bench_levels) - 1].disable);
+#if defined(_MSC_VER)
+		_putenv_s("RAPIDCRC_CPU_DISABLE", line);
+#else
+		setenv("RAPIDCRC_CPU_DISABLE", line, 1);
+#endif
+		return run_digests(only, min_size, max_size);
+	}
+
+	if (level >= 0) {
+		if (level >= (int)BENCH_COUNT(bench_levels))
+			return 2;
+		/* before the first cpu_features call */
+#if defined(_MSC_VER)
+		_putenv_s("RAPIDCRC_CPU_DISABLE", bench_levels[level].disable);
+#else
+		setenv("RAPIDCRC_CPU_DISABLE", bench_levels[level].disable, 1);
+#endif
+		return run_level(level, only, skip, expect, min_size, max_size, seconds);
+	}
+
+	if (baseline_file) {
+		baseline = fopen(baseline_file, "r");
+		if (baseline == NULL) {
+			fprintf(stderr, "hash_bench: can not open %s\n", baseline_file);
+			return 2;
+		}
+	}
+
+	/* the digests of the portable kernels, every level is checked against them */
+	sprintf(command, "\"%s\" --digests --min-size %lu --max-size %lu%s%s",
+		argv[0], min_size, max_size, only ? " --only " : "", only ? only : "");
+	child = popen(command, "r");
+	if (child == NULL) {
+		fprintf(stderr, "hash_bench: can not run %s\n", argv[0]);
+		return 2;
+	}
+	while (fgets(line, sizeof(line), child)) {
+		char digest[BENCH_MAX_LINE];
+
+		if (!json_string(line, "name", name, sizeof(name)) || !json_string(line, "digest", digest, sizeof(digest))
+			|| strlen(expect_list) + strlen(name) + strlen(digest) + 3 >= sizeof(expect_list))
+			continue;
+		if (expect_list[0])
+			strcat(expect_list, ",");
+		strcat(expect_list, name);
+		strcat(expect_list, "=");
+		strcat(expect_list, digest);
+	}
+	if (pclose(child) != 0)
+		failures++;
+
+	printf("{\n\"cpu_features\": %u,\n\"results\": [\n", cpu_features());
+	for (i = 0; i < BENCH_COUNT(bench_levels); i++) {
+		sprintf(command, "\"%s\" --level %u --time %f --min-size %lu --max-size %lu --skip \"%s\" --expect \"%s\"%s%s",
+			argv[0], i, seconds * 1000, min_size, max_size, skip_list, expect_list, only ? " --only " : "", only ? only : "");
+		child = popen(command, "r");
+		if (child == NULL) {
+			fprintf(stderr, "hash_bench: can not run %s\n", argv[0]);
+			return 2;
+		}
+
+		while (fgets(line, sizeof(line), child)) {
+			char entry[2 * BENCH_MAX_LINE];
+			double size, gbps, reference;
+
+			if (!json_string(line, "name", name, sizeof(name)) || !json_string(line, "kernel", kernel, sizeof(kernel))
+				|| !json_number(line, "size", &size) || !json_number(line, "gbps", &gbps))
+				continue;
+			line[strcspn(line, "\r\n")] = 0;
+
+			/* the children of the following levels skip what this one measured */
+			snprintf(entry, sizeof(entry), "%s=%s", name, kernel);
+			if (!in_list(skip_list, entry) && strlen(skip_list) + strlen(entry) + 2 < sizeof(skip_list)) {
+				if (skip_list[0])
+					strcat(skip_list, ",");
+				strcat(skip_list, entry);
+			}
+
+			reference = baseline_gbps(baseline, name, kernel, size);
+			if (reference > 0) {
+				const double change = (gbps / reference - 1) * 100;
+				if (change < -tolerance)
+					regressions++;
+				/* appended to the object */
+				line[strlen(line) - 1] = 0;
+				printf("%s%s, \"baseline_gbps\": %.3f, \"change_percent\": %.1f}", first ? "" : ",\n", line, reference, change);
+			} else
+				printf("%s%s", first ? "" : ",\n", line);
+			first = 0;
+			fflush(stdout);
+		}
+		/* wrong digests, the child reported them on stderr */
+		if (pclose(child) != 0)
+			failures++;
+	}
+	printf("\n],\n\"regressions\": %d,\n\"failed_levels\": %d\n}\n", regressions, failures);
+
+	if (baseline)
+		fclose(baseline);
+	return failures ? 3 : regressions ? 1 : 0;
+}
@@ -473,6 +473,10 @@ VOID ReadOptions()
 
     if(program_options_file.uiReadBufferSizeKb < 1 || program_options_file.uiReadBufferSizeKb > 20 * 1024) // limit between 1kb and 20mb
         program_options_file.uiReadBufferSizeKb = DEFAULT_BUFFER_SIZE_CALC;
+    if(program_options_file.uiReadBufferCount < 2 || program_options_file.uiReadBufferCount > MAX_BUFFER_COUNT_CALC)
+        program_options_file.uiReadBufferCount = DEFAULT_BUFFER_COUNT_CALC;
+    if(program_options_file.uiConcurrentFiles < 1 || program_options_file.uiConcurrentFiles > MAX_CONCURRENT_FILES)
+        program_options_file.uiConcurrentFiles = DEFAULT_CONCURRENT_FILES;
 
     g_program_options = program_options_file;
 
@@ -643,6 +647,35 @@ BOOL IsStringPrefix(CONST TCHAR szSearchPattern[MAX_PATH_EX], CONST TCHAR szSear
 	return TRUE;
 }
 
+/*****************************************************************************
+BOOL IsConcurrentFilesSwitch(CONST TCHAR *szArg, UINT *puiConcurrentFiles)
+	szArg				: (IN) a command line argument
+	puiConcurrentFiles	: (OUT) files hashed at once per disk, if szArg is the switch
+
+Return Value:
+returns TRUE if szArg is -ConcurrentFiles:N
+
+Notes:
+- N is clamped to 1..MAX_CONCURRENT_FILES, the value overrides uiConcurrentFiles of
+  the options for the files of this command line
+*****************************************************************************/
+BOOL IsConcurrentFilesSwitch(CONST TCHAR *szArg, UINT *puiConcurrentFiles)
+{
+	CONST TCHAR szSwitch[] = TEXT("-ConcurrentFiles:");
+	INT iFiles;
+
+	if(_tcsnicmp(szArg, szSwitch, _countof(szSwitch) - 1) != 0)
+		return FALSE;
+
+	iFiles = _ttoi(szArg + _countof(szSwitch) - 1);
+	if(iFiles < 1)
+		iFiles = 1;
+	if(iFiles > MAX_CONCURRENT_FILES)
+		iFiles = MAX_CONCURRENT_FILES;
+	*puiConcurrentFiles = (UINT)iFiles;
+	return TRUE;
+}
+
 /*****************************************************************************
 DWORD MyPriorityToPriorityClass(CONST UINT uiMyPriority)
 	uiMyPriority	: (IN) uiMyPriority to be converted
@@ -675,11 +708,13 @@ returns nothing
 VOID SetFileInfoStrings(FILEINFO *pFileinfo,lFILEINFO *fileList)
 {
     TCHAR *szCrcHex = TEXT("%08X");
+    TCHAR *szCrc64Hex = TEXT("%02X");
     TCHAR *szHashHex = TEXT("%02x");
     if(g_program_options.iHexFormat == UPPERCASE) {
         szHashHex = TEXT("%02X");
     } else if(g_program_options.iHexFormat == LOWERCASE) {
         szCrcHex = TEXT("%08x");
+        szCrc64Hex = TEXT("%02x");
     }
 
     for(int i=0;i<NUM_HASH_TYPES;i++) {
@@ -693,6 +728,11 @@ VOID SetFileInfoStrings(FILEINFO *pFileinfo,lFILEINFO *fileList)
                 CRCI(pFileinfo).szResult.Format(szCrcHex, CRCI(pFileinfo).r.dwCrc32Result);
             else if(i == HASH_TYPE_CRC32C)
                 CRCCI(pFileinfo).szResult.Format(szCrcHex, CRCCI(pFileinfo).r.dwCrc32cResult);
+            else if(i == HASH_TYPE_CRC64)
+                // stored big endian, printed in upper case by default like the other crcs
+                for(UINT j=0;j<g_hash_lengths[i];j++) {
+                    rPrint.AppendFormat(szCrc64Hex,pFileinfo->hashInfo[i].r.abCrc64Result[j]);
+                }
             else
                 for(UINT j=0;j<g_hash_lengths[i];j++) {
                     rPrint.AppendFormat(szHashHex,*((BYTE *)&pFileinfo->hashInfo[i].r + j));
@@ -948,6 +988,12 @@ CString HashBytesToString(const BYTE *abBytes, UINT uiHashType)
 	{
 		s.Format(TEXT("%08X"), *((DWORD*)abBytes));
 	}
+	else if (uiHashType == HASH_TYPE_CRC64)
+	{
+		for (UINT j = 0; j < g_hash_lengths[uiHashType]; j++) {
+			s.AppendFormat(TEXT("%02X"), *(abBytes + j));
+		}
+	}
 	else
 	{
 		for (UINT j = 0; j < g_hash_lengths[uiHashType]; j++) {
@@ -1029,6 +1075,29 @@ void PROGRAM_OPTIONS_FILE::SetDefaults()
 	bDisplayBlake3InListView = FALSE;
 	bUseUnbufferedReads = FALSE;
 	bCloseAfterActionFromShellExt = FALSE;
+	bHashLargeFilesInSegments = TRUE;
+	uiCreateFileModeBlake2bp = CREATE_ONE_FILE;
+	StringCchPrintf(szFilenameBlake2bp, MAX_PATH, TEXT("checksum.%s"), g_hash_ext[HASH_TYPE_BLAKE2BP]);
+	bSaveAbsolutePathsBlake2bp = 0;
+	bCalcBlake2bpPerDefault = FALSE;
+	bDisplayBlake2bpInListView = FALSE;
+	uiCreateFileModeXxh128 = CREATE_ONE_FILE;
+	StringCchPrintf(szFilenameXxh128, MAX_PATH, TEXT("checksum.%s"), g_hash_ext[HASH_TYPE_XXH128]);
+	bSaveAbsolutePathsXxh128 = 0;
+	bCalcXxh128PerDefault = FALSE;
+	bDisplayXxh128InListView = FALSE;
+	uiCreateFileModeK12 = CREATE_ONE_FILE;
+	StringCchPrintf(szFilenameK12, MAX_PATH, TEXT("checksum.%s"), g_hash_ext[HASH_TYPE_K12]);
+	bSaveAbsolutePathsK12 = 0;
+	bCalcK12PerDefault = FALSE;
+	bDisplayK12InListView = FALSE;
+	uiCreateFileModeCrc64 = CREATE_ONE_FILE;
+	StringCchPrintf(szFilenameCrc64, MAX_PATH, TEXT("checksum.%s"), g_hash_ext[HASH_TYPE_CRC64]);
+	bSaveAbsolutePathsCrc64 = 0;
+	bCalcCrc64PerDefault = FALSE;
+	bDisplayCrc64InListView = FALSE;
+	uiReadBufferCount = DEFAULT_BUFFER_COUNT_CALC;
+	uiConcurrentFiles = DEFAULT_CONCURRENT_FILES;
 }
 
 /*****************************************************************************
@@ -1093,6 +1162,9 @@ PROGRAM_OPTIONS_FILE& PROGRAM_OPTIONS_FILE::operator=(const PROGRAM_OPTIONS& oth
 	bAlwaysUseNewWindow = other.bAlwaysUseNewWindow;
 	bUseUnbufferedReads = other.bUseUnbufferedReads;
 	bCloseAfterActionFromShellExt = other.bCloseAfterActionFromShellExt;
+	bHashLargeFilesInSegments = other.bHashLargeFilesInSegments;
+	uiReadBufferCount = other.uiReadBufferCount;
+	uiConcurrentFiles = other.uiConcurrentFiles;
 
 	bDisplayBlake3InListView = other.bDisplayInListView[HASH_TYPE_BLAKE3];
 	bCalcBlake3PerDefault = other.bCalcPerDefault[HASH_TYPE_BLAKE3];
@@ -1100,6 +1172,30 @@ PROGRAM_OPTIONS_FILE& PROGRAM_OPTIONS_FILE::operator=(const PROGRAM_OPTIONS& oth
 	StringCchCopy(szFilenameBlake3, MAX_PATH, other.szFilename[HASH_TYPE_BLAKE3]);
 	bSaveAbsolutePathsBlake3 = other.bSaveAbsolutePaths[HASH_TYPE_BLAKE3];
 
+	bDisplayBlake2bpInListView = other.bDisplayInListView[HASH_TYPE_BLAKE2BP];
+	bCalcBlake2bpPerDefault = other.bCalcPerDefault[HASH_TYPE_BLAKE2BP];
+	uiCreateFileModeBlake2bp = other.uiCreateFileMode[HASH_TYPE_BLAKE2BP];
+	StringCchCopy(szFilenameBlake2bp, MAX_PATH, other.szFilename[HASH_TYPE_BLAKE2BP]);
+	bSaveAbsolutePathsBlake2bp = other.bSaveAbsolutePaths[HASH_TYPE_BLAKE2BP];
+
+	bDisplayXxh128InListView = other.bDisplayInListView[HASH_TYPE_XXH128];
+	bCalcXxh128PerDefault = other.bCalcPerDefault[HASH_TYPE_XXH128];
+	uiCreateFileModeXxh128 = other.uiCreateFileMode[HASH_TYPE_XXH128];
+	StringCchCopy(szFilenameXxh128, MAX_PATH, other.szFilename[HASH_TYPE_XXH128]);
+	bSaveAbsolutePathsXxh128 = other.bSaveAbsolutePaths[HASH_TYPE_XXH128];
+
+	bDisplayK12InListView = other.bDisplayInListView[HASH_TYPE_K12];
+	bCalcK12PerDefault = other.bCalcPerDefault[HASH_TYPE_K12];
+	uiCreateFileModeK12 = other.uiCreateFileMode[HASH_TYPE_K12];
+	StringCchCopy(szFilenameK12, MAX_PATH, other.szFilename[HASH_TYPE_K12]);
+	bSaveAbsolutePathsK12 = other.bSaveAbsolutePaths[HASH_TYPE_K12];
+
+	bDisplayCrc64InListView = other.bDisplayInListView[HASH_TYPE_CRC64];
+	bCalcCrc64PerDefault = other.bCalcPerDefault[HASH_TYPE_CRC64];
+	uiCreateFileModeCrc64 = other.uiCreateFileMode[HASH_TYPE_CRC64];
+	StringCchCopy(szFilenameCrc64, MAX_PATH, other.szFilename[HASH_TYPE_CRC64]);
+	bSaveAbsolutePathsCrc64 = other.bSaveAbsolutePaths[HASH_TYPE_CRC64];
+
     return *this;
 }
 
@@ -1160,6 +1256,9 @@ PROGRAM_OPTIONS& PROGRAM_OPTIONS::operator=(const PROGRAM_OPTIONS_FILE& other)
 	bAlwaysUseNewWindow = other.bAlwaysUseNewWindow;
 	bUseUnbufferedReads = other.bUseUnbufferedReads;
 	bCloseAfterActionFromShellExt = other.bCloseAfterActionFromShellExt;
+	bHashLargeFilesInSegments = other.bHashLargeFilesInSegments;
+	uiReadBufferCount = other.uiReadBufferCount;
+	uiConcurrentFiles = other.uiConcurrentFiles;
 
 	bDisplayInListView[HASH_TYPE_BLAKE3] = other.bDisplayBlake3InListView;
 	bCalcPerDefault[HASH_TYPE_BLAKE3] = other.bCalcBlake3PerDefault;
@@ -1167,5 +1266,29 @@ PROGRAM_OPTIONS& PROGRAM_OPTIONS::operator=(const PROGRAM_OPTIONS_FILE& other)
 	StringCchCopy(szFilename[HASH_TYPE_BLAKE3], MAX_PATH, other.szFilenameBlake3);
 	bSaveAbsolutePaths[HASH_TYPE_BLAKE3] = other.bSaveAbsolutePathsBlake3;
 
+	bDisplayInListView[HASH_TYPE_BLAKE2BP] = other.bDisplayBlake2bpInListView;
+	bCalcPerDefault[HASH_TYPE_BLAKE2BP] = other.bCalcBlake2bpPerDefault;
+	uiCreateFileMode[HASH_TYPE_BLAKE2BP] = other.uiCreateFileModeBlake2bp;
+	StringCchCopy(szFilename[HASH_TYPE_BLAKE2BP], MAX_PATH, other.szFilenameBlake2bp);
+	bSaveAbsolutePaths[HASH_TYPE_BLAKE2BP] = other.bSaveAbsolutePathsBlake2bp;
+
+	bDisplayInListView[HASH_TYPE_XXH128] = other.bDisplayXxh128InListView;
+	bCalcPerDefault[HASH_TYPE_XXH128] = other.bCalcXxh128PerDefault;
+	uiCreateFileMode[HASH_TYPE_XXH128] = other.uiCreateFileModeXxh128;
+	StringCchCopy(szFilename[HASH_TYPE_XXH128], MAX_PATH, other.szFilenameXxh128);
+	bSaveAbsolutePaths[HASH_TYPE_XXH128] = other.bSaveAbsolutePathsXxh128;
+
+	bDisplayInListView[HASH_TYPE_K12] = other.bDisplayK12InListView;
+	bCalcPerDefault[HASH_TYPE_K12] = other.bCalcK12PerDefault;
+	uiCreateFileMode[HASH_TYPE_K12] = other.uiCreateFileModeK12;
+	StringCchCopy(szFilename[HASH_TYPE_K12], MAX_PATH, other.szFilenameK12);
+	bSaveAbsolutePaths[HASH_TYPE_K12] = other.bSaveAbsolutePathsK12;
+
+	bDisplayInListView[HASH_TYPE_CRC64] = other.bDisplayCrc64InListView;
+	bCalcPerDefault[HASH_TYPE_CRC64] = other.bCalcCrc64PerDefault;
+	uiCreateFileMode[HASH_TYPE_CRC64] = other.uiCreateFileModeCrc64;
+	StringCchCopy(szFilename[HASH_TYPE_CRC64], MAX_PATH, other.szFilenameCrc64);
+	bSaveAbsolutePaths[HASH_TYPE_CRC64] = other.bSaveAbsolutePathsCrc64;
+
     return *this;
 }
@@ -0,0 +1,534 @@
+#include "mb_hash.h"
+#include "cpu_features.h"
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/*
+ * Multi-buffer MD5/SHA-1/SHA-256: every SIMD lane runs the compression function of a
+ * different message. The block functions are templates over a small vector class, so
+ * the same round code is used for 4 (SSE2), 8 (AVX2) and 16 (AVX-512) lanes.
+ */
+
+typedef void (*mb_blocks_func)(unsigned int h[][MB_MAX_LANES], const unsigned char **ptr, size_t nblocks);
+
+// //////////////////////////////////////////////////////////
+// vector classes
+
+#if !defined(_MSC_VER)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+/* transposes 8 words at off of 8 lanes, w[i] holds word i of all lanes */
+static inline void transpose8x8(__m256i w[8], const unsigned char * const *ptr, size_t off)
+{
+	__m256i t0, t1, t2, t3, t4, t5, t6, t7;
+	__m256i u0, u1, u2, u3, u4, u5, u6, u7;
+
+	t0 = _mm256_loadu_si256((const __m256i *)(ptr[0] + off));
+	t1 = _mm256_loadu_si256((const __m256i *)(ptr[1] + off));
+	t2 = _mm256_loadu_si256((const __m256i *)(ptr[2] + off));
+	t3 = _mm256_loadu_si256((const __m256i *)(ptr[3] + off));
+	t4 = _mm256_loadu_si256((const __m256i *)(ptr[4] + off));
+	t5 = _mm256_loadu_si256((const __m256i *)(ptr[5] + off));
+	t6 = _mm256_loadu_si256((const __m256i *)(ptr[6] + off));
+	t7 = _mm256_loadu_si256((const __m256i *)(ptr[7] + off));
+
+	u0 = _mm256_unpacklo_epi32(t0, t1);
+	u1 = _mm256_unpackhi_epi32(t0, t1);
+	u2 = _mm256_unpacklo_epi32(t2, t3);
+	u3 = _mm256_unpackhi_epi32(t2, t3);
+	u4 = _mm256_unpacklo_epi32(t4, t5);
+	u5 = _mm256_unpackhi_epi32(t4, t5);
+	u6 = _mm256_unpacklo_epi32(t6, t7);
+	u7 = _mm256_unpackhi_epi32(t6, t7);
+
+	t0 = _mm256_unpacklo_epi64(u0, u2);
+	t1 = _mm256_unpackhi_epi64(u0, u2);
+	t2 = _mm256_unpacklo_epi64(u1, u3);
+	t3 = _mm256_unpackhi_epi64(u1, u3);
+	t4 = _mm256_unpacklo_epi64(u4, u6);
+	t5 = _mm256_unpackhi_epi64(u4, u6);
+	t6 = _mm256_unpacklo_epi64(u5, u7);
+	t7 = _mm256_unpackhi_epi64(u5, u7);
+
+	w[0] = _mm256_permute2x128_si256(t0, t4, 0x20);
+	w[1] = _mm256_permute2x128_si256(t1, t5, 0x20);
+	w[2] = _mm256_permute2x128_si256(t2, t6, 0x20);
+	w[3] = _mm256_permute2x128_si256(t3, t7, 0x20);
+	w[4] = _mm256_permute2x128_si256(t0, t4, 0x31);
+	w[5] = _mm256_permute2x128_si256(t1, t5, 0x31);
+	w[6] = _mm256_permute2x128_si256(t2, t6, 0x31);
+	w[7] = _mm256_permute2x128_si256(t3, t7, 0x31);
+}
+
+#if !defined(_MSC_VER)
+#pragma GCC pop_options
+#endif
+
+struct VecSSE2 {
+	typedef __m128i T;
+	enum { LANES = 4 };
+
+	static T load(const unsigned int *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static void store(unsigned int *p, T x) { _mm_storeu_si128((__m128i *)p, x); }
+	static T set1(unsigned int x) { return _mm_set1_epi32((int)x); }
+	static T add(T a, T b) { return _mm_add_epi32(a, b); }
+	static T xor2(T a, T b) { return _mm_xor_si128(a, b); }
+	static T xor3(T a, T b, T c) { return _mm_xor_si128(_mm_xor_si128(a, b), c); }
+	template<int n> static T rol(T x) { return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n)); }
+	template<int n> static T shr(T x) { return _mm_srli_epi32(x, n); }
+	/* (x & y) | (~x & z) */
+	static T ch(T x, T y, T z) { return _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z))); }
+	static T maj(T x, T y, T z) { return _mm_or_si128(_mm_and_si128(x, y), _mm_and_si128(z, _mm_or_si128(x, y))); }
+	/* y ^ (x | ~z), MD5 function I */
+	static T md5i(T x, T y, T z) { return _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, _mm_set1_epi32(-1)))); }
+	static T bswap(T x)
+	{
+		x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+		return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+	}
+	static void loadWords(T w[16], const unsigned char * const *ptr, size_t off)
+	{
+		for (int i = 0; i < 16; i += 4) {
+			T r0 = _mm_loadu_si128((const __m128i *)(ptr[0] + off + 4 * i));
+			T r1 = _mm_loadu_si128((const __m128i *)(ptr[1] + off + 4 * i));
+			T r2 = _mm_loadu_si128((const __m128i *)(ptr[2] + off + 4 * i));
+			T r3 = _mm_loadu_si128((const __m128i *)(ptr[3] + off + 4 * i));
+			T t0 = _mm_unpacklo_epi32(r0, r1);
+			T t1 = _mm_unpacklo_epi32(r2, r3);
+			T t2 = _mm_unpackhi_epi32(r0, r1);
+			T t3 = _mm_unpackhi_epi32(r2, r3);
+			w[i + 0] = _mm_unpacklo_epi64(t0, t1);
+			w[i + 1] = _mm_unpackhi_epi64(t0, t1);
+			w[i + 2] = _mm_unpacklo_epi64(t2, t3);
+			w[i + 3] = _mm_unpackhi_epi64(t2, t3);
+		}
+	}
+	static void done() { }
+};
+
+#if !defined(_MSC_VER)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+struct VecAVX2 {
+	typedef __m256i T;
+	enum { LANES = 8 };
+
+	static T load(const unsigned int *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static void store(unsigned int *p, T x) { _mm256_storeu_si256((__m256i *)p, x); }
+	static T set1(unsigned int x) { return _mm256_set1_epi32((int)x); }
+	static T add(T a, T b) { return _mm256_add_epi32(a, b); }
+	static T xor2(T a, T b) { return _mm256_xor_si256(a, b); }
+	static T xor3(T a, T b, T c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+	template<int n> static T rol(T x) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+	template<int n> static T shr(T x) { return _mm256_srli_epi32(x, n); }
+	static T ch(T x, T y, T z) { return _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z))); }
+	static T maj(T x, T y, T z) { return _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(z, _mm256_or_si256(x, y))); }
+	static T md5i(T x, T y, T z) { return _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, _mm256_set1_epi32(-1)))); }
+	static T bswap(T x)
+	{
+		return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+													   3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+	}
+	static void loadWords(T w[16], const unsigned char * const *ptr, size_t off)
+	{
+		transpose8x8(w, ptr, off);
+		transpose8x8(w + 8, ptr, off + 32);
+	}
+	static void done() { _mm256_zeroupper(); }
+};
+
+#if !defined(_MSC_VER)
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx2,avx512f,avx512bw")
+#endif
+
+struct VecAVX512 {
+	typedef __m512i T;
+	enum { LANES = 16 };
+
+	static T load(const unsigned int *p) { return _mm512_loadu_si512((const void *)p); }
+	static void store(unsigned int *p, T x) { _mm512_storeu_si512((void *)p, x); }
+	static T set1(unsigned int x) { return _mm512_set1_epi32((int)x); }
+	static T add(T a, T b) { return _mm512_add_epi32(a, b); }
+	static T xor2(T a, T b) { return _mm512_xor_si512(a, b); }
+	static T xor3(T a, T b, T c) { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+	template<int n> static T rol(T x) { return _mm512_rol_epi32(x, n); }
+	template<int n> static T shr(T x) { return _mm512_srli_epi32(x, n); }
+	static T ch(T x, T y, T z) { return _mm512_ternarylogic_epi32(x, y, z, 0xCA); }
+	static T maj(T x, T y, T z) { return _mm512_ternarylogic_epi32(x, y, z, 0xE8); }
+	static T md5i(T x, T y, T z) { return _mm512_ternarylogic_epi32(x, y, z, 0x39); }
+	static T bswap(T x)
+	{
+		return _mm512_shuffle_epi8(x, _mm512_broadcast_i32x4(_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)));
+	}
+	static void loadWords(T w[16], const unsigned char * const *ptr, size_t off)
+	{
+		__m256i lo[8], hi[8];
+		for (int i = 0; i < 16; i += 8) {
+			transpose8x8(lo, ptr, off + 4 * i);
+			transpose8x8(hi, ptr + 8, off + 4 * i);
+			for (int j = 0; j < 8; j++)
+				w[i + j] = _mm512_inserti64x4(_mm512_castsi256_si512(lo[j]), hi[j], 1);
+		}
+	}
+	static void done() { _mm256_zeroupper(); }
+};
+
+#if !defined(_MSC_VER)
+#pragma GCC pop_options
+#endif
+
+// //////////////////////////////////////////////////////////
+// block functions
+
+#define MD5_STEP(f, a, b, c, d, k, s, t) \
+	a = V::add(b, V::template rol<s>(V::add(V::add(a, f), V::add(w[k], V::set1(t)))))
+
+template<class V> static void md5_blocks(unsigned int h[][MB_MAX_LANES], const unsigned char **ptr, size_t nblocks)
+{
+	typedef typename V::T T;
+	T a = V::load(h[0]), b = V::load(h[1]), c = V::load(h[2]), d = V::load(h[3]);
+	T w[16];
+
+	for (size_t off = 0; off < nblocks * 64; off += 64) {
+		T aa = a, bb = b, cc = c, dd = d;
+		V::loadWords(w, ptr, off);
+
+		MD5_STEP(V::ch(b, c, d), a, b, c, d,  0,  7, 0xd76aa478);
+		MD5_STEP(V::ch(a, b, c), d, a, b, c,  1, 12, 0xe8c7b756);
+		MD5_STEP(V::ch(d, a, b), c, d, a, b,  2, 17, 0x242070db);
+		MD5_STEP(V::ch(c, d, a), b, c, d, a,  3, 22, 0xc1bdceee);
+		MD5_STEP(V::ch(b, c, d), a, b, c, d,  4,  7, 0xf57c0faf);
+		MD5_STEP(V::ch(a, b, c), d, a, b, c,  5, 12, 0x4787c62a);
+		MD5_STEP(V::ch(d, a, b), c, d, a, b,  6, 17, 0xa8304613);
+		MD5_STEP(V::ch(c, d, a), b, c, d, a,  7, 22, 0xfd469501);
+		MD5_STEP(V::ch(b, c, d), a, b, c, d,  8,  7, 0x698098d8);
+		MD5_STEP(V::ch(a, b, c), d, a, b, c,  9, 12, 0x8b44f7af);
+		MD5_STEP(V::ch(d, a, b), c, d, a, b, 10, 17, 0xffff5bb1);
+		MD5_STEP(V::ch(c, d, a), b, c, d, a, 11, 22, 0x895cd7be);
+		MD5_STEP(V::ch(b, c, d), a, b, c, d, 12,  7, 0x6b901122);
+		MD5_STEP(V::ch(a, b, c), d, a, b, c, 13, 12, 0xfd987193);
+		MD5_STEP(V::ch(d, a, b), c, d, a, b, 14, 17, 0xa679438e);
+		MD5_STEP(V::ch(c, d, a), b, c, d, a, 15, 22, 0x49b40821);
+
+		MD5_STEP(V::ch(d, b, c), a, b, c, d,  1,  5, 0xf61e2562);
+		MD5_STEP(V::ch(c, a, b), d, a, b, c,  6,  9, 0xc040b340);
+		MD5_STEP(V::ch(b, d, a), c, d, a, b, 11, 14, 0x265e5a51);
+		MD5_STEP(V::ch(a, c, d), b, c, d, a,  0, 20, 0xe9b6c7aa);
+		MD5_STEP(V::ch(d, b, c), a, b, c, d,  5,  5, 0xd62f105d);
+		MD5_STEP(V::ch(c, a, b), d, a, b, c, 10,  9, 0x02441453);
+		MD5_STEP(V::ch(b, d, a), c, d, a, b, 15, 14, 0xd8a1e681);
+		MD5_STEP(V::ch(a, c, d), b, c, d, a,  4, 20, 0xe7d3fbc8);
+		MD5_STEP(V::ch(d, b, c), a, b, c, d,  9,  5, 0x21e1cde6);
+		MD5_STEP(V::ch(c, a, b), d, a, b, c, 14,  9, 0xc33707d6);
+		MD5_STEP(V::ch(b, d, a), c, d, a, b,  3, 14, 0xf4d50d87);
+		MD5_STEP(V::ch(a, c, d), b, c, d, a,  8, 20, 0x455a14ed);
+		MD5_STEP(V::ch(d, b, c), a, b, c, d, 13,  5, 0xa9e3e905);
+		MD5_STEP(V::ch(c, a, b), d, a, b, c,  2,  9, 0xfcefa3f8);
+		MD5_STEP(V::ch(b, d, a), c, d, a, b,  7, 14, 0x676f02d9);
+		MD5_STEP(V::ch(a, c, d), b, c, d, a, 12, 20, 0x8d2a4c8a);
+
+		MD5_STEP(V::xor3(b, c, d), a, b, c, d,  5,  4, 0xfffa3942);
+		MD5_STEP(V::xor3(a, b, c), d, a, b, c,  8, 11, 0x8771f681);
+		MD5_STEP(V::xor3(d, a, b), c, d, a, b, 11, 16, 0x6d9d6122);
+		MD5_STEP(V::xor3(c, d, a), b, c, d, a, 14, 23, 0xfde5380c);
+		MD5_STEP(V::xor3(b, c, d), a, b, c, d,  1,  4, 0xa4beea44);
+		MD5_STEP(V::xor3(a, b, c), d, a, b, c,  4, 11, 0x4bdecfa9);
+		MD5_STEP(V::xor3(d, a, b), c, d, a, b,  7, 16, 0xf6bb4b60);
+		MD5_STEP(V::xor3(c, d, a), b, c, d, a, 10, 23, 0xbebfbc70);
+		MD5_STEP(V::xor3(b, c, d), a, b, c, d, 13,  4, 0x289b7ec6);
+		MD5_STEP(V::xor3(a, b, c), d, a, b, c,  0, 11, 0xeaa127fa);
+		MD5_STEP(V::xor3(d, a, b), c, d, a, b,  3, 16, 0xd4ef3085);
+		MD5_STEP(V::xor3(c, d, a), b, c, d, a,  6, 23, 0x04881d05);
+		MD5_STEP(V::xor3(b, c, d), a, b, c, d,  9,  4, 0xd9d4d039);
+		MD5_STEP(V::xor3(a, b, c), d, a, b, c, 12, 11, 0xe6db99e5);
+		MD5_STEP(V::xor3(d, a, b), c, d, a, b, 15, 16, 0x1fa27cf8);
+		MD5_STEP(V::xor3(c, d, a), b, c, d, a,  2, 23, 0xc4ac5665);
+
+		MD5_STEP(V::md5i(b, c, d), a, b, c, d,  0,  6, 0xf4292244);
+		MD5_STEP(V::md5i(a, b, c), d, a, b, c,  7, 10, 0x432aff97);
+		MD5_STEP(V::md5i(d, a, b), c, d, a, b, 14, 15, 0xab9423a7);
+		MD5_STEP(V::md5i(c, d, a), b, c, d, a,  5, 21, 0xfc93a039);
+		MD5_STEP(V::md5i(b, c, d), a, b, c, d, 12,  6, 0x655b59c3);
+		MD5_STEP(V::md5i(a, b, c), d, a, b, c,  3, 10, 0x8f0ccc92);
+		MD5_STEP(V::md5i(d, a, b), c, d, a, b, 10, 15, 0xffeff47d);
+		MD5_STEP(V::md5i(c, d, a), b, c, d, a,  1, 21, 0x85845dd1);
+		MD5_STEP(V::md5i(b, c, d), a, b, c, d,  8,  6, 0x6fa87e4f);
+		MD5_STEP(V::md5i(a, b, c), d, a, b, c, 15, 10, 0xfe2ce6e0);
+		MD5_STEP(V::md5i(d, a, b), c, d, a, b,  6, 15, 0xa3014314);
+		MD5_STEP(V::md5i(c, d, a), b, c, d, a, 13, 21, 0x4e0811a1);
+		MD5_STEP(V::md5i(b, c, d), a, b, c, d,  4,  6, 0xf7537e82);
+		MD5_STEP(V::md5i(a, b, c), d, a, b, c, 11, 10, 0xbd3af235);
+		MD5_STEP(V::md5i(d, a, b), c, d, a, b,  2, 15, 0x2ad7d2bb);
+		MD5_STEP(V::md5i(c, d, a), b, c, d, a,  9, 21, 0xeb86d391);
+
+		a = V::add(a, aa); b = V::add(b, bb); c = V::add(c, cc); d = V::add(d, dd);
+	}
+
+	V::store(h[0], a); V::store(h[1], b); V::store(h[2], c); V::store(h[3], d);
+	V::done();
+}
+
+template<class V> static void sha1_blocks(unsigned int h[][MB_MAX_LANES], const unsigned char **ptr, size_t nblocks)
+{
+	typedef typename V::T T;
+	T a = V::load(h[0]), b = V::load(h[1]), c = V::load(h[2]), d = V::load(h[3]), e = V::load(h[4]);
+	T w[16], f, t;
+	int i;
+
+	for (size_t off = 0; off < nblocks * 64; off += 64) {
+		T aa = a, bb = b, cc = c, dd = d, ee = e;
+		V::loadWords(w, ptr, off);
+		for (i = 0; i < 16; i++)
+			w[i] = V::bswap(w[i]);
+
+		for (i = 0; i < 80; i++) {
+			if (i >= 16)
+				w[i & 15] = V::template rol<1>(V::xor2(V::xor3(w[(i - 3) & 15], w[(i - 8) & 15], w[(i - 14) & 15]), w[i & 15]));
+			if (i < 20)
+				f = V::add(V::ch(b, c, d), V::set1(0x5a827999));
+			else if (i < 40)
+				f = V::add(V::xor3(b, c, d), V::set1(0x6ed9eba1));
+			else if (i < 60)
+				f = V::add(V::maj(b, c, d), V::set1(0x8f1bbcdc));
+			else
+				f = V::add(V::xor3(b, c, d), V::set1(0xca62c1d6));
+			t = V::add(V::add(V::template rol<5>(a), f), V::add(e, w[i & 15]));
+			e = d; d = c; c = V::template rol<30>(b); b = a; a = t;
+		}
+
+		a = V::add(a, aa); b = V::add(b, bb); c = V::add(c, cc); d = V::add(d, dd); e = V::add(e, ee);
+	}
+
+	V::store(h[0], a); V::store(h[1], b); V::store(h[2], c); V::store(h[3], d); V::store(h[4], e);
+	V::done();
+}
+
+static const unsigned int K256[64] = {
+	0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+	0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+	0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+	0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+	0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+	0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+	0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2 };
+
+template<class V> static void sha256_blocks(unsigned int h[][MB_MAX_LANES], const unsigned char **ptr, size_t nblocks)
+{
+	typedef typename V::T T;
+	T s[8], v[8], w[16], t1, t2;
+	int i, j;
+
+	for (j = 0; j < 8; j++)
+		s[j] = V::load(h[j]);
+
+	for (size_t off = 0; off < nblocks * 64; off += 64) {
+		V::loadWords(w, ptr, off);
+		for (i = 0; i < 16; i++)
+			w[i] = V::bswap(w[i]);
+		for (j = 0; j < 8; j++)
+			v[j] = s[j];
+
+		for (i = 0; i < 64; i++) {
+			if (i >= 16) {
+				T x = w[(i - 15) & 15], y = w[(i - 2) & 15];
+				T s0 = V::xor3(V::template rol<25>(x), V::template rol<14>(x), V::template shr<3>(x));
+				T s1 = V::xor3(V::template rol<15>(y), V::template rol<13>(y), V::template shr<10>(y));
+				w[i & 15] = V::add(V::add(w[i & 15], s0), V::add(w[(i - 7) & 15], s1));
+			}
+			/* v[] = a,b,c,d,e,f,g,h */
+			t1 = V::add(V::add(v[7], V::xor3(V::template rol<26>(v[4]), V::template rol<21>(v[4]), V::template rol<7>(v[4]))),
+						V::add(V::ch(v[4], v[5], v[6]), V::add(V::set1(K256[i]), w[i & 15])));
+			t2 = V::add(V::xor3(V::template rol<30>(v[0]), V::template rol<19>(v[0]), V::template rol<10>(v[0])),
+						V::maj(v[0], v[1], v[2]));
+			v[7] = v[6]; v[6] = v[5]; v[5] = v[4]; v[4] = V::add(v[3], t1);
+			v[3] = v[2]; v[2] = v[1]; v[1] = v[0]; v[0] = V::add(t1, t2);
+		}
+
+		for (j = 0; j < 8; j++)
+			s[j] = V::add(s[j], v[j]);
+	}
+
+	for (j = 0; j < 8; j++)
+		V::store(h[j], s[j]);
+	V::done();
+}
+
+// //////////////////////////////////////////////////////////
+// dispatch
+
+static const unsigned int mb_iv[MB_NUM_HASHES][8] = {
+	{ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 },
+	{ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 },
+	{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 },
+};
+
+static const unsigned int mb_words[MB_NUM_HASHES] = { 4, 5, 8 };
+
+/* the block functions of a vector class beyond SSE2, compiled for its instruction sets */
+#define MB_KERNELS(V, features) \
+	CPU_KERNEL_TARGET(features) static void md5_blocks_##V(unsigned int h[][MB_MAX_LANES], const unsigned char **ptr, size_t nblocks) \
+	{ md5_blocks<V>(h, ptr, nblocks); } \
+	CPU_KERNEL_TARGET(features) static void sha1_blocks_##V(unsigned int h[][MB_MAX_LANES], const unsigned char **ptr, size_t nblocks) \
+	{ sha1_blocks<V>(h, ptr, nblocks); } \
+	CPU_KERNEL_TARGET(features) static void sha256_blocks_##V(unsigned int h[][MB_MAX_LANES], const unsigned char **ptr, size_t nblocks) \
+	{ sha256_blocks<V>(h, ptr, nblocks); }
+
+MB_KERNELS(VecAVX2, "avx2")
+MB_KERNELS(VecAVX512, "avx2,avx512f,avx512bw")
+
+static const mb_blocks_func mb_funcs[3][MB_NUM_HASHES] = {
+	{ md5_blocks<VecSSE2>, sha1_blocks<VecSSE2>, sha256_blocks<VecSSE2> },
+	{ md5_blocks_VecAVX2, sha1_blocks_VecAVX2, sha256_blocks_VecAVX2 },
+	{ md5_blocks_VecAVX512, sha1_blocks_VecAVX512, sha256_blocks_VecAVX512 },
+};
+
+static int mb_level = -1;
+
+/* fastest first, the index counts down from the last row of mb_funcs */
+static const CPU_KERNEL mb_kernels[] = {
+	{ "avx512",	CPU_AVX512F | CPU_AVX512BW,	NULL },
+	{ "avx2",	CPU_AVX2,					NULL },
+	{ "sse2",	0,							NULL },
+};
+
+/* 0: SSE2, 1: AVX2, 2: AVX-512F/BW */
+static int mb_select_level()
+{
+	return 2 - (int)cpu_select_kernel("mb_hash", mb_kernels, 3);
+}
+
+unsigned int MB_Lanes()
+{
+	if (mb_level < 0)
+		mb_level = mb_select_level();
+	return 4 << mb_level;
+}
+
+// //////////////////////////////////////////////////////////
+// scheduler
+
+/* per lane bookkeeping of MB_Hash */
+typedef struct {
+	size_t			job;			/* index into jobs */
+	size_t			blocks;			/* blocks left in the current part (message or padding) */
+	int				inPadding;
+	unsigned char	pad[2 * 64];	/* last partial block, 0x80, zeros and the bit length */
+} MB_LANE;
+
+void MB_Hash(int algo, MB_JOB *jobs, size_t count)
+{
+	const unsigned int lanes = MB_Lanes();
+	const mb_blocks_func blocks_func = mb_funcs[mb_level][algo];
+	MB_CTX ctx;
+	MB_LANE lane[MB_MAX_LANES];
+	int active[MB_MAX_LANES];
+	unsigned int l, i, nactive = 0;
+	size_t next = 0;
+
+	for (l = 0; l < lanes; l++)
+		active[l] = 0;
+
+	for (;;) {
+		/* refill idle lanes with the next messages */
+		for (l = 0; l < lanes && next < count; l++) {
+			if (active[l])
+				continue;
+
+			MB_JOB *job = &jobs[next];
+			size_t rest = job->len % 64;
+			unsigned long long bits = (unsigned long long)job->len << 3;
+
+			lane[l].job = next++;
+			lane[l].blocks = job->len / 64;
+			memset(lane[l].pad, 0, sizeof(lane[l].pad));
+			memcpy(lane[l].pad, job->data + job->len - rest, rest);
+			lane[l].pad[rest] = 0x80;
+			size_t padlen = rest + 9 <= 64 ? 64 : 128;
+			for (i = 0; i < 8; i++) {
+				if (algo == MB_HASH_MD5)
+					lane[l].pad[padlen - 8 + i] = (unsigned char)(bits >> (8 * i));
+				else
+					lane[l].pad[padlen - 1 - i] = (unsigned char)(bits >> (8 * i));
+			}
+			if (lane[l].blocks) {
+				lane[l].inPadding = 0;
+				ctx.ptr[l] = job->data;
+			} else {
+				lane[l].inPadding = 1;
+				lane[l].blocks = padlen / 64;
+				ctx.ptr[l] = lane[l].pad;
+			}
+			for (i = 0; i < mb_words[algo]; i++)
+				ctx.h[i][l] = mb_iv[algo][i];
+			active[l] = 1;
+			nactive++;
+		}
+
+		if (nactive == 0)
+			break;
+
+		/* run all lanes until the first one reaches the end of its part, idle lanes
+		   shadow an active one so they always read valid memory */
+		size_t n = (size_t)-1;
+		unsigned int firstActive = 0;
+		for (l = lanes; l-- > 0; ) {
+			if (active[l]) {
+				firstActive = l;
+				if (lane[l].blocks < n)
+					n = lane[l].blocks;
+			}
+		}
+		for (l = 0; l < lanes; l++) {
+			if (!active[l])
+				ctx.ptr[l] = ctx.ptr[firstActive];
+		}
+
+		blocks_func(ctx.h, ctx.ptr, n);
+
+		for (l = 0; l < lanes; l++) {
+			if (!active[l])
+				continue;
+			lane[l].blocks -= n;
+			ctx.ptr[l] += n * 64;
+			if (lane[l].blocks)
+				continue;
+			if (!lane[l].inPadding) {
+				MB_JOB *job = &jobs[lane[l].job];
+				lane[l].inPadding = 1;
+				lane[l].blocks = (job->len % 64) + 9 <= 64 ? 1 : 2;
+				ctx.ptr[l] = lane[l].pad;
+				continue;
+			}
+
+			/* message done, write the digest */
+			unsigned char *md = jobs[lane[l].job].digest;
+			for (i = 0; i < mb_words[algo]; i++) {
+				unsigned int x = ctx.h[i][l];
+				if (algo == MB_HASH_MD5) {
+					md[4 * i + 0] = (unsigned char)(x);
+					md[4 * i + 1] = (unsigned char)(x >> 8);
+					md[4 * i + 2] = (unsigned char)(x >> 16);
+					md[4 * i + 3] = (unsigned char)(x >> 24);
+				} else {
+					md[4 * i + 0] = (unsigned char)(x >> 24);
+					md[4 * i + 1] = (unsigned char)(x >> 16);
+					md[4 * i + 2] = (unsigned char)(x >> 8);
+					md[4 * i + 3] = (unsigned char)(x);
+				}
+			}
+			active[l] = 0;
+			nactive--;
+		}
+	}
+}
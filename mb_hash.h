@@ -0,0 +1,35 @@
+#ifndef HEADER_MB_HASH_H
+#define HEADER_MB_HASH_H
+
+#include <stddef.h>
+
+/* algorithms supported by the multi-buffer engine */
+#define MB_HASH_MD5		0
+#define MB_HASH_SHA1	1
+#define MB_HASH_SHA256	2
+#define MB_NUM_HASHES	3
+
+#define MB_MAX_LANES	16
+
+/* one message, hashed as a whole */
+typedef struct _MB_JOB {
+	const unsigned char	*data;		/* in:  message */
+	size_t				len;		/* in:  length of the message in bytes */
+	unsigned char		*digest;	/* out: MD5_DIGEST_LENGTH, SHA_DIGEST_LENGTH or SHA256_DIGEST_LENGTH bytes */
+} MB_JOB;
+
+/* Word sliced state of all lanes, the equivalent of MD5_CTX (A,B,C,D), SHA_CTX (h0..h4)
+   and SHA256_CTX (h[8]) with h[i][lane] holding word i of the message in that lane */
+typedef struct _MB_CTX {
+	unsigned int			h[8][MB_MAX_LANES];
+	const unsigned char		*ptr[MB_MAX_LANES];	/* next block of each lane */
+} MB_CTX;
+
+/* number of messages hashed in parallel on this CPU: 4 (SSE2), 8 (AVX2) or 16 (AVX-512) */
+unsigned int MB_Lanes();
+
+/* hashes all jobs with one algorithm, a lane that finishes its message is refilled
+   with the next job, so messages of different length keep all lanes busy */
+void MB_Hash(int algo, MB_JOB *jobs, size_t count);
+
+#endif
@@ -21,8 +21,11 @@
 
 #pragma once
 
-#include "utility.hpp"
+#include "Utility.hpp"
+// MD4_asm.asm is 32 bit MASM only, x64 and other compilers use the C++ transform
+#if defined(_MSC_VER) && !defined(_WIN64)
 #define HASHLIB_USE_ASM
+#endif
 
 class CMD4
 {
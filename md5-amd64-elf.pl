@@ -0,0 +1,57 @@
+#!/usr/bin/env perl
+#
+# Translates md5-ms-amd64-v2.asm (MASM, Windows x64 calling convention) to
+# GNU assembler source for ELF x86_64, so that the same kernel is used on
+# Linux. Only the constructs that file uses are handled:
+#
+#	perl md5-amd64-elf.pl md5-ms-amd64-v2.asm > md5-amd64-elf.s
+#
+# The Windows prologue expects ctx, ptr and the block count in rcx, rdx and
+# r8d; a short entry sequence moves the System V arguments (rdi, rsi, edx)
+# there, everything else is left as it is.
+
+use strict;
+use warnings;
+
+my $function;
+
+print "\t.intel_syntax noprefix\n";
+
+while (my $line = <>) {
+	$line =~ s/\r?\n$//;
+	$line =~ s/;.*$//;				# comments
+	$line =~ s/\s+$//;
+	next if $line eq '';
+
+	if ($line =~ /^\s*\.code$/) {
+		print "\t.text\n";
+	} elsif ($line =~ /^(\w+)\s+PROC$/) {
+		$function = $1;
+		print "\t.globl\t$function\n";
+		print "\t.type\t$function,\@function\n";
+		print "\t.p2align\t4\n";
+		print "$function:\n";
+		print "\tmov\tr8d,edx\n";
+		print "\tmov\trdx,rsi\n";
+		print "\tmov\trcx,rdi\n";
+	} elsif ($line =~ /^(\w+)\s+ENDP$/) {
+		print "\t.size\t$1,.-$1\n";
+	} elsif ($line =~ /^\s*END$/) {
+		last;
+	} elsif ($line =~ /^\s*align\s+(\d+)$/) {
+		print "\t.balign\t$1\n";
+	} else {
+		$line =~ s/\b(lab\d+)\b/.L$1/g;
+		# hexadecimal constants: 0d76aa478h -> 0xd76aa478
+		$line =~ s/\b([0-9][0-9a-fA-F]*)h\b/0x$1/g;
+		# displacement in front of the brackets: DWORD PTR 4[r12] -> DWORD PTR [r12+4]
+		$line =~ s/PTR\s+([^\[\s][^\[]*?)\s*\[\s*([^\]]*?)\s*\]/PTR [$2+$1]/g;
+		$line =~ s/\s*,\s*/,/g;
+		$line =~ s/\s*\+\s*/+/g;
+		$line =~ s/\s*\*\s*/*/g;
+		print "$line\n";
+	}
+}
+
+# no executable stack
+print "\t.section\t.note.GNU-stack,\"\",\@progbits\n";
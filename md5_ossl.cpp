@@ -1,5 +1,5 @@
 #include <stdio.h>
-#include "globals.h"
+#include <string.h>
 #include "md5_ossl.h"
 
 #define MD5_LONG_LOG2 2 /*^=log2(sizeof(MD5_LONG)) = log2(4) = 2;  default to 32 bits */
@@ -67,8 +67,8 @@ void md5_block_asm_host_order(MD5_CTX *c, const void *p, int num);
 void MD5_Update (MD5_CTX *c, const BYTE *data, unsigned long len)
 {
 	//const unsigned char *data=data_;
-	register MD5_LONG * p;
-	register unsigned long l;
+	MD5_LONG * p;
+	unsigned long l;
 	int sw,sc,ew,ec;
 
 	if (len==0) return;
@@ -162,9 +162,9 @@ void MD5_Transform (MD5_CTX *c, const unsigned char *data)
 
 void MD5_Final (unsigned char *md, MD5_CTX *c)
 {
-	register MD5_LONG *p;
-	register unsigned long l;
-	register int i,j;
+	MD5_LONG *p;
+	unsigned long l;
+	int i,j;
 	static const unsigned char end[4]={0x80,0x00,0x00,0x00};
 	const unsigned char *cp=end;
 
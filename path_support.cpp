@@ -473,6 +473,16 @@ BOOL GetHashFromFilename(FILEINFO *fileInfo)
                     break;
                 }
             }
+            // xxh128 has the same size as md5, prefer it only if it is calculated by default and md5 is not
+            if(bFound && iHashIndex == HASH_TYPE_MD5 && g_program_options.bCalcPerDefault[HASH_TYPE_XXH128] &&
+               !g_program_options.bCalcPerDefault[HASH_TYPE_MD5])
+                iHashIndex = HASH_TYPE_XXH128;
+            // no other hash has the size of crc64, only look for it if it is calculated by default
+            if(!bFound && g_program_options.bCalcPerDefault[HASH_TYPE_CRC64] &&
+               uiFoundHexSymbols == g_hash_lengths[HASH_TYPE_CRC64] * 2) {
+                bFound = TRUE;
+                iHashIndex = HASH_TYPE_CRC64;
+            }
         }
 	}
 	while((iIndex > 0) && (!bFound));
@@ -37,6 +37,10 @@
 #define IDC_ALWAYS_USE_NEW_WINDOW       1030
 #define IDC_ENABLE_UNBUFFERED_READS     1031
 #define IDC_CLOSE_AFTER_SHELLEXT_ACTION 1032
+#define IDC_HASH_LARGE_FILES_IN_SEGMENTS 1033
+#define IDC_EDIT_READ_BUFFER_COUNT      1034
+#define IDC_EDIT_CONCURRENT_FILES       1035
+#define IDC_BTN_CPU_KERNELS             1036
 #define IDC_RADIO_ONE_PER_FILE          1040
 #define IDC_CHECK_HIDE_VERIFIED         1040
 #define IDC_RADIO_ONE_PER_DIR           1041
@@ -89,6 +93,10 @@
 #define IDC_CHECK_DISPLAY_CRCC_IN_LIST  4009
 #define IDC_CHECK_DISPLAY_BLAKE2SP_IN_LIST 4010
 #define IDC_CHECK_DISPLAY_BLAKE3_IN_LIST 4011
+#define IDC_CHECK_DISPLAY_BLAKE2BP_IN_LIST 4012
+#define IDC_CHECK_DISPLAY_XXH128_IN_LIST 4013
+#define IDC_CHECK_DISPLAY_K12_IN_LIST   4014
+#define IDC_CHECK_DISPLAY_CRC64_IN_LIST 4015
 #define IDC_CHECK_CRC_DEFAULT           5000
 #define IDC_CHECK_MD5_DEFAULT           5001
 #define IDC_CHECK_ED2K_DEFAULT          5002
@@ -101,6 +109,10 @@
 #define IDC_CHECK_CRCC_DEFAULT          5009
 #define IDC_CHECK_BLAKE2SP_DEFAULT      5010
 #define IDC_CHECK_BLAKE3_DEFAULT        5011
+#define IDC_CHECK_BLAKE2BP_DEFAULT      5012
+#define IDC_CHECK_XXH128_DEFAULT        5013
+#define IDC_CHECK_K12_DEFAULT           5014
+#define IDC_CHECK_CRC64_DEFAULT         5015
 
 // Next default values for new objects
 // 
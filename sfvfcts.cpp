@@ -89,12 +89,12 @@ DWORD WriteHashLine(CONST HANDLE hFile, CONST TCHAR szFilename[MAX_PATH_EX], CON
 		    ReplaceChar(szFilenameTemp, MAX_PATH_EX, TEXT('\\'), TEXT('/'));
     }
 
-    if(uiMode == MODE_SFV || uiMode == MODE_CRC32C)
+    if(uiMode == MODE_SFV || uiMode == MODE_CRC32C || uiMode == MODE_CRC64)
         StringCchPrintf(szLine, MAX_LINE_LENGTH, TEXT("%s %s%s"), szFilenameTemp,
 		    szHashResult, g_program_options.bCreateUnixStyle ? TEXT("\n") : TEXT("\r\n"));
 	else
 	{
-		const TCHAR *psz_format = uiMode == MODE_BLAKE3 ? TEXT("%s  %s%s") : TEXT("%s *%s%s");
+		const TCHAR *psz_format = (uiMode == MODE_BLAKE3 || uiMode == MODE_XXH128) ? TEXT("%s  %s%s") : TEXT("%s *%s%s");
 		StringCchPrintf(szLine, MAX_LINE_LENGTH, psz_format, szHashResult,
 			szFilenameTemp, g_program_options.bCreateUnixStyle ? TEXT("\n") : TEXT("\r\n"));
 	}
@@ -227,6 +227,7 @@ BOOL EnterHashMode(lFILEINFO *fileList, UINT uiMode)
         switch(uiMode) {
             case MODE_SFV:
             case MODE_CRC32C:
+            case MODE_CRC64:
                 bWasAbsolute = InterpretSFVLine(szLine, uiStringLength, fileList, uiMode);
                 break;
             case MODE_MD5:
@@ -238,6 +239,9 @@ BOOL EnterHashMode(lFILEINFO *fileList, UINT uiMode)
             case MODE_SHA3_512:
             case MODE_BLAKE2SP:
 			case MODE_BLAKE3:
+			case MODE_BLAKE2BP:
+			case MODE_XXH128:
+			case MODE_K12:
                 bWasAbsolute = InterpretMDSHALine(szLine, uiStringLength, uiMode, fileList);
                 break;
             case MODE_BSD:
@@ -266,34 +270,41 @@ BOOL EnterHashMode(lFILEINFO *fileList, UINT uiMode)
 
 BOOL InterpretSFVLine(TCHAR *szLine, UINT uiStringLength, lFILEINFO *fileList, UINT uiHashMode)
 {
+    UINT    uiCrcLengthChars = g_hash_lengths[uiHashMode] * 2;
     BOOL	bCrcOK, bWasAbsolute = FALSE;
 
     FILEINFO fileinfoTmp = {0};
     fileinfoTmp.parentList=fileList;
 
-    if(uiStringLength < 9)
+    if(uiStringLength < uiCrcLengthChars + 1)
         return FALSE;
 
     //delete trailing spaces
-	while( (szLine[uiStringLength - 1] == TEXT(' ')) && (uiStringLength > 8) ){
+	while( (szLine[uiStringLength - 1] == TEXT(' ')) && (uiStringLength > uiCrcLengthChars) ){
 		szLine[uiStringLength - 1] = NULL;
 		uiStringLength--;
 	}
 
 	if( (szLine[0] != TEXT(';')) && (szLine[0] != TEXT('\0')) ){
 		bCrcOK = TRUE;
-		for(int i=1; i <= 8; ++i)
+		for(UINT i=1; i <= uiCrcLengthChars; ++i)
 			if(! IsLegalHexSymbol(szLine[uiStringLength-i]))
 				bCrcOK = FALSE;
 		if(bCrcOK){
+            TCHAR *szCrc = szLine + uiStringLength - uiCrcLengthChars;
             fileinfoTmp.hashInfo[uiHashMode].dwFound = HASH_FOUND_FILE;
-            fileinfoTmp.hashInfo[uiHashMode].f.dwCrc32Found = HexToDword(szLine + uiStringLength - 8, 8);
+            if(uiHashMode == MODE_CRC64) {
+                // crc64 is kept as bytes in display order
+                for(UINT i=0; i < g_hash_lengths[uiHashMode]; ++i)
+                    fileinfoTmp.hashInfo[uiHashMode].f.abCrc64Found[i] = (BYTE)HexToDword(szCrc + i * 2, 2);
+            } else
+                fileinfoTmp.hashInfo[uiHashMode].f.dwCrc32Found = HexToDword(szCrc, 8);
 			fileinfoTmp.dwError = NOERROR;
 		}
 		else
 			fileinfoTmp.dwError = APPL_ERROR_ILLEGAL_CRC;
 
-		uiStringLength -= 8;
+		uiStringLength -= uiCrcLengthChars;
 		szLine[uiStringLength] = NULL; // keep only the filename
 		//delete trailing spaces
 		while( (szLine[uiStringLength - 1] == TEXT(' ')) && (uiStringLength > 0) ){
@@ -370,7 +381,10 @@ BOOL InterpretBSDLine(TCHAR *szLine, UINT uiStringLength, lFILEINFO *fileList)
         return FALSE;
 
     for(int i=0; i < NUM_HASH_TYPES; i++) {
-        if(!_tcsncmp(szLine, g_hash_names[i], lstrlen(g_hash_names[i]))) {
+        int iNameLength = lstrlen(g_hash_names[i]);
+        // the name has to be followed by the filename, otherwise CRC32 would match CRC32C lines
+        if(!_tcsncmp(szLine, g_hash_names[i], iNameLength) &&
+           (szLine[iNameLength] == TEXT(' ') || szLine[iNameLength] == TEXT('('))) {
             iHashIndex = i;
             break;
         }
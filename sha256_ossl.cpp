@@ -1,5 +1,11 @@
-#include "globals.h"
+#include <string.h>
 #include "sha256_ossl.h"
+#include "cpu_features.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 
 #ifdef  __cplusplus
@@ -10,6 +16,193 @@ void sha256_block_data_order (SHA256_CTX *ctx, const void *in, size_t num);
 }
 #endif
 
+static const SHA_LONG K256[64] = {
+	0x428a2f98UL,0x71374491UL,0xb5c0fbcfUL,0xe9b5dba5UL,
+	0x3956c25bUL,0x59f111f1UL,0x923f82a4UL,0xab1c5ed5UL,
+	0xd807aa98UL,0x12835b01UL,0x243185beUL,0x550c7dc3UL,
+	0x72be5d74UL,0x80deb1feUL,0x9bdc06a7UL,0xc19bf174UL,
+	0xe49b69c1UL,0xefbe4786UL,0x0fc19dc6UL,0x240ca1ccUL,
+	0x2de92c6fUL,0x4a7484aaUL,0x5cb0a9dcUL,0x76f988daUL,
+	0x983e5152UL,0xa831c66dUL,0xb00327c8UL,0xbf597fc7UL,
+	0xc6e00bf3UL,0xd5a79147UL,0x06ca6351UL,0x14292967UL,
+	0x27b70a85UL,0x2e1b2138UL,0x4d2c6dfcUL,0x53380d13UL,
+	0x650a7354UL,0x766a0abbUL,0x81c2c92eUL,0x92722c85UL,
+	0xa2bfe8a1UL,0xa81a664bUL,0xc24b8b70UL,0xc76c51a3UL,
+	0xd192e819UL,0xd6990624UL,0xf40e3585UL,0x106aa070UL,
+	0x19a4c116UL,0x1e376c08UL,0x2748774cUL,0x34b0bcb5UL,
+	0x391c0cb3UL,0x4ed8aa4aUL,0x5b9cca4fUL,0x682e6ff3UL,
+	0x748f82eeUL,0x78a5636fUL,0x84c87814UL,0x8cc70208UL,
+	0x90befffaUL,0xa4506cebUL,0xbef9a3f7UL,0xc67178f2UL };
+
+/* SHA-256 with the SHA extensions (sha256rnds2/sha256msg1/sha256msg2) */
+CPU_TARGET("sse4.1,sha")
+static void sha256_block_data_order_shaext (SHA256_CTX *ctx, const void *in, size_t num)
+{
+	const unsigned char *data = (const unsigned char *)in;
+	const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i STATE0, STATE1, ABEF_SAVE, CDGH_SAVE, TMP, MSG;
+	__m128i MSG0, MSG1, MSG2, MSG3;
+
+	/* the rounds instruction wants the state as ABEF/CDGH */
+	TMP = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&ctx->h[0]), 0xB1);
+	STATE1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&ctx->h[4]), 0x1B);
+	STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);
+
+	while (num--)
+		{
+		ABEF_SAVE = STATE0;
+		CDGH_SAVE = STATE1;
+
+		/* rounds 0-3 */
+		MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 0)), MASK);
+		MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i *)(K256 + 0)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+
+		/* rounds 4-7 */
+		MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), MASK);
+		MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i *)(K256 + 4)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+		/* rounds 8-11 */
+		MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), MASK);
+		MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i *)(K256 + 8)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+		/* rounds 12-15 */
+		MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), MASK);
+		MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i *)(K256 + 12)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG0 = _mm_add_epi32(MSG0, _mm_alignr_epi8(MSG3, MSG2, 4));
+		MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+		/* rounds 16-19 */
+		MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i *)(K256 + 16)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG1 = _mm_add_epi32(MSG1, _mm_alignr_epi8(MSG0, MSG3, 4));
+		MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+		/* rounds 20-23 */
+		MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i *)(K256 + 20)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG2 = _mm_add_epi32(MSG2, _mm_alignr_epi8(MSG1, MSG0, 4));
+		MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+		/* rounds 24-27 */
+		MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i *)(K256 + 24)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG3 = _mm_add_epi32(MSG3, _mm_alignr_epi8(MSG2, MSG1, 4));
+		MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+		/* rounds 28-31 */
+		MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i *)(K256 + 28)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG0 = _mm_add_epi32(MSG0, _mm_alignr_epi8(MSG3, MSG2, 4));
+		MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+		/* rounds 32-35 */
+		MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i *)(K256 + 32)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG1 = _mm_add_epi32(MSG1, _mm_alignr_epi8(MSG0, MSG3, 4));
+		MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+		/* rounds 36-39 */
+		MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i *)(K256 + 36)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG2 = _mm_add_epi32(MSG2, _mm_alignr_epi8(MSG1, MSG0, 4));
+		MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG0 = _mm_sha256msg1_epu32(MSG0, MSG1);
+
+		/* rounds 40-43 */
+		MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i *)(K256 + 40)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG3 = _mm_add_epi32(MSG3, _mm_alignr_epi8(MSG2, MSG1, 4));
+		MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG1 = _mm_sha256msg1_epu32(MSG1, MSG2);
+
+		/* rounds 44-47 */
+		MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i *)(K256 + 44)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG0 = _mm_add_epi32(MSG0, _mm_alignr_epi8(MSG3, MSG2, 4));
+		MSG0 = _mm_sha256msg2_epu32(MSG0, MSG3);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG2 = _mm_sha256msg1_epu32(MSG2, MSG3);
+
+		/* rounds 48-51 */
+		MSG = _mm_add_epi32(MSG0, _mm_loadu_si128((const __m128i *)(K256 + 48)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG1 = _mm_add_epi32(MSG1, _mm_alignr_epi8(MSG0, MSG3, 4));
+		MSG1 = _mm_sha256msg2_epu32(MSG1, MSG0);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		MSG3 = _mm_sha256msg1_epu32(MSG3, MSG0);
+
+		/* rounds 52-55 */
+		MSG = _mm_add_epi32(MSG1, _mm_loadu_si128((const __m128i *)(K256 + 52)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG2 = _mm_add_epi32(MSG2, _mm_alignr_epi8(MSG1, MSG0, 4));
+		MSG2 = _mm_sha256msg2_epu32(MSG2, MSG1);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+
+		/* rounds 56-59 */
+		MSG = _mm_add_epi32(MSG2, _mm_loadu_si128((const __m128i *)(K256 + 56)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		MSG3 = _mm_add_epi32(MSG3, _mm_alignr_epi8(MSG2, MSG1, 4));
+		MSG3 = _mm_sha256msg2_epu32(MSG3, MSG2);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+
+		/* rounds 60-63 */
+		MSG = _mm_add_epi32(MSG3, _mm_loadu_si128((const __m128i *)(K256 + 60)));
+		STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);
+		STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E));
+		STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+		STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+
+		data += SHA256_CBLOCK;
+		}
+
+	TMP = _mm_shuffle_epi32(STATE0, 0x1B);
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);
+	_mm_storeu_si128((__m128i *)&ctx->h[0], _mm_blend_epi16(TMP, STATE1, 0xF0));
+	_mm_storeu_si128((__m128i *)&ctx->h[4], _mm_alignr_epi8(STATE1, TMP, 8));
+}
+
+/* SHA extensions, the shuffles need SSSE3/SSE4.1, or the assembler version */
+static const CPU_KERNEL sha256_kernels[] = {
+	{ "shaext",	CPU_SHA | CPU_SSSE3 | CPU_SSE41,	(const void *)sha256_block_data_order_shaext },
+	{ "ossl",	0,									(const void *)sha256_block_data_order },
+};
+
+static void sha256_block_resolve (SHA256_CTX *ctx, const void *in, size_t num);
+
+/* block function used by SHA256_Update/SHA256_Final, picked on first use */
+static void (*sha256_block) (SHA256_CTX *ctx, const void *in, size_t num) = sha256_block_resolve;
+
+static void sha256_block_resolve (SHA256_CTX *ctx, const void *in, size_t num)
+{
+	sha256_block = (void (*) (SHA256_CTX *, const void *, size_t))
+		sha256_kernels[cpu_select_kernel("sha256", sha256_kernels, sizeof(sha256_kernels) / sizeof(sha256_kernels[0]))].impl;
+	sha256_block (ctx,in,num);
+}
+
 #define HOST_c2l(c,l)	(l =(((unsigned long)(*((c)++)))<<24),		\
 			 l|=(((unsigned long)(*((c)++)))<<16),		\
 			 l|=(((unsigned long)(*((c)++)))<< 8),		\
@@ -68,7 +261,7 @@ int SHA256_Update(SHA256_CTX *c, const void *data_, size_t len)
 		if (len >= SHA256_CBLOCK || len+n >= SHA256_CBLOCK)
 			{
 			memcpy (p+n,data,SHA256_CBLOCK-n);
-			sha256_block_data_order (c,p,1);
+			sha256_block (c,p,1);
 			n      = SHA256_CBLOCK-n;
 			data  += n;
 			len   -= n;
@@ -86,7 +279,7 @@ int SHA256_Update(SHA256_CTX *c, const void *data_, size_t len)
 	n = len/SHA256_CBLOCK;
 	if (n > 0)
 		{
-		sha256_block_data_order (c,data,n);
+		sha256_block (c,data,n);
 		n    *= SHA256_CBLOCK;
 		data += n;
 		len  -= n;
@@ -103,7 +296,7 @@ int SHA256_Update(SHA256_CTX *c, const void *data_, size_t len)
 
 void SHA256_Transform (SHA256_CTX *c, const unsigned char *data)
 {
-	sha256_block_data_order (c,data,1);
+	sha256_block (c,data,1);
 }
 
 int SHA256_Final (unsigned char *md, SHA256_CTX *c)
@@ -118,7 +311,7 @@ int SHA256_Final (unsigned char *md, SHA256_CTX *c)
 		{
 		memset (p+n,0,SHA256_CBLOCK-n);
 		n=0;
-		sha256_block_data_order (c,p,1);
+		sha256_block (c,p,1);
 		}
 	memset (p+n,0,SHA256_CBLOCK-8-n);
 
@@ -126,7 +319,7 @@ int SHA256_Final (unsigned char *md, SHA256_CTX *c)
 	(void)HOST_l2c(c->Nh,p);
 	(void)HOST_l2c(c->Nl,p);
 	p -= SHA256_CBLOCK;
-	sha256_block_data_order (c,p,1);
+	sha256_block (c,p,1);
 	c->num=0;
 	memset (p,0,SHA256_CBLOCK);
 
@@ -0,0 +1,365 @@
+/*
+Implementation by Ronny Van Keer, hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our website:
+https://keccak.team/
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+
+---
+
+Leaf chunks are hashed by KangarooTwelve_ProcessLeaves() into an array of chaining
+values, which is then absorbed by the final node. Runs of 8 or 4 leaves use the
+times8 (AVX-512) or times4 (AVX2) permutations, KangarooTwelve_UpdateMT() additionally
+splits large runs over threads of the system thread pool.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#include "KangarooTwelve.h"
+#include "KeccakHashBatch.h"
+#include "KeccakP-1600-times4-SnP.h"
+#include "KeccakP-1600-times8-SnP.h"
+
+#define chunkSize       K12_chunkSize
+#define laneSize        8
+#define suffixLeaf      0x0B /* '110': message hop, simple padding, inner node */
+
+#define security        128
+#define capacity        (2*security)
+#define capacityInBytes (capacity/8)
+#define capacityInLanes (capacityInBytes/laneSize)
+#define rate            (1600-capacity)
+#define rateInBytes     (rate/8)
+#define rateInLanes     (rateInBytes/laneSize)
+
+/* number of leaves whose chaining values are collected before they are absorbed */
+#define K12_leavesPerRun        64
+/* KangarooTwelve_UpdateMT() gives each thread at least this many leaves (256 KiB) */
+#define K12_minLeavesPerThread  32
+#define K12_maxThreads          64
+
+static unsigned int right_encode( unsigned char * encbuf, size_t value )
+{
+    unsigned int n, i;
+    size_t v;
+
+    for ( v = value, n = 0; v && (n < sizeof(size_t)); ++n, v >>= 8 )
+        ; /* empty */
+    for ( i = 1; i <= n; ++i )
+        encbuf[i-1] = (unsigned char)(value >> (8 * (n-i)));
+    encbuf[n] = (unsigned char)n;
+    return n + 1;
+}
+
+#define ProcessLeavesParallel( Parallellism ) \
+    while ( leafCount >= Parallellism ) { \
+        ALIGN(KeccakP1600times##Parallellism##_statesAlignment) unsigned char states[KeccakP1600times##Parallellism##_statesSizeInBytes]; \
+        unsigned int localBlockLen = chunkSize; \
+        const unsigned char * localInput = input; \
+        unsigned int i; \
+        unsigned int fastLoopOffset; \
+        \
+        KeccakP1600times##Parallellism##_StaticInitialize(); \
+        KeccakP1600times##Parallellism##_InitializeAll(states); \
+        fastLoopOffset = (unsigned int)KeccakP1600times##Parallellism##_12rounds_FastLoop_Absorb(states, rateInLanes, chunkSize / laneSize, rateInLanes, localInput, Parallellism * chunkSize); \
+        localBlockLen -= fastLoopOffset; \
+        localInput += fastLoopOffset; \
+        for ( i = 0; i < Parallellism; ++i, localInput += chunkSize ) { \
+            KeccakP1600times##Parallellism##_AddBytes(states, i, localInput, 0, localBlockLen); \
+            KeccakP1600times##Parallellism##_AddByte(states, i, suffixLeaf, localBlockLen); \
+            KeccakP1600times##Parallellism##_AddByte(states, i, 0x80, rateInBytes-1); \
+        } \
+        KeccakP1600times##Parallellism##_PermuteAll_12rounds(states); \
+        KeccakP1600times##Parallellism##_ExtractLanesAll(states, output, capacityInLanes, capacityInLanes ); \
+        input += Parallellism * chunkSize; \
+        output += Parallellism * capacityInBytes; \
+        leafCount -= Parallellism; \
+    }
+
+/* Hashes leafCount whole leaf chunks and stores their chaining values one after the other */
+static void KangarooTwelve_ProcessLeaves(const unsigned char *input, size_t leafCount, unsigned char *output)
+{
+    unsigned int parallelism = Keccak_HashBatchParallelism();
+
+    if ( parallelism >= 8 ) {
+        ProcessLeavesParallel( 8 )
+    }
+    if ( parallelism >= 4 ) {
+        ProcessLeavesParallel( 4 )
+    }
+    while ( leafCount > 0 ) {
+        KeccakWidth1600_12rounds_SpongeInstance leafNode;
+
+        KeccakWidth1600_12rounds_SpongeInitialize(&leafNode, rate, capacity);
+        KeccakWidth1600_12rounds_SpongeAbsorb(&leafNode, input, chunkSize);
+        KeccakWidth1600_12rounds_SpongeAbsorbLastFewBits(&leafNode, suffixLeaf);
+        KeccakWidth1600_12rounds_SpongeSqueeze(&leafNode, output, capacityInBytes);
+        input += chunkSize;
+        output += capacityInBytes;
+        --leafCount;
+    }
+}
+
+#if defined(_WIN32)
+typedef struct {
+    const unsigned char *input;
+    size_t leafCount;
+    unsigned char *output;
+    HANDLE done;
+} KangarooTwelve_LeafJob;
+
+static DWORD WINAPI KangarooTwelve_LeafJobRun(LPVOID param)
+{
+    KangarooTwelve_LeafJob *job = (KangarooTwelve_LeafJob *)param;
+
+    KangarooTwelve_ProcessLeaves(job->input, job->leafCount, job->output);
+    SetEvent(job->done);
+    return 0;
+}
+
+/* Same as KangarooTwelve_ProcessLeaves(), the leaves are split into contiguous ranges,
+   all but the first one are queued to the thread pool */
+static void KangarooTwelve_ProcessLeavesMT(const unsigned char *input, size_t leafCount, unsigned char *output)
+{
+    static DWORD dwNumberOfProcessors = 0;
+    KangarooTwelve_LeafJob jobs[K12_maxThreads];
+    size_t jobCount, leavesPerJob, i;
+
+    if ( dwNumberOfProcessors == 0 ) {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        dwNumberOfProcessors = si.dwNumberOfProcessors;
+    }
+
+    jobCount = leafCount / K12_minLeavesPerThread;
+    if ( jobCount > dwNumberOfProcessors )
+        jobCount = dwNumberOfProcessors;
+    if ( jobCount > K12_maxThreads )
+        jobCount = K12_maxThreads;
+    if ( jobCount < 2 ) {
+        KangarooTwelve_ProcessLeaves(input, leafCount, output);
+        return;
+    }
+
+    /* multiple of 8, so that only the last range has leaves left for the narrower permutations */
+    leavesPerJob = ((leafCount + jobCount - 1) / jobCount + 7) & ~(size_t)7;
+
+    for ( i = 1; i < jobCount; ++i ) {
+        KangarooTwelve_LeafJob *job = &jobs[i];
+        size_t first = i * leavesPerJob;
+
+        job->done = NULL;
+        if ( first >= leafCount )
+            continue;
+        job->input = input + first * chunkSize;
+        job->leafCount = (leafCount - first < leavesPerJob) ? leafCount - first : leavesPerJob;
+        job->output = output + first * capacityInBytes;
+        job->done = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if ( (job->done == NULL) || !QueueUserWorkItem(KangarooTwelve_LeafJobRun, job, WT_EXECUTELONGFUNCTION) ) {
+            /* no worker available, hash the range on this thread */
+            if ( job->done != NULL )
+                CloseHandle(job->done);
+            job->done = NULL;
+            KangarooTwelve_ProcessLeaves(job->input, job->leafCount, job->output);
+        }
+    }
+
+    KangarooTwelve_ProcessLeaves(input, (leafCount < leavesPerJob) ? leafCount : leavesPerJob, output);
+
+    for ( i = 1; i < jobCount; ++i ) {
+        if ( jobs[i].done != NULL ) {
+            WaitForSingleObject(jobs[i].done, INFINITE);
+            CloseHandle(jobs[i].done);
+        }
+    }
+}
+#else
+/* no thread pool outside of Windows, the leaves are hashed on the calling thread */
+static void KangarooTwelve_ProcessLeavesMT(const unsigned char *input, size_t leafCount, unsigned char *output)
+{
+    KangarooTwelve_ProcessLeaves(input, leafCount, output);
+}
+#endif
+
+/* Finishes the leaf in the queue node and absorbs its chaining value into the final node */
+static int KangarooTwelve_FinishQueueNode(KangarooTwelve_Instance *ktInstance)
+{
+    unsigned char intermediate[capacityInBytes];
+
+    ktInstance->queueAbsorbedLen = 0;
+    ++ktInstance->blockNumber;
+    if (KeccakWidth1600_12rounds_SpongeAbsorbLastFewBits(&ktInstance->queueNode, suffixLeaf) != 0)
+        return 1;
+    if (KeccakWidth1600_12rounds_SpongeSqueeze(&ktInstance->queueNode, intermediate, capacityInBytes) != 0)
+        return 1;
+    return KeccakWidth1600_12rounds_SpongeAbsorb(&ktInstance->finalNode, intermediate, capacityInBytes);
+}
+
+int KangarooTwelve_Initialize(KangarooTwelve_Instance *ktInstance, size_t outputByteLen)
+{
+    ktInstance->fixedOutputLength = outputByteLen;
+    ktInstance->queueAbsorbedLen = 0;
+    ktInstance->blockNumber = 0;
+    ktInstance->phase = ABSORBING;
+    return KeccakWidth1600_12rounds_SpongeInitialize(&ktInstance->finalNode, rate, capacity);
+}
+
+static int KangarooTwelve_UpdateInternal(KangarooTwelve_Instance *ktInstance, const unsigned char *input, size_t inputByteLen, int useMT)
+{
+    if (ktInstance->phase != ABSORBING)
+        return 1;
+
+    if ( ktInstance->blockNumber == 0 ) {
+        /* First block, absorb in final node */
+        unsigned int len = (inputByteLen < (chunkSize - ktInstance->queueAbsorbedLen)) ? (unsigned int)inputByteLen : (chunkSize - ktInstance->queueAbsorbedLen);
+        if (KeccakWidth1600_12rounds_SpongeAbsorb(&ktInstance->finalNode, input, len) != 0)
+            return 1;
+        input += len;
+        inputByteLen -= len;
+        ktInstance->queueAbsorbedLen += len;
+        if ( (ktInstance->queueAbsorbedLen == chunkSize) && (inputByteLen != 0) ) {
+            /* First block complete and more input data available, finalize it */
+            const unsigned char padding = 0x03; /* '110^6': message hop, simple padding */
+            ktInstance->queueAbsorbedLen = 0;
+            ktInstance->blockNumber = 1;
+            if (KeccakWidth1600_12rounds_SpongeAbsorb(&ktInstance->finalNode, &padding, 1) != 0)
+                return 1;
+            ktInstance->finalNode.byteIOIndex = (ktInstance->finalNode.byteIOIndex + 7) & ~7; /* Zero padding up to 64 bits */
+        }
+    }
+    else if ( ktInstance->queueAbsorbedLen != 0 ) {
+        /* There is data in the queue, absorb further in queue until block complete */
+        unsigned int len = (inputByteLen < (chunkSize - ktInstance->queueAbsorbedLen)) ? (unsigned int)inputByteLen : (chunkSize - ktInstance->queueAbsorbedLen);
+        if (KeccakWidth1600_12rounds_SpongeAbsorb(&ktInstance->queueNode, input, len) != 0)
+            return 1;
+        input += len;
+        inputByteLen -= len;
+        ktInstance->queueAbsorbedLen += len;
+        if ( ktInstance->queueAbsorbedLen == chunkSize ) {
+            if (KangarooTwelve_FinishQueueNode(ktInstance) != 0)
+                return 1;
+        }
+    }
+
+    /* From here on the queue is empty (or all input is consumed), whole chunks are leaves */
+    if ( useMT && (inputByteLen >= (size_t)2 * K12_minLeavesPerThread * chunkSize) ) {
+        size_t leafCount = inputByteLen / chunkSize;
+        unsigned char *intermediate = (unsigned char *)malloc(leafCount * capacityInBytes);
+
+        if ( intermediate != NULL ) {
+            int result;
+
+            KangarooTwelve_ProcessLeavesMT(input, leafCount, intermediate);
+            result = KeccakWidth1600_12rounds_SpongeAbsorb(&ktInstance->finalNode, intermediate, leafCount * capacityInBytes);
+            free(intermediate);
+            if (result != 0)
+                return 1;
+            input += leafCount * chunkSize;
+            inputByteLen -= leafCount * chunkSize;
+            ktInstance->blockNumber += leafCount;
+        }
+    }
+
+    while ( inputByteLen >= chunkSize ) {
+        unsigned char intermediate[K12_leavesPerRun * capacityInBytes];
+        size_t leafCount = inputByteLen / chunkSize;
+
+        if ( leafCount > K12_leavesPerRun )
+            leafCount = K12_leavesPerRun;
+        KangarooTwelve_ProcessLeaves(input, leafCount, intermediate);
+        if (KeccakWidth1600_12rounds_SpongeAbsorb(&ktInstance->finalNode, intermediate, leafCount * capacityInBytes) != 0)
+            return 1;
+        input += leafCount * chunkSize;
+        inputByteLen -= leafCount * chunkSize;
+        ktInstance->blockNumber += leafCount;
+    }
+
+    if ( inputByteLen > 0 ) {
+        /* Incomplete leaf, keep it in the queue node */
+        if (KeccakWidth1600_12rounds_SpongeInitialize(&ktInstance->queueNode, rate, capacity) != 0)
+            return 1;
+        if (KeccakWidth1600_12rounds_SpongeAbsorb(&ktInstance->queueNode, input, inputByteLen) != 0)
+            return 1;
+        ktInstance->queueAbsorbedLen = (unsigned int)inputByteLen;
+    }
+    return 0;
+}
+
+int KangarooTwelve_Update(KangarooTwelve_Instance *ktInstance, const unsigned char *input, size_t inputByteLen)
+{
+    return KangarooTwelve_UpdateInternal(ktInstance, input, inputByteLen, 0);
+}
+
+int KangarooTwelve_UpdateMT(KangarooTwelve_Instance *ktInstance, const unsigned char *input, size_t inputByteLen)
+{
+    return KangarooTwelve_UpdateInternal(ktInstance, input, inputByteLen, 1);
+}
+
+int KangarooTwelve_Final(KangarooTwelve_Instance *ktInstance, unsigned char * output, const unsigned char * customization, size_t customByteLen)
+{
+    unsigned char encbuf[sizeof(size_t)+1+2];
+    unsigned char padding;
+
+    if (ktInstance->phase != ABSORBING)
+        return 1;
+
+    /* Absorb customization | right_encode(customByteLen) */
+    if ((customByteLen != 0) && (KangarooTwelve_Update(ktInstance, customization, customByteLen) != 0))
+        return 1;
+    if (KangarooTwelve_Update(ktInstance, encbuf, right_encode(encbuf, customByteLen)) != 0)
+        return 1;
+
+    if ( ktInstance->blockNumber == 0 ) {
+        /* Non complete first block in final node, pad it */
+        padding = 0x07; /*  '11': message hop, final node */
+    }
+    else {
+        unsigned int n;
+
+        if ( ktInstance->queueAbsorbedLen != 0 ) {
+            /* There is data in the queue node */
+            if (KangarooTwelve_FinishQueueNode(ktInstance) != 0)
+                return 1;
+        }
+        --ktInstance->blockNumber; /* Absorb right_encode(number of Chaining Values) || 0xFF || 0xFF */
+        n = right_encode(encbuf, ktInstance->blockNumber);
+        encbuf[n++] = 0xFF;
+        encbuf[n++] = 0xFF;
+        if (KeccakWidth1600_12rounds_SpongeAbsorb(&ktInstance->finalNode, encbuf, n) != 0)
+            return 1;
+        padding = 0x06; /* '01': chaining hop, final node */
+    }
+    if (KeccakWidth1600_12rounds_SpongeAbsorbLastFewBits(&ktInstance->finalNode, padding) != 0)
+        return 1;
+    if ( ktInstance->fixedOutputLength != 0 ) {
+        ktInstance->phase = FINAL;
+        return KeccakWidth1600_12rounds_SpongeSqueeze(&ktInstance->finalNode, output, ktInstance->fixedOutputLength);
+    }
+    ktInstance->phase = SQUEEZING;
+    return 0;
+}
+
+int KangarooTwelve_Squeeze(KangarooTwelve_Instance *ktInstance, unsigned char * output, size_t outputByteLen)
+{
+    if (ktInstance->phase != SQUEEZING)
+        return 1;
+    return KeccakWidth1600_12rounds_SpongeSqueeze(&ktInstance->finalNode, output, outputByteLen);
+}
+
+int KangarooTwelve( const unsigned char * input, size_t inputByteLen, unsigned char * output, size_t outputByteLen, const unsigned char * customization, size_t customByteLen )
+{
+    KangarooTwelve_Instance ktInstance;
+
+    if (outputByteLen == 0)
+        return 1;
+    KangarooTwelve_Initialize(&ktInstance, outputByteLen);
+    if (KangarooTwelve_Update(&ktInstance, input, inputByteLen) != 0)
+        return 1;
+    return KangarooTwelve_Final(&ktInstance, output, customization, customByteLen);
+}
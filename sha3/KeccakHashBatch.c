@@ -0,0 +1,197 @@
+/*
+Batch interface on top of KeccakHash.c, see KeccakHashBatch.h.
+
+Each instance is assigned to one slot of the parallel state. All slots absorb one block
+and are permuted together, an instance that has no whole block left gets its state
+copied back and absorbs the rest with Keccak_HashUpdate(), then the slot is refilled
+with the next instance.
+*/
+
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#include "align.h"
+#include "KeccakHashBatch.h"
+#include "../cpu_features.h"
+#include "KeccakP-1600-times4-SnP.h"
+#include "KeccakP-1600-times8-SnP.h"
+
+#define KeccakBatch_maxParallelism 8
+
+typedef struct {
+    unsigned int parallelism;
+    void (*InitializeAll)(void *states);
+    void (*AddBytes)(void *states, unsigned int instanceIndex, const unsigned char *data, unsigned int offset, unsigned int length);
+    void (*OverwriteBytes)(void *states, unsigned int instanceIndex, const unsigned char *data, unsigned int offset, unsigned int length);
+    void (*ExtractBytes)(const void *states, unsigned int instanceIndex, unsigned char *data, unsigned int offset, unsigned int length);
+    void (*PermuteAll_24rounds)(void *states);
+} KeccakBatch_PlSnP;
+
+static const KeccakBatch_PlSnP KeccakBatch_times4 = {
+    4,
+    KeccakP1600times4_InitializeAll,
+    KeccakP1600times4_AddBytes,
+    KeccakP1600times4_OverwriteBytes,
+    KeccakP1600times4_ExtractBytes,
+    KeccakP1600times4_PermuteAll_24rounds
+};
+
+static const KeccakBatch_PlSnP KeccakBatch_times8 = {
+    8,
+    KeccakP1600times8_InitializeAll,
+    KeccakP1600times8_AddBytes,
+    KeccakP1600times8_OverwriteBytes,
+    KeccakP1600times8_ExtractBytes,
+    KeccakP1600times8_PermuteAll_24rounds
+};
+
+/* ---------------------------------------------------------------- */
+
+static int KeccakBatch_selected = 0;
+static const KeccakBatch_PlSnP *KeccakBatch_plsnp = NULL;
+
+/* without AVX2 the instances are hashed one after the other */
+static const CPU_KERNEL KeccakBatch_kernels[] = {
+    { "times8", CPU_AVX512F, &KeccakBatch_times8 },
+    { "times4", CPU_AVX2, &KeccakBatch_times4 },
+    { "serial", 0, NULL },
+};
+
+static const KeccakBatch_PlSnP *KeccakBatch_Select(void)
+{
+    unsigned int kernel = cpu_select_kernel("keccak-batch", KeccakBatch_kernels, 3);
+
+    return (const KeccakBatch_PlSnP *)KeccakBatch_kernels[kernel].impl;
+}
+
+static const KeccakBatch_PlSnP *KeccakBatch_Get(void)
+{
+    if (!KeccakBatch_selected) {
+        KeccakBatch_plsnp = KeccakBatch_Select();
+        KeccakBatch_selected = 1;
+    }
+    return KeccakBatch_plsnp;
+}
+
+unsigned int Keccak_HashBatchParallelism(void)
+{
+    const KeccakBatch_PlSnP *plsnp = KeccakBatch_Get();
+
+    return (plsnp != NULL) ? plsnp->parallelism : 1;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* the single instance state has its own lane representation (lane complementing or bit
+   interleaving), so it is converted through the plain byte representation */
+static void KeccakBatch_Load(const KeccakBatch_PlSnP *plsnp, void *states, unsigned int slot, const Keccak_HashInstance *instance)
+{
+    unsigned char state[KeccakP1600_stateSizeInBytes];
+
+    KeccakP1600_ExtractBytes(instance->sponge.state, state, 0, KeccakP1600_stateSizeInBytes);
+    plsnp->OverwriteBytes(states, slot, state, 0, KeccakP1600_stateSizeInBytes);
+}
+
+static void KeccakBatch_Store(const KeccakBatch_PlSnP *plsnp, const void *states, unsigned int slot, Keccak_HashInstance *instance)
+{
+    unsigned char state[KeccakP1600_stateSizeInBytes];
+
+    plsnp->ExtractBytes(states, slot, state, 0, KeccakP1600_stateSizeInBytes);
+    KeccakP1600_OverwriteBytes(instance->sponge.state, state, 0, KeccakP1600_stateSizeInBytes);
+}
+
+HashReturn Keccak_HashUpdateBatch(Keccak_HashInstance * const *instances, const BitSequence * const *data, const size_t *dataByteLen, unsigned int count)
+{
+    const KeccakBatch_PlSnP *plsnp = KeccakBatch_Get();
+    ALIGN(64) unsigned char states[KeccakP1600times8_statesSizeInBytes];
+    unsigned int slotInstance[KeccakBatch_maxParallelism];
+    const BitSequence *slotData[KeccakBatch_maxParallelism];
+    size_t slotBlocks[KeccakBatch_maxParallelism];
+    int slotActive[KeccakBatch_maxParallelism];
+    unsigned int active = 0;
+    unsigned int next = 0;
+    unsigned int slot;
+    HashReturn result = SUCCESS;
+
+    if ((plsnp == NULL) || (count < 2)) {
+        for(next=0; next<count; next++) {
+            if (Keccak_HashUpdate(instances[next], data[next], dataByteLen[next]*8) != SUCCESS)
+                result = FAIL;
+        }
+        return result;
+    }
+
+    plsnp->InitializeAll(states);
+    for(slot=0; slot<plsnp->parallelism; slot++)
+        slotActive[slot] = 0;
+
+    for(;;) {
+        size_t blocks;
+
+        /* Put the next instances into the free slots. Instances in the middle of a block
+           or without a whole block of input are done one by one right away. */
+        for(slot=0; slot<plsnp->parallelism; slot++) {
+            while(!slotActive[slot] && (next < count)) {
+                Keccak_HashInstance *instance = instances[next];
+                unsigned int rateInBytes = instance->sponge.rate/8;
+
+                if ((instance->sponge.byteIOIndex == 0) && !instance->sponge.squeezing && (dataByteLen[next] >= rateInBytes)) {
+                    KeccakBatch_Load(plsnp, states, slot, instance);
+                    slotInstance[slot] = next;
+                    slotData[slot] = data[next];
+                    slotBlocks[slot] = dataByteLen[next]/rateInBytes;
+                    slotActive[slot] = 1;
+                    active++;
+                }
+                else if (Keccak_HashUpdate(instance, data[next], dataByteLen[next]*8) != SUCCESS)
+                    result = FAIL;
+                next++;
+            }
+        }
+        if (active == 0)
+            break;
+
+        /* The last instance is finished on its own, the single instance permutation is faster */
+        if ((active == 1) && (next == count)) {
+            for(slot=0; !slotActive[slot]; slot++)
+                ;
+            slotBlocks[slot] = 0;
+        }
+
+        /* Run all slots until the first one has no whole block left */
+        blocks = (size_t)-1;
+        for(slot=0; slot<plsnp->parallelism; slot++) {
+            if (slotActive[slot] && (slotBlocks[slot] < blocks))
+                blocks = slotBlocks[slot];
+        }
+        for(; blocks>0; blocks--) {
+            for(slot=0; slot<plsnp->parallelism; slot++) {
+                if (slotActive[slot]) {
+                    unsigned int rateInBytes = instances[slotInstance[slot]]->sponge.rate/8;
+                    plsnp->AddBytes(states, slot, slotData[slot], 0, rateInBytes);
+                    slotData[slot] += rateInBytes;
+                    slotBlocks[slot]--;
+                }
+            }
+            plsnp->PermuteAll_24rounds(states);
+        }
+
+        /* Finished slots absorb the rest of their input one by one */
+        for(slot=0; slot<plsnp->parallelism; slot++) {
+            if (slotActive[slot] && (slotBlocks[slot] == 0)) {
+                unsigned int i = slotInstance[slot];
+                size_t rest = dataByteLen[i] - (size_t)(slotData[slot] - data[i]);
+
+                KeccakBatch_Store(plsnp, states, slot, instances[i]);
+                if (Keccak_HashUpdate(instances[i], slotData[slot], rest*8) != SUCCESS)
+                    result = FAIL;
+                slotActive[slot] = 0;
+                active--;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,35 @@
+/*
+Batch interface on top of KeccakHash.h: the Keccak_HashInstance of several independent
+messages are advanced in lockstep, so that the parallel permutations of
+KeccakP-1600-times4-SnP.h (AVX2) and KeccakP-1600-times8-SnP.h (AVX-512) can be used.
+*/
+
+#ifndef _KeccakHashBatch_h_
+#define _KeccakHashBatch_h_
+
+#ifndef KeccakP1600_excluded
+
+#include "KeccakHash.h"
+
+/**
+  * Function to get the number of instances that Keccak_HashUpdateBatch() permutes together.
+  * @return 8 with AVX-512, 4 with AVX2, 1 if the instances are processed one after the other.
+  */
+unsigned int Keccak_HashBatchParallelism(void);
+
+/**
+  * Function to give input data to be absorbed to several hash instances at once.
+  * This has the same effect as calling Keccak_HashUpdate() on each instance, but whole blocks
+  * of different instances are absorbed in parallel. The instances may have different rates.
+  * @param  instances   Array of @a count pointers to hash instances initialized by Keccak_HashInitialize().
+  * @param  data        data[i] is the input data for instances[i].
+  * @param  dataByteLen dataByteLen[i] is the number of input bytes in data[i].
+  * @param  count       The number of instances.
+  * @pre    In the previous call to Keccak_HashUpdate() of each instance, databitlen was a multiple of 8.
+  * @return SUCCESS if successful, FAIL otherwise.
+  */
+HashReturn Keccak_HashUpdateBatch(Keccak_HashInstance * const *instances, const BitSequence * const *data, const size_t *dataByteLen, unsigned int count);
+
+#endif
+
+#endif
@@ -0,0 +1,241 @@
+/*
+Implementation by the Keccak Team, namely, Guido Bertoni, Joan Daemen,
+Michaël Peeters, Gilles Van Assche and Ronny Van Keer,
+hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our website:
+https://keccak.team/
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+
+---
+
+This file implements the Keccak-p[1600] permutation of a single state with AVX-512F.
+Each of the five rows of the state is kept in a zmm register, elements 0 to 4.
+
+The state layout is the one of KeccakP-1600-opt64.c, which calls these functions when
+KeccakP1600_AVX512_IsAvailable() returns non-zero. The lanes that opt64 keeps
+complemented are converted on entry and exit.
+*/
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#include "KeccakP-1600-SnP.h"
+#include "../cpu_features.h"
+
+typedef unsigned long long int UINT64;
+typedef __m512i V512;
+
+#define XOR3(a, b, c)       _mm512_ternarylogic_epi64(a, b, c, 0x96)
+/* a ^ (~b & c) */
+#define CHI(a, b, c)        _mm512_ternarylogic_epi64(a, b, c, 0xD2)
+#define LOAD_ROW(p)         _mm512_maskz_loadu_epi64(0x1F, p)
+#define STORE_ROW(p, a)     _mm512_mask_storeu_epi64(p, 0x1F, a)
+#define CONST8_64(a, b, c, d, e, f, g, h) _mm512_setr_epi64(a, b, c, d, e, f, g, h)
+
+static const UINT64 KeccakP1600RoundConstants[24] = {
+    0x0000000000000001ULL,
+    0x0000000000008082ULL,
+    0x800000000000808aULL,
+    0x8000000080008000ULL,
+    0x000000000000808bULL,
+    0x0000000080000001ULL,
+    0x8000000080008081ULL,
+    0x8000000000008009ULL,
+    0x000000000000008aULL,
+    0x0000000000000088ULL,
+    0x0000000080008009ULL,
+    0x000000008000000aULL,
+    0x000000008000808bULL,
+    0x800000000000008bULL,
+    0x8000000000008089ULL,
+    0x8000000000008003ULL,
+    0x8000000000008002ULL,
+    0x8000000000000080ULL,
+    0x000000000000800aULL,
+    0x800000008000000aULL,
+    0x8000000080008081ULL,
+    0x8000000000008080ULL,
+    0x0000000080000001ULL,
+    0x8000000080008008ULL };
+
+/* ---------------------------------------------------------------- */
+
+static const CPU_KERNEL KeccakP1600_kernels[] = {
+    { "avx512", CPU_AVX512F, NULL },
+    { "opt64", 0, NULL },
+};
+
+int KeccakP1600_AVX512_IsAvailable(void)
+{
+    static int available = -1;
+
+    if (available < 0)
+        available = cpu_select_kernel("keccak-p1600", KeccakP1600_kernels, 2) == 0;
+    return available;
+}
+
+/* ---------------------------------------------------------------- */
+
+#define declareRows \
+    V512 a0, a1, a2, a3, a4; \
+    V512 b0, b1, b2, b3, b4; \
+    const V512 complement0 = CONST8_64(0, -1, -1, 0, 0, 0, 0, 0); \
+    const V512 complement1 = CONST8_64(0, 0, 0, -1, 0, 0, 0, 0); \
+    const V512 complement2 = CONST8_64(0, 0, -1, 0, 0, 0, 0, 0); \
+    const V512 complement3 = CONST8_64(0, 0, -1, 0, 0, 0, 0, 0); \
+    const V512 complement4 = CONST8_64(-1, 0, 0, 0, 0, 0, 0, 0); \
+    const V512 thetaPrev = CONST8_64(4, 0, 1, 2, 3, 5, 6, 7); \
+    const V512 thetaNext = CONST8_64(1, 2, 3, 4, 0, 5, 6, 7); \
+    const V512 rho0 = CONST8_64( 0,  1, 62, 28, 27, 0, 0, 0); \
+    const V512 rho1 = CONST8_64(36, 44,  6, 55, 20, 0, 0, 0); \
+    const V512 rho2 = CONST8_64( 3, 10, 43, 25, 39, 0, 0, 0); \
+    const V512 rho3 = CONST8_64(41, 45, 15, 21,  8, 0, 0, 0); \
+    const V512 rho4 = CONST8_64(18,  2, 61, 56, 14, 0, 0, 0); \
+    const V512 pi0 = CONST8_64(0, 3, 1, 4, 2, 5, 6, 7); \
+    const V512 pi1 = CONST8_64(1, 4, 2, 0, 3, 5, 6, 7); \
+    const V512 pi2 = CONST8_64(2, 0, 3, 1, 4, 5, 6, 7); \
+    const V512 pi3 = CONST8_64(3, 1, 4, 2, 0, 5, 6, 7); \
+    const V512 pi4 = CONST8_64(4, 2, 0, 3, 1, 5, 6, 7); \
+    const V512 transpose0 = CONST8_64(0, 1,  8,  9, 0, 0, 0, 0); \
+    const V512 transpose1 = CONST8_64(2, 3, 10, 11, 0, 0, 0, 0); \
+    const V512 transpose2 = CONST8_64(4, 5, 12, 13, 0, 0, 0, 0);
+
+/* lanes 1, 2, 8, 12, 17 and 20 are kept complemented by KeccakP-1600-opt64.c */
+#define complementRows \
+    a0 = _mm512_xor_si512(a0, complement0); \
+    a1 = _mm512_xor_si512(a1, complement1); \
+    a2 = _mm512_xor_si512(a2, complement2); \
+    a3 = _mm512_xor_si512(a3, complement3); \
+    a4 = _mm512_xor_si512(a4, complement4);
+
+#define copyFromState(state) \
+    a0 = LOAD_ROW((const UINT64 *)(state) +  0); \
+    a1 = LOAD_ROW((const UINT64 *)(state) +  5); \
+    a2 = LOAD_ROW((const UINT64 *)(state) + 10); \
+    a3 = LOAD_ROW((const UINT64 *)(state) + 15); \
+    a4 = LOAD_ROW((const UINT64 *)(state) + 20); \
+    complementRows
+
+#define copyToState(state) \
+    complementRows \
+    STORE_ROW((UINT64 *)(state) +  0, a0); \
+    STORE_ROW((UINT64 *)(state) +  5, a1); \
+    STORE_ROW((UINT64 *)(state) + 10, a2); \
+    STORE_ROW((UINT64 *)(state) + 15, a3); \
+    STORE_ROW((UINT64 *)(state) + 20, a4);
+
+/*
+Round i. Theta and rho work on the rows a0..a4. The first part of pi permutes each row
+so that b<x> holds column x of the result, chi and iota are done on these columns, and
+the second part of pi transposes the columns back into rows.
+*/
+#define KeccakP_Round(i) \
+    b0 = XOR3(XOR3(a0, a1, a2), a3, a4); \
+    b1 = _mm512_permutexvar_epi64(thetaPrev, b0); \
+    b0 = _mm512_rol_epi64(_mm512_permutexvar_epi64(thetaNext, b0), 1); \
+    a0 = XOR3(a0, b0, b1); \
+    a1 = XOR3(a1, b0, b1); \
+    a2 = XOR3(a2, b0, b1); \
+    a3 = XOR3(a3, b0, b1); \
+    a4 = XOR3(a4, b0, b1); \
+\
+    b0 = _mm512_permutexvar_epi64(pi0, _mm512_rolv_epi64(a0, rho0)); \
+    b1 = _mm512_permutexvar_epi64(pi1, _mm512_rolv_epi64(a1, rho1)); \
+    b2 = _mm512_permutexvar_epi64(pi2, _mm512_rolv_epi64(a2, rho2)); \
+    b3 = _mm512_permutexvar_epi64(pi3, _mm512_rolv_epi64(a3, rho3)); \
+    b4 = _mm512_permutexvar_epi64(pi4, _mm512_rolv_epi64(a4, rho4)); \
+\
+    a0 = CHI(b0, b1, b2); \
+    a1 = CHI(b1, b2, b3); \
+    a2 = CHI(b2, b3, b4); \
+    a3 = CHI(b3, b4, b0); \
+    a4 = CHI(b4, b0, b1); \
+    a0 = _mm512_xor_si512(a0, _mm512_maskz_set1_epi64(0x01, KeccakP1600RoundConstants[i])); \
+\
+    b0 = _mm512_unpacklo_epi64(a0, a1); \
+    b1 = _mm512_unpackhi_epi64(a0, a1); \
+    b2 = _mm512_unpacklo_epi64(a2, a3); \
+    b3 = _mm512_unpackhi_epi64(a2, a3); \
+    a0 = _mm512_mask_permutexvar_epi64(_mm512_permutex2var_epi64(b0, transpose0, b2), 0x10, _mm512_set1_epi64(0), a4); \
+    a1 = _mm512_mask_permutexvar_epi64(_mm512_permutex2var_epi64(b1, transpose0, b3), 0x10, _mm512_set1_epi64(1), a4); \
+    a2 = _mm512_mask_permutexvar_epi64(_mm512_permutex2var_epi64(b0, transpose1, b2), 0x10, _mm512_set1_epi64(2), a4); \
+    a3 = _mm512_mask_permutexvar_epi64(_mm512_permutex2var_epi64(b1, transpose1, b3), 0x10, _mm512_set1_epi64(3), a4); \
+    a4 = _mm512_mask_permutexvar_epi64(_mm512_permutex2var_epi64(b0, transpose2, b2), 0x10, _mm512_set1_epi64(4), a4);
+
+#define addInput(data) \
+    a0 = _mm512_xor_si512(a0, _mm512_maskz_loadu_epi64(laneMask[0], (const UINT64 *)(data) +  0)); \
+    a1 = _mm512_xor_si512(a1, _mm512_maskz_loadu_epi64(laneMask[1], (const UINT64 *)(data) +  5)); \
+    a2 = _mm512_xor_si512(a2, _mm512_maskz_loadu_epi64(laneMask[2], (const UINT64 *)(data) + 10)); \
+    a3 = _mm512_xor_si512(a3, _mm512_maskz_loadu_epi64(laneMask[3], (const UINT64 *)(data) + 15)); \
+    a4 = _mm512_xor_si512(a4, _mm512_maskz_loadu_epi64(laneMask[4], (const UINT64 *)(data) + 20));
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600_AVX512_Permute_Nrounds(void *state, unsigned int nrounds)
+{
+    declareRows
+    unsigned int i;
+
+    copyFromState(state)
+    for(i=24-nrounds; i<24; i++) {
+        KeccakP_Round(i)
+    }
+    copyToState(state)
+}
+
+void KeccakP1600_AVX512_Permute_24rounds(void *state)
+{
+    KeccakP1600_AVX512_Permute_Nrounds(state, 24);
+}
+
+void KeccakP1600_AVX512_Permute_12rounds(void *state)
+{
+    KeccakP1600_AVX512_Permute_Nrounds(state, 12);
+}
+
+/* ---------------------------------------------------------------- */
+
+static size_t KeccakP1600_AVX512_FastLoop_Absorb(void *state, unsigned int laneCount, const unsigned char *data, size_t dataByteLen, unsigned int firstRound)
+{
+    size_t originalDataByteLen = dataByteLen;
+    __mmask8 laneMask[5];
+    declareRows
+    unsigned int i;
+
+    for(i=0; i<5; i++) {
+        if (laneCount >= 5*i + 5)
+            laneMask[i] = 0x1F;
+        else if (laneCount > 5*i)
+            laneMask[i] = (__mmask8)((1 << (laneCount - 5*i)) - 1);
+        else
+            laneMask[i] = 0;
+    }
+
+    copyFromState(state)
+    while(dataByteLen >= laneCount*8) {
+        addInput(data)
+        for(i=firstRound; i<24; i++) {
+            KeccakP_Round(i)
+        }
+        data += laneCount*8;
+        dataByteLen -= laneCount*8;
+    }
+    copyToState(state)
+    return originalDataByteLen - dataByteLen;
+}
+
+size_t KeccakF1600_AVX512_FastLoop_Absorb(void *state, unsigned int laneCount, const unsigned char *data, size_t dataByteLen)
+{
+    return KeccakP1600_AVX512_FastLoop_Absorb(state, laneCount, data, dataByteLen, 0);
+}
+
+size_t KeccakP1600_12rounds_AVX512_FastLoop_Absorb(void *state, unsigned int laneCount, const unsigned char *data, size_t dataByteLen)
+{
+    return KeccakP1600_AVX512_FastLoop_Absorb(state, laneCount, data, dataByteLen, 12);
+}
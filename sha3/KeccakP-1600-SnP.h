@@ -19,10 +19,10 @@ Please refer to SnP-documentation.h for more details.
 #define _KeccakP_1600_SnP_h_
 
 #include "brg_endian.h"
-#ifdef _WIN64
+#if defined(_WIN64) || defined(__x86_64__)
 #include "KeccakP-1600-opt64-config.h"
 
-#define KeccakP1600_implementation      "generic 64-bit optimized implementation (" KeccakP1600_implementation_config ")"
+#define KeccakP1600_implementation      "generic 64-bit optimized implementation (" KeccakP1600_implementation_config "), AVX-512 if available"
 #define KeccakP1600_stateSizeInBytes    200
 #define KeccakP1600_stateAlignment      8
 #define KeccakF1600_FastLoop_supported
@@ -31,13 +31,13 @@ Please refer to SnP-documentation.h for more details.
 #define KeccakP1600_implementation      "in-place 32-bit optimized implementation"
 #define KeccakP1600_stateSizeInBytes    200
 #define KeccakP1600_stateAlignment      8
-#endif // _WIN64
+#endif // _WIN64 || __x86_64__
 
 #include <stddef.h>
 
 #define KeccakP1600_StaticInitialize()
 void KeccakP1600_Initialize(void *state);
-#if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN) && defined(_WIN64)
+#if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN) && (defined(_WIN64) || defined(__x86_64__))
 #define KeccakP1600_AddByte(state, byte, offset) \
     ((unsigned char*)(state))[(offset)] ^= (byte)
 #else
@@ -54,4 +54,15 @@ void KeccakP1600_ExtractAndAddBytes(const void *state, const unsigned char *inpu
 size_t KeccakF1600_FastLoop_Absorb(void *state, unsigned int laneCount, const unsigned char *data, size_t dataByteLen);
 size_t KeccakP1600_12rounds_FastLoop_Absorb(void *state, unsigned int laneCount, const unsigned char *data, size_t dataByteLen);
 
+#if defined(_WIN64) || defined(__x86_64__)
+/* AVX-512 permutation in KeccakP-1600-AVX512.c, the permutation and FastLoop functions
+   above switch to it at runtime if KeccakP1600_AVX512_IsAvailable() */
+int KeccakP1600_AVX512_IsAvailable(void);
+void KeccakP1600_AVX512_Permute_Nrounds(void *state, unsigned int nrounds);
+void KeccakP1600_AVX512_Permute_12rounds(void *state);
+void KeccakP1600_AVX512_Permute_24rounds(void *state);
+size_t KeccakF1600_AVX512_FastLoop_Absorb(void *state, unsigned int laneCount, const unsigned char *data, size_t dataByteLen);
+size_t KeccakP1600_12rounds_AVX512_FastLoop_Absorb(void *state, unsigned int laneCount, const unsigned char *data, size_t dataByteLen);
+#endif
+
 #endif
@@ -23,6 +23,7 @@ Please refer to LowLevel.build for the exact list of other files it must be comb
 #include <stdlib.h>
 #include "brg_endian.h"
 #include "KeccakP-1600-opt64-config.h"
+#include "KeccakP-1600-SnP.h"
 
 typedef unsigned char UINT8;
 typedef unsigned long long int UINT64;
@@ -330,6 +331,10 @@ void KeccakP1600_Permute_Nrounds(void *state, unsigned int nr)
     unsigned int i;
     UINT64 *stateAsLanes = (UINT64*)state;
 
+    if (KeccakP1600_AVX512_IsAvailable()) {
+        KeccakP1600_AVX512_Permute_Nrounds(state, nr);
+        return;
+    }
     copyFromState(A, stateAsLanes)
     roundsN(nr)
     copyToState(stateAsLanes, A)
@@ -346,6 +351,10 @@ void KeccakP1600_Permute_24rounds(void *state)
     #endif
     UINT64 *stateAsLanes = (UINT64*)state;
 
+    if (KeccakP1600_AVX512_IsAvailable()) {
+        KeccakP1600_AVX512_Permute_24rounds(state);
+        return;
+    }
     copyFromState(A, stateAsLanes)
     rounds24
     copyToState(stateAsLanes, A)
@@ -361,6 +370,10 @@ void KeccakP1600_Permute_12rounds(void *state)
     #endif
     UINT64 *stateAsLanes = (UINT64*)state;
 
+    if (KeccakP1600_AVX512_IsAvailable()) {
+        KeccakP1600_AVX512_Permute_12rounds(state);
+        return;
+    }
     copyFromState(A, stateAsLanes)
     rounds12
     copyToState(stateAsLanes, A)
@@ -529,6 +542,8 @@ size_t KeccakF1600_FastLoop_Absorb(void *state, unsigned int laneCount, const un
     UINT64 *stateAsLanes = (UINT64*)state;
     UINT64 *inDataAsLanes = (UINT64*)data;
 
+    if (KeccakP1600_AVX512_IsAvailable())
+        return KeccakF1600_AVX512_FastLoop_Absorb(state, laneCount, data, dataByteLen);
     copyFromState(A, stateAsLanes)
     while(dataByteLen >= laneCount*8) {
         addInput(A, inDataAsLanes, laneCount)
@@ -552,6 +567,8 @@ size_t KeccakP1600_12rounds_FastLoop_Absorb(void *state, unsigned int laneCount,
     UINT64 *stateAsLanes = (UINT64*)state;
     UINT64 *inDataAsLanes = (UINT64*)data;
 
+    if (KeccakP1600_AVX512_IsAvailable())
+        return KeccakP1600_12rounds_AVX512_FastLoop_Absorb(state, laneCount, data, dataByteLen);
     copyFromState(A, stateAsLanes)
     while(dataByteLen >= laneCount*8) {
         addInput(A, inDataAsLanes, laneCount)
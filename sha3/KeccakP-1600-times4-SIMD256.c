@@ -0,0 +1,432 @@
+/*
+Implementation by the Keccak Team, namely, Guido Bertoni, Joan Daemen,
+Michaël Peeters, Gilles Van Assche and Ronny Van Keer,
+hereby denoted as "the implementer".
+
+For more information, feedback or questions, please refer to our website:
+https://keccak.team/
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+
+---
+
+This file implements 4 interleaved instances of Keccak-p[1600] with 256-bit
+AVX2 instructions, one instance per 64-bit element of a vector.
+Please refer to SnP-documentation.h for more details.
+
+This implementation comes with KeccakP-1600-times4-SnP.h in the same folder.
+*/
+
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#include "align.h"
+#include "KeccakP-1600-times4-SnP.h"
+
+typedef unsigned char UINT8;
+typedef unsigned long long int UINT64;
+
+typedef __m256i V256;
+
+#define LOAD256(a)          _mm256_load_si256((const V256 *)&(a))
+#define LOAD256u(a)         _mm256_loadu_si256((const V256 *)&(a))
+#define STORE256(a, b)      _mm256_store_si256((V256 *)&(a), b)
+#define CONST256_64(a)      _mm256_set1_epi64x(a)
+#define XOR256(a, b)        _mm256_xor_si256(a, b)
+#define XOR5(a, b, c, d, e) XOR256(XOR256(XOR256(a, b), XOR256(c, d)), e)
+#define ANDnu256(a, b)      _mm256_andnot_si256(a, b)
+#define ROL64in256(a, o)    _mm256_or_si256(_mm256_slli_epi64(a, o), _mm256_srli_epi64(a, 64-(o)))
+#define ROL64in256_8(a)     _mm256_shuffle_epi8(a, CONST256_rho8)
+#define ROL64in256_56(a)    _mm256_shuffle_epi8(a, CONST256_rho56)
+/* a ^ (~b & c) */
+#define CHI(a, b, c)        XOR256(a, ANDnu256(b, c))
+
+static const ALIGN(32) UINT8 rho8[32] = {
+    7, 0, 1, 2, 3, 4, 5, 6, 15, 8, 9, 10, 11, 12, 13, 14,
+    7, 0, 1, 2, 3, 4, 5, 6, 15, 8, 9, 10, 11, 12, 13, 14 };
+static const ALIGN(32) UINT8 rho56[32] = {
+    1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8,
+    1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8 };
+#define CONST256_rho8       LOAD256u(rho8[0])
+#define CONST256_rho56      LOAD256u(rho56[0])
+
+/* lane lanePosition of instance instanceIndex, the lanes of all instances are interleaved */
+#define laneIndex(instanceIndex, lanePosition) ((lanePosition)*4 + (instanceIndex))
+
+#define declareABCDE \
+    V256 Aba, Abe, Abi, Abo, Abu, Aga, Age, Agi, Ago, Agu, Aka, Ake, Aki, Ako, Aku, Ama, Ame, Ami, Amo, Amu, Asa, Ase, Asi, Aso, Asu; \
+    V256 Ba, Be, Bi, Bo, Bu; \
+    V256 Ca, Ce, Ci, Co, Cu; \
+    V256 Da, De, Di, Do, Du; \
+    V256 Eba, Ebe, Ebi, Ebo, Ebu, Ega, Ege, Egi, Ego, Egu, Eka, Eke, Eki, Eko, Eku, Ema, Eme, Emi, Emo, Emu, Esa, Ese, Esi, Eso, Esu;
+
+/* round i, from the lanes A into the lanes E */
+#define thetaRhoPiChiIota(i, A, E) \
+    Ca = XOR5(A##ba, A##ga, A##ka, A##ma, A##sa); \
+    Ce = XOR5(A##be, A##ge, A##ke, A##me, A##se); \
+    Ci = XOR5(A##bi, A##gi, A##ki, A##mi, A##si); \
+    Co = XOR5(A##bo, A##go, A##ko, A##mo, A##so); \
+    Cu = XOR5(A##bu, A##gu, A##ku, A##mu, A##su); \
+    Da = XOR256(Cu, ROL64in256(Ce, 1)); \
+    De = XOR256(Ca, ROL64in256(Ci, 1)); \
+    Di = XOR256(Ce, ROL64in256(Co, 1)); \
+    Do = XOR256(Ci, ROL64in256(Cu, 1)); \
+    Du = XOR256(Co, ROL64in256(Ca, 1)); \
+\
+    Ba = XOR256(A##ba, Da); \
+    Be = ROL64in256(XOR256(A##ge, De), 44); \
+    Bi = ROL64in256(XOR256(A##ki, Di), 43); \
+    Bo = ROL64in256(XOR256(A##mo, Do), 21); \
+    Bu = ROL64in256(XOR256(A##su, Du), 14); \
+    E##ba = XOR256(CHI(Ba, Be, Bi), CONST256_64(KeccakF1600RoundConstants[i])); \
+    E##be = CHI(Be, Bi, Bo); \
+    E##bi = CHI(Bi, Bo, Bu); \
+    E##bo = CHI(Bo, Bu, Ba); \
+    E##bu = CHI(Bu, Ba, Be); \
+\
+    Ba = ROL64in256(XOR256(A##bo, Do), 28); \
+    Be = ROL64in256(XOR256(A##gu, Du), 20); \
+    Bi = ROL64in256(XOR256(A##ka, Da), 3); \
+    Bo = ROL64in256(XOR256(A##me, De), 45); \
+    Bu = ROL64in256(XOR256(A##si, Di), 61); \
+    E##ga = CHI(Ba, Be, Bi); \
+    E##ge = CHI(Be, Bi, Bo); \
+    E##gi = CHI(Bi, Bo, Bu); \
+    E##go = CHI(Bo, Bu, Ba); \
+    E##gu = CHI(Bu, Ba, Be); \
+\
+    Ba = ROL64in256(XOR256(A##be, De), 1); \
+    Be = ROL64in256(XOR256(A##gi, Di), 6); \
+    Bi = ROL64in256(XOR256(A##ko, Do), 25); \
+    Bo = ROL64in256_8(XOR256(A##mu, Du)); \
+    Bu = ROL64in256(XOR256(A##sa, Da), 18); \
+    E##ka = CHI(Ba, Be, Bi); \
+    E##ke = CHI(Be, Bi, Bo); \
+    E##ki = CHI(Bi, Bo, Bu); \
+    E##ko = CHI(Bo, Bu, Ba); \
+    E##ku = CHI(Bu, Ba, Be); \
+\
+    Ba = ROL64in256(XOR256(A##bu, Du), 27); \
+    Be = ROL64in256(XOR256(A##ga, Da), 36); \
+    Bi = ROL64in256(XOR256(A##ke, De), 10); \
+    Bo = ROL64in256(XOR256(A##mi, Di), 15); \
+    Bu = ROL64in256_56(XOR256(A##so, Do)); \
+    E##ma = CHI(Ba, Be, Bi); \
+    E##me = CHI(Be, Bi, Bo); \
+    E##mi = CHI(Bi, Bo, Bu); \
+    E##mo = CHI(Bo, Bu, Ba); \
+    E##mu = CHI(Bu, Ba, Be); \
+\
+    Ba = ROL64in256(XOR256(A##bi, Di), 62); \
+    Be = ROL64in256(XOR256(A##go, Do), 55); \
+    Bi = ROL64in256(XOR256(A##ku, Du), 39); \
+    Bo = ROL64in256(XOR256(A##ma, Da), 41); \
+    Bu = ROL64in256(XOR256(A##se, De), 2); \
+    E##sa = CHI(Ba, Be, Bi); \
+    E##se = CHI(Be, Bi, Bo); \
+    E##si = CHI(Bi, Bo, Bu); \
+    E##so = CHI(Bo, Bu, Ba); \
+    E##su = CHI(Bu, Ba, Be);
+
+#define copyFromState(X, state) \
+    X##ba = LOAD256(state[ 0]); \
+    X##be = LOAD256(state[ 1]); \
+    X##bi = LOAD256(state[ 2]); \
+    X##bo = LOAD256(state[ 3]); \
+    X##bu = LOAD256(state[ 4]); \
+    X##ga = LOAD256(state[ 5]); \
+    X##ge = LOAD256(state[ 6]); \
+    X##gi = LOAD256(state[ 7]); \
+    X##go = LOAD256(state[ 8]); \
+    X##gu = LOAD256(state[ 9]); \
+    X##ka = LOAD256(state[10]); \
+    X##ke = LOAD256(state[11]); \
+    X##ki = LOAD256(state[12]); \
+    X##ko = LOAD256(state[13]); \
+    X##ku = LOAD256(state[14]); \
+    X##ma = LOAD256(state[15]); \
+    X##me = LOAD256(state[16]); \
+    X##mi = LOAD256(state[17]); \
+    X##mo = LOAD256(state[18]); \
+    X##mu = LOAD256(state[19]); \
+    X##sa = LOAD256(state[20]); \
+    X##se = LOAD256(state[21]); \
+    X##si = LOAD256(state[22]); \
+    X##so = LOAD256(state[23]); \
+    X##su = LOAD256(state[24]);
+
+#define copyToState(state, X) \
+    STORE256(state[ 0], X##ba); \
+    STORE256(state[ 1], X##be); \
+    STORE256(state[ 2], X##bi); \
+    STORE256(state[ 3], X##bo); \
+    STORE256(state[ 4], X##bu); \
+    STORE256(state[ 5], X##ga); \
+    STORE256(state[ 6], X##ge); \
+    STORE256(state[ 7], X##gi); \
+    STORE256(state[ 8], X##go); \
+    STORE256(state[ 9], X##gu); \
+    STORE256(state[10], X##ka); \
+    STORE256(state[11], X##ke); \
+    STORE256(state[12], X##ki); \
+    STORE256(state[13], X##ko); \
+    STORE256(state[14], X##ku); \
+    STORE256(state[15], X##ma); \
+    STORE256(state[16], X##me); \
+    STORE256(state[17], X##mi); \
+    STORE256(state[18], X##mo); \
+    STORE256(state[19], X##mu); \
+    STORE256(state[20], X##sa); \
+    STORE256(state[21], X##se); \
+    STORE256(state[22], X##si); \
+    STORE256(state[23], X##so); \
+    STORE256(state[24], X##su);
+
+#define rounds(first) \
+    for(i=(first); i<24; i+=2) { \
+        thetaRhoPiChiIota(i  , A, E) \
+        thetaRhoPiChiIota(i+1, E, A) \
+    }
+
+static const UINT64 KeccakF1600RoundConstants[24] = {
+    0x0000000000000001ULL,
+    0x0000000000008082ULL,
+    0x800000000000808aULL,
+    0x8000000080008000ULL,
+    0x000000000000808bULL,
+    0x0000000080000001ULL,
+    0x8000000080008081ULL,
+    0x8000000000008009ULL,
+    0x000000000000008aULL,
+    0x0000000000000088ULL,
+    0x0000000080008009ULL,
+    0x000000008000000aULL,
+    0x000000008000808bULL,
+    0x800000000000008bULL,
+    0x8000000000008089ULL,
+    0x8000000000008003ULL,
+    0x8000000000008002ULL,
+    0x8000000000000080ULL,
+    0x000000000000800aULL,
+    0x800000008000000aULL,
+    0x8000000080008081ULL,
+    0x8000000000008080ULL,
+    0x0000000080000001ULL,
+    0x8000000080008008ULL };
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_InitializeAll(void *states)
+{
+    memset(states, 0, KeccakP1600times4_statesSizeInBytes);
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_AddBytes(void *states, unsigned int instanceIndex, const unsigned char *data, unsigned int offset, unsigned int length)
+{
+    unsigned int sizeLeft = length;
+    unsigned int lanePosition = offset/8;
+    unsigned int offsetInLane = offset%8;
+    const unsigned char *curData = data;
+    UINT64 *statesAsLanes = (UINT64 *)states;
+
+    if ((sizeLeft > 0) && (offsetInLane != 0)) {
+        unsigned int bytesInLane = 8 - offsetInLane;
+        UINT64 lane = 0;
+        if (bytesInLane > sizeLeft)
+            bytesInLane = sizeLeft;
+        memcpy((unsigned char*)&lane + offsetInLane, curData, bytesInLane);
+        statesAsLanes[laneIndex(instanceIndex, lanePosition)] ^= lane;
+        sizeLeft -= bytesInLane;
+        lanePosition++;
+        curData += bytesInLane;
+    }
+
+    while(sizeLeft >= 8) {
+        UINT64 lane;
+        memcpy(&lane, curData, 8);
+        statesAsLanes[laneIndex(instanceIndex, lanePosition)] ^= lane;
+        sizeLeft -= 8;
+        lanePosition++;
+        curData += 8;
+    }
+
+    if (sizeLeft > 0) {
+        UINT64 lane = 0;
+        memcpy(&lane, curData, sizeLeft);
+        statesAsLanes[laneIndex(instanceIndex, lanePosition)] ^= lane;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_AddLanesAll(void *states, const unsigned char *data, unsigned int laneCount, unsigned int laneOffset)
+{
+    UINT64 *statesAsLanes = (UINT64 *)states;
+    unsigned int i, j;
+
+    for(i=0; i<laneCount; i++) {
+        for(j=0; j<4; j++) {
+            UINT64 lane;
+            memcpy(&lane, data + (j*laneOffset + i)*8, 8);
+            statesAsLanes[laneIndex(j, i)] ^= lane;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_OverwriteBytes(void *states, unsigned int instanceIndex, const unsigned char *data, unsigned int offset, unsigned int length)
+{
+    unsigned int sizeLeft = length;
+    unsigned int lanePosition = offset/8;
+    unsigned int offsetInLane = offset%8;
+    const unsigned char *curData = data;
+    UINT64 *statesAsLanes = (UINT64 *)states;
+
+    if ((sizeLeft > 0) && (offsetInLane != 0)) {
+        unsigned int bytesInLane = 8 - offsetInLane;
+        if (bytesInLane > sizeLeft)
+            bytesInLane = sizeLeft;
+        memcpy((unsigned char*)&statesAsLanes[laneIndex(instanceIndex, lanePosition)] + offsetInLane, curData, bytesInLane);
+        sizeLeft -= bytesInLane;
+        lanePosition++;
+        curData += bytesInLane;
+    }
+
+    while(sizeLeft >= 8) {
+        memcpy(&statesAsLanes[laneIndex(instanceIndex, lanePosition)], curData, 8);
+        sizeLeft -= 8;
+        lanePosition++;
+        curData += 8;
+    }
+
+    if (sizeLeft > 0)
+        memcpy(&statesAsLanes[laneIndex(instanceIndex, lanePosition)], curData, sizeLeft);
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_OverwriteLanesAll(void *states, const unsigned char *data, unsigned int laneCount, unsigned int laneOffset)
+{
+    UINT64 *statesAsLanes = (UINT64 *)states;
+    unsigned int i, j;
+
+    for(i=0; i<laneCount; i++)
+        for(j=0; j<4; j++)
+            memcpy(&statesAsLanes[laneIndex(j, i)], data + (j*laneOffset + i)*8, 8);
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_OverwriteWithZeroes(void *states, unsigned int instanceIndex, unsigned int byteCount)
+{
+    UINT64 *statesAsLanes = (UINT64 *)states;
+    unsigned int lanePosition;
+
+    for(lanePosition=0; lanePosition<byteCount/8; lanePosition++)
+        statesAsLanes[laneIndex(instanceIndex, lanePosition)] = 0;
+    if (byteCount%8 != 0)
+        memset(&statesAsLanes[laneIndex(instanceIndex, byteCount/8)], 0, byteCount%8);
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_ExtractBytes(const void *states, unsigned int instanceIndex, unsigned char *data, unsigned int offset, unsigned int length)
+{
+    unsigned int sizeLeft = length;
+    unsigned int lanePosition = offset/8;
+    unsigned int offsetInLane = offset%8;
+    unsigned char *curData = data;
+    const UINT64 *statesAsLanes = (const UINT64 *)states;
+
+    if ((sizeLeft > 0) && (offsetInLane != 0)) {
+        unsigned int bytesInLane = 8 - offsetInLane;
+        if (bytesInLane > sizeLeft)
+            bytesInLane = sizeLeft;
+        memcpy(curData, (const unsigned char*)&statesAsLanes[laneIndex(instanceIndex, lanePosition)] + offsetInLane, bytesInLane);
+        sizeLeft -= bytesInLane;
+        lanePosition++;
+        curData += bytesInLane;
+    }
+
+    while(sizeLeft >= 8) {
+        memcpy(curData, &statesAsLanes[laneIndex(instanceIndex, lanePosition)], 8);
+        sizeLeft -= 8;
+        lanePosition++;
+        curData += 8;
+    }
+
+    if (sizeLeft > 0)
+        memcpy(curData, &statesAsLanes[laneIndex(instanceIndex, lanePosition)], sizeLeft);
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_ExtractLanesAll(const void *states, unsigned char *data, unsigned int laneCount, unsigned int laneOffset)
+{
+    const UINT64 *statesAsLanes = (const UINT64 *)states;
+    unsigned int i, j;
+
+    for(i=0; i<laneCount; i++)
+        for(j=0; j<4; j++)
+            memcpy(data + (j*laneOffset + i)*8, &statesAsLanes[laneIndex(j, i)], 8);
+}
+
+/* ---------------------------------------------------------------- */
+
+void KeccakP1600times4_PermuteAll_24rounds(void *states)
+{
+    V256 *statesAsLanes = (V256 *)states;
+    declareABCDE
+    unsigned int i;
+
+    copyFromState(A, statesAsLanes)
+    rounds(0)
+    copyToState(statesAsLanes, A)
+}
+
+void KeccakP1600times4_PermuteAll_12rounds(void *states)
+{
+    V256 *statesAsLanes = (V256 *)states;
+    declareABCDE
+    unsigned int i;
+
+    copyFromState(A, statesAsLanes)
+    rounds(12)
+    copyToState(statesAsLanes, A)
+}
+
+/* ---------------------------------------------------------------- */
+
+size_t KeccakF1600times4_FastLoop_Absorb(void *states, unsigned int laneCount, unsigned int laneOffsetParallel, unsigned int laneOffsetSerial, const unsigned char *data, size_t dataByteLen)
+{
+    const unsigned char *dataStart = data;
+
+    while(dataByteLen >= (laneOffsetParallel*3 + laneCount)*8) {
+        KeccakP1600times4_AddLanesAll(states, data, laneCount, laneOffsetParallel);
+        KeccakP1600times4_PermuteAll_24rounds(states);
+        data += laneOffsetSerial*8;
+        dataByteLen -= laneOffsetSerial*8;
+    }
+    return data - dataStart;
+}
+
+size_t KeccakP1600times4_12rounds_FastLoop_Absorb(void *states, unsigned int laneCount, unsigned int laneOffsetParallel, unsigned int laneOffsetSerial, const unsigned char *data, size_t dataByteLen)
+{
+    const unsigned char *dataStart = data;
+
+    while(dataByteLen >= (laneOffsetParallel*3 + laneCount)*8) {
+        KeccakP1600times4_AddLanesAll(states, data, laneCount, laneOffsetParallel);
+        KeccakP1600times4_PermuteAll_12rounds(states);
+        data += laneOffsetSerial*8;
+        dataByteLen -= laneOffsetSerial*8;
+    }
+    return data - dataStart;
+}
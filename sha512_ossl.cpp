@@ -1,5 +1,11 @@
-#include "globals.h"
+#include <string.h>
 #include "sha512_ossl.h"
+#include "cpu_features.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 
 #ifdef  __cplusplus
@@ -10,6 +16,212 @@ void sha512_block_data_order (SHA512_CTX *ctx, const void *in, size_t num);
 }
 #endif
 
+static const SHA_LONG64 K512[80] = {
+	U64(0x428a2f98d728ae22),U64(0x7137449123ef65cd),U64(0xb5c0fbcfec4d3b2f),U64(0xe9b5dba58189dbbc),
+	U64(0x3956c25bf348b538),U64(0x59f111f1b605d019),U64(0x923f82a4af194f9b),U64(0xab1c5ed5da6d8118),
+	U64(0xd807aa98a3030242),U64(0x12835b0145706fbe),U64(0x243185be4ee4b28c),U64(0x550c7dc3d5ffb4e2),
+	U64(0x72be5d74f27b896f),U64(0x80deb1fe3b1696b1),U64(0x9bdc06a725c71235),U64(0xc19bf174cf692694),
+	U64(0xe49b69c19ef14ad2),U64(0xefbe4786384f25e3),U64(0x0fc19dc68b8cd5b5),U64(0x240ca1cc77ac9c65),
+	U64(0x2de92c6f592b0275),U64(0x4a7484aa6ea6e483),U64(0x5cb0a9dcbd41fbd4),U64(0x76f988da831153b5),
+	U64(0x983e5152ee66dfab),U64(0xa831c66d2db43210),U64(0xb00327c898fb213f),U64(0xbf597fc7beef0ee4),
+	U64(0xc6e00bf33da88fc2),U64(0xd5a79147930aa725),U64(0x06ca6351e003826f),U64(0x142929670a0e6e70),
+	U64(0x27b70a8546d22ffc),U64(0x2e1b21385c26c926),U64(0x4d2c6dfc5ac42aed),U64(0x53380d139d95b3df),
+	U64(0x650a73548baf63de),U64(0x766a0abb3c77b2a8),U64(0x81c2c92e47edaee6),U64(0x92722c851482353b),
+	U64(0xa2bfe8a14cf10364),U64(0xa81a664bbc423001),U64(0xc24b8b70d0f89791),U64(0xc76c51a30654be30),
+	U64(0xd192e819d6ef5218),U64(0xd69906245565a910),U64(0xf40e35855771202a),U64(0x106aa07032bbd1b8),
+	U64(0x19a4c116b8d2d0c8),U64(0x1e376c085141ab53),U64(0x2748774cdf8eeb99),U64(0x34b0bcb5e19b48a8),
+	U64(0x391c0cb3c5c95a63),U64(0x4ed8aa4ae3418acb),U64(0x5b9cca4f7763e373),U64(0x682e6ff3d6b2b8a3),
+	U64(0x748f82ee5defb2fc),U64(0x78a5636f43172f60),U64(0x84c87814a1f0ab72),U64(0x8cc702081a6439ec),
+	U64(0x90befffa23631e28),U64(0xa4506cebde82bde9),U64(0xbef9a3f7b2c67915),U64(0xc67178f2e372532b),
+	U64(0xca273eceea26619c),U64(0xd186b8c721c0c207),U64(0xeada7dd6cde0eb1e),U64(0xf57d4f7fee6ed178),
+	U64(0x06f067aa72176fba),U64(0x0a637dc5a2c898a6),U64(0x113f9804bef90dae),U64(0x1b710b35131c471b),
+	U64(0x28db77f523047d84),U64(0x32caab7b40c72493),U64(0x3c9ebe0a15c9bebc),U64(0x431d67c49c100d4c),
+	U64(0x4cc5d4becb3e42b6),U64(0x597f299cfc657e2a),U64(0x5fcb6fab3ad6faec),U64(0x6c44198c4a475817) };
+
+/*
+ * SIMD variants: the message schedule of 4 (AVX2) or 8 (AVX-512) consecutive blocks
+ * is computed in parallel, one block per 64 bit lane, and stored with the round
+ * constants already added. The rounds themselves are sequential per block and use
+ * rorx for the rotations.
+ */
+#if defined(_MSC_VER) && defined(_M_X64)
+#define ROTR64(x,n)	_rorx_u64(x,n)
+#elif defined(_MSC_VER)
+#define ROTR64(x,n)	_rotr64(x,n)
+#else
+/* recognized as a rotation, rorx in the AVX2 kernel that sha512_rounds is flattened into */
+#define ROTR64(x,n)	(((x) >> (n)) | ((x) << (64-(n))))
+#endif
+
+#if defined(_MSC_VER)
+#define SHA512_ALIGN(n)	__declspec(align(n))
+#else
+#define SHA512_ALIGN(n)	__attribute__((aligned(n)))
+#endif
+
+#define Sigma0(x)	(ROTR64((x),28) ^ ROTR64((x),34) ^ ROTR64((x),39))
+#define Sigma1(x)	(ROTR64((x),14) ^ ROTR64((x),18) ^ ROTR64((x),41))
+#define Ch(x,y,z)	(((x) & (y)) ^ ((~(x)) & (z)))
+#define Maj(x,y,z)	(((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+
+#define ROUND_00_79(i,a,b,c,d,e,f,g,h)	do {	\
+	T1 = h + Sigma1(e) + Ch(e,f,g) + wk[(i)*stride];	\
+	h = Sigma0(a) + Maj(a,b,c);		\
+	d += T1;	h += T1;		} while (0)
+
+/* 80 rounds over one block, wk[i*stride] holds W[i]+K[i] */
+static void sha512_rounds (SHA_LONG64 *state, const SHA_LONG64 *wk, size_t stride)
+{
+	SHA_LONG64 a,b,c,d,e,f,g,h,T1;
+	int i;
+
+	a = state[0];	b = state[1];	c = state[2];	d = state[3];
+	e = state[4];	f = state[5];	g = state[6];	h = state[7];
+
+	for (i=0;i<80;i+=8)
+		{
+		ROUND_00_79(i+0,a,b,c,d,e,f,g,h);
+		ROUND_00_79(i+1,h,a,b,c,d,e,f,g);
+		ROUND_00_79(i+2,g,h,a,b,c,d,e,f);
+		ROUND_00_79(i+3,f,g,h,a,b,c,d,e);
+		ROUND_00_79(i+4,e,f,g,h,a,b,c,d);
+		ROUND_00_79(i+5,d,e,f,g,h,a,b,c);
+		ROUND_00_79(i+6,c,d,e,f,g,h,a,b);
+		ROUND_00_79(i+7,b,c,d,e,f,g,h,a);
+		}
+
+	state[0] += a;	state[1] += b;	state[2] += c;	state[3] += d;
+	state[4] += e;	state[5] += f;	state[6] += g;	state[7] += h;
+}
+
+CPU_KERNEL_TARGET("avx2,bmi2")
+static void sha512_block_data_order_avx2 (SHA512_CTX *ctx, const void *in, size_t num)
+{
+	const unsigned char *data = (const unsigned char *)in;
+	const __m256i BSWAP = _mm256_set_epi64x(U64(0x08090a0b0c0d0e0f), U64(0x0001020304050607),
+											U64(0x08090a0b0c0d0e0f), U64(0x0001020304050607));
+	SHA512_ALIGN(32) SHA_LONG64 wk[80*4];
+	__m256i W[80];
+	size_t blocks, j;
+	int i;
+
+	while (num > 0)
+		{
+		blocks = num < 4 ? num : 4;
+
+		/* load 4 words of each block and transpose, lanes past the last block repeat the first one */
+		for (i=0;i<16;i+=4)
+			{
+			__m256i r0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data + 8*i)), BSWAP);
+			__m256i r1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data + (blocks > 1 ? 1 : 0)*128 + 8*i)), BSWAP);
+			__m256i r2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data + (blocks > 2 ? 2 : 0)*128 + 8*i)), BSWAP);
+			__m256i r3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(data + (blocks > 3 ? 3 : 0)*128 + 8*i)), BSWAP);
+			__m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+			__m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+			__m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+			__m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+			W[i+0] = _mm256_permute2x128_si256(t0, t2, 0x20);
+			W[i+1] = _mm256_permute2x128_si256(t1, t3, 0x20);
+			W[i+2] = _mm256_permute2x128_si256(t0, t2, 0x31);
+			W[i+3] = _mm256_permute2x128_si256(t1, t3, 0x31);
+			}
+
+		for (i=16;i<80;i++)
+			{
+			__m256i x = W[i-15], y = W[i-2];
+			__m256i s0 = _mm256_xor_si256(_mm256_xor_si256(
+							_mm256_or_si256(_mm256_srli_epi64(x, 1), _mm256_slli_epi64(x, 63)),
+							_mm256_or_si256(_mm256_srli_epi64(x, 8), _mm256_slli_epi64(x, 56))),
+							_mm256_srli_epi64(x, 7));
+			__m256i s1 = _mm256_xor_si256(_mm256_xor_si256(
+							_mm256_or_si256(_mm256_srli_epi64(y, 19), _mm256_slli_epi64(y, 45)),
+							_mm256_or_si256(_mm256_srli_epi64(y, 61), _mm256_slli_epi64(y, 3))),
+							_mm256_srli_epi64(y, 6));
+			W[i] = _mm256_add_epi64(_mm256_add_epi64(s0, s1), _mm256_add_epi64(W[i-7], W[i-16]));
+			}
+
+		for (i=0;i<80;i++)
+			_mm256_store_si256((__m256i *)&wk[4*i], _mm256_add_epi64(W[i], _mm256_set1_epi64x(K512[i])));
+
+		for (j=0;j<blocks;j++)
+			sha512_rounds (ctx->h, wk + j, 4);
+
+		data += blocks * SHA512_CBLOCK;
+		num -= blocks;
+		}
+	_mm256_zeroupper();
+}
+
+CPU_KERNEL_TARGET("avx512f,avx512bw")
+static void sha512_block_data_order_avx512 (SHA512_CTX *ctx, const void *in, size_t num)
+{
+	const unsigned char *data = (const unsigned char *)in;
+	const __m512i BSWAP = _mm512_set_epi64(U64(0x08090a0b0c0d0e0f), U64(0x0001020304050607),
+										   U64(0x08090a0b0c0d0e0f), U64(0x0001020304050607),
+										   U64(0x08090a0b0c0d0e0f), U64(0x0001020304050607),
+										   U64(0x08090a0b0c0d0e0f), U64(0x0001020304050607));
+	SHA512_ALIGN(64) SHA_LONG64 wk[80*8];
+	__m512i W[80];
+	__m512i index;
+	size_t blocks, j;
+	int i;
+
+	while (num > 0)
+		{
+		blocks = num < 8 ? num : 8;
+
+		/* word i of block j is at j*128 + i*8, lanes past the last block repeat the first one */
+		index = _mm512_set_epi64(blocks > 7 ? 7*128 : 0, blocks > 6 ? 6*128 : 0,
+								 blocks > 5 ? 5*128 : 0, blocks > 4 ? 4*128 : 0,
+								 blocks > 3 ? 3*128 : 0, blocks > 2 ? 2*128 : 0,
+								 blocks > 1 ? 1*128 : 0, 0);
+		for (i=0;i<16;i++)
+			W[i] = _mm512_shuffle_epi8(_mm512_i64gather_epi64(index, (const void *)(data + 8*i), 1), BSWAP);
+
+		for (i=16;i<80;i++)
+			{
+			__m512i x = W[i-15], y = W[i-2];
+			__m512i s0 = _mm512_ternarylogic_epi64(_mm512_ror_epi64(x, 1), _mm512_ror_epi64(x, 8), _mm512_srli_epi64(x, 7), 0x96);
+			__m512i s1 = _mm512_ternarylogic_epi64(_mm512_ror_epi64(y, 19), _mm512_ror_epi64(y, 61), _mm512_srli_epi64(y, 6), 0x96);
+			W[i] = _mm512_add_epi64(_mm512_add_epi64(s0, s1), _mm512_add_epi64(W[i-7], W[i-16]));
+			}
+
+		for (i=0;i<80;i++)
+			_mm512_store_si512((void *)&wk[8*i], _mm512_add_epi64(W[i], _mm512_set1_epi64(K512[i])));
+
+		for (j=0;j<blocks;j++)
+			sha512_rounds (ctx->h, wk + j, 8);
+
+		data += blocks * SHA512_CBLOCK;
+		num -= blocks;
+		}
+	_mm256_zeroupper();
+}
+
+/* AVX-512F/BW, AVX2 with BMI2 (rorx), or the scalar assembler version */
+static const CPU_KERNEL sha512_kernels[] = {
+	{ "avx512",	CPU_AVX512F | CPU_AVX512BW,	(const void *)sha512_block_data_order_avx512 },
+	{ "avx2",	CPU_AVX2 | CPU_BMI2,		(const void *)sha512_block_data_order_avx2 },
+	{ "ossl",	0,							(const void *)sha512_block_data_order },
+};
+
+static void (*sha512_select (void)) (SHA512_CTX *ctx, const void *in, size_t num)
+{
+	const unsigned int kernel = cpu_select_kernel("sha512", sha512_kernels, sizeof(sha512_kernels) / sizeof(sha512_kernels[0]));
+	return (void (*) (SHA512_CTX *, const void *, size_t))sha512_kernels[kernel].impl;
+}
+
+static void sha512_block_resolve (SHA512_CTX *ctx, const void *in, size_t num);
+
+/* block function used by SHA512_Update/SHA512_Final, picked on first use */
+static void (*sha512_block) (SHA512_CTX *ctx, const void *in, size_t num) = sha512_block_resolve;
+
+static void sha512_block_resolve (SHA512_CTX *ctx, const void *in, size_t num)
+{
+	sha512_block = sha512_select();
+	sha512_block (ctx,in,num);
+}
+
 int SHA512_Update (SHA512_CTX *c, const void *_data, size_t len)
 {
 	SHA_LONG64	l;
@@ -35,13 +247,13 @@ int SHA512_Update (SHA512_CTX *c, const void *_data, size_t len)
 		else	{
 			memcpy (p+c->num,data,n), c->num = 0;
 			len-=n, data+=n;
-			sha512_block_data_order (c,p,1);
+			sha512_block (c,p,1);
 			}
 		}
 
 	if (len >= sizeof(c->u))
 		{
-			sha512_block_data_order (c,data,len/sizeof(c->u)),
+			sha512_block (c,data,len/sizeof(c->u)),
 			data += len,
 			len  %= sizeof(c->u),
 			data -= len;
@@ -54,7 +266,7 @@ int SHA512_Update (SHA512_CTX *c, const void *_data, size_t len)
 
 void SHA512_Transform (SHA512_CTX *c, const unsigned char *data)
 {
-    sha512_block_data_order (c,data,1);
+    sha512_block (c,data,1);
 }
 
 int SHA512_Final (unsigned char *md, SHA512_CTX *c)
@@ -66,7 +278,7 @@ int SHA512_Final (unsigned char *md, SHA512_CTX *c)
 	n++;
 	if (n > (sizeof(c->u)-16))
 		memset (p+n,0,sizeof(c->u)-n), n=0,
-		sha512_block_data_order (c,p,1);
+		sha512_block (c,p,1);
 
 	memset (p+n,0,sizeof(c->u)-16-n);
 	p[sizeof(c->u)-1]  = (unsigned char)(c->Nl);
@@ -86,7 +298,7 @@ int SHA512_Final (unsigned char *md, SHA512_CTX *c)
 	p[sizeof(c->u)-15] = (unsigned char)(c->Nh>>48);
 	p[sizeof(c->u)-16] = (unsigned char)(c->Nh>>56);
 
-	sha512_block_data_order (c,p,1);
+	sha512_block (c,p,1);
 
 	if (md==0) return 0;
 
@@ -13,8 +13,13 @@ extern "C" {
 #define SHA512_CBLOCK	(SHA_LBLOCK*8)	/* SHA-512 treats input data as a
 					 * contiguous array of 64 bit
 					 * wide big-endian values. */
+#if defined(_MSC_VER)
 #define SHA_LONG64 unsigned __int64
 #define U64(C)     C##UI64
+#else
+#define SHA_LONG64 unsigned long long
+#define U64(C)     C##ULL
+#endif
 typedef struct SHA512state_st
 	{
 	SHA_LONG64 h[8];
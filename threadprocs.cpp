@@ -21,62 +21,108 @@
 #include "globals.h"
 #include <process.h>
 #include <commctrl.h>
-#ifdef _WIN64
-#include "ed2k_hash_cryptapi.h"
-#else
-#include "ed2k_hash.h"
-#endif
-#include "sha1_ossl.h"
-#include "md5_ossl.h"
-#include "sha256_ossl.h"
-#include "sha512_ossl.h"
+#include <intrin.h>
+#include <new>
+#include <vector>
+#include "hash_algorithms.h"
 extern "C" {
-#include "sha3\KeccakHash.h"
+#include "sha3\KeccakHashBatch.h"
 }
-#include "crc32c.h"
-#include "crc32.h"
-#include "blake2\blake2.h"
-#include "blake3\blake3.h"
+#include "mb_hash.h"
 #include "CSyncQueue.h"
 
-DWORD WINAPI ThreadProc_Md5Calc(VOID * pParam);
-DWORD WINAPI ThreadProc_Sha1Calc(VOID * pParam);
-DWORD WINAPI ThreadProc_Sha256Calc(VOID * pParam);
-DWORD WINAPI ThreadProc_Sha512Calc(VOID * pParam);
-DWORD WINAPI ThreadProc_Ed2kCalc(VOID * pParam);
-DWORD WINAPI ThreadProc_CrcCalc(VOID * pParam);
-DWORD WINAPI ThreadProc_Sha3_224Calc(VOID * pParam);
-DWORD WINAPI ThreadProc_Sha3_256Calc(VOID * pParam);
-DWORD WINAPI ThreadProc_Sha3_512Calc(VOID * pParam);
-DWORD WINAPI ThreadProc_Crc32cCalc(VOID * pParam);
-DWORD WINAPI ThreadProc_Blake2spCalc(VOID * pParam);
-DWORD WINAPI ThreadProc_Blake3Calc(VOID * pParam);
-
-// used in UINT __stdcall ThreadProc_Calc(VOID * pParam)
-#define SWAPBUFFERS() \
-	tempBuffer=readBuffer;\
-	dwBytesReadTb=dwBytesReadRb;\
-	readBuffer=calcBuffer;\
-	dwBytesReadRb=dwBytesReadCb;\
-	calcBuffer=tempBuffer;\
-	dwBytesReadCb=dwBytesReadTb
-
-typedef DWORD (WINAPI *threadfunc)(VOID * pParam);
-
-threadfunc hash_function[] = {
-    ThreadProc_CrcCalc,
-    ThreadProc_Md5Calc,
-    ThreadProc_Ed2kCalc,
-    ThreadProc_Sha1Calc,
-    ThreadProc_Sha256Calc,
-    ThreadProc_Sha512Calc,
-    ThreadProc_Sha3_224Calc,
-    ThreadProc_Sha3_256Calc,
-    ThreadProc_Sha3_512Calc,
-    ThreadProc_Crc32cCalc,
-    ThreadProc_Blake2spCalc,
-	ThreadProc_Blake3Calc,
-};
+DWORD WINAPI ThreadProc_HashWorker(VOID * pParam);
+DWORD WINAPI ThreadProc_FileStream(VOID * pParam);
+DWORD WINAPI ThreadProc_SegmentCalc(VOID * pParam);
+
+static UINT AssignHashWorkers(CONST BOOL bDoCalculate[NUM_HASH_TYPES], HASH_GROUP groups[NUM_HASH_TYPES]);
+
+static BOOL ReadFileIntoRing(THREAD_PARAMS_FILESTREAM *stream, CONST INT iFile);
+static VOID ReapReadBuffers(READ_RING *ring);
+static BOOL StartFileStreams(THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES], UINT *puiThreads, CONST UINT uiStreams);
+static VOID RunFileStreams(THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES], CONST UINT uiStreams,
+						   CONST vector<FILEINFO *> &files, CONST vector<UINT> &fileStream, vector<LONG> &fileState,
+						   CONST UINT uiFile, CONST UINT uiEnd);
+static VOID StopFileStreams(THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES], CONST UINT uiThreads);
+static BOOL CanHashInFileStream(CONST FILEINFO *pFileinfo, CONST BOOL bMultiBuffer);
+static BOOL GetFileSeekPenalty(CONST FILEINFO *pFileinfo, map<CString, BOOL> *pDirSeekPenalty);
+static UINT ScheduleFileStreams(lFILEINFO *fileList, CONST BOOL bDoCalculate[NUM_HASH_TYPES], CONST BOOL bMultiBuffer,
+								CONST UINT uiWorkers, CONST UINT uiFilesPerDevice, CONST UINT uiMaxStreams,
+								map<CString, BOOL> *pDirSeekPenalty, vector<FILEINFO *> *pFiles, vector<UINT> *pFileStream);
+static BOOL WaitForStreamFile(THREAD_PARAMS_CALC *pthread_params_calc, THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES],
+							  CONST UINT uiStreams, THREAD_PARAMS_FILESTREAM *stream, CONST vector<LONG> &fileState,
+							  CONST UINT uiFile, CONST QWORD qwBytesReadBase);
+static VOID WaitForFileStreams(THREAD_PARAMS_CALC *pthread_params_calc, THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES],
+							   CONST UINT uiStreams, CONST QWORD qwBytesReadBase);
+static BOOL StartHashWorkers(THREAD_PARAMS_HASHWORKER hashWorkers[NUM_HASH_TYPES], UINT *puiThreads, CONST UINT uiWorkers);
+static VOID StopHashWorkers(THREAD_PARAMS_HASHWORKER hashWorkers[NUM_HASH_TYPES], CONST UINT uiThreads);
+static VOID DestroyGroupContexts(HASH_GROUP groups[NUM_HASH_TYPES], CONST UINT uiWorkers);
+static VOID PostHashTask(THREAD_PARAMS_HASHWORKER *worker, HASH_GROUP *group, READ_RING *ring, READ_BUFFER *buffer);
+
+static UINT GetSegmentCount(CONST BOOL bDoCalculate[NUM_HASH_TYPES], CONST FILEINFO *pFileinfo,
+							map<CString, BOOL> *pDirSeekPenalty);
+static BOOL StartSegmentThreads(THREAD_PARAMS_SEGMENTCALC segments[MAXIMUM_WAIT_OBJECTS], UINT *puiThreads, CONST UINT uiSegments);
+static VOID StopSegmentThreads(THREAD_PARAMS_SEGMENTCALC segments[MAXIMUM_WAIT_OBJECTS], CONST UINT uiThreads);
+static BOOL CalcFileInSegments(THREAD_PARAMS_CALC *pthread_params_calc, THREAD_PARAMS_SEGMENTCALC segments[MAXIMUM_WAIT_OBJECTS],
+							   UINT *puiSegmentThreads, FILEINFO *pFileinfo, CONST BOOL bDoCalculate[NUM_HASH_TYPES], UINT uiSegments);
+static BOOL UseMultiBuffer(CONST BOOL bDoCalculate[NUM_HASH_TYPES]);
+static UINT CalcSmallFilesBatch(THREAD_PARAMS_CALC *pthread_params_calc, list<FILEINFO>::iterator itFirst,
+								list<FILEINFO>::iterator itEnd, CONST BOOL bDoCalculate[NUM_HASH_TYPES], BYTE *batchBuffer);
+
+// files are only split into segments if each segment gets at least this many bytes
+#define SEGMENT_MIN_SIZE (64 * 1024 * 1024)
+
+// files smaller than this are read whole and hashed together in the lanes of MB_Hash
+#define MB_MAX_FILE_SIZE (64 * 1024)
+// number of small files read and hashed in one batch
+#define MB_BATCH_FILES 64
+
+// StorageDeviceSeekPenaltyProperty and its descriptor, only declared by the Windows 7 SDK headers
+#define STORAGE_SEEK_PENALTY_PROPERTY ((STORAGE_PROPERTY_ID)7)
+typedef struct _SEEK_PENALTY_DESCRIPTOR {
+	DWORD Version;
+	DWORD Size;
+	BOOLEAN IncursSeekPenalty;
+} SEEK_PENALTY_DESCRIPTOR;
+
+// entry of ScheduleFileStreams' stream list for a file that ThreadProc_Calc hashes itself
+#define NO_FILE_STREAM ((UINT)-1)
+
+// state of a file of the job that a stream hashes
+#define FILE_STREAM_PENDING 0
+#define FILE_STREAM_DONE 1
+#define FILE_STREAM_STOPPED 2
+
+// memory all file streams of a job may take together for their read rings and hash
+// contexts, fewer files are hashed at once than asked for if they would not fit
+#define READ_BUFFER_BUDGET (256 * 1024 * 1024)
+
+// the fused worker runs all of its hashes over one block before moving on, so that
+// only the first hash has to pull the block from memory (half of a typical L1 data cache)
+#define FUSED_BLOCK_SIZE (16 * 1024)
+// a worker may get this much more work than the slowest single hash before a new one is used
+#define FUSED_COST_SLACK 1.25f
+// blocks hashed per algorithm when measuring the cycles per byte
+#define FUSED_COST_ROUNDS 16
+
+// type-erased HashAlgorithm<>, so that code that picks the hashes at runtime does not
+// need a switch over the hash types, see hash_algorithms.h
+typedef struct _HASH_ALGORITHM_INFO {
+	VOID *	(*pfnCreate)();						// new initialized context, free with pfnDestroy
+	VOID	(*pfnUpdate)(VOID *context, CONST BYTE *data, DWORD dwLength);
+	VOID	(*pfnCombine)(VOID *context, CONST VOID *next, QWORD qwLength);
+	VOID	(*pfnFinal)(VOID *context, VOID *result);
+	VOID	(*pfnDestroy)(VOID *context);
+	VOID	(*pfnReset)(VOID *context);			// initializes a finalized context again
+	VOID	(*pfnHashOnce)(CONST BYTE *data, DWORD dwLength, VOID *result);
+	DWORD	dwDigestSize;
+	BOOL	bMergeable;
+	BOOL	bMultiBuffer;
+	BOOL	bFusable;
+} HASH_ALGORITHM_INFO;
+
+// indexed by hash type, defined after the generic worker
+extern CONST HASH_ALGORITHM_INFO hash_algorithms[NUM_HASH_TYPES];
 
 /*****************************************************************************
 UINT __stdcall ThreadProc_Calc(VOID * pParam)
@@ -87,9 +133,19 @@ Return Value:
 
 Notes:
 - requests jobs from the queue and calculates hashes until the queue is empty
-- spawns up to three additional threads, one for each hash value
-- performs asynchronous I/O with two buffers -> one buffer is filled while the hash-threads
-  work on the other buffer
+- keeps a pool of hash workers per file stream for all files and jobs, one per hash value, cheap hashes
+  are grouped into a single worker (see AssignHashWorkers and RunHashTask)
+- performs asynchronous I/O with a ring of uiReadBufferCount buffers, every free buffer has
+  a read outstanding and every hash-thread works through the filled ones at its own pace
+  (see ReadFileIntoRing)
+- up to uiConcurrentFiles files per disk are read at the same time, each by a file stream
+  with a ring of its own. Every disk of the job gets streams of its own, the files of a
+  stream are read one after the other (see ScheduleFileStreams) without waiting for the
+  files of other streams. Results are still collected in list order (see RunFileStreams)
+- large files are split into byte ranges that are hashed in parallel if only CRC32/CRC32C/CRC64
+  are requested (see CalcFileInSegments)
+- runs of small files are hashed together with the multi-buffer MD5/SHA1/SHA256 and
+  SHA3 code if nothing else is requested (see CalcSmallFilesBatch)
 - if an error occured, GetLastError() is saved in the current pFileinfo->dwError
 - what has be calculated is determined by bDoCalculate[HASH_TYPE_CRC32]/bDoCalculate[HASH_TYPE_MD5]/bDoCalculate[HASH_TYPE_ED2K] of the
   current job
@@ -103,49 +159,43 @@ UINT __stdcall ThreadProc_Calc(VOID * pParam)
 	BOOL bDoCalculate[NUM_HASH_TYPES];
 
 	QWORD qwStart, qwStop, wqFreq;
-	HANDLE hFile;
     UINT uiBufferSize = g_program_options.uiReadBufferSizeKb * 1024;
 	bool doUnbufferedReads = g_program_options.bUseUnbufferedReads;
-	BYTE *readBuffer = NULL;
-	BYTE *calcBuffer = NULL;
-	if (doUnbufferedReads) {
-		readBuffer = (BYTE *)VirtualAlloc(NULL, uiBufferSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-		calcBuffer = (BYTE *)VirtualAlloc(NULL, uiBufferSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
-	} else {
-		readBuffer = (BYTE *)malloc(uiBufferSize);
-		calcBuffer = (BYTE *)malloc(uiBufferSize);
-	}
-	BYTE *tempBuffer;
-	DWORD readWords[2];
-	DWORD *dwBytesReadRb = &readWords[0];
-	DWORD *dwBytesReadCb = &readWords[1];
-	DWORD *dwBytesReadTb;
-	BOOL bSuccess;
 	BOOL bFileDone;
-	BOOL bAsync;
-
-    HANDLE hEvtThreadGo[NUM_HASH_TYPES];
-    HANDLE hEvtThreadReady[NUM_HASH_TYPES];
-
-	HANDLE hEvtReadDone;
-	OVERLAPPED olp;
-	ZeroMemory(&olp,sizeof(olp));
-
-    HANDLE hThread[NUM_HASH_TYPES];
-	
-	HANDLE hEvtReadyHandles[NUM_HASH_TYPES];
-	DWORD cEvtReadyHandles;
-
-    THREAD_PARAMS_HASHCALC calcParams[NUM_HASH_TYPES];
+	BOOL bMultiBuffer;
+	UINT uiBatchFiles;
+	BYTE *batchBuffer = NULL;
+
+    HASH_GROUP groups[NUM_HASH_TYPES];
+	UINT uiWorkers;
+
+	THREAD_PARAMS_FILESTREAM *fileStreams = new THREAD_PARAMS_FILESTREAM[MAX_CONCURRENT_FILES];
+	UINT uiStreamThreads = 0;
+	UINT uiStreams, uiMaxStreams, uiFile;
+	UINT uiRunEnd;								// the streams hash the files up to here, see RunFileStreams
+	THREAD_PARAMS_SEGMENTCALC *segments = new THREAD_PARAMS_SEGMENTCALC[MAXIMUM_WAIT_OBJECTS];
+	UINT uiSegmentThreads = 0;
+	vector<FILEINFO *> jobFiles;
+	vector<UINT> fileStream;					// stream of every file of the job, see ScheduleFileStreams
+	vector<LONG> fileState;						// FILE_STREAM_* of every file of the job
+	map<CString, BOOL> dirSeekPenalty;			// see GetFileSeekPenalty
+	QWORD qwBytesReadBase = 0;
 
 	lFILEINFO *fileList;
 	list<FILEINFO*> finalList;
 
-	if(readBuffer == NULL || calcBuffer == NULL) {
-		ShowErrorMsg(arrHwnd[ID_MAIN_WND],GetLastError());
-		ExitProcess(1);
+	for(UINT s=0;s<MAX_CONCURRENT_FILES;s++) {
+		fileStreams[s].uiBufferSize = uiBufferSize;
+		fileStreams[s].bUnbufferedReads = doUnbufferedReads;
+		fileStreams[s].uiHashThreads = 0;
+		fileStreams[s].uiWorkers = 0;
 	}
-	
+	for(UINT i=0;i<MAXIMUM_WAIT_OBJECTS;i++) {
+		segments[i].uiBufferSize = uiBufferSize;
+		segments[i].bUnbufferedReads = doUnbufferedReads;
+		segments[i].pthread_params_calc = pthread_params_calc;
+	}
+
 
 	// set some UI stuff:
 	// - disable action buttons while in thread
@@ -155,37 +205,64 @@ UINT __stdcall ThreadProc_Calc(VOID * pParam)
 	
 	while((fileList = SyncQueue.popQueue()) != NULL) {
 
-        cEvtReadyHandles = 0;
-
         for(int i=0;i<NUM_HASH_TYPES;i++) {
 		    bDoCalculate[i]	= !fileList->bCalculated[i] && fileList->bDoCalculate[i];
-
-            if(bDoCalculate[i]) {
+            if(bDoCalculate[i])
 			    fileList->bCalculated[i] = TRUE;
-			    hEvtThreadGo[i] = CreateEvent(NULL,FALSE,FALSE,NULL);
-			    hEvtThreadReady[i] = CreateEvent(NULL,FALSE,FALSE,NULL);
-			    if(hEvtThreadGo[i] == NULL || hEvtThreadReady[i] == NULL) {
-				    ShowErrorMsg(arrHwnd[ID_MAIN_WND],GetLastError());
-				    ExitProcess(1);
-			    }
-			    hEvtReadyHandles[cEvtReadyHandles] = hEvtThreadReady[i];
-			    cEvtReadyHandles++;
-			    calcParams[i].bFileDone = &bFileDone;
-			    calcParams[i].hHandleGo = hEvtThreadGo[i];
-			    calcParams[i].hHandleReady = hEvtThreadReady[i];
-			    calcParams[i].buffer = &calcBuffer;
-			    calcParams[i].dwBytesRead = &dwBytesReadCb;
-		    }
         }
 
-		hEvtReadDone = CreateEvent(NULL,FALSE,FALSE,NULL);
-		if(hEvtReadDone == NULL) {
-			ShowErrorMsg(arrHwnd[ID_MAIN_WND],GetLastError());
-			ExitProcess(1);
+        uiWorkers = AssignHashWorkers(bDoCalculate, groups);
+        for(UINT w=0;w<uiWorkers;w++) {
+            for(UINT k=0;k<groups[w].uiHashCount;k++)
+                groups[w].context[k] = NULL;
+        }
+
+		bMultiBuffer = UseMultiBuffer(bDoCalculate);
+
+		// every ring takes uiReadBufferCount buffers, an ED2K context up to ED2K_MAX_PARTS_IN_FLIGHT
+		// part buffers on top, stay within READ_BUFFER_BUDGET
+		QWORD qwStreamMemory = (QWORD)g_program_options.uiReadBufferCount * uiBufferSize;
+		if(bDoCalculate[HASH_TYPE_ED2K])
+			qwStreamMemory += (QWORD)ED2K_MAX_PARTS_IN_FLIGHT * BLOCKSIZE;
+		uiMaxStreams = MAX_CONCURRENT_FILES;
+		if(uiMaxStreams > READ_BUFFER_BUDGET / qwStreamMemory)
+			uiMaxStreams = (UINT)(READ_BUFFER_BUDGET / qwStreamMemory);
+		if(uiMaxStreams < 1)
+			uiMaxStreams = 1;
+		uiStreams = ScheduleFileStreams(fileList, bDoCalculate, bMultiBuffer, uiWorkers,
+										fileList->uiConcurrentFiles ? fileList->uiConcurrentFiles : g_program_options.uiConcurrentFiles,
+										uiMaxStreams, &dirSeekPenalty, &jobFiles, &fileStream);
+		if(!StartFileStreams(fileStreams, &uiStreamThreads, uiStreams)) {
+		    ShowErrorMsg(arrHwnd[ID_MAIN_WND],GetLastError());
+		    ExitProcess(1);
+		}
+		for(UINT s=0;s<uiStreams;s++) {
+			// every stream has its own workers, a group keeps its order within the stream
+			if(!StartHashWorkers(fileStreams[s].hashWorkers, &fileStreams[s].uiHashThreads, uiWorkers)) {
+				ShowErrorMsg(arrHwnd[ID_MAIN_WND],GetLastError());
+				ExitProcess(1);
+			}
+			fileStreams[s].pthread_params_calc = pthread_params_calc;
+			// the contexts of the last job the stream had are kept until now
+			DestroyGroupContexts(fileStreams[s].groups, fileStreams[s].uiWorkers);
+			fileStreams[s].uiWorkers = uiWorkers;
+			memcpy(fileStreams[s].groups, groups, sizeof(groups));
+			fileStreams[s].bBusy = FALSE;
 		}
+		fileState.assign(jobFiles.size(), FILE_STREAM_PENDING);
+		uiRunEnd = 0;
 
 		QueryPerformanceFrequency((LARGE_INTEGER*)&wqFreq);
 
+		uiBatchFiles = 0;
+		if(bMultiBuffer && batchBuffer == NULL) {
+			batchBuffer = (BYTE *)VirtualAlloc(NULL, MB_BATCH_FILES * MB_MAX_FILE_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if(batchBuffer == NULL) {
+				ShowErrorMsg(arrHwnd[ID_MAIN_WND],GetLastError());
+				ExitProcess(1);
+			}
+		}
+
 		if(g_program_options.bEnableQueue && g_pstatus.bHaveComCtrlv6) {
 			if(fileList->iGroupId==0)
 				InsertGroupIntoListView(arrHwnd[ID_LISTVIEW],fileList);
@@ -195,7 +272,8 @@ UINT __stdcall ThreadProc_Calc(VOID * pParam)
             ListView_DeleteAllItems(arrHwnd[ID_LISTVIEW]);
         }
 
-		for(list<FILEINFO>::iterator it=fileList->fInfos.begin();it!=fileList->fInfos.end();it++)
+		uiFile = 0;
+		for(list<FILEINFO>::iterator it=fileList->fInfos.begin();it!=fileList->fInfos.end();it++,uiFile++)
 		{
 			pthread_params_calc->pFileinfo_cur = &(*it);
 			pthread_params_calc->qwBytesReadCurFile = 0;
@@ -204,91 +282,50 @@ UINT __stdcall ThreadProc_Calc(VOID * pParam)
 
             bFileDone = TRUE; // assume done until we successfully opened the file
 
-			if ( (curFileInfo.dwError == NO_ERROR) && cEvtReadyHandles > 0)
+			// no stream runs when ThreadProc_Calc reaches a file of its own
+			if(bMultiBuffer && uiBatchFiles == 0 && fileStream[uiFile] == NO_FILE_STREAM && !pthread_params_calc->signalStop)
+				uiBatchFiles = CalcSmallFilesBatch(pthread_params_calc, it, fileList->fInfos.end(), bDoCalculate, batchBuffer);
+
+			if(uiBatchFiles > 0)
+			{
+				// already hashed together with the following files, only the list entry is left
+				uiBatchFiles--;
+			}
+			else if (fileStream[uiFile] != NO_FILE_STREAM || ((curFileInfo.dwError == NO_ERROR) && uiWorkers > 0))
 			{
 
                 DisplayStatusOverview(arrHwnd[ID_EDIT_STATUS]);
 
-				QueryPerformanceCounter((LARGE_INTEGER*) &qwStart);
-				DWORD flags = FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN;
-				if (doUnbufferedReads) {
-					flags |= FILE_FLAG_NO_BUFFERING;
-				}
-				hFile = CreateFile(curFileInfo.szFilename,
-						GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, 0);
-				if(hFile == INVALID_HANDLE_VALUE) {
-					curFileInfo.dwError = GetLastError();
-                } else {
-
-				    bFileDone = FALSE;
-
-                    for(int i=0;i<NUM_HASH_TYPES;i++) {
-                        if(bDoCalculate[i]) {
-                            ResetEvent(hEvtThreadGo[i]);
-                            ResetEvent(hEvtThreadReady[i]);
-                            calcParams[i].result = &curFileInfo.hashInfo[i].r;
-					        hThread[i] = CreateThread(NULL,0,hash_function[i],&calcParams[i],0,NULL);
-					        if(hThread[i] == NULL) {
-						        ShowErrorMsg(arrHwnd[ID_MAIN_WND],GetLastError());
-						        ExitProcess(1);
-					        }
-                        }
-				    }
-
-				    ZeroMemory(&olp,sizeof(olp));
-				    olp.hEvent = hEvtReadDone;
-				    olp.Offset = 0;
-				    olp.OffsetHigh = 0;
-				    bSuccess = ReadFile(hFile, readBuffer, uiBufferSize, dwBytesReadRb, &olp);
-				    if(!bSuccess && (GetLastError()==ERROR_IO_PENDING))
-					    bAsync = TRUE;
-				    else
-					    bAsync = FALSE;
-
-				    do {
-					    if(bAsync)
-						    bSuccess = GetOverlappedResult(hFile,&olp,dwBytesReadRb,TRUE);
-					    if(!bSuccess && (GetLastError() != ERROR_HANDLE_EOF)) {
-						    curFileInfo.dwError = GetLastError();
-						    bFileDone = TRUE;
-					    }
-					    pthread_params_calc->qwBytesReadCurFile  += *dwBytesReadRb; //for progress bar
-					    pthread_params_calc->qwBytesReadAllFiles += *dwBytesReadRb;
-
-					    olp.Offset = pthread_params_calc->qwBytesReadCurFile & 0xffffffff;
-					    olp.OffsetHigh = (pthread_params_calc->qwBytesReadCurFile >> 32) & 0xffffffff;
-    					
-					    WaitForMultipleObjects(cEvtReadyHandles,hEvtReadyHandles,TRUE,INFINITE);
-					    SWAPBUFFERS();
-					    bSuccess = ReadFile(hFile, readBuffer, uiBufferSize, dwBytesReadRb, &olp);
-					    if(!bSuccess && (GetLastError()==ERROR_IO_PENDING))
-						    bAsync = TRUE;
-					    else
-						    bAsync = FALSE;
-
-					    if(*dwBytesReadCb < uiBufferSize)
-						    bFileDone=TRUE;
-
-                        for(int i=0;i<NUM_HASH_TYPES;i++) {
-                            if(bDoCalculate[i])
-						        SetEvent(hEvtThreadGo[i]);
-                        }
-
-				    } while(!bFileDone && !pthread_params_calc->signalStop);
-
-				    WaitForMultipleObjects(cEvtReadyHandles,hEvtReadyHandles,TRUE,INFINITE);
-
-				    if(hFile != NULL)
-					    CloseHandle(hFile);
-
-                    for(int i=0;i<NUM_HASH_TYPES;i++) {
-                        if(bDoCalculate[i])
-					        CloseHandle(hThread[i]);
-                    }
+				// ScheduleFileStreams leaves a large file to ThreadProc_Calc if it is to be split
+				UINT uiSegments = fileStream[uiFile] != NO_FILE_STREAM ? 1 : GetSegmentCount(bDoCalculate, &curFileInfo, &dirSeekPenalty);
+				if(uiSegments > 1) {
+					// only CRCs requested, hash byte ranges in parallel and combine them
+				    QueryPerformanceCounter((LARGE_INTEGER*) &qwStart);
+
+					bFileDone = CalcFileInSegments(pthread_params_calc, segments, &uiSegmentThreads, &curFileInfo, bDoCalculate, uiSegments);
 
 				    QueryPerformanceCounter((LARGE_INTEGER*) &qwStop);
 				    curFileInfo.fSeconds = (float)((qwStop - qwStart) / (float)wqFreq);
-                }
+				} else {
+					// all streams are idle, start them on the files up to the next one ThreadProc_Calc hashes itself
+					if(uiFile >= uiRunEnd) {
+						qwBytesReadBase = pthread_params_calc->qwBytesReadAllFiles;
+						if(fileStream[uiFile] == NO_FILE_STREAM) {
+							// a small file that did not make it into a batch
+							fileStream[uiFile] = 0;
+							uiRunEnd = uiFile + 1;
+						} else {
+							for(uiRunEnd=uiFile+1;uiRunEnd<jobFiles.size() && fileStream[uiRunEnd]!=NO_FILE_STREAM;uiRunEnd++);
+						}
+						RunFileStreams(fileStreams, uiStreams, jobFiles, fileStream, fileState, uiFile, uiRunEnd);
+					}
+
+					bFileDone = WaitForStreamFile(pthread_params_calc, fileStreams, uiStreams, &fileStreams[fileStream[uiFile]],
+												  fileState, uiFile, qwBytesReadBase);
+
+					if(uiFile + 1 == uiRunEnd)
+						WaitForFileStreams(pthread_params_calc, fileStreams, uiStreams, qwBytesReadBase);
+				}
 			}
 
             curFileInfo.status = InfoToIntValue(&curFileInfo);
@@ -308,6 +345,10 @@ UINT __stdcall ThreadProc_Calc(VOID * pParam)
 			    ShowResult(arrHwnd, &curFileInfo, pshowresult_params);
             }
 
+			// files after the current one are dropped, the streams have to let go of them first
+            if(pthread_params_calc->signalStop)
+                WaitForFileStreams(pthread_params_calc, fileStreams, uiStreams, qwBytesReadBase);
+
 			// we are stopping, need to remove unfinished file entries from the list and adjust count
             if(pthread_params_calc->signalStop && !pthread_params_calc->signalExit) {
 				// if current file is done keep it
@@ -324,13 +365,6 @@ UINT __stdcall ThreadProc_Calc(VOID * pParam)
                 break;
 		}
 
-        for(int i=0;i<NUM_HASH_TYPES;i++) {
-            if(bDoCalculate[i]) {
-		        CloseHandle(hEvtThreadGo[i]);
-			    CloseHandle(hEvtThreadReady[i]);
-            }
-        }
-
 		// if we are stopping remove any open lists from the queue
         if(pthread_params_calc->signalStop) {
             SyncQueue.clearQueue();
@@ -367,14 +401,18 @@ UINT __stdcall ThreadProc_Calc(VOID * pParam)
 		EnableWindowsForThread(arrHwnd, TRUE);
 
 	PostMessage(arrHwnd[ID_MAIN_WND], WM_THREAD_CALC_DONE, 0, 0);
-	
-	if (doUnbufferedReads) {
-		VirtualFree(readBuffer, 0, MEM_RELEASE);
-		VirtualFree(calcBuffer, 0, MEM_RELEASE);
-	} else {
-		free(readBuffer);
-		free(calcBuffer);
+
+	StopFileStreams(fileStreams, uiStreamThreads);
+	for(UINT s=0;s<MAX_CONCURRENT_FILES;s++) {
+		StopHashWorkers(fileStreams[s].hashWorkers, fileStreams[s].uiHashThreads);
+		DestroyGroupContexts(fileStreams[s].groups, fileStreams[s].uiWorkers);
 	}
+	delete [] fileStreams;
+	StopSegmentThreads(segments, uiSegmentThreads);
+	delete [] segments;
+
+	if (batchBuffer != NULL)
+		VirtualFree(batchBuffer, 0, MEM_RELEASE);
 
 	_endthreadex( 0 );
 	return 0;
@@ -424,6 +462,7 @@ UINT __stdcall ThreadProc_FileInfo(VOID * pParam)
         ProcessDirectories(fileList, arrHwnd[ID_EDIT_STATUS], TRUE);
         for(list<FILEINFO>::iterator it=fileList->fInfos.begin();it!=fileList->fInfos.end();it++) {
             lFILEINFO *pHashList = new lFILEINFO;
+            pHashList->uiConcurrentFiles = fileList->uiConcurrentFiles;
             pHashList->fInfos.push_back((*it));
             PostProcessList(arrHwnd, pshowresult_params, pHashList);
             SyncQueue.pushQueue(pHashList);
@@ -518,363 +557,1402 @@ void StartAcceptPipeThread(CONST HWND *arrHwnd, lFILEINFO * fileList) {
 }
 
 /*****************************************************************************
-DWORD WINAPI ThreadProc_Md5Calc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+BOOL ReadFileIntoRing(THREAD_PARAMS_FILESTREAM *stream, CONST INT iFile)
+	stream	: (IN/OUT) the stream of pFileinfo, all buffers of its ring are free,
+			  receives the progress and pFileinfo->dwError
+	iFile	: (IN) the file, opened with file_io_open on the FILE_IO of the ring
 
 Return Value:
-	returns 0
+	FALSE if the read was stopped through signalStop, TRUE otherwise
 
 Notes:
-- initializes the md5 hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- keeps a read outstanding for every buffer that no worker holds, so a slow hash only
+  stalls the reader once the whole ring is filled and a slow read only stalls the
+  workers once they have caught up
+- the reads go through file_io.h, the overlapped backend issues them with ReadFile
+- reads past the file size from the listing are only issued if nothing else is
+  pending, the end of the file is found by a short read as before
+- no new reads are issued while hEvtRun is reset (pause button)
+- completed reads are handed out in file order: the buffer gets a reference for every
+  worker and a HASH_TASK is posted to each of them. The worker that releases the last
+  reference returns the buffer to hSemFree (see ReleaseReadBuffer)
+- the last buffer (short read, error or stop) has bLast set, reads issued after it are
+  cancelled. Returns after the last buffer was handed out, hEvtHashed of the ring is
+  set once all workers wrote their results
 *****************************************************************************/
-DWORD WINAPI ThreadProc_Md5Calc(VOID * pParam)
+static BOOL ReadFileIntoRing(THREAD_PARAMS_FILESTREAM *stream, CONST INT iFile)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	THREAD_PARAMS_CALC * CONST pthread_params_calc = stream->pthread_params_calc;
+	FILEINFO * CONST pFileinfo = stream->pFileinfo;
+	READ_RING * CONST ring = &stream->ring;
+	CONST UINT uiBufferSize = stream->uiBufferSize;
+	CONST UINT uiWorkers = stream->uiWorkers;
+	READ_BUFFER *rb;
+	UINT uiIssued = 0, uiDone = 0;		// reads started and handed out, buffer index is the count modulo uiCount
+	QWORD qwOffset = 0;
+	BOOL bLast = FALSE, bStopped = FALSE;
+	INT iResult;
+
+	ring->lWorkersBusy = uiWorkers;
+	ResetEvent(ring->hEvtHashed);
+
+	while(!bLast) {
+		// paused, the reads already issued are still handed out when it goes on
+		WaitForSingleObject(pthread_params_calc->hEvtRun, INFINITE);
+
+		while(!pthread_params_calc->signalStop && uiIssued - uiDone < ring->uiCount &&
+			  (uiIssued == uiDone || qwOffset <= pFileinfo->qwFilesize) &&
+			  WaitForSingleObject(ring->hSemFree, uiIssued == uiDone ? INFINITE : 0) == WAIT_OBJECT_0) {
+			rb = &ring->buffers[uiIssued % ring->uiCount];
+			rb->bRead = FALSE;
+			if((iResult = file_io_read(ring->io, iFile, uiIssued % ring->uiCount, qwOffset, uiBufferSize)) < 0) {
+				// not queued, there is nothing to reap
+				rb->dwError = (DWORD)-iResult;
+				rb->dwBytesRead = 0;
+				rb->bRead = TRUE;
+			}
+			qwOffset += uiBufferSize;
+			uiIssued++;
+		}
+		if((iResult = file_io_submit(ring->io)) < 0)
+			pFileinfo->dwError = (DWORD)-iResult;
+
+		if(uiIssued == uiDone) {
+			// stopped with nothing in flight, the workers still need a last buffer to finish
+			WaitForSingleObject(ring->hSemFree, INFINITE);
+			rb = &ring->buffers[uiIssued % ring->uiCount];
+			rb->dwBytesRead = 0;
+			uiIssued++;
+			bLast = bStopped = TRUE;
+		} else {
+			rb = &ring->buffers[uiDone % ring->uiCount];
+			while(!rb->bRead)
+				ReapReadBuffers(ring);
+			if(rb->dwError != NO_ERROR) {
+				rb->dwBytesRead = 0;
+				pFileinfo->dwError = rb->dwError;
+			}
+			stream->qwBytesReadFile += rb->dwBytesRead; //for progress bar
+			stream->qwBytesRead += rb->dwBytesRead;
 
-	MD5_CTX context;
-	MD5_Init(&context);
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		MD5_Update(&context, *buffer, **dwBytesRead);
-	} while (!(*bFileDone));
-	MD5_Final(result,&context);
-	SetEvent(hEvtThreadReady);
-	return 0;
+			bLast = rb->dwError != NO_ERROR || rb->dwBytesRead < uiBufferSize;
+			if(!bLast && pthread_params_calc->signalStop)
+				bLast = bStopped = TRUE;
+		}
+
+		rb->bLast = bLast;
+		rb->lPending = uiWorkers;
+		uiDone++;
+		for(UINT w=0;w<uiWorkers;w++)
+			PostHashTask(&stream->hashWorkers[w], &stream->groups[w], ring, rb);
+	}
+
+	if(uiIssued != uiDone) {
+		file_io_cancel(ring->io, iFile);
+		for(;uiDone != uiIssued;uiDone++) {
+			rb = &ring->buffers[uiDone % ring->uiCount];
+			while(!rb->bRead)
+				ReapReadBuffers(ring);
+			ReleaseSemaphore(ring->hSemFree, 1, NULL);
+		}
+	}
+
+	return !bStopped;
+}
+
+// waits for at least one read of the ring and stores the results in the buffers
+static VOID ReapReadBuffers(READ_RING *ring)
+{
+	FILE_IO_COMPLETION completions[MAX_BUFFER_COUNT_CALC];
+	INT iCompleted = file_io_reap(ring->io, completions, ring->uiCount, TRUE);
+
+	if(iCompleted <= 0) {
+		// nothing left to wait for, the buffers that are still expected fail
+		for(UINT b=0;b<ring->uiCount;b++) {
+			if(!ring->buffers[b].bRead) {
+				ring->buffers[b].dwError = iCompleted < 0 ? (DWORD)-iCompleted : ERROR_READ_FAULT;
+				ring->buffers[b].dwBytesRead = 0;
+				ring->buffers[b].bRead = TRUE;
+			}
+		}
+		return;
+	}
+	for(INT i=0;i<iCompleted;i++) {
+		READ_BUFFER * CONST rb = &ring->buffers[completions[i].buffer];
+		if(completions[i].result < 0) {
+			rb->dwError = (DWORD)-completions[i].result;
+			rb->dwBytesRead = 0;
+		} else {
+			rb->dwError = NO_ERROR;
+			rb->dwBytesRead = (DWORD)completions[i].result;
+		}
+		rb->bRead = TRUE;
+	}
 }
 
 /*****************************************************************************
-DWORD WINAPI ThreadProc_Sha1Calc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+BOOL CreateReadRing(READ_RING *ring, CONST UINT uiCount, CONST UINT uiBufferSize)
+	ring				: (OUT) the ring
+	uiCount				: (IN) number of buffers
+	uiBufferSize		: (IN) size of every buffer
 
 Return Value:
-	returns 0
+	FALSE if an allocation failed
 
 Notes:
-- initializes the sha1 hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- the buffers belong to a FILE_IO, the backend is picked by file_io_create (RAPIDCRC_IO
+  in the environment, otherwise overlapped ReadFile). They are page aligned, so they
+  can be used with FILE_FLAG_NO_BUFFERING
 *****************************************************************************/
-DWORD WINAPI ThreadProc_Sha1Calc(VOID * pParam)
+static BOOL CreateReadRing(READ_RING *ring, CONST UINT uiCount, CONST UINT uiBufferSize)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	ring->uiCount = uiCount;
+	ring->buffers = (READ_BUFFER *)calloc(uiCount, sizeof(READ_BUFFER));
+	ring->hSemFree = CreateSemaphore(NULL, uiCount, uiCount, NULL);
+	ring->hEvtHashed = CreateEvent(NULL,TRUE,FALSE,NULL);
+	ring->io = file_io_create(NULL, uiCount, uiBufferSize);
+	if(ring->buffers == NULL || ring->hSemFree == NULL || ring->hEvtHashed == NULL || ring->io == NULL)
+		return FALSE;
+	for(UINT b=0;b<uiCount;b++)
+		ring->buffers[b].data = file_io_buffer(ring->io, b);
+	return TRUE;
+}
 
-	SHA_CTX context;
-	SHA1_Init(&context);
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		SHA1_Update(&context, *buffer, **dwBytesRead);
-	} while (!(*bFileDone));
-	SHA1_Final(result,&context);
-	SetEvent(hEvtThreadReady);
-	return 0;
+static VOID DestroyReadRing(READ_RING *ring)
+{
+	file_io_destroy(ring->io);
+	free(ring->buffers);
+	CloseHandle(ring->hSemFree);
+	CloseHandle(ring->hEvtHashed);
 }
 
 /*****************************************************************************
-DWORD WINAPI ThreadProc_Sha256Calc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+DWORD WINAPI ThreadProc_FileStream(VOID * pParam)
+	pParam	: (IN/OUT) THREAD_PARAMS_FILESTREAM struct pointer special for this thread
 
 Return Value:
 	returns 0
 
 Notes:
-- initializes the sha256 hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- every time hEvtStart is set the files from uiFirstFile to uiEndFile that belong to
+  the stream are hashed one after the other, the results are in the FILEINFOs
+- after each file its plFileState entry is set and hEvtFile is signaled, so the next
+  file is started right away whether ThreadProc_Calc collected the last one or not.
+  hEvtDone is set after the last one
+- the reads of the file go through the ring of the stream, so several streams read
+  different files at the same time, each with its own hash workers
+- once signalStop is set the remaining files are marked as stopped without opening them
 *****************************************************************************/
-DWORD WINAPI ThreadProc_Sha256Calc(VOID * pParam)
+DWORD WINAPI ThreadProc_FileStream(VOID * pParam)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	THREAD_PARAMS_FILESTREAM * CONST stream = (THREAD_PARAMS_FILESTREAM *)pParam;
+	QWORD qwStart, qwStop, wqFreq;
+	INT iFile;
+	BOOL bFileDone;
+
+	QueryPerformanceFrequency((LARGE_INTEGER*)&wqFreq);
+
+	for(;;) {
+		WaitForSingleObject(stream->hEvtStart, INFINITE);
+		if(stream->bExit)
+			break;
+
+		for(UINT f=stream->uiFirstFile;f<stream->uiEndFile;f++) {
+			if(stream->puiFileStream[f] != stream->uiStream)
+				continue;
+
+			FILEINFO * CONST pFileinfo = stream->ppFiles[f];
+			stream->pFileinfo = pFileinfo;
+			stream->qwBytesReadFile = 0;
+			stream->uiFile = f;
+			bFileDone = !stream->pthread_params_calc->signalStop;
+
+			if(bFileDone) {
+				QueryPerformanceCounter((LARGE_INTEGER*) &qwStart);
+				if((iFile = file_io_open(stream->ring.io, pFileinfo->szFilename, stream->bUnbufferedReads)) < 0) {
+					pFileinfo->dwError = (DWORD)-iFile;
+				} else {
+					for(UINT w=0;w<stream->uiWorkers;w++) {
+						for(UINT k=0;k<stream->groups[w].uiHashCount;k++)
+							stream->groups[w].result[k] = &pFileinfo->hashInfo[stream->groups[w].uiHashType[k]].r;
+					}
+
+					bFileDone = ReadFileIntoRing(stream, iFile);
+
+					// the buffers are released before the results are written, so all of them are free again
+					WaitForSingleObject(stream->ring.hEvtHashed,INFINITE);
+
+					file_io_close(stream->ring.io, iFile);
+
+					QueryPerformanceCounter((LARGE_INTEGER*) &qwStop);
+					pFileinfo->fSeconds = (float)((qwStop - qwStart) / (float)wqFreq);
+				}
+			}
+
+			InterlockedExchange(&stream->plFileState[f], bFileDone ? FILE_STREAM_DONE : FILE_STREAM_STOPPED);
+			SetEvent(stream->hEvtFile);
+		}
+
+		SetEvent(stream->hEvtDone);
+	}
 
-	SHA256_CTX context;
-	SHA256_Init(&context);
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		SHA256_Update(&context, *buffer, **dwBytesRead);
-	} while (!(*bFileDone));
-	SHA256_Final(result,&context);
-	SetEvent(hEvtThreadReady);
 	return 0;
 }
 
 /*****************************************************************************
-DWORD WINAPI ThreadProc_Sha512Calc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+BOOL StartFileStreams(THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES], UINT *puiThreads, CONST UINT uiStreams)
+	fileStreams	: (IN/OUT) the streams, uiBufferSize and bUnbufferedReads have to be set
+	puiThreads	: (IN/OUT) number of running streams
+	uiStreams	: (IN) number of streams the job needs
 
 Return Value:
-	returns 0
+	FALSE if a stream could not be started
 
 Notes:
-- initializes the sha512 hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- like StartHashWorkers only the missing streams are started, each with a ring of
+  uiReadBufferCount buffers
 *****************************************************************************/
-DWORD WINAPI ThreadProc_Sha512Calc(VOID * pParam)
+static BOOL StartFileStreams(THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES], UINT *puiThreads, CONST UINT uiStreams)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	for(;*puiThreads<uiStreams;(*puiThreads)++) {
+		THREAD_PARAMS_FILESTREAM * CONST stream = &fileStreams[*puiThreads];
+		stream->uiStream = *puiThreads;
+		stream->bExit = FALSE;
+		stream->hEvtStart = CreateEvent(NULL,FALSE,FALSE,NULL);
+		stream->hEvtFile = CreateEvent(NULL,FALSE,FALSE,NULL);
+		stream->hEvtDone = CreateEvent(NULL,FALSE,FALSE,NULL);
+		if(stream->hEvtStart == NULL || stream->hEvtFile == NULL || stream->hEvtDone == NULL ||
+		   !CreateReadRing(&stream->ring, g_program_options.uiReadBufferCount, stream->uiBufferSize))
+			return FALSE;
+		stream->hThread = CreateThread(NULL,0,ThreadProc_FileStream,stream,0,NULL);
+		if(stream->hThread == NULL)
+			return FALSE;
+	}
+	return TRUE;
+}
 
-	SHA512_CTX context;
-	SHA512_Init(&context);
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		SHA512_Update(&context, *buffer, **dwBytesRead);
-	} while (!(*bFileDone));
-	SHA512_Final(result,&context);
-	SetEvent(hEvtThreadReady);
-	return 0;
+// ends all streams, none of them may have a file
+static VOID StopFileStreams(THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES], CONST UINT uiThreads)
+{
+	for(UINT s=0;s<uiThreads;s++) {
+		THREAD_PARAMS_FILESTREAM * CONST stream = &fileStreams[s];
+		stream->bExit = TRUE;
+		SetEvent(stream->hEvtStart);
+		WaitForSingleObject(stream->hThread, INFINITE);
+		CloseHandle(stream->hThread);
+		CloseHandle(stream->hEvtStart);
+		CloseHandle(stream->hEvtFile);
+		CloseHandle(stream->hEvtDone);
+		DestroyReadRing(&stream->ring);
+	}
 }
 
 /*****************************************************************************
-DWORD WINAPI ThreadProc_Sha3_224Calc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+BOOL CanHashInFileStream(CONST FILEINFO *pFileinfo, CONST BOOL bMultiBuffer)
+	pFileinfo		: (IN) a file of the current job
+	bMultiBuffer	: (IN) small files are hashed in batches
 
 Return Value:
-	returns 0
+	TRUE if the file can be hashed by a file stream
 
 Notes:
-- initializes the sha3-224 hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- files that are hashed in small file batches are left to ThreadProc_Calc, so are the
+  ones that already failed. Whether a file is split into segments instead depends on
+  the other files of its device, see ScheduleFileStreams
 *****************************************************************************/
-DWORD WINAPI ThreadProc_Sha3_224Calc(VOID * pParam)
+static BOOL CanHashInFileStream(CONST FILEINFO *pFileinfo, CONST BOOL bMultiBuffer)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	if(pFileinfo->dwError != NO_ERROR)
+		return FALSE;
+	return !bMultiBuffer || pFileinfo->qwFilesize > MB_MAX_FILE_SIZE;
+}
 
-	Keccak_HashInstance hashState;
-    Keccak_HashInitialize_SHA3_224(&hashState);
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		Keccak_HashUpdate(&hashState, *buffer, **dwBytesRead * 8);
-	} while (!(*bFileDone));
-	Keccak_HashFinal(&hashState, result);
-	SetEvent(hEvtThreadReady);
-	return 0;
+/*****************************************************************************
+DWORD GetFileDevice(CONST FILEINFO *pFileinfo, map<CString, DWORD> *pDirDevices)
+	pFileinfo	: (IN) the file
+	pDirDevices	: (IN/OUT) devices of the directories looked up so far
+
+Return Value:
+	serial number of the volume the file is on, 0 if it could not be determined
+
+Notes:
+- GetVolumeInformationByHandleW needs Vista, so the volume is found from the path
+- the files of a directory are on the same volume, only the first one is looked up
+*****************************************************************************/
+static DWORD GetFileDevice(CONST FILEINFO *pFileinfo, map<CString, DWORD> *pDirDevices)
+{
+	CString szDir = pFileinfo->szFilename.Left(pFileinfo->szFilename.ReverseFind(TEXT('\\')) + 1);
+	map<CString, DWORD>::iterator itDir = pDirDevices->find(szDir);
+	if(itDir != pDirDevices->end())
+		return itDir->second;
+
+	CString szVolume;
+	DWORD dwSerial = 0;
+	if(GetVolumePathName(pFileinfo->szFilename, szVolume.GetBuffer(MAX_PATH_EX), MAX_PATH_EX)) {
+		szVolume.ReleaseBuffer();
+		if(!GetVolumeInformation(szVolume, NULL, 0, &dwSerial, NULL, NULL, NULL, 0))
+			dwSerial = 0;
+	} else {
+		szVolume.ReleaseBuffer(0);
+	}
+
+	(*pDirDevices)[szDir] = dwSerial;
+	return dwSerial;
 }
 
 /*****************************************************************************
-DWORD WINAPI ThreadProc_Sha3_256Calc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+BOOL GetFileSeekPenalty(CONST FILEINFO *pFileinfo, map<CString, BOOL> *pDirSeekPenalty)
+	pFileinfo		: (IN) the file
+	pDirSeekPenalty	: (IN/OUT) results for the directories looked up so far
 
 Return Value:
-	returns 0
+	FALSE if the device the file is on reports that it does not seek (SSD), TRUE
+	otherwise
 
 Notes:
-- initializes the sha3-256 hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- the volume is asked with IOCTL_STORAGE_QUERY_PROPERTY, which forwards the query to
+  its disk. Before Windows 7, for network shares and volumes spanning several disks
+  the query fails and the device is taken to seek
 *****************************************************************************/
-DWORD WINAPI ThreadProc_Sha3_256Calc(VOID * pParam)
+static BOOL GetFileSeekPenalty(CONST FILEINFO *pFileinfo, map<CString, BOOL> *pDirSeekPenalty)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	CString szDir = pFileinfo->szFilename.Left(pFileinfo->szFilename.ReverseFind(TEXT('\\')) + 1);
+	map<CString, BOOL>::iterator itDir = pDirSeekPenalty->find(szDir);
+	if(itDir != pDirSeekPenalty->end())
+		return itDir->second;
+
+	BOOL bSeekPenalty = TRUE;
+	CString szVolume;
+	TCHAR szVolumeName[MAX_PATH];
+	BOOL bVolume = GetVolumePathName(pFileinfo->szFilename, szVolume.GetBuffer(MAX_PATH_EX), MAX_PATH_EX);
+	szVolume.ReleaseBuffer(bVolume ? -1 : 0);
+	if(bVolume && GetVolumeNameForVolumeMountPoint(szVolume, szVolumeName, MAX_PATH)) {
+		// \\?\Volume{guid}\ without the trailing backslash opens the volume itself
+		int len = lstrlen(szVolumeName);
+		if(len && szVolumeName[len - 1] == TEXT('\\'))
+			szVolumeName[len - 1] = TEXT('\0');
+		HANDLE hVolume = CreateFile(szVolumeName, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+		if(hVolume != INVALID_HANDLE_VALUE) {
+			STORAGE_PROPERTY_QUERY query;
+			SEEK_PENALTY_DESCRIPTOR descriptor;
+			DWORD dwBytes;
+			ZeroMemory(&query, sizeof(query));
+			query.PropertyId = STORAGE_SEEK_PENALTY_PROPERTY;
+			query.QueryType = PropertyStandardQuery;
+			if(DeviceIoControl(hVolume, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query),
+							   &descriptor, sizeof(descriptor), &dwBytes, NULL) && dwBytes >= sizeof(descriptor))
+				bSeekPenalty = descriptor.IncursSeekPenalty;
+			CloseHandle(hVolume);
+		}
+	}
 
-	Keccak_HashInstance hashState;
-	Keccak_HashInitialize_SHA3_256(&hashState);
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		Keccak_HashUpdate(&hashState, *buffer, **dwBytesRead * 8);
-	} while (!(*bFileDone));
-	Keccak_HashFinal(&hashState, result);
-	SetEvent(hEvtThreadReady);
-	return 0;
+	(*pDirSeekPenalty)[szDir] = bSeekPenalty;
+	return bSeekPenalty;
 }
 
 /*****************************************************************************
-DWORD WINAPI ThreadProc_Sha3_512Calc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+UINT ScheduleFileStreams(lFILEINFO *fileList, CONST BOOL bDoCalculate[NUM_HASH_TYPES], CONST BOOL bMultiBuffer,
+						 CONST UINT uiWorkers, CONST UINT uiFilesPerDevice, CONST UINT uiMaxStreams,
+						 map<CString, BOOL> *pDirSeekPenalty, vector<FILEINFO *> *pFiles, vector<UINT> *pFileStream)
+	fileList			: (IN) the job
+	bDoCalculate		: (IN) hashes requested for the job
+	bMultiBuffer		: (IN) small files are hashed in batches
+	uiWorkers			: (IN) number of hash groups, no file gets a stream without them
+	uiFilesPerDevice	: (IN) files of a device that are read at the same time
+	uiMaxStreams		: (IN) streams the memory budget allows
+	pDirSeekPenalty		: (IN/OUT) see GetFileSeekPenalty
+	pFiles				: (OUT) the files of the job in list order
+	pFileStream			: (OUT) stream of every file, NO_FILE_STREAM for the ones
+						  ThreadProc_Calc hashes itself
 
 Return Value:
-	returns 0
+	number of streams the job needs
 
 Notes:
-- initializes the sha3-512 hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- the files are grouped by the volume they are on, every device gets uiFilesPerDevice
+  streams that take its files in turn. A stream reads its files one after the other,
+  so a disk never sees more than uiFilesPerDevice sequential reads while the reads on
+  different disks add up
+- if there are more devices than streams, devices share streams
+- a file is only split into segments if it is the single file for the streams and its
+  device does not seek. Otherwise every disk of the job is busy with a stream of its
+  own, and segments on a disk that seeks only make it jump between them
 *****************************************************************************/
-DWORD WINAPI ThreadProc_Sha3_512Calc(VOID * pParam)
+static UINT ScheduleFileStreams(lFILEINFO *fileList, CONST BOOL bDoCalculate[NUM_HASH_TYPES], CONST BOOL bMultiBuffer,
+								CONST UINT uiWorkers, CONST UINT uiFilesPerDevice, CONST UINT uiMaxStreams,
+								map<CString, BOOL> *pDirSeekPenalty, vector<FILEINFO *> *pFiles, vector<UINT> *pFileStream)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	map<CString, DWORD> dirDevices;
+	map<DWORD, UINT> deviceIndex;				// devices numbered in the order they appear
+	vector<UINT> deviceFiles;					// files seen per device
+	UINT uiPerDevice, uiDevice;
+
+	pFiles->clear();
+	pFileStream->clear();
+	for(list<FILEINFO>::iterator it=fileList->fInfos.begin();it!=fileList->fInfos.end();it++) {
+		pFiles->push_back(&(*it));
+		if(uiWorkers == 0 || !CanHashInFileStream(&(*it), bMultiBuffer)) {
+			pFileStream->push_back(NO_FILE_STREAM);
+			continue;
+		}
+		DWORD dwDevice = GetFileDevice(&(*it), &dirDevices);
+		map<DWORD, UINT>::iterator itDevice = deviceIndex.find(dwDevice);
+		if(itDevice == deviceIndex.end()) {
+			uiDevice = (UINT)deviceFiles.size();
+			deviceIndex[dwDevice] = uiDevice;
+			deviceFiles.push_back(0);
+		} else {
+			uiDevice = itDevice->second;
+		}
+		// device and position within it for now, turned into the stream below
+		pFileStream->push_back(uiDevice);
+		deviceFiles[uiDevice]++;
+	}
 
-	Keccak_HashInstance hashState;
-	Keccak_HashInitialize_SHA3_512(&hashState);
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		Keccak_HashUpdate(&hashState, *buffer, **dwBytesRead * 8);
-	} while (!(*bFileDone));
-	Keccak_HashFinal(&hashState, result);
-	SetEvent(hEvtThreadReady);
-	return 0;
+	if(deviceFiles.empty())
+		return 1;
+
+	// a lone file on a device that does not seek is read faster in segments. Only if no
+	// other device has files, the streams wait while ThreadProc_Calc splits a file
+	if(deviceFiles.size() == 1 && deviceFiles[0] == 1) {
+		for(size_t f=0;f<pFileStream->size();f++) {
+			if((*pFileStream)[f] != NO_FILE_STREAM && GetSegmentCount(bDoCalculate, (*pFiles)[f], pDirSeekPenalty) > 1) {
+				(*pFileStream)[f] = NO_FILE_STREAM;
+				return 1;
+			}
+		}
+	}
+
+	uiPerDevice = uiFilesPerDevice < 1 ? 1 : uiFilesPerDevice;
+	if(deviceFiles.size() * uiPerDevice > uiMaxStreams)
+		uiPerDevice = max(1U, uiMaxStreams / (UINT)deviceFiles.size());
+
+	for(uiDevice=0;uiDevice<deviceFiles.size();uiDevice++)
+		deviceFiles[uiDevice] = 0;
+	for(size_t f=0;f<pFileStream->size();f++) {
+		if((*pFileStream)[f] == NO_FILE_STREAM)
+			continue;
+		uiDevice = (*pFileStream)[f];
+		(*pFileStream)[f] = (uiDevice * uiPerDevice + deviceFiles[uiDevice]++ % uiPerDevice) % uiMaxStreams;
+	}
+
+	return min(uiMaxStreams, (UINT)deviceFiles.size() * uiPerDevice);
 }
 
 /*****************************************************************************
-DWORD WINAPI ThreadProc_Ed2kCalc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+VOID RunFileStreams(THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES], CONST UINT uiStreams,
+					CONST vector<FILEINFO *> &files, CONST vector<UINT> &fileStream, vector<LONG> &fileState,
+					CONST UINT uiFile, CONST UINT uiEnd)
+	fileStreams	: (IN/OUT) the streams, all of them idle
+	uiStreams	: (IN) number of streams of the job
+	files		: (IN) the files of the job in list order
+	fileStream	: (IN) stream of every file, see ScheduleFileStreams
+	fileState	: (IN/OUT) receives the FILE_STREAM_* of the files
+	uiFile		: (IN) the file ThreadProc_Calc collects next
+	uiEnd		: (IN) the next file ThreadProc_Calc hashes itself, or the end of the job
+
+Return Value:
+	none
+
+Notes:
+- every stream hashes its files in [uiFile, uiEnd) back to back, a stream that is
+  done with a file moves on to its next one while ThreadProc_Calc still waits for a
+  file of another stream (see WaitForStreamFile). So no disk idles while the files
+  of another one are collected
+- no stream runs when ThreadProc_Calc gets to uiEnd, WaitForFileStreams is called
+  after the file before it
+*****************************************************************************/
+static VOID RunFileStreams(THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES], CONST UINT uiStreams,
+						   CONST vector<FILEINFO *> &files, CONST vector<UINT> &fileStream, vector<LONG> &fileState,
+						   CONST UINT uiFile, CONST UINT uiEnd)
+{
+	for(UINT s=0;s<uiStreams;s++) {
+		THREAD_PARAMS_FILESTREAM * CONST stream = &fileStreams[s];
+		stream->ppFiles = &files[0];
+		stream->puiFileStream = &fileStream[0];
+		stream->plFileState = &fileState[0];
+		stream->uiFirstFile = uiFile;
+		stream->uiEndFile = uiEnd;
+		stream->qwBytesRead = 0;
+		stream->bBusy = TRUE;
+		SetEvent(stream->hEvtStart);
+	}
+}
+
+/*****************************************************************************
+BOOL WaitForStreamFile(THREAD_PARAMS_CALC *pthread_params_calc, THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES],
+					   CONST UINT uiStreams, THREAD_PARAMS_FILESTREAM *stream, CONST vector<LONG> &fileState,
+					   CONST UINT uiFile, CONST QWORD qwBytesReadBase)
+	pthread_params_calc	: (IN/OUT) receives the progress
+	fileStreams			: (IN) the streams
+	uiStreams			: (IN) number of streams of the job
+	stream				: (IN) the stream of uiFile
+	fileState			: (IN) FILE_STREAM_* of every file of the job
+	uiFile				: (IN) the file that is collected
+	qwBytesReadBase		: (IN) qwBytesReadAllFiles when the streams were started
+
+Return Value:
+	FALSE if the file was stopped
+
+Notes:
+- only waits for uiFile, the other streams keep going with their files
+- updates the progress bar while waiting, the current file is the one waited for and
+  everything the streams read since RunFileStreams counts for the total
+*****************************************************************************/
+static BOOL WaitForStreamFile(THREAD_PARAMS_CALC *pthread_params_calc, THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES],
+							  CONST UINT uiStreams, THREAD_PARAMS_FILESTREAM *stream, CONST vector<LONG> &fileState,
+							  CONST UINT uiFile, CONST QWORD qwBytesReadBase)
+{
+	QWORD qwBytesRead;
+
+	while(*(volatile CONST LONG *)&fileState[uiFile] == FILE_STREAM_PENDING) {
+		WaitForSingleObject(stream->hEvtFile, 100);
+		qwBytesRead = 0;
+		for(UINT s=0;s<uiStreams;s++)
+			qwBytesRead += fileStreams[s].qwBytesRead;
+		pthread_params_calc->qwBytesReadCurFile = stream->uiFile == uiFile ? stream->qwBytesReadFile : 0;
+		pthread_params_calc->qwBytesReadAllFiles = qwBytesReadBase + qwBytesRead;
+	}
+
+	return fileState[uiFile] == FILE_STREAM_DONE;
+}
+
+// waits until all streams are through their files, everything they read goes into the total
+static VOID WaitForFileStreams(THREAD_PARAMS_CALC *pthread_params_calc, THREAD_PARAMS_FILESTREAM fileStreams[MAX_CONCURRENT_FILES],
+							   CONST UINT uiStreams, CONST QWORD qwBytesReadBase)
+{
+	QWORD qwBytesRead = 0;
+	BOOL bStreamsBusy = FALSE;
+
+	for(UINT s=0;s<uiStreams;s++) {
+		if(!fileStreams[s].bBusy)
+			continue;
+		WaitForSingleObject(fileStreams[s].hEvtDone, INFINITE);
+		qwBytesRead += fileStreams[s].qwBytesRead;
+		fileStreams[s].bBusy = FALSE;
+		bStreamsBusy = TRUE;
+	}
+	if(bStreamsBusy)
+		pthread_params_calc->qwBytesReadAllFiles = qwBytesReadBase + qwBytesRead;
+}
+
+// the worker is done with the buffer, the last one to release it hands it back to the reader
+static inline VOID ReleaseReadBuffer(READ_RING *ring, READ_BUFFER *rb)
+{
+	if(InterlockedDecrement(&rb->lPending) == 0)
+		ReleaseSemaphore(ring->hSemFree, 1, NULL);
+}
+
+// the contexts are allocated aligned, the sponge and blake2 states ask for more than new guarantees
+template<UINT uiHashType>
+static VOID * HashCreate()
+{
+	typedef typename HashAlgorithm<uiHashType>::Context Context;
+
+	VOID *p = _aligned_malloc(sizeof(Context), __alignof(Context));
+	if(p == NULL)
+		throw std::bad_alloc();
+	Context *context = new(p) Context;
+	HashAlgorithm<uiHashType>::Init(context);
+	return context;
+}
+
+template<UINT uiHashType>
+static VOID HashUpdate(VOID *context, CONST BYTE *data, DWORD dwLength)
+{
+	HashAlgorithm<uiHashType>::Update((typename HashAlgorithm<uiHashType>::Context *)context, data, dwLength);
+}
+
+template<UINT uiHashType>
+static VOID HashCombine(VOID *context, CONST VOID *next, QWORD qwLength)
+{
+	typedef typename HashAlgorithm<uiHashType>::Context Context;
+
+	HashAlgorithm<uiHashType>::Combine((Context *)context, (CONST Context *)next, qwLength);
+}
+
+template<UINT uiHashType>
+static VOID HashFinal(VOID *context, VOID *result)
+{
+	HashAlgorithm<uiHashType>::Final((typename HashAlgorithm<uiHashType>::Context *)context, result);
+}
+
+template<UINT uiHashType>
+static VOID HashDestroy(VOID *context)
+{
+	typedef typename HashAlgorithm<uiHashType>::Context Context;
+
+	((Context *)context)->~Context();
+	_aligned_free(context);
+}
+
+template<UINT uiHashType>
+static VOID HashReset(VOID *context)
+{
+	HashAlgorithm<uiHashType>::Init((typename HashAlgorithm<uiHashType>::Context *)context);
+}
+
+template<UINT uiHashType>
+static VOID HashOnce(CONST BYTE *data, DWORD dwLength, VOID *result)
+{
+	typename HashAlgorithm<uiHashType>::Context context;
+
+	HashAlgorithm<uiHashType>::Init(&context);
+	HashAlgorithm<uiHashType>::Update(&context, data, dwLength);
+	HashAlgorithm<uiHashType>::Final(&context, result);
+}
+
+#define HASH_ALGORITHM_ENTRY(type) { \
+	HashCreate<type>, HashUpdate<type>, HashCombine<type>, \
+	HashFinal<type>, HashDestroy<type>, HashReset<type>, HashOnce<type>, HashAlgorithm<type>::dwDigestSize, \
+	HashAlgorithm<type>::bMergeable, HashAlgorithm<type>::bMultiBuffer, HashAlgorithm<type>::bFusable }
+
+extern CONST HASH_ALGORITHM_INFO hash_algorithms[NUM_HASH_TYPES] = {
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_CRC32),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_MD5),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_ED2K),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_SHA1),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_SHA256),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_SHA512),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_SHA3_224),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_SHA3_256),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_SHA3_512),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_CRC32C),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_BLAKE2SP),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_BLAKE3),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_BLAKE2BP),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_XXH128),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_K12),
+	HASH_ALGORITHM_ENTRY(HASH_TYPE_CRC64),
+};
+
+/*****************************************************************************
+hash worker pool
+
+ThreadProc_Calc starts one worker per HASH_GROUP of the job for every file stream
+and keeps them for all following files and jobs, only missing ones are added. With
+N streams a group runs on N cores, one per file. The reader posts a HASH_TASK
+for every buffer to every worker of the file; a worker has a queue of its own, so
+the tasks of a group are never run in parallel or out of order.
+
+Cheap hashes cost less per byte than pulling the buffer through the cache once
+more, so several of them share one group. Its worker runs all of them over one
+FUSED_BLOCK_SIZE block while the block is still in L1.
+*****************************************************************************/
+
+/*****************************************************************************
+VOID RunHashTask(CONST HASH_TASK *task)
+	task	: (IN) group and buffer to hash
+
+Return Value:
+	returns nothing
+
+Notes:
+- the contexts of the group are created with the first task of the stream and reset
+  after every file, so they keep what they allocated (the ED2K part buffers) for the
+  following files of the job
+- a single hash gets the whole buffer at once, a fused group processes it in blocks
+  of FUSED_BLOCK_SIZE and each block is passed to every hash before the next one
+- the buffer is released before the hashes are finalized, the worker that finishes
+  the file last sets hEvtHashed of the ring
+*****************************************************************************/
+static VOID RunHashTask(CONST HASH_TASK *task)
+{
+	HASH_GROUP * CONST group = task->group;
+	READ_BUFFER * CONST rb = task->buffer;
+	CONST BOOL bLast = rb->bLast;
+	CONST HASH_ALGORITHM_INFO * algorithm[NUM_HASH_TYPES];
+
+	for(UINT k=0;k<group->uiHashCount;k++) {
+		algorithm[k] = &hash_algorithms[group->uiHashType[k]];
+		if(group->context[k] == NULL)
+			group->context[k] = algorithm[k]->pfnCreate();
+	}
+
+	if(group->uiHashCount == 1) {
+		algorithm[0]->pfnUpdate(group->context[0], rb->data, rb->dwBytesRead);
+	} else {
+		for(DWORD dwOffset=0;dwOffset<rb->dwBytesRead;dwOffset+=FUSED_BLOCK_SIZE) {
+			CONST DWORD dwBlock = min((DWORD)FUSED_BLOCK_SIZE, rb->dwBytesRead - dwOffset);
+			for(UINT k=0;k<group->uiHashCount;k++)
+				algorithm[k]->pfnUpdate(group->context[k], rb->data + dwOffset, dwBlock);
+		}
+	}
+	ReleaseReadBuffer(task->ring, rb);
+
+	if(bLast) {
+		for(UINT k=0;k<group->uiHashCount;k++) {
+			algorithm[k]->pfnFinal(group->context[k], group->result[k]);
+			algorithm[k]->pfnReset(group->context[k]);
+		}
+		if(InterlockedDecrement(&task->ring->lWorkersBusy) == 0)
+			SetEvent(task->ring->hEvtHashed);
+	}
+}
+
+/*****************************************************************************
+DWORD WINAPI ThreadProc_HashWorker(VOID * pParam)
+	pParam	: (IN/OUT) THREAD_PARAMS_HASHWORKER struct pointer special for this thread
 
 Return Value:
 	returns 0
 
 Notes:
-- initializes the ed2k hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- runs the tasks of its queue in order until it gets one without a ring
 *****************************************************************************/
-DWORD WINAPI ThreadProc_Ed2kCalc(VOID * pParam)
+DWORD WINAPI ThreadProc_HashWorker(VOID * pParam)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	THREAD_PARAMS_HASHWORKER * CONST worker = (THREAD_PARAMS_HASHWORKER *)pParam;
+	HASH_TASK task;
+
+	for(;;) {
+		WaitForSingleObject(worker->hSemTasks, INFINITE);
+		EnterCriticalSection(&worker->csTasks);
+		task = worker->tasks.front();
+		worker->tasks.pop();
+		LeaveCriticalSection(&worker->csTasks);
+		if(task.ring == NULL)
+			break;
+		RunHashTask(&task);
+	}
 
-	CEd2kHash ed2khash;
-	ed2khash.restart_calc();
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		ed2khash.add_data(*buffer,**dwBytesRead);
-	} while (!(*bFileDone));
-	ed2khash.finish_calc();
-	ed2khash.get_hash(result);
-	SetEvent(hEvtThreadReady);
 	return 0;
 }
 
+// queues a task for the worker, a NULL ring ends it
+static VOID PostHashTask(THREAD_PARAMS_HASHWORKER *worker, HASH_GROUP *group, READ_RING *ring, READ_BUFFER *buffer)
+{
+	HASH_TASK task;
+
+	task.group = group;
+	task.ring = ring;
+	task.buffer = buffer;
+	EnterCriticalSection(&worker->csTasks);
+	worker->tasks.push(task);
+	LeaveCriticalSection(&worker->csTasks);
+	ReleaseSemaphore(worker->hSemTasks, 1, NULL);
+}
+
 /*****************************************************************************
-DWORD WINAPI ThreadProc_CrcCalc(VOID * pParam)
-	pParam	: (IN/OUT) THREAD_PARAMS_HASHCALC struct pointer special for this thread
+BOOL StartHashWorkers(THREAD_PARAMS_HASHWORKER hashWorkers[NUM_HASH_TYPES], UINT *puiThreads, CONST UINT uiWorkers)
+	hashWorkers	: (IN/OUT) the workers of a file stream
+	puiThreads	: (IN/OUT) number of running workers
+	uiWorkers	: (IN) number of workers the job needs
 
 Return Value:
-	returns 0
+	FALSE if a worker could not be started
 
 Notes:
-- initializes the crc hash calculation and loops through the calculation until
-  ThreadProc_Calc signalizes the end of the file
-- buffer synchronization is done through hEvtThreadReady and hEvtThreadGo
+- only starts the workers that are missing, the running ones are kept
 *****************************************************************************/
-DWORD WINAPI ThreadProc_CrcCalc(VOID * pParam)
+static BOOL StartHashWorkers(THREAD_PARAMS_HASHWORKER hashWorkers[NUM_HASH_TYPES], UINT *puiThreads, CONST UINT uiWorkers)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	DWORD * CONST result=(DWORD *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	for(;*puiThreads<uiWorkers;(*puiThreads)++) {
+		THREAD_PARAMS_HASHWORKER * CONST worker = &hashWorkers[*puiThreads];
+		worker->hSemTasks = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+		if(worker->hSemTasks == NULL)
+			return FALSE;
+		InitializeCriticalSection(&worker->csTasks);
+		worker->hThread = CreateThread(NULL,0,ThreadProc_HashWorker,worker,0,NULL);
+		if(worker->hThread == NULL) {
+			DeleteCriticalSection(&worker->csTasks);
+			CloseHandle(worker->hSemTasks);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
 
-	DWORD dwCrc32;
+// frees the contexts the workers kept from their last file
+static VOID DestroyGroupContexts(HASH_GROUP groups[NUM_HASH_TYPES], CONST UINT uiWorkers)
+{
+	for(UINT w=0;w<uiWorkers;w++) {
+		for(UINT k=0;k<groups[w].uiHashCount;k++) {
+			if(groups[w].context[k] != NULL)
+				hash_algorithms[groups[w].uiHashType[k]].pfnDestroy(groups[w].context[k]);
+			groups[w].context[k] = NULL;
+		}
+	}
+}
 
-	dwCrc32 = 0;
+// ends all workers of the pool after their queued tasks
+static VOID StopHashWorkers(THREAD_PARAMS_HASHWORKER hashWorkers[NUM_HASH_TYPES], CONST UINT uiThreads)
+{
+	for(UINT w=0;w<uiThreads;w++)
+		PostHashTask(&hashWorkers[w], NULL, NULL, NULL);
+	for(UINT w=0;w<uiThreads;w++) {
+		WaitForSingleObject(hashWorkers[w].hThread, INFINITE);
+		CloseHandle(hashWorkers[w].hThread);
+		CloseHandle(hashWorkers[w].hSemTasks);
+		DeleteCriticalSection(&hashWorkers[w].csTasks);
+	}
+}
 
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		
-        dwCrc32 = crc32_8bytes(*buffer, **dwBytesRead, dwCrc32);
+/*****************************************************************************
+VOID MeasureFusedHashCosts(float fCyclesPerByte[NUM_HASH_TYPES])
+	fCyclesPerByte	: (OUT) cost of every fusable hash, 0 for the others
 
-	} while (!(*bFileDone));
-	*result = dwCrc32;
-	SetEvent(hEvtThreadReady);
-	return 0;
+Return Value:
+	returns nothing
+
+Notes:
+- hashes FUSED_COST_ROUNDS blocks of FUSED_BLOCK_SIZE with each fusable hash, the
+  block is hashed once before to get it and the code into the cache
+*****************************************************************************/
+static VOID MeasureFusedHashCosts(float fCyclesPerByte[NUM_HASH_TYPES])
+{
+	VOID *context;
+	BYTE abResult[64];
+	BYTE *block = (BYTE *)malloc(FUSED_BLOCK_SIZE);
+
+	for(UINT i=0;i<NUM_HASH_TYPES;i++) {
+		fCyclesPerByte[i] = 0.0f;
+		if(!hash_algorithms[i].bFusable || block == NULL)
+			continue;
+		for(UINT j=0;j<FUSED_BLOCK_SIZE;j++)
+			block[j] = (BYTE)(j * 131 + i);
+		context = hash_algorithms[i].pfnCreate();
+		hash_algorithms[i].pfnUpdate(context, block, FUSED_BLOCK_SIZE);
+		CONST unsigned __int64 qwStart = __rdtsc();
+		for(UINT r=0;r<FUSED_COST_ROUNDS;r++)
+			hash_algorithms[i].pfnUpdate(context, block, FUSED_BLOCK_SIZE);
+		CONST unsigned __int64 qwStop = __rdtsc();
+		hash_algorithms[i].pfnFinal(context, abResult);
+		hash_algorithms[i].pfnDestroy(context);
+		fCyclesPerByte[i] = (float)(qwStop - qwStart) / (FUSED_COST_ROUNDS * FUSED_BLOCK_SIZE);
+	}
+
+	free(block);
 }
 
-DWORD WINAPI ThreadProc_Crc32cCalc(VOID * pParam)
+/*****************************************************************************
+UINT AssignHashWorkers(CONST BOOL bDoCalculate[NUM_HASH_TYPES], HASH_GROUP groups[NUM_HASH_TYPES])
+	bDoCalculate	: (IN) hashes to calculate for the current job
+	groups			: (OUT) receives uiHashCount and uiHashType of every worker
+
+Return Value:
+	number of workers, at most one per requested hash
+
+Notes:
+- hashes that are not fusable get a worker of their own, each of them keeps a
+  processor busy
+- the fusable hashes are packed first-fit by decreasing cycles per byte into
+  workers whose total cost stays below the capacity. The capacity is the slowest
+  fusable hash (plus FUSED_COST_SLACK), and it grows if the remaining processors
+  would otherwise not be enough for the fused workers
+- the cycles per byte are measured once, on the first call
+*****************************************************************************/
+static UINT AssignHashWorkers(CONST BOOL bDoCalculate[NUM_HASH_TYPES], HASH_GROUP groups[NUM_HASH_TYPES])
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	DWORD * CONST result=(DWORD *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	static float fCyclesPerByte[NUM_HASH_TYPES];
+	static DWORD dwNumberOfProcessors = 0;
+	UINT uiFusable[NUM_HASH_TYPES];
+	UINT uiFusableCount = 0;
+	float fWorkerCost[NUM_HASH_TYPES];
+	float fMaxCost = 0.0f, fTotalCost = 0.0f;
+	UINT uiWorkers = 0;
+
+	if(dwNumberOfProcessors == 0) {
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		dwNumberOfProcessors = si.dwNumberOfProcessors;
+		MeasureFusedHashCosts(fCyclesPerByte);
+	}
 
-    __crc32_init();
+	for(UINT i=0;i<NUM_HASH_TYPES;i++) {
+		if(!bDoCalculate[i])
+			continue;
+		if(hash_algorithms[i].bFusable) {
+			uiFusable[uiFusableCount++] = i;
+			fMaxCost = max(fMaxCost, fCyclesPerByte[i]);
+			fTotalCost += fCyclesPerByte[i];
+		} else {
+			groups[uiWorkers].uiHashCount = 1;
+			groups[uiWorkers].uiHashType[0] = i;
+			uiWorkers++;
+		}
+	}
 
-    DWORD dwCrc32c = 0;
+	// most expensive first
+	for(UINT i=1;i<uiFusableCount;i++) {
+		UINT uiType = uiFusable[i];
+		UINT j = i;
+		for(;j>0 && fCyclesPerByte[uiFusable[j - 1]] < fCyclesPerByte[uiType];j--)
+			uiFusable[j] = uiFusable[j - 1];
+		uiFusable[j] = uiType;
+	}
 
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-		dwCrc32c = crc32c_append(dwCrc32c, *buffer, **dwBytesRead);
-	} while (!(*bFileDone));
-	*result = dwCrc32c;
-	SetEvent(hEvtThreadReady);
-	return 0;
+	CONST DWORD dwFreeProcessors = dwNumberOfProcessors > uiWorkers ? dwNumberOfProcessors - uiWorkers : 1;
+	CONST float fCapacity = max(fMaxCost, fTotalCost / dwFreeProcessors) * FUSED_COST_SLACK;
+
+	CONST UINT uiFirstFused = uiWorkers;
+	for(UINT i=0;i<uiFusableCount;i++) {
+		CONST UINT uiType = uiFusable[i];
+		UINT w = uiFirstFused;
+		while(w < uiWorkers && fWorkerCost[w] + fCyclesPerByte[uiType] > fCapacity)
+			w++;
+		if(w == uiWorkers) {
+			groups[w].uiHashCount = 0;
+			fWorkerCost[w] = 0.0f;
+			uiWorkers++;
+		}
+		groups[w].uiHashType[groups[w].uiHashCount++] = uiType;
+		fWorkerCost[w] += fCyclesPerByte[uiType];
+	}
+
+	return uiWorkers;
 }
 
-DWORD WINAPI ThreadProc_Blake2spCalc(VOID * pParam)
+/*****************************************************************************
+UINT GetSegmentCount(CONST BOOL bDoCalculate[NUM_HASH_TYPES], CONST FILEINFO *pFileinfo,
+					 map<CString, BOOL> *pDirSeekPenalty)
+	bDoCalculate	: (IN) hashes requested for the current job
+	pFileinfo		: (IN) the file
+	pDirSeekPenalty	: (IN/OUT) see GetFileSeekPenalty
+
+Return Value:
+	number of byte ranges the file should be split into, 1 if the file has to be
+	read front to back
+
+Notes:
+- only mergeable hashes (the CRCs) can be split, since their segment results can be
+  combined afterwards
+- each segment is at least SEGMENT_MIN_SIZE, at most one segment per processor
+- the segments are read at the same time, on a disk that seeks that is slower than
+  reading the file front to back. So files on those are never split
+*****************************************************************************/
+static UINT GetSegmentCount(CONST BOOL bDoCalculate[NUM_HASH_TYPES], CONST FILEINFO *pFileinfo,
+							map<CString, BOOL> *pDirSeekPenalty)
 {
-	BYTE ** CONST buffer=((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead=((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo=((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result=(BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone=((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	static DWORD dwNumberOfProcessors = 0;
 
-    blake2sp_state state;
+	if(!g_program_options.bHashLargeFilesInSegments)
+		return 1;
 
-    blake2sp_init( &state, 32 );
+	for(int i=0;i<NUM_HASH_TYPES;i++) {
+		if(bDoCalculate[i] && !hash_algorithms[i].bMergeable)
+			return 1;
+	}
 
-	do {
-		SignalObjectAndWait(hEvtThreadReady,hEvtThreadGo,INFINITE,FALSE);
-        blake2sp_update( &state, *buffer, **dwBytesRead );
-	} while (!(*bFileDone));
+	if(dwNumberOfProcessors == 0) {
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		dwNumberOfProcessors = si.dwNumberOfProcessors;
+	}
 
-	blake2sp_final( &state, result, 32 );
+	QWORD qwSegments = pFileinfo->qwFilesize / SEGMENT_MIN_SIZE;
+	if(qwSegments > dwNumberOfProcessors)
+		qwSegments = dwNumberOfProcessors;
+	if(qwSegments > MAXIMUM_WAIT_OBJECTS)
+		qwSegments = MAXIMUM_WAIT_OBJECTS;
 
-	SetEvent(hEvtThreadReady);
-	return 0;
+	if(qwSegments < 2 || GetFileSeekPenalty(pFileinfo, pDirSeekPenalty))
+		return 1;
+	return (UINT)qwSegments;
 }
 
-DWORD WINAPI ThreadProc_Blake3Calc(VOID * pParam)
+/*****************************************************************************
+BOOL StartSegmentThreads(THREAD_PARAMS_SEGMENTCALC segments[MAXIMUM_WAIT_OBJECTS], UINT *puiThreads, CONST UINT uiSegments)
+	segments	: (IN/OUT) the segment threads, uiBufferSize and bUnbufferedReads have to be set
+	puiThreads	: (IN/OUT) number of running segment threads
+	uiSegments	: (IN) number of segments the file needs
+
+Return Value:
+	FALSE if a thread could not be started
+
+Notes:
+- like StartFileStreams only the missing threads are started, they are kept for the
+  following files until StopSegmentThreads
+*****************************************************************************/
+static BOOL StartSegmentThreads(THREAD_PARAMS_SEGMENTCALC segments[MAXIMUM_WAIT_OBJECTS], UINT *puiThreads, CONST UINT uiSegments)
+{
+	for(;*puiThreads<uiSegments;(*puiThreads)++) {
+		THREAD_PARAMS_SEGMENTCALC * CONST segParams = &segments[*puiThreads];
+		segParams->bExit = FALSE;
+		segParams->hEvtStart = CreateEvent(NULL,FALSE,FALSE,NULL);
+		segParams->hEvtDone = CreateEvent(NULL,FALSE,FALSE,NULL);
+		if(segParams->hEvtStart == NULL || segParams->hEvtDone == NULL)
+			return FALSE;
+		segParams->hThread = CreateThread(NULL,0,ThreadProc_SegmentCalc,segParams,0,NULL);
+		if(segParams->hThread == NULL)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// ends all segment threads, none of them may have a segment
+static VOID StopSegmentThreads(THREAD_PARAMS_SEGMENTCALC segments[MAXIMUM_WAIT_OBJECTS], CONST UINT uiThreads)
+{
+	for(UINT i=0;i<uiThreads;i++) {
+		THREAD_PARAMS_SEGMENTCALC * CONST segParams = &segments[i];
+		segParams->bExit = TRUE;
+		SetEvent(segParams->hEvtStart);
+		WaitForSingleObject(segParams->hThread, INFINITE);
+		CloseHandle(segParams->hThread);
+		CloseHandle(segParams->hEvtStart);
+		CloseHandle(segParams->hEvtDone);
+	}
+}
+
+/*****************************************************************************
+BOOL CalcFileInSegments(THREAD_PARAMS_CALC *pthread_params_calc, THREAD_PARAMS_SEGMENTCALC segments[MAXIMUM_WAIT_OBJECTS],
+						UINT *puiSegmentThreads, FILEINFO *pFileinfo, CONST BOOL bDoCalculate[NUM_HASH_TYPES], UINT uiSegments)
+	pthread_params_calc	: (IN/OUT) params of the calling ThreadProc_Calc, for progress and stop
+	segments			: (IN/OUT) the segment threads of ThreadProc_Calc
+	puiSegmentThreads	: (IN/OUT) number of running segment threads
+	pFileinfo			: (IN/OUT) the file to hash, receives the results and error
+	bDoCalculate		: (IN) hashes to calculate, only mergeable ones
+	uiSegments			: (IN) number of byte ranges, from GetSegmentCount
+
+Return Value:
+	returns TRUE if the file is done (finished or error), FALSE if stopped
+
+Notes:
+- splits the file into uiSegments ranges aligned to the read buffer size, hashes each
+  range in a ThreadProc_SegmentCalc and combines the segment contexts in file order
+- the segment threads are started with the first file that needs them and wait for
+  the next one afterwards
+*****************************************************************************/
+static BOOL CalcFileInSegments(THREAD_PARAMS_CALC *pthread_params_calc, THREAD_PARAMS_SEGMENTCALC segments[MAXIMUM_WAIT_OBJECTS],
+							   UINT *puiSegmentThreads, FILEINFO *pFileinfo, CONST BOOL bDoCalculate[NUM_HASH_TYPES], UINT uiSegments)
 {
-	BYTE ** CONST buffer = ((THREAD_PARAMS_HASHCALC *)pParam)->buffer;
-	DWORD ** CONST dwBytesRead = ((THREAD_PARAMS_HASHCALC *)pParam)->dwBytesRead;
-	CONST HANDLE hEvtThreadReady = ((THREAD_PARAMS_HASHCALC *)pParam)->hHandleReady;
-	CONST HANDLE hEvtThreadGo = ((THREAD_PARAMS_HASHCALC *)pParam)->hHandleGo;
-	BYTE * CONST result = (BYTE *)((THREAD_PARAMS_HASHCALC *)pParam)->result;
-	BOOL * CONST bFileDone = ((THREAD_PARAMS_HASHCALC *)pParam)->bFileDone;
+	CONST QWORD qwBufferSize = g_program_options.uiReadBufferSizeKb * 1024;
+	CONST QWORD qwFilesize = pFileinfo->qwFilesize;
+	QWORD qwSegmentSize = (qwFilesize / uiSegments + qwBufferSize - 1) / qwBufferSize * qwBufferSize;
+	HANDLE hEvtDone[MAXIMUM_WAIT_OBJECTS];
+	QWORD qwBytesDone;
+	BOOL bFileDone = TRUE;
+
+	// rounding up to the buffer size might leave the last segments empty
+	uiSegments = (UINT)((qwFilesize + qwSegmentSize - 1) / qwSegmentSize);
+
+	if(!StartSegmentThreads(segments, puiSegmentThreads, uiSegments)) {
+		ShowErrorMsg(pthread_params_calc->arrHwnd[ID_MAIN_WND],GetLastError());
+		ExitProcess(1);
+	}
 
-	blake3_hasher hasher;
-	blake3_hasher_init(&hasher);
+	for(UINT i=0;i<uiSegments;i++) {
+		THREAD_PARAMS_SEGMENTCALC * CONST segParams = &segments[i];
+		segParams->szFilename = pFileinfo->szFilename;
+		segParams->qwOffset = i * qwSegmentSize;
+		segParams->qwLength = (i == uiSegments - 1) ? qwFilesize - segParams->qwOffset : qwSegmentSize;
+		segParams->pthread_params_calc = pthread_params_calc;
+		segParams->qwBytesDone = 0;
+		segParams->dwError = NO_ERROR;
+		for(int j=0;j<NUM_HASH_TYPES;j++) {
+			segParams->bDoCalculate[j] = bDoCalculate[j];
+			segParams->context[j] = bDoCalculate[j] ? hash_algorithms[j].pfnCreate() : NULL;
+		}
+		hEvtDone[i] = segParams->hEvtDone;
+		SetEvent(segParams->hEvtStart);
+	}
 
+	// update the progress bar while the segments are running
+	CONST QWORD qwBytesReadAllFilesStart = pthread_params_calc->qwBytesReadAllFiles;
+	DWORD dwWaitResult;
 	do {
-		SignalObjectAndWait(hEvtThreadReady, hEvtThreadGo, INFINITE, FALSE);
-		blake3_hasher_update(&hasher, *buffer, **dwBytesRead);
-	} while (!(*bFileDone));
+		dwWaitResult = WaitForMultipleObjects(uiSegments,hEvtDone,TRUE,100);
+		qwBytesDone = 0;
+		for(UINT i=0;i<uiSegments;i++)
+			qwBytesDone += segments[i].qwBytesDone;
+		pthread_params_calc->qwBytesReadCurFile = qwBytesDone;
+		pthread_params_calc->qwBytesReadAllFiles = qwBytesReadAllFilesStart + qwBytesDone;
+	} while(dwWaitResult == WAIT_TIMEOUT);
+
+	for(UINT i=0;i<uiSegments;i++) {
+		if(segments[i].dwError != NO_ERROR && pFileinfo->dwError == NO_ERROR)
+			pFileinfo->dwError = segments[i].dwError;
+		if(segments[i].qwBytesDone != segments[i].qwLength && segments[i].dwError == NO_ERROR)
+			bFileDone = FALSE;
+	}
+
+	if(pFileinfo->dwError != NO_ERROR) {
+		bFileDone = TRUE;
+	} else if(bFileDone) {
+		for(int j=0;j<NUM_HASH_TYPES;j++) {
+			if(!bDoCalculate[j])
+				continue;
+			for(UINT i=1;i<uiSegments;i++)
+				hash_algorithms[j].pfnCombine(segments[0].context[j], segments[i].context[j], segments[i].qwLength);
+			hash_algorithms[j].pfnFinal(segments[0].context[j], &pFileinfo->hashInfo[j].r);
+		}
+	}
+
+	for(UINT i=0;i<uiSegments;i++) {
+		for(int j=0;j<NUM_HASH_TYPES;j++) {
+			if(segments[i].context[j])
+				hash_algorithms[j].pfnDestroy(segments[i].context[j]);
+			segments[i].context[j] = NULL;
+		}
+	}
+
+	return bFileDone;
+}
+
+// hashes the byte range of segParams with its own handle to the file, buffer holds uiBufferSize bytes
+static VOID HashSegment(THREAD_PARAMS_SEGMENTCALC *segParams, BYTE *buffer)
+{
+	QWORD qwRemaining = segParams->qwLength;
+	DWORD dwBytesRead;
+	LARGE_INTEGER liOffset;
+	HANDLE hFile;
+
+	DWORD flags = FILE_FLAG_SEQUENTIAL_SCAN;
+	if (segParams->bUnbufferedReads) {
+		flags |= FILE_FLAG_NO_BUFFERING;
+	}
+	hFile = CreateFile(segParams->szFilename,
+			GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, 0);
+	if(hFile == INVALID_HANDLE_VALUE) {
+		segParams->dwError = GetLastError();
+		return;
+	}
+
+	liOffset.QuadPart = segParams->qwOffset;
+	if(!SetFilePointerEx(hFile, liOffset, NULL, FILE_BEGIN))
+		segParams->dwError = GetLastError();
+
+	while(qwRemaining && segParams->dwError == NO_ERROR && !segParams->pthread_params_calc->signalStop) {
+		// the pause button only suspends ThreadProc_Calc, which waits for the segments
+		WaitForSingleObject(segParams->pthread_params_calc->hEvtRun, INFINITE);
+		if(!ReadFile(hFile, buffer, segParams->uiBufferSize, &dwBytesRead, NULL)) {
+			segParams->dwError = GetLastError();
+			break;
+		}
+		if(dwBytesRead > qwRemaining)
+			dwBytesRead = (DWORD)qwRemaining;
+		if(dwBytesRead == 0) {
+			// file got shorter since the size was determined
+			segParams->dwError = ERROR_HANDLE_EOF;
+			break;
+		}
 
-	blake3_hasher_finalize(&hasher, result, BLAKE3_OUT_LEN);
+		for(int i=0;i<NUM_HASH_TYPES;i++) {
+			if(segParams->bDoCalculate[i])
+				hash_algorithms[i].pfnUpdate(segParams->context[i], buffer, dwBytesRead);
+		}
+
+		qwRemaining -= dwBytesRead;
+		segParams->qwBytesDone += dwBytesRead;
+	}
+
+	CloseHandle(hFile);
+}
+
+/*****************************************************************************
+DWORD WINAPI ThreadProc_SegmentCalc(VOID * pParam)
+	pParam	: (IN/OUT) THREAD_PARAMS_SEGMENTCALC struct pointer special for this thread
+
+Return Value:
+	returns 0
 
-	SetEvent(hEvtThreadReady);
+Notes:
+- every time hEvtStart is set one byte range is hashed into the segment contexts,
+  hEvtDone is set afterwards. The read buffer is kept for all segments of the thread
+- stops early if ThreadProc_Calc is signaled to stop, qwBytesDone is then less
+  than qwLength; waits while hEvtRun is reset (paused)
+*****************************************************************************/
+DWORD WINAPI ThreadProc_SegmentCalc(VOID * pParam)
+{
+	THREAD_PARAMS_SEGMENTCALC * CONST segParams = (THREAD_PARAMS_SEGMENTCALC *)pParam;
+	BYTE *buffer;
+	DWORD dwAllocError = NO_ERROR;
+
+	if (segParams->bUnbufferedReads)
+		buffer = (BYTE *)VirtualAlloc(NULL, segParams->uiBufferSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	else
+		buffer = (BYTE *)malloc(segParams->uiBufferSize);
+	if(buffer == NULL)
+		dwAllocError = segParams->bUnbufferedReads ? GetLastError() : ERROR_NOT_ENOUGH_MEMORY;
+
+	for(;;) {
+		WaitForSingleObject(segParams->hEvtStart, INFINITE);
+		if(segParams->bExit)
+			break;
+
+		if(buffer == NULL)
+			segParams->dwError = dwAllocError;
+		else
+			HashSegment(segParams, buffer);
+
+		SetEvent(segParams->hEvtDone);
+	}
+
+	if (segParams->bUnbufferedReads)
+		VirtualFree(buffer, 0, MEM_RELEASE);
+	else
+		free(buffer);
 	return 0;
 }
+
+/*****************************************************************************
+BOOL UseMultiBuffer(CONST BOOL bDoCalculate[NUM_HASH_TYPES])
+	bDoCalculate	: (IN) hashes requested for the current job
+
+Return Value:
+	TRUE if small files of this job can be hashed in batches by CalcSmallFilesBatch
+
+Notes:
+- at least one multi-buffer hash (MD5/SHA1/SHA256/SHA3) has to be requested and nothing
+  besides them and the mergeable CRCs, which are cheap enough to be calculated directly
+  on the batch
+*****************************************************************************/
+static BOOL UseMultiBuffer(CONST BOOL bDoCalculate[NUM_HASH_TYPES])
+{
+	BOOL bHaveMultiBufferHash = FALSE;
+
+	for(int i=0;i<NUM_HASH_TYPES;i++) {
+		if(!bDoCalculate[i])
+			continue;
+		if(hash_algorithms[i].bMultiBuffer)
+			bHaveMultiBufferHash = TRUE;
+		else if(!hash_algorithms[i].bMergeable)
+			return FALSE;
+	}
+
+	return bHaveMultiBufferHash;
+}
+
+/*****************************************************************************
+UINT CalcSmallFilesBatch(THREAD_PARAMS_CALC *pthread_params_calc, list<FILEINFO>::iterator itFirst,
+						 list<FILEINFO>::iterator itEnd, CONST BOOL bDoCalculate[NUM_HASH_TYPES], BYTE *batchBuffer)
+	pthread_params_calc	: (IN/OUT) params of the calling ThreadProc_Calc, for progress
+	itFirst				: (IN/OUT) first file of the batch, the files receive results and errors
+	itEnd				: (IN) end of the job's file list
+	bDoCalculate		: (IN) hashes to calculate, see UseMultiBuffer
+	batchBuffer			: (IN) MB_BATCH_FILES * MB_MAX_FILE_SIZE bytes
+
+Return Value:
+	number of files starting at itFirst that are done (finished or error), 0 if itFirst
+	has to be hashed the normal way
+
+Notes:
+- reads up to MB_BATCH_FILES consecutive files smaller than MB_MAX_FILE_SIZE into their
+  own slot of batchBuffer, then hashes all of them at once with MB_Hash, which keeps
+  one file in each SIMD lane, and Keccak_HashUpdateBatch for SHA3
+- a batch needs at least two files, a single one is faster with the regular code
+- a file that grew since its size was determined ends the batch before it
+*****************************************************************************/
+static UINT CalcSmallFilesBatch(THREAD_PARAMS_CALC *pthread_params_calc, list<FILEINFO>::iterator itFirst,
+								list<FILEINFO>::iterator itEnd, CONST BOOL bDoCalculate[NUM_HASH_TYPES], BYTE *batchBuffer)
+{
+	FILEINFO *pFileinfo[MB_BATCH_FILES];
+	DWORD dwBytesRead[MB_BATCH_FILES];
+	MB_JOB jobs[MB_BATCH_FILES];
+	Keccak_HashInstance keccakInstance[MB_BATCH_FILES];
+	Keccak_HashInstance *keccakInstances[MB_BATCH_FILES];
+	const BitSequence *keccakData[MB_BATCH_FILES];
+	size_t keccakDataLen[MB_BATCH_FILES];
+	UINT uiFiles = 0;
+	UINT uiJobs;
+	QWORD qwStart, qwStop, wqFreq;
+	QWORD qwBytesTotal = 0;
+	HANDLE hFile;
+
+	for(list<FILEINFO>::iterator it=itFirst;it!=itEnd && uiFiles < MB_BATCH_FILES;it++) {
+		if((*it).dwError == NO_ERROR && (*it).qwFilesize >= MB_MAX_FILE_SIZE)
+			break;
+		pFileinfo[uiFiles++] = &(*it);
+	}
+	if(uiFiles < 2)
+		return 0;
+
+	DisplayStatusOverview(pthread_params_calc->arrHwnd[ID_EDIT_STATUS]);
+
+	QueryPerformanceFrequency((LARGE_INTEGER*)&wqFreq);
+	QueryPerformanceCounter((LARGE_INTEGER*) &qwStart);
+
+	DWORD flags = FILE_FLAG_SEQUENTIAL_SCAN;
+	if (g_program_options.bUseUnbufferedReads) {
+		flags |= FILE_FLAG_NO_BUFFERING;
+	}
+	for(UINT i=0;i<uiFiles;i++) {
+		dwBytesRead[i] = 0;
+		if(pFileinfo[i]->dwError != NO_ERROR)
+			continue;
+		hFile = CreateFile(pFileinfo[i]->szFilename,
+				GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, 0);
+		if(hFile == INVALID_HANDLE_VALUE) {
+			pFileinfo[i]->dwError = GetLastError();
+			continue;
+		}
+		if(!ReadFile(hFile, batchBuffer + i * MB_MAX_FILE_SIZE, MB_MAX_FILE_SIZE, &dwBytesRead[i], NULL))
+			pFileinfo[i]->dwError = GetLastError();
+		CloseHandle(hFile);
+		if(dwBytesRead[i] == MB_MAX_FILE_SIZE) {
+			// grew too large for its slot, leave it and all following files to the caller
+			uiFiles = i;
+			break;
+		}
+		qwBytesTotal += dwBytesRead[i];
+	}
+	if(uiFiles < 2)
+		return 0;
+
+	uiJobs = 0;
+	for(UINT i=0;i<uiFiles;i++) {
+		if(pFileinfo[i]->dwError != NO_ERROR)
+			continue;
+		BYTE *data = batchBuffer + i * MB_MAX_FILE_SIZE;
+		for(int t=0;t<NUM_HASH_TYPES;t++) {
+			if(bDoCalculate[t] && !hash_algorithms[t].bMultiBuffer)
+				hash_algorithms[t].pfnHashOnce(data, dwBytesRead[i], &pFileinfo[i]->hashInfo[t].r);
+		}
+		jobs[uiJobs].data = data;
+		jobs[uiJobs].len = dwBytesRead[i];
+		uiJobs++;
+	}
+
+	if(bDoCalculate[HASH_TYPE_MD5]) {
+		for(UINT i=0,j=0;i<uiFiles;i++) {
+			if(pFileinfo[i]->dwError == NO_ERROR)
+				jobs[j++].digest = pFileinfo[i]->hashInfo[HASH_TYPE_MD5].r.abMd5Result;
+		}
+		MB_Hash(MB_HASH_MD5, jobs, uiJobs);
+	}
+	if(bDoCalculate[HASH_TYPE_SHA1]) {
+		for(UINT i=0,j=0;i<uiFiles;i++) {
+			if(pFileinfo[i]->dwError == NO_ERROR)
+				jobs[j++].digest = pFileinfo[i]->hashInfo[HASH_TYPE_SHA1].r.abSha1Result;
+		}
+		MB_Hash(MB_HASH_SHA1, jobs, uiJobs);
+	}
+	if(bDoCalculate[HASH_TYPE_SHA256]) {
+		for(UINT i=0,j=0;i<uiFiles;i++) {
+			if(pFileinfo[i]->dwError == NO_ERROR)
+				jobs[j++].digest = pFileinfo[i]->hashInfo[HASH_TYPE_SHA256].r.abSha256Result;
+		}
+		MB_Hash(MB_HASH_SHA256, jobs, uiJobs);
+	}
+	for(int t=HASH_TYPE_SHA3_224;t<=HASH_TYPE_SHA3_512;t++) {
+		if(!bDoCalculate[t])
+			continue;
+		for(UINT j=0;j<uiJobs;j++) {
+			if(t == HASH_TYPE_SHA3_224)
+				Keccak_HashInitialize_SHA3_224(&keccakInstance[j]);
+			else if(t == HASH_TYPE_SHA3_256)
+				Keccak_HashInitialize_SHA3_256(&keccakInstance[j]);
+			else
+				Keccak_HashInitialize_SHA3_512(&keccakInstance[j]);
+			keccakInstances[j] = &keccakInstance[j];
+			keccakData[j] = jobs[j].data;
+			keccakDataLen[j] = jobs[j].len;
+		}
+		Keccak_HashUpdateBatch(keccakInstances, keccakData, keccakDataLen, uiJobs);
+		for(UINT i=0,j=0;i<uiFiles;i++) {
+			if(pFileinfo[i]->dwError == NO_ERROR)
+				Keccak_HashFinal(&keccakInstance[j++], (BitSequence *)&pFileinfo[i]->hashInfo[t].r);
+		}
+	}
+
+	QueryPerformanceCounter((LARGE_INTEGER*) &qwStop);
+
+	// the files share the time of the batch according to their size
+	float fSeconds = (float)((qwStop - qwStart) / (float)wqFreq);
+	for(UINT i=0;i<uiFiles;i++) {
+		pFileinfo[i]->fSeconds = qwBytesTotal ? fSeconds * dwBytesRead[i] / qwBytesTotal : fSeconds / uiFiles;
+	}
+	pthread_params_calc->qwBytesReadAllFiles += qwBytesTotal;
+
+	return uiFiles;
+}
@@ -104,6 +104,22 @@ lFILEINFO *ParseCommandLine(BOOL *bPipeNecessary) {
 			{
 				fileList->uiCmdOpts = CMD_BLAKE3;
 			}
+			else if (lstrcmpi(argv[2], TEXT("-CreateBLAKE2BP")) == 0)
+			{
+				fileList->uiCmdOpts = CMD_BLAKE2BP;
+			}
+			else if (lstrcmpi(argv[2], TEXT("-CreateXXH128")) == 0)
+			{
+				fileList->uiCmdOpts = CMD_XXH128;
+			}
+			else if (lstrcmpi(argv[2], TEXT("-CreateK12")) == 0)
+			{
+				fileList->uiCmdOpts = CMD_K12;
+			}
+			else if (lstrcmpi(argv[2], TEXT("-CreateCRC64")) == 0)
+			{
+				fileList->uiCmdOpts = CMD_CRC64;
+			}
 			else if(lstrcmpi(argv[2], TEXT("-PutNAME")) == 0)
 			{
 				g_pstatus.bStartedWithClosableShellExtAction = TRUE;
@@ -131,10 +147,13 @@ lFILEINFO *ParseCommandLine(BOOL *bPipeNecessary) {
 				fileList->uiCmdOpts = CMD_FORCE_NORMAL;
 			}
 		}
+		// -ConcurrentFiles:N may follow the action or take its place
+		for(INT i = 2; i < argc; ++i)
+			IsConcurrentFilesSwitch(argv[i], &fileList->uiConcurrentFiles);
 		if(g_program_options.bEnableQueue && !g_program_options.bAlwaysUseNewWindow) {
 			prevInst = FindSameVersionMainWindow();
 			if(prevInst) {
-				PostMessage(prevInst,WM_ACCEPT_PIPE,(WPARAM)fileList->uiCmdOpts,NULL);
+				PostMessage(prevInst,WM_ACCEPT_PIPE,(WPARAM)fileList->uiCmdOpts,(LPARAM)fileList->uiConcurrentFiles);
 				delete fileList;
 				LocalFree(argv);
 
@@ -166,6 +185,8 @@ lFILEINFO *ParseCommandLine(BOOL *bPipeNecessary) {
 		}
 
 		for(INT i = 0; i < iNumFiles; ++i){
+			if(IsConcurrentFilesSwitch(argv[i+1], &fileList->uiConcurrentFiles))
+				continue;
             fileinfoTmp.szFilename = argv[i+1];
 			fileList->fInfos.push_back(fileinfoTmp);
 		}
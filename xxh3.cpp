@@ -0,0 +1,527 @@
+#include "xxh3.h"
+#include "cpu_features.h"
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/*
+ * XXH3-128 (xxHash 0.8) with the default secret and seed 0, producing the same values
+ * as xxhsum -H2. Inputs above 240 bytes are hashed by eight 64-bit accumulators that
+ * take one 64 byte stripe per step; the accumulate and scramble loops are templates
+ * over a small vector class, so the same code runs with SSE2, AVX2 and AVX-512.
+ */
+
+typedef unsigned long long u64;
+typedef unsigned int u32;
+typedef unsigned char u8;
+
+#define PRIME32_1	0x9E3779B1U
+#define PRIME32_2	0x85EBCA77U
+#define PRIME32_3	0xC2B2AE3DU
+
+#define PRIME64_1	0x9E3779B185EBCA87ULL
+#define PRIME64_2	0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3	0x165667B19E3779F9ULL
+#define PRIME64_4	0x85EBCA77C2B2AE63ULL
+#define PRIME64_5	0x27D4EB2F165667C5ULL
+
+#define PRIME_MX1	0x165667919E3779F9ULL
+#define PRIME_MX2	0x9FB21C651E98DF25ULL
+
+#define SECRET_SIZE				192
+#define SECRET_SIZE_MIN			136
+#define SECRET_CONSUME_RATE		8
+#define SECRET_LASTACC_START	7
+#define SECRET_MERGEACCS_START	11
+#define MIDSIZE_MAX				240
+#define MIDSIZE_STARTOFFSET		3
+#define MIDSIZE_LASTOFFSET		17
+
+/* stripes between two scrambles and the secret offset of the scramble */
+#define STRIPES_PER_BLOCK		((SECRET_SIZE - XXH3_STRIPE_LEN) / SECRET_CONSUME_RATE)
+#define SECRET_LIMIT			(SECRET_SIZE - XXH3_STRIPE_LEN)
+
+static const u8 kSecret[SECRET_SIZE] = {
+	0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+	0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+	0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+	0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+	0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+	0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+	0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+	0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+	0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+	0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+	0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+	0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+// //////////////////////////////////////////////////////////
+// scalar helpers
+
+static inline u32 readLE32(const u8 *p) { u32 v; memcpy(&v, p, sizeof(v)); return v; }
+static inline u64 readLE64(const u8 *p) { u64 v; memcpy(&v, p, sizeof(v)); return v; }
+
+#if defined(_MSC_VER)
+static inline u32 swap32(u32 x) { return _byteswap_ulong(x); }
+static inline u64 swap64(u64 x) { return _byteswap_uint64(x); }
+#else
+static inline u32 swap32(u32 x) { return __builtin_bswap32(x); }
+static inline u64 swap64(u64 x) { return __builtin_bswap64(x); }
+#endif
+static inline u32 rotl32(u32 x, int r) { return (x << r) | (x >> (32 - r)); }
+static inline u64 rotl64(u64 x, int r) { return (x << r) | (x >> (64 - r)); }
+static inline u64 xorshift64(u64 x, int s) { return x ^ (x >> s); }
+
+static inline u64 mult32to64(u64 a, u64 b) { return (u64)(u32)a * (u64)(u32)b; }
+
+/* full 64x64->128 multiply, returns the low half and stores the high half */
+static inline u64 mult64to128(u64 lhs, u64 rhs, u64 *hi)
+{
+#if defined(_M_X64)
+	return _umul128(lhs, rhs, hi);
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 const product = (unsigned __int128)lhs * rhs;
+	*hi = (u64)(product >> 64);
+	return (u64)product;
+#else
+	u64 const lo_lo = mult32to64(lhs, rhs);
+	u64 const hi_lo = mult32to64(lhs >> 32, rhs);
+	u64 const lo_hi = mult32to64(lhs, rhs >> 32);
+	u64 const hi_hi = mult32to64(lhs >> 32, rhs >> 32);
+	u64 const cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+	*hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+	return (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+}
+
+static inline u64 mul128_fold64(u64 lhs, u64 rhs)
+{
+	u64 hi;
+	u64 lo = mult64to128(lhs, rhs, &hi);
+	return lo ^ hi;
+}
+
+static u64 XXH64_avalanche(u64 h)
+{
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+static u64 XXH3_avalanche(u64 h)
+{
+	h = xorshift64(h, 37);
+	h *= PRIME_MX1;
+	return xorshift64(h, 32);
+}
+
+// //////////////////////////////////////////////////////////
+// inputs up to 240 bytes
+
+typedef struct {
+	u64 low64;
+	u64 high64;
+} XXH128_HASH;
+
+static XXH128_HASH len_1to3(const u8 *input, size_t len)
+{
+	u8 const c1 = input[0];
+	u8 const c2 = input[len >> 1];
+	u8 const c3 = input[len - 1];
+	u32 const combinedl = ((u32)c1 << 16) | ((u32)c2 << 24) | ((u32)c3 << 0) | ((u32)len << 8);
+	u32 const combinedh = rotl32(swap32(combinedl), 13);
+	u64 const bitflipl = readLE32(kSecret) ^ readLE32(kSecret + 4);
+	u64 const bitfliph = readLE32(kSecret + 8) ^ readLE32(kSecret + 12);
+	XXH128_HASH h;
+	h.low64 = XXH64_avalanche((u64)combinedl ^ bitflipl);
+	h.high64 = XXH64_avalanche((u64)combinedh ^ bitfliph);
+	return h;
+}
+
+static XXH128_HASH len_4to8(const u8 *input, size_t len)
+{
+	u32 const input_lo = readLE32(input);
+	u32 const input_hi = readLE32(input + len - 4);
+	u64 const input_64 = input_lo + ((u64)input_hi << 32);
+	u64 const bitflip = readLE64(kSecret + 16) ^ readLE64(kSecret + 24);
+	XXH128_HASH m;
+
+	m.low64 = mult64to128(input_64 ^ bitflip, PRIME64_1 + (len << 2), &m.high64);
+	m.high64 += (m.low64 << 1);
+	m.low64 ^= (m.high64 >> 3);
+	m.low64 = xorshift64(m.low64, 35);
+	m.low64 *= PRIME_MX2;
+	m.low64 = xorshift64(m.low64, 28);
+	m.high64 = XXH3_avalanche(m.high64);
+	return m;
+}
+
+static XXH128_HASH len_9to16(const u8 *input, size_t len)
+{
+	u64 const bitflipl = readLE64(kSecret + 32) ^ readLE64(kSecret + 40);
+	u64 const bitfliph = readLE64(kSecret + 48) ^ readLE64(kSecret + 56);
+	u64 const input_lo = readLE64(input);
+	u64 input_hi = readLE64(input + len - 8);
+	XXH128_HASH m, h;
+
+	m.low64 = mult64to128(input_lo ^ input_hi ^ bitflipl, PRIME64_1, &m.high64);
+	m.low64 += (u64)(len - 1) << 54;
+	input_hi ^= bitfliph;
+	m.high64 += input_hi + mult32to64((u32)input_hi, PRIME32_2 - 1);
+	m.low64 ^= swap64(m.high64);
+
+	/* 128x64 multiply: h = m * PRIME64_2 */
+	h.low64 = mult64to128(m.low64, PRIME64_2, &h.high64);
+	h.high64 += m.high64 * PRIME64_2;
+	h.low64 = XXH3_avalanche(h.low64);
+	h.high64 = XXH3_avalanche(h.high64);
+	return h;
+}
+
+static XXH128_HASH len_0to16(const u8 *input, size_t len)
+{
+	if (len > 8)
+		return len_9to16(input, len);
+	if (len >= 4)
+		return len_4to8(input, len);
+	if (len)
+		return len_1to3(input, len);
+
+	XXH128_HASH h;
+	h.low64 = XXH64_avalanche(readLE64(kSecret + 64) ^ readLE64(kSecret + 72));
+	h.high64 = XXH64_avalanche(readLE64(kSecret + 80) ^ readLE64(kSecret + 88));
+	return h;
+}
+
+static inline u64 mix16B(const u8 *input, const u8 *secret, u64 seed)
+{
+	return mul128_fold64(readLE64(input) ^ (readLE64(secret) + seed),
+						 readLE64(input + 8) ^ (readLE64(secret + 8) - seed));
+}
+
+static inline XXH128_HASH mix32B(XXH128_HASH acc, const u8 *input_1, const u8 *input_2, const u8 *secret, u64 seed)
+{
+	acc.low64 += mix16B(input_1, secret, seed);
+	acc.low64 ^= readLE64(input_2) + readLE64(input_2 + 8);
+	acc.high64 += mix16B(input_2, secret + 16, seed);
+	acc.high64 ^= readLE64(input_1) + readLE64(input_1 + 8);
+	return acc;
+}
+
+static XXH128_HASH finalize_mid(XXH128_HASH acc, size_t len)
+{
+	XXH128_HASH h;
+	h.low64 = acc.low64 + acc.high64;
+	h.high64 = (acc.low64 * PRIME64_1) + (acc.high64 * PRIME64_4) + ((u64)len * PRIME64_2);
+	h.low64 = XXH3_avalanche(h.low64);
+	h.high64 = (u64)0 - XXH3_avalanche(h.high64);
+	return h;
+}
+
+static XXH128_HASH len_17to128(const u8 *input, size_t len)
+{
+	XXH128_HASH acc;
+	acc.low64 = len * PRIME64_1;
+	acc.high64 = 0;
+
+	if (len > 32) {
+		if (len > 64) {
+			if (len > 96)
+				acc = mix32B(acc, input + 48, input + len - 64, kSecret + 96, 0);
+			acc = mix32B(acc, input + 32, input + len - 48, kSecret + 64, 0);
+		}
+		acc = mix32B(acc, input + 16, input + len - 32, kSecret + 32, 0);
+	}
+	acc = mix32B(acc, input, input + len - 16, kSecret, 0);
+	return finalize_mid(acc, len);
+}
+
+static XXH128_HASH len_129to240(const u8 *input, size_t len)
+{
+	XXH128_HASH acc;
+	size_t i;
+
+	acc.low64 = len * PRIME64_1;
+	acc.high64 = 0;
+	for (i = 32; i < 160; i += 32)
+		acc = mix32B(acc, input + i - 32, input + i - 16, kSecret + i - 32, 0);
+	acc.low64 = XXH3_avalanche(acc.low64);
+	acc.high64 = XXH3_avalanche(acc.high64);
+	for (i = 160; i <= len; i += 32)
+		acc = mix32B(acc, input + i - 32, input + i - 16, kSecret + MIDSIZE_STARTOFFSET + i - 160, 0);
+	acc = mix32B(acc, input + len - 16, input + len - 32,
+				 kSecret + SECRET_SIZE_MIN - MIDSIZE_LASTOFFSET - 16, 0);
+	return finalize_mid(acc, len);
+}
+
+// //////////////////////////////////////////////////////////
+// vector classes
+
+struct VecSSE2 {
+	typedef __m128i T;
+	enum { REGS = 4 };
+
+	static T load(const void *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static void store(void *p, T x) { _mm_storeu_si128((__m128i *)p, x); }
+	static T set1_32(u32 x) { return _mm_set1_epi32((int)x); }
+	static T add64(T a, T b) { return _mm_add_epi64(a, b); }
+	static T xor2(T a, T b) { return _mm_xor_si128(a, b); }
+	static T xor3(T a, T b, T c) { return _mm_xor_si128(_mm_xor_si128(a, b), c); }
+	static T mul32(T a, T b) { return _mm_mul_epu32(a, b); }
+	template<int n> static T shr64(T x) { return _mm_srli_epi64(x, n); }
+	template<int n> static T shl64(T x) { return _mm_slli_epi64(x, n); }
+	/* exchanges the two 64-bit words of each pair */
+	static T swap64(T x) { return _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)); }
+	static void prefetch(const void *p) { _mm_prefetch((const char *)p, _MM_HINT_T0); }
+	static void done() { }
+};
+
+#if !defined(_MSC_VER)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+struct VecAVX2 {
+	typedef __m256i T;
+	enum { REGS = 2 };
+
+	static T load(const void *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static void store(void *p, T x) { _mm256_storeu_si256((__m256i *)p, x); }
+	static T set1_32(u32 x) { return _mm256_set1_epi32((int)x); }
+	static T add64(T a, T b) { return _mm256_add_epi64(a, b); }
+	static T xor2(T a, T b) { return _mm256_xor_si256(a, b); }
+	static T xor3(T a, T b, T c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+	static T mul32(T a, T b) { return _mm256_mul_epu32(a, b); }
+	template<int n> static T shr64(T x) { return _mm256_srli_epi64(x, n); }
+	template<int n> static T shl64(T x) { return _mm256_slli_epi64(x, n); }
+	static T swap64(T x) { return _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)); }
+	static void prefetch(const void *p) { _mm_prefetch((const char *)p, _MM_HINT_T0); }
+	static void done() { _mm256_zeroupper(); }
+};
+
+#if !defined(_MSC_VER)
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx2,avx512f")
+#endif
+
+struct VecAVX512 {
+	typedef __m512i T;
+	enum { REGS = 1 };
+
+	static T load(const void *p) { return _mm512_loadu_si512(p); }
+	static void store(void *p, T x) { _mm512_storeu_si512(p, x); }
+	static T set1_32(u32 x) { return _mm512_set1_epi32((int)x); }
+	static T add64(T a, T b) { return _mm512_add_epi64(a, b); }
+	static T xor2(T a, T b) { return _mm512_xor_si512(a, b); }
+	static T xor3(T a, T b, T c) { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+	static T mul32(T a, T b) { return _mm512_mul_epu32(a, b); }
+	template<int n> static T shr64(T x) { return _mm512_srli_epi64(x, n); }
+	template<int n> static T shl64(T x) { return _mm512_slli_epi64(x, n); }
+	static T swap64(T x) { return _mm512_shuffle_epi32(x, (_MM_PERM_ENUM)_MM_SHUFFLE(1, 0, 3, 2)); }
+	static void prefetch(const void *p) { _mm_prefetch((const char *)p, _MM_HINT_T0); }
+	static void done() { _mm256_zeroupper(); }
+};
+
+#if !defined(_MSC_VER)
+#pragma GCC pop_options
+#endif
+
+// //////////////////////////////////////////////////////////
+// long inputs
+
+/* accumulates nbStripes consecutive stripes, the secret advances by 8 bytes per stripe;
+   if scramble is set the block is completed with a scramble at SECRET_LIMIT */
+template<class V>
+static void accumulate_block(u64 *acc, const u8 *input, const u8 *secret, size_t nbStripes, bool scramble)
+{
+	typedef typename V::T T;
+	T a[V::REGS];
+	int i;
+
+	for (i = 0; i < V::REGS; i++)
+		a[i] = V::load(acc + i * sizeof(T) / 8);
+
+	for (size_t n = 0; n < nbStripes; n++, input += XXH3_STRIPE_LEN, secret += SECRET_CONSUME_RATE) {
+		V::prefetch(input + 384);
+		for (i = 0; i < V::REGS; i++) {
+			T const data = V::load(input + i * sizeof(T));
+			T const key = V::xor2(data, V::load(secret + i * sizeof(T)));
+			/* acc += swap(data) + lo32(key) * hi32(key) */
+			T const product = V::mul32(key, V::template shr64<32>(key));
+			a[i] = V::add64(V::add64(a[i], V::swap64(data)), product);
+		}
+	}
+
+	if (scramble) {
+		T const prime32 = V::set1_32(PRIME32_1);
+		for (i = 0; i < V::REGS; i++) {
+			/* acc = (acc ^ (acc >> 47) ^ key) * PRIME32_1 */
+			T const key = V::xor3(a[i], V::template shr64<47>(a[i]), V::load(kSecret + SECRET_LIMIT + i * sizeof(T)));
+			T const prod_lo = V::mul32(key, prime32);
+			T const prod_hi = V::mul32(V::template shr64<32>(key), prime32);
+			a[i] = V::add64(prod_lo, V::template shl64<32>(prod_hi));
+		}
+	}
+
+	for (i = 0; i < V::REGS; i++)
+		V::store(acc + i * sizeof(T) / 8, a[i]);
+	V::done();
+}
+
+typedef void (*accumulate_func)(u64 *acc, const u8 *input, const u8 *secret, size_t nbStripes, bool scramble);
+
+/* instantiations beyond SSE2, compiled for the instruction sets of their vector class */
+CPU_KERNEL_TARGET("avx2")
+static void accumulate_block_avx2(u64 *acc, const u8 *input, const u8 *secret, size_t nbStripes, bool scramble)
+{
+	accumulate_block<VecAVX2>(acc, input, secret, nbStripes, scramble);
+}
+
+CPU_KERNEL_TARGET("avx2,avx512f")
+static void accumulate_block_avx512(u64 *acc, const u8 *input, const u8 *secret, size_t nbStripes, bool scramble)
+{
+	accumulate_block<VecAVX512>(acc, input, secret, nbStripes, scramble);
+}
+
+static const accumulate_func accumulate_funcs[3] = {
+	accumulate_block<VecSSE2>, accumulate_block_avx2, accumulate_block_avx512,
+};
+
+static int xxh3_level = -1;
+
+/* fastest first, the index counts down from the last entry of accumulate_funcs */
+static const CPU_KERNEL xxh3_kernels[] = {
+	{ "avx512",	CPU_AVX512F,	NULL },
+	{ "avx2",	CPU_AVX2,		NULL },
+	{ "sse2",	0,				NULL },
+};
+
+/* 0: SSE2, 1: AVX2, 2: AVX-512F */
+static int xxh3_select_level()
+{
+	return 2 - (int)cpu_select_kernel("xxh128", xxh3_kernels, 3);
+}
+
+/* feeds nbStripes stripes into the accumulators, scrambling at every block boundary */
+static void consume_stripes(u64 *acc, size_t *stripesSoFar, const u8 *input, size_t nbStripes)
+{
+	const accumulate_func accumulate = accumulate_funcs[xxh3_level];
+
+	while (nbStripes >= STRIPES_PER_BLOCK - *stripesSoFar) {
+		size_t const n = STRIPES_PER_BLOCK - *stripesSoFar;
+		accumulate(acc, input, kSecret + *stripesSoFar * SECRET_CONSUME_RATE, n, true);
+		input += n * XXH3_STRIPE_LEN;
+		nbStripes -= n;
+		*stripesSoFar = 0;
+	}
+	if (nbStripes) {
+		accumulate(acc, input, kSecret + *stripesSoFar * SECRET_CONSUME_RATE, nbStripes, false);
+		*stripesSoFar += nbStripes;
+	}
+}
+
+static u64 merge_accs(const u64 *acc, const u8 *secret, u64 start)
+{
+	u64 result = start;
+	for (int i = 0; i < 4; i++)
+		result += mul128_fold64(acc[2 * i] ^ readLE64(secret + 16 * i), acc[2 * i + 1] ^ readLE64(secret + 16 * i + 8));
+	return XXH3_avalanche(result);
+}
+
+// //////////////////////////////////////////////////////////
+// streaming interface
+
+void XXH3_128_Init(XXH3_128_CTX *c)
+{
+	if (xxh3_level < 0)
+		xxh3_level = xxh3_select_level();
+
+	c->acc[0] = PRIME32_3;
+	c->acc[1] = PRIME64_1;
+	c->acc[2] = PRIME64_2;
+	c->acc[3] = PRIME64_3;
+	c->acc[4] = PRIME64_4;
+	c->acc[5] = PRIME32_2;
+	c->acc[6] = PRIME64_5;
+	c->acc[7] = PRIME32_1;
+	c->bufferedSize = 0;
+	c->stripesSoFar = 0;
+	c->totalLen = 0;
+}
+
+void XXH3_128_Update(XXH3_128_CTX *c, const void *data, size_t len)
+{
+	const u8 *input = (const u8 *)data;
+	const u8 * const end = input + len;
+
+	c->totalLen += len;
+
+	if (len <= XXH3_BUFFER_SIZE - c->bufferedSize) {
+		memcpy(c->buffer + c->bufferedSize, input, len);
+		c->bufferedSize += len;
+		return;
+	}
+
+	/* the last stripe is never consumed here, it may turn out to be the final one */
+	if (c->bufferedSize) {
+		size_t const loadSize = XXH3_BUFFER_SIZE - c->bufferedSize;
+		memcpy(c->buffer + c->bufferedSize, input, loadSize);
+		input += loadSize;
+		consume_stripes(c->acc, &c->stripesSoFar, c->buffer, XXH3_BUFFER_SIZE / XXH3_STRIPE_LEN);
+		c->bufferedSize = 0;
+	}
+	if (end - input > XXH3_BUFFER_SIZE) {
+		size_t const nbStripes = (size_t)(end - 1 - input) / XXH3_STRIPE_LEN;
+		consume_stripes(c->acc, &c->stripesSoFar, input, nbStripes);
+		input += nbStripes * XXH3_STRIPE_LEN;
+		/* keep the stripe before the tail, Final may need it to complete the last stripe */
+		memcpy(c->buffer + XXH3_BUFFER_SIZE - XXH3_STRIPE_LEN, input - XXH3_STRIPE_LEN, XXH3_STRIPE_LEN);
+	}
+	memcpy(c->buffer, input, (size_t)(end - input));
+	c->bufferedSize = (size_t)(end - input);
+}
+
+void XXH3_128_Final(unsigned char *md, XXH3_128_CTX *c)
+{
+	XXH128_HASH h;
+
+	if (c->totalLen > MIDSIZE_MAX) {
+		u8 lastStripe[XXH3_STRIPE_LEN];
+		const u8 *lastStripePtr;
+
+		if (c->bufferedSize >= XXH3_STRIPE_LEN) {
+			size_t const nbStripes = (c->bufferedSize - 1) / XXH3_STRIPE_LEN;
+			consume_stripes(c->acc, &c->stripesSoFar, c->buffer, nbStripes);
+			lastStripePtr = c->buffer + c->bufferedSize - XXH3_STRIPE_LEN;
+		} else {
+			size_t const catchupSize = XXH3_STRIPE_LEN - c->bufferedSize;
+			memcpy(lastStripe, c->buffer + XXH3_BUFFER_SIZE - catchupSize, catchupSize);
+			memcpy(lastStripe + catchupSize, c->buffer, c->bufferedSize);
+			lastStripePtr = lastStripe;
+		}
+		accumulate_funcs[xxh3_level](c->acc, lastStripePtr, kSecret + SECRET_LIMIT - SECRET_LASTACC_START, 1, false);
+
+		h.low64 = merge_accs(c->acc, kSecret + SECRET_MERGEACCS_START, c->totalLen * PRIME64_1);
+		h.high64 = merge_accs(c->acc, kSecret + SECRET_SIZE - sizeof(c->acc) - SECRET_MERGEACCS_START,
+							  ~(c->totalLen * PRIME64_2));
+	} else if (c->totalLen <= 16) {
+		h = len_0to16(c->buffer, (size_t)c->totalLen);
+	} else if (c->totalLen <= 128) {
+		h = len_17to128(c->buffer, (size_t)c->totalLen);
+	} else {
+		h = len_129to240(c->buffer, (size_t)c->totalLen);
+	}
+
+	for (int i = 0; i < 8; i++) {
+		md[i] = (u8)(h.high64 >> (56 - 8 * i));
+		md[8 + i] = (u8)(h.low64 >> (56 - 8 * i));
+	}
+}
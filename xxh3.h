@@ -0,0 +1,25 @@
+#ifndef HEADER_XXH3_H
+#define HEADER_XXH3_H
+
+#include <stddef.h>
+
+#define XXH3_128_DIGEST_LENGTH	16
+
+#define XXH3_STRIPE_LEN			64
+#define XXH3_BUFFER_SIZE		256
+
+/* streaming state of XXH3-128 with the default secret and seed 0 */
+typedef struct _XXH3_128_CTX {
+	unsigned long long	acc[8];
+	unsigned char		buffer[XXH3_BUFFER_SIZE];
+	size_t				bufferedSize;
+	size_t				stripesSoFar;	/* stripes accumulated in the current block */
+	unsigned long long	totalLen;
+} XXH3_128_CTX;
+
+void XXH3_128_Init(XXH3_128_CTX *c);
+void XXH3_128_Update(XXH3_128_CTX *c, const void *data, size_t len);
+/* writes the canonical (big endian) form, the byte order xxhsum displays */
+void XXH3_128_Final(unsigned char *md, XXH3_128_CTX *c);
+
+#endif